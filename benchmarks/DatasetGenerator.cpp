@@ -0,0 +1,296 @@
+#include "DatasetGenerator.h"
+
+#include <Wt/Auth/HashFunction.h>
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <random>
+#include <sqlite3.h>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "File.h"
+#include "MimeType.h"
+#include "SqliteStatement.h"
+#include "StorageApplication.h"
+
+namespace {
+
+struct FileType {
+    std::string_view extension;
+    // Written at the start of the file so that its type is detected.
+    std::string_view signature;
+    bool isText;
+    int weight;
+};
+
+}
+
+constexpr std::array<FileType, 8> FILE_TYPES { {
+    { "txt", "", true, 25 },
+    { "md", "", true, 10 },
+    { "csv", "", true, 10 },
+    { "cpp", "", true, 10 },
+    { "json", "", true, 5 },
+    { "pdf", "%PDF-1.7\n", false, 15 },
+    { "zip", "PK\x03\x04", false, 10 },
+    { "bin", "", false, 15 },
+} };
+
+constexpr std::array<std::string_view, 12> WORDS { "goose", "lecture", "notes", "assignment", "final", "draft", "lab", "report", "midterm", "review", "project", "week" };
+
+// How spread out file sizes are around the median. With this value, about 1%
+// of files are over 30 times the median.
+constexpr double FILE_SIZE_SIGMA = 1.5;
+
+// The chance that a new folder goes inside the previous one, which makes
+// long chains of nested folders.
+constexpr double NESTING_CHANCE = 0.3;
+
+// The chance that a file goes in the user's root folder.
+constexpr double ROOT_FILE_CHANCE = 0.25;
+
+// The most files kept as candidates for duplicate content.
+constexpr std::size_t MAX_CONTENT_SOURCES = 10000;
+
+constexpr std::size_t CHUNK_SIZE = 64 * 1024;
+
+/**
+ * Generates the content of a file, piece by piece.
+ */
+class ContentStream {
+public:
+    ContentStream(uint64_t seed, uint64_t size, const FileType& type)
+        : m_random(seed)
+        , m_remaining(size)
+        , m_type(type)
+    {
+    }
+
+    /**
+     * Generates up to `maxSize` more bytes, or an empty string at the end.
+     */
+    std::string next(std::size_t maxSize)
+    {
+        std::string chunk;
+        std::size_t size = static_cast<std::size_t>(std::min<uint64_t>(maxSize, m_remaining));
+        chunk.reserve(size);
+        if (!m_hasStarted) {
+            chunk.append(m_type.signature.substr(0, size));
+            m_hasStarted = true;
+        }
+
+        while (chunk.size() < size) {
+            if (m_type.isText) {
+                std::string_view word = WORDS[m_random() % WORDS.size()];
+                chunk.append(word.substr(0, size - chunk.size()));
+                if (chunk.size() < size) {
+                    chunk.push_back(m_random() % 8 == 0 ? '\n' : ' ');
+                }
+            } else {
+                uint64_t bytes = m_random();
+                for (int i = 0; i < 8 && chunk.size() < size; ++i) {
+                    chunk.push_back(static_cast<char>((bytes >> (i * 8)) & 0xff));
+                }
+            }
+        }
+
+        m_remaining -= chunk.size();
+        return chunk;
+    }
+
+private:
+    std::mt19937_64 m_random;
+    uint64_t m_remaining;
+    const FileType& m_type;
+    bool m_hasStarted { false };
+};
+
+DatasetGenerator::DatasetGenerator(Options options)
+    : m_options(options)
+    , m_random(options.seed)
+{
+    std::vector<int> weights;
+    for (const auto& type : FILE_TYPES) {
+        weights.push_back(type.weight);
+    }
+    m_fileTypes = std::discrete_distribution<std::size_t>(weights.begin(), weights.end());
+
+    m_options.userCount = std::max(0LL, m_options.userCount);
+    m_options.batchSize = std::max(1LL, m_options.batchSize);
+    m_options.maxDepth = std::max(1, m_options.maxDepth);
+}
+
+DatasetGenerator::Summary DatasetGenerator::generate(const std::filesystem::path& directory)
+{
+    m_userFilesPath = directory / File::FILE_SYSTEM_ROOT;
+    std::filesystem::create_directories(m_userFilesPath);
+    auto databasePath = (directory / StorageApplication::DATABASE_PATH).string();
+
+    // The tables are created through Wt::Dbo so that they match the real
+    // ones exactly.
+    StorageApplication::createDatabaseSession(databasePath);
+
+    if (sqlite3_open(databasePath.c_str(), &m_database) != SQLITE_OK) {
+        sqlite3_close(m_database);
+        throw std::runtime_error("Failed to open " + databasePath);
+    }
+    std::unique_ptr<sqlite3, int (*)(sqlite3*)> databaseGuard(m_database, sqlite3_close);
+
+    {
+        sqlite3_stmt* countStatement = nullptr;
+        sqlite3_prepare_v2(m_database, "SELECT COUNT(*) FROM users", -1, &countStatement, nullptr);
+        bool hasUsers = sqlite3_step(countStatement) == SQLITE_ROW && sqlite3_column_int64(countStatement, 0) > 0;
+        sqlite3_finalize(countStatement);
+        if (hasUsers) {
+            throw std::runtime_error(databasePath + " already has users. Please generate data in an empty directory.");
+        }
+    }
+
+    SqliteStatement::execute(m_database, "PRAGMA synchronous = OFF");
+    SqliteStatement::execute(m_database, "BEGIN");
+
+    SqliteStatement insertUser(m_database, "INSERT INTO users (id, version, username, password_hash, root_folder_id) VALUES (?, 0, ?, ?, ?)");
+    SqliteStatement insertFolder(m_database, "INSERT INTO folders (id, version, name, owner_id, parent_id) VALUES (?, 0, ?, ?, ?)");
+    SqliteStatement insertFile(m_database, "INSERT INTO files (id, version, name, owner_id, parent_id, file_size, extension, mime_type, segment_id, segment_offset) VALUES (?, 0, ?, ?, ?, ?, ?, ?, 0, 0)");
+    SqliteStatement insertSharingLink(m_database, "INSERT INTO sharing_links (id, version, url_id, file_id) VALUES (?, 0, ?, ?)");
+
+    // Hashing is slow on purpose, so every user gets the same hash.
+    std::string passwordHash = Wt::Auth::BCryptHashFunction().compute(PASSWORD, "");
+
+    long long nextFolderId = 1;
+    long long nextFileId = 1;
+    std::bernoulli_distribution isInRoot(ROOT_FILE_CHANCE);
+    std::bernoulli_distribution isShared(m_options.sharedFraction);
+    for (long long userId = 1; userId <= m_options.userCount; ++userId) {
+        long long rootFolderId = nextFolderId++;
+        insertUser.bind(1, userId).bind(2, "user-" + std::to_string(userId)).bind(3, passwordHash).bind(4, rootFolderId).run();
+        countRow();
+        insertFolder.bind(1, rootFolderId).bind(2, std::string("~root")).bind(3, userId).bindNull(4).run();
+        countRow();
+        ++m_summary.userCount;
+
+        auto folderIds = generateFolders(insertFolder, userId, rootFolderId, nextFolderId);
+        m_summary.folderCount += static_cast<long long>(folderIds.size()) - 1;
+
+        long long fileCount = std::uniform_int_distribution<long long>(0, 2 * m_options.filesPerUser)(m_random);
+        for (long long i = 0; i < fileCount; ++i) {
+            long long fileId = nextFileId++;
+            long long parentId = isInRoot(m_random) ? rootFolderId : folderIds[m_random() % folderIds.size()];
+            auto file = pickFile();
+            const auto& type = FILE_TYPES[file.typeIndex];
+
+            std::string name = std::string(WORDS[m_random() % WORDS.size()]) + "-" + std::to_string(fileId) + "." + std::string(type.extension);
+            std::string header = ContentStream(file.contentSeed, file.size, type).next(MimeType::HEADER_SIZE);
+            std::string mimeType(MimeType::detect(header, type.extension));
+
+            insertFile.bind(1, fileId).bind(2, name).bind(3, userId).bind(4, parentId).bind(5, static_cast<long long>(file.size)).bind(6, std::string(type.extension)).bind(7, mimeType).run();
+            countRow();
+            ++m_summary.fileCount;
+            m_summary.totalFileSize += file.size;
+
+            if (isShared(m_random)) {
+                insertSharingLink.bind(1, ++m_summary.sharingLinkCount).bind(2, generateUrlId()).bind(3, fileId).run();
+                countRow();
+            }
+
+            if (m_options.writesContent) {
+                writeContent(fileId, file);
+            }
+        }
+    }
+
+    SqliteStatement::execute(m_database, "COMMIT");
+    SqliteStatement::execute(m_database, "ANALYZE");
+    m_database = nullptr;
+    return m_summary;
+}
+
+void DatasetGenerator::countRow()
+{
+    if (++m_rowsInTransaction >= m_options.batchSize) {
+        SqliteStatement::execute(m_database, "COMMIT");
+        SqliteStatement::execute(m_database, "BEGIN");
+        m_rowsInTransaction = 0;
+    }
+}
+
+std::vector<long long> DatasetGenerator::generateFolders(SqliteStatement& insertFolder, long long userId, long long rootFolderId, long long& nextFolderId)
+{
+    std::vector<long long> folderIds { rootFolderId };
+    std::vector<int> depths { 0 };
+    std::bernoulli_distribution isNested(NESTING_CHANCE);
+    long long folderCount = std::uniform_int_distribution<long long>(0, 2 * m_options.foldersPerUser)(m_random);
+    for (long long i = 0; i < folderCount; ++i) {
+        // Either nest inside the last folder, or pick any folder, which tends
+        // to make the shallow folders wide.
+        std::size_t parentIndex = folderIds.size() - 1;
+        if (!isNested(m_random) || depths[parentIndex] >= m_options.maxDepth) {
+            parentIndex = m_random() % folderIds.size();
+            while (depths[parentIndex] >= m_options.maxDepth) {
+                parentIndex = m_random() % folderIds.size();
+            }
+        }
+
+        long long folderId = nextFolderId++;
+        std::string name = std::string(WORDS[m_random() % WORDS.size()]) + "-" + std::to_string(folderId);
+        insertFolder.bind(1, folderId).bind(2, name).bind(3, userId).bind(4, folderIds[parentIndex]).run();
+        countRow();
+
+        folderIds.push_back(folderId);
+        depths.push_back(depths[parentIndex] + 1);
+    }
+    return folderIds;
+}
+
+DatasetGenerator::GeneratedFile DatasetGenerator::pickFile()
+{
+    if (!m_contentSources.empty() && std::bernoulli_distribution(m_options.duplicateFraction)(m_random)) {
+        return m_contentSources[m_random() % m_contentSources.size()];
+    }
+
+    std::lognormal_distribution<double> sizes(std::log(static_cast<double>(std::max<uint64_t>(1, m_options.medianFileSize))), FILE_SIZE_SIGMA);
+
+    GeneratedFile file {};
+    file.contentSeed = m_random();
+    file.size = std::min(m_options.maxFileSize, static_cast<uint64_t>(sizes(m_random)));
+    file.typeIndex = m_fileTypes(m_random);
+
+    // Keep a random sample of earlier files to copy from.
+    if (m_contentSources.size() < MAX_CONTENT_SOURCES) {
+        m_contentSources.push_back(file);
+    } else {
+        m_contentSources[m_random() % MAX_CONTENT_SOURCES] = file;
+    }
+    return file;
+}
+
+void DatasetGenerator::writeContent(long long fileId, const GeneratedFile& file) const
+{
+    auto path = m_userFilesPath / std::to_string(fileId);
+    std::ofstream output(path, std::ios::binary | std::ios::trunc);
+    ContentStream content(file.contentSeed, file.size, FILE_TYPES[file.typeIndex]);
+    for (std::string chunk = content.next(CHUNK_SIZE); !chunk.empty(); chunk = content.next(CHUNK_SIZE)) {
+        output.write(chunk.data(), static_cast<std::streamsize>(chunk.size()));
+    }
+    if (!output.flush()) {
+        throw std::runtime_error("Failed to write " + path.string());
+    }
+}
+
+std::string DatasetGenerator::generateUrlId()
+{
+    // The same characters and length as SharingLink::generateRandomUrlID, but
+    // from the seeded generator.
+    constexpr std::string_view characters = "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789-_";
+    std::string urlId;
+    for (int i = 0; i < 15; ++i) {
+        urlId += characters[m_random() % characters.size()];
+    }
+    return urlId;
+}
@@ -0,0 +1,131 @@
+/**
+ * \class DatasetGenerator
+ *
+ * Fills an empty Cloud Goose Storage database and `userFiles` folder with
+ * realistic generated data, for performance testing.
+ *
+ * Each user gets a folder tree that mixes long chains of nested folders with
+ * wide folders, and files whose sizes follow a log-normal distribution so
+ * that most are small and a few are large. Some files have the same content
+ * as an earlier file, and some are shared. The same options and seed always
+ * produce exactly the same data.
+ *
+ * Rows are inserted with prepared statements in large transactions, and file
+ * content is written directly, so millions of files can be created quickly.
+ *
+ * \date 2026-10-19 (last updated)
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <random>
+#include <sqlite3.h>
+#include <string>
+#include <vector>
+#include "SqliteStatement.h"
+
+class DatasetGenerator {
+public:
+    struct Options {
+        // The number of users to create.
+        long long userCount { 100 };
+
+        // The average number of folders and files that each user has.
+        long long foldersPerUser { 50 };
+        long long filesPerUser { 200 };
+
+        // The deepest that a folder can be, where the root folder is 0.
+        int maxDepth { 8 };
+
+        // The median and largest file sizes, in bytes.
+        uint64_t medianFileSize { 16 * 1024 };
+        uint64_t maxFileSize { 8 * 1024 * 1024 };
+
+        // The fraction of files that copy the content of an earlier file, and
+        // the fraction that have a sharing link.
+        double duplicateFraction { 0.1 };
+        double sharedFraction { 0.05 };
+
+        // Whether to write file content, or only the database rows.
+        bool writesContent { true };
+
+        // The number of rows inserted in each transaction.
+        long long batchSize { 100000 };
+
+        uint64_t seed { 1 };
+    };
+
+    struct Summary {
+        long long userCount { 0 };
+        long long folderCount { 0 };
+        long long fileCount { 0 };
+        long long sharingLinkCount { 0 };
+        uint64_t totalFileSize { 0 };
+    };
+
+    /**
+     * The password of every generated user.
+     */
+    constexpr static const char* PASSWORD = "password";
+
+    explicit DatasetGenerator(Options options);
+
+    /**
+     * Generates the data in a directory.
+     *
+     * The database is created if it doesn't exist, but must not contain any
+     * users yet.
+     *
+     * \param directory The directory that holds `CloudGooseStorage.db` and
+     *                  `userFiles`.
+     * \return          What was generated.
+     * \exception std::runtime_error If the database already has data or
+     *                               anything can't be written.
+     */
+    Summary generate(const std::filesystem::path& directory);
+
+private:
+    struct GeneratedFile {
+        uint64_t contentSeed;
+        uint64_t size;
+        std::size_t typeIndex;
+    };
+
+    Options m_options;
+    std::mt19937_64 m_random;
+    std::discrete_distribution<std::size_t> m_fileTypes;
+    Summary m_summary;
+    sqlite3* m_database { nullptr };
+    std::filesystem::path m_userFilesPath;
+    long long m_rowsInTransaction { 0 };
+
+    // Files whose content can be copied by later files.
+    std::vector<GeneratedFile> m_contentSources;
+
+    /**
+     * Commits the current transaction and starts another once it has enough
+     * rows in it.
+     */
+    void countRow();
+
+    /**
+     * Creates a random number of folders for a user, returning their IDs
+     * along with the root folder's.
+     */
+    std::vector<long long> generateFolders(SqliteStatement& insertFolder, long long userId, long long rootFolderId, long long& nextFolderId);
+
+    /**
+     * Picks the type, size and content of the next file.
+     */
+    GeneratedFile pickFile();
+
+    /**
+     * Writes the content of a file, which is fully determined by its seed,
+     * size and type.
+     */
+    void writeContent(long long fileId, const GeneratedFile& file) const;
+
+    std::string generateUrlId();
+};
@@ -0,0 +1,105 @@
+// Fills a directory with generated users, folders, files and sharing links
+// for performance testing. See DatasetGenerator for what is generated.
+//
+// The server can then be run from the directory:
+//
+//     build/generate-dataset --users 1000 --output data
+//     cd data && ../build/cs3307-group-project --docroot ../docroot --http-listen 127.0.0.1:8080 -c ../wt_config.xml
+
+#include <chrono>
+#include <cstdlib>
+#include <exception>
+#include <filesystem>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include "DatasetGenerator.h"
+
+static void printUsage(const char* program)
+{
+    DatasetGenerator::Options defaults;
+    std::cerr << "Usage: " << program << " [options]\n"
+              << "  --output PATH          directory to fill (default .)\n"
+              << "  --users N              number of users (default " << defaults.userCount << ")\n"
+              << "  --folders-per-user N   average folders per user (default " << defaults.foldersPerUser << ")\n"
+              << "  --files-per-user N     average files per user (default " << defaults.filesPerUser << ")\n"
+              << "  --max-depth N          deepest folder nesting (default " << defaults.maxDepth << ")\n"
+              << "  --median-size BYTES    median file size (default " << defaults.medianFileSize << ")\n"
+              << "  --max-size BYTES       largest file size (default " << defaults.maxFileSize << ")\n"
+              << "  --duplicates FRACTION  files that copy earlier content (default " << defaults.duplicateFraction << ")\n"
+              << "  --shared FRACTION      files with a sharing link (default " << defaults.sharedFraction << ")\n"
+              << "  --batch-size N         rows per transaction (default " << defaults.batchSize << ")\n"
+              << "  --seed N               random seed (default " << defaults.seed << ")\n"
+              << "  --no-content           only create database rows, without file content\n";
+}
+
+int main(int argc, char** argv)
+{
+    DatasetGenerator::Options options;
+    std::filesystem::path output = ".";
+
+    // NOLINTBEGIN (cppcoreguidelines-pro-bounds-pointer-arithmetic)
+    std::vector<std::string> args { argv + 1, argv + argc };
+    // NOLINTEND
+    try {
+        for (std::size_t i = 0; i < args.size(); ++i) {
+            const std::string& name = args[i];
+            if (name == "--help") {
+                printUsage(argv[0]);
+                return EXIT_SUCCESS;
+            }
+            if (name == "--no-content") {
+                options.writesContent = false;
+                continue;
+            }
+            if (i + 1 >= args.size()) {
+                throw std::invalid_argument("Missing value for " + name);
+            }
+            const std::string& value = args[++i];
+            if (name == "--output") {
+                output = value;
+            } else if (name == "--users") {
+                options.userCount = std::stoll(value);
+            } else if (name == "--folders-per-user") {
+                options.foldersPerUser = std::stoll(value);
+            } else if (name == "--files-per-user") {
+                options.filesPerUser = std::stoll(value);
+            } else if (name == "--max-depth") {
+                options.maxDepth = std::stoi(value);
+            } else if (name == "--median-size") {
+                options.medianFileSize = std::stoull(value);
+            } else if (name == "--max-size") {
+                options.maxFileSize = std::stoull(value);
+            } else if (name == "--duplicates") {
+                options.duplicateFraction = std::stod(value);
+            } else if (name == "--shared") {
+                options.sharedFraction = std::stod(value);
+            } else if (name == "--batch-size") {
+                options.batchSize = std::stoll(value);
+            } else if (name == "--seed") {
+                options.seed = std::stoull(value);
+            } else {
+                throw std::invalid_argument("Unknown option " + name);
+            }
+        }
+    } catch (const std::exception& ex) {
+        std::cerr << ex.what() << std::endl;
+        printUsage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    try {
+        auto start = std::chrono::steady_clock::now();
+        auto summary = DatasetGenerator(options).generate(output);
+        double elapsedSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        std::cout << "Generated " << summary.userCount << " users, " << summary.folderCount << " folders, " << summary.fileCount << " files ("
+                  << summary.totalFileSize << " bytes) and " << summary.sharingLinkCount << " sharing links in " << elapsedSeconds << " s" << std::endl;
+        std::cout << "Users are named user-1 to user-" << summary.userCount << ", with the password \"" << DatasetGenerator::PASSWORD << "\"" << std::endl;
+    } catch (const std::exception& ex) {
+        std::cerr << "Exception: " << ex.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
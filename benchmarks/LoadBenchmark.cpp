@@ -0,0 +1,461 @@
+// A load test that runs the server in-process and drives many simulated users
+// through it at once, timing each kind of operation.
+//
+// Operations that the JSON API or the plain HTML login page support are sent
+// over HTTP to the running server. Sorting, searching and sharing are only
+// done by the web interface, whose events can't easily be scripted, so they
+// are timed by calling the same model code that the pages use.
+//
+// The results are written as JSON so that runs can be compared by scripts.
+
+#include <Wt/Dbo/Session.h>
+#include <Wt/Dbo/Transaction.h>
+#include <Wt/Dbo/ptr.h>
+#include <Wt/Json/Object.h>
+#include <Wt/Json/Parser.h>
+#include <Wt/Json/Serializer.h>
+#include <Wt/Json/Value.h>
+#include <Wt/WApplication.h>
+#include <Wt/WConfig.h>
+#include <Wt/WServer.h>
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cctype>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <vector>
+#include "ApiResource.h"
+#include "File.h"
+#include "Folder.h"
+#include "FolderCache.h"
+#include "Histogram.h"
+#include "LoginResource.h"
+#include "Metrics.h"
+#include "MetricsResource.h"
+#include "SharingLink.h"
+#include "StorageApplication.h"
+#include "User.h"
+
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+namespace {
+
+struct Options {
+    int users { 16 };
+    int iterations { 10 };
+    std::size_t fileSize { 64 * 1024 };
+    int port { 18080 };
+    std::filesystem::path output { "load-benchmark.json" };
+    std::filesystem::path wtConfig { "wt_config.xml" };
+    std::filesystem::path workDirectory;
+};
+
+struct HttpResponse {
+    int status { 0 };
+    std::string body;
+};
+
+/**
+ * The timings of one kind of operation, shared by all users.
+ */
+struct Operation {
+    Histogram microseconds;
+    std::atomic<uint64_t> errors { 0 };
+};
+
+/**
+ * Thrown when an operation fails, so that it is counted as an error.
+ */
+class OperationError : public std::runtime_error {
+public:
+    using std::runtime_error::runtime_error;
+};
+
+constexpr std::array<const char*, 8> OPERATION_NAMES { "create-account", "login", "upload", "browse", "sort", "search", "share", "download" };
+
+}
+
+static void printUsage(const char* program)
+{
+    std::cerr << "Usage: " << program << " [options]\n"
+              << "  --users N          simulated users running at once (default 16)\n"
+              << "  --iterations N     visits made by each user (default 10)\n"
+              << "  --file-size BYTES  size of each uploaded file (default 65536)\n"
+              << "  --port N           localhost port for the server (default 18080)\n"
+              << "  --output PATH      where to write the JSON results (default load-benchmark.json)\n"
+              << "  --wt-config PATH   Wt configuration file (default wt_config.xml)\n"
+              << "  --work-dir PATH    directory for the database and files (default: a new\n"
+              << "                     temporary directory that is removed afterwards)\n";
+}
+
+static Options parseOptions(int argc, char** argv)
+{
+    Options options;
+    // NOLINTBEGIN (cppcoreguidelines-pro-bounds-pointer-arithmetic)
+    std::vector<std::string> args { argv + 1, argv + argc };
+    // NOLINTEND
+    for (std::size_t i = 0; i < args.size(); ++i) {
+        if (i + 1 >= args.size()) {
+            throw std::invalid_argument("Missing value for " + args[i]);
+        }
+        const std::string& name = args[i];
+        const std::string& value = args[++i];
+        if (name == "--users") {
+            options.users = std::max(1, std::stoi(value));
+        } else if (name == "--iterations") {
+            options.iterations = std::max(1, std::stoi(value));
+        } else if (name == "--file-size") {
+            options.fileSize = std::stoul(value);
+        } else if (name == "--port") {
+            options.port = std::stoi(value);
+        } else if (name == "--output") {
+            options.output = value;
+        } else if (name == "--wt-config") {
+            options.wtConfig = value;
+        } else if (name == "--work-dir") {
+            options.workDirectory = value;
+        } else {
+            throw std::invalid_argument("Unknown option " + name);
+        }
+    }
+    return options;
+}
+
+static std::string urlEncode(const std::string& value)
+{
+    std::ostringstream encoded;
+    encoded << std::hex << std::uppercase;
+    for (unsigned char character : value) {
+        if (std::isalnum(character) || character == '-' || character == '_' || character == '.' || character == '~') {
+            encoded << character;
+        } else {
+            encoded << '%' << std::setw(2) << std::setfill('0') << static_cast<int>(character);
+        }
+    }
+    return encoded.str();
+}
+
+/**
+ * Sends a request to the server and waits for the whole response.
+ *
+ * HTTP/1.0 is used so that the server ends the response by closing the
+ * connection, rather than with chunked encoding.
+ */
+static HttpResponse sendRequest(int port, const std::string& method, const std::string& target, const std::vector<std::string>& headers, const std::string& body = "")
+{
+    int socketFd = socket(AF_INET, SOCK_STREAM, 0);
+    if (socketFd < 0) {
+        throw OperationError("Failed to create a socket");
+    }
+    std::unique_ptr<int, void (*)(int*)> socketGuard(&socketFd, [](int* fd) { close(*fd); });
+
+    sockaddr_in address {};
+    address.sin_family = AF_INET;
+    address.sin_port = htons(static_cast<uint16_t>(port));
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (connect(socketFd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0) {
+        throw OperationError("Failed to connect to the server");
+    }
+
+    std::string request = method + " " + target + " HTTP/1.0\r\nHost: 127.0.0.1\r\nContent-Length: " + std::to_string(body.size()) + "\r\n";
+    for (const auto& header : headers) {
+        request += header + "\r\n";
+    }
+    request += "\r\n";
+    request += body;
+
+    for (std::size_t sent = 0; sent < request.size();) {
+        ssize_t count = send(socketFd, request.data() + sent, request.size() - sent, MSG_NOSIGNAL);
+        if (count <= 0) {
+            throw OperationError("Failed to send the request");
+        }
+        sent += static_cast<std::size_t>(count);
+    }
+
+    std::string received;
+    std::array<char, 64 * 1024> buffer {};
+    ssize_t count = 0;
+    while ((count = recv(socketFd, buffer.data(), buffer.size(), 0)) > 0) {
+        received.append(buffer.data(), static_cast<std::size_t>(count));
+    }
+
+    auto headerEnd = received.find("\r\n\r\n");
+    auto statusStart = received.find(' ');
+    if (headerEnd == std::string::npos || statusStart == std::string::npos) {
+        throw OperationError("Invalid response from the server");
+    }
+
+    HttpResponse response;
+    response.status = std::atoi(received.c_str() + statusStart + 1);
+    response.body = received.substr(headerEnd + 4);
+    return response;
+}
+
+static HttpResponse expectStatus(HttpResponse response, int status)
+{
+    if (response.status != status) {
+        throw OperationError("Expected status " + std::to_string(status) + " but got " + std::to_string(response.status) + ": " + response.body);
+    }
+    return response;
+}
+
+static Wt::Json::Object parseObject(const std::string& body)
+{
+    Wt::Json::Object object;
+    Wt::Json::parse(body, object);
+    return object;
+}
+
+/**
+ * Runs an operation and records its time, or counts it as an error if it
+ * throws.
+ *
+ * \return `true` if the operation succeeded.
+ */
+static bool measure(Operation& operation, const std::function<void()>& function)
+{
+    auto start = std::chrono::steady_clock::now();
+    try {
+        function();
+    } catch (const std::exception& ex) {
+        if (operation.errors.fetch_add(1) == 0) {
+            std::cerr << "LoadBenchmark: " << ex.what() << std::endl;
+        }
+        return false;
+    }
+    operation.microseconds.record(Metrics::getMicrosecondsSince(start));
+    return true;
+}
+
+/**
+ * Simulates one user: creates their account, then makes a number of visits
+ * that each log in, upload a file, look at and share it, and download it.
+ */
+static void runUser(const Options& options, int userIndex, std::map<std::string, Operation>& operations)
+{
+    auto databaseSession = StorageApplication::createDatabaseSession();
+    std::string username = "user-" + std::to_string(userIndex);
+    const std::string password = "password-" + std::to_string(userIndex);
+
+    // The same form as the create account page, which redirects to the
+    // application once the account exists.
+    bool isCreated = measure(operations.at("create-account"), [&] {
+        expectStatus(sendRequest(options.port, "POST", std::string(LoginResource::LOGIN_PATH) + "?create", { "Content-Type: application/x-www-form-urlencoded" }, "username=" + urlEncode(username) + "&password=" + urlEncode(password)), 303);
+    });
+    if (!isCreated) {
+        return;
+    }
+
+    Wt::Dbo::ptr<User> user;
+    {
+        Wt::Dbo::Transaction transaction(*databaseSession);
+        user = User::findByUsername(*databaseSession, username);
+    }
+    if (!user) {
+        return;
+    }
+
+    std::mt19937 random(static_cast<unsigned int>(userIndex));
+    std::string content(options.fileSize, '\0');
+    std::generate(content.begin(), content.end(), [&random] { return static_cast<char>('a' + random() % 26); });
+
+    for (int iteration = 0; iteration < options.iterations; ++iteration) {
+        std::string token;
+        bool isLoggedIn = measure(operations.at("login"), [&] {
+            auto response = expectStatus(sendRequest(options.port, "POST", "/api/tokens", { "Content-Type: application/x-www-form-urlencoded" }, "username=" + urlEncode(username) + "&password=" + urlEncode(password)), 201);
+            auto object = parseObject(response.body);
+            const Wt::WString& value = object.get("token");
+            token = value.toUTF8();
+        });
+        if (!isLoggedIn) {
+            continue;
+        }
+        const std::string authorization = "Authorization: Bearer " + token;
+
+        long long fileId = -1;
+        measure(operations.at("upload"), [&] {
+            std::string name = "file-" + std::to_string(iteration) + ".txt";
+            auto response = expectStatus(sendRequest(options.port, "POST", "/api/folders/root/files?name=" + urlEncode(name), { authorization, "Content-Type: application/octet-stream" }, content), 201);
+            fileId = parseObject(response.body).get("id");
+        });
+
+        measure(operations.at("browse"), [&] {
+            expectStatus(sendRequest(options.port, "GET", "/api/folders/root", { authorization }), 200);
+        });
+
+        // The same sorting as the sort buttons, which copy the cached listing.
+        measure(operations.at("sort"), [&] {
+            Wt::Dbo::Transaction transaction(*databaseSession);
+            auto files = FolderCache::instance().get(*databaseSession, user->getRootFolder().id())->files;
+            switch (iteration % 3) {
+            case 0:
+                std::stable_sort(files.begin(), files.end(), [](const auto& first, const auto& second) { return first.name < second.name; });
+                break;
+            case 1:
+                std::stable_sort(files.begin(), files.end(), [](const auto& first, const auto& second) { return std::tie(first.extension, first.name) < std::tie(second.extension, second.name); });
+                break;
+            default:
+                std::stable_sort(files.rbegin(), files.rend(), [](const auto& first, const auto& second) { return first.fileSize < second.fileSize; });
+                break;
+            }
+        });
+
+        // The same filtering as FolderView::filterFiles.
+        measure(operations.at("search"), [&] {
+            Wt::Dbo::Transaction transaction(*databaseSession);
+            std::size_t matchCount = 0;
+            for (const auto& file : FolderCache::instance().get(*databaseSession, user->getRootFolder().id())->files) {
+                if (file.name.find("file-1") != std::string::npos) {
+                    ++matchCount;
+                }
+            }
+            static_cast<void>(matchCount);
+        });
+
+        if (fileId < 0) {
+            continue;
+        }
+
+        measure(operations.at("share"), [&] {
+            Wt::Dbo::Transaction transaction(*databaseSession);
+            SharingLink link(databaseSession->load<File>(fileId));
+            link.createLink(databaseSession.get());
+        });
+
+        measure(operations.at("download"), [&] {
+            auto response = expectStatus(sendRequest(options.port, "GET", "/api/files/" + std::to_string(fileId) + "/content", { authorization }), 200);
+            if (response.body.size() != content.size()) {
+                throw OperationError("Downloaded " + std::to_string(response.body.size()) + " bytes instead of " + std::to_string(content.size()));
+            }
+        });
+    }
+}
+
+static Wt::Json::Object summarize(const Options& options, std::map<std::string, Operation>& operations, double elapsedSeconds)
+{
+    Wt::Json::Object results;
+    results["users"] = options.users;
+    results["iterations"] = options.iterations;
+    results["fileSize"] = static_cast<long long>(options.fileSize);
+    results["elapsedSeconds"] = elapsedSeconds;
+
+    Wt::Json::Object operationResults;
+    std::cerr << std::left << std::setw(16) << "operation" << std::right << std::setw(8) << "count" << std::setw(8) << "errors" << std::setw(12) << "ops/s" << std::setw(12)
+              << "p50 ms" << std::setw(12) << "p99 ms" << std::endl;
+    for (const char* name : OPERATION_NAMES) {
+        auto& operation = operations.at(name);
+        auto snapshot = operation.microseconds.getSnapshot();
+        double throughput = elapsedSeconds > 0 ? static_cast<double>(snapshot.count) / elapsedSeconds : 0;
+        double p50 = static_cast<double>(snapshot.getPercentile(50)) / 1000.0;
+        double p99 = static_cast<double>(snapshot.getPercentile(99)) / 1000.0;
+
+        Wt::Json::Object result;
+        result["count"] = static_cast<long long>(snapshot.count);
+        result["errors"] = static_cast<long long>(operation.errors.load());
+        result["throughput"] = throughput;
+        result["p50Ms"] = p50;
+        result["p99Ms"] = p99;
+        operationResults[name] = std::move(result);
+
+        std::cerr << std::left << std::setw(16) << name << std::right << std::setw(8) << snapshot.count << std::setw(8) << operation.errors.load() << std::fixed
+                  << std::setprecision(1) << std::setw(12) << throughput << std::setprecision(2) << std::setw(12) << p50 << std::setw(12) << p99 << std::endl;
+    }
+    results["operations"] = std::move(operationResults);
+    return results;
+}
+
+int main(int argc, char** argv)
+{
+    Options options;
+    try {
+        options = parseOptions(argc, argv);
+    } catch (const std::exception& ex) {
+        std::cerr << ex.what() << std::endl;
+        printUsage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    // The server uses paths relative to the working directory, so it runs in
+    // a directory of its own to keep away from real data.
+    auto output = std::filesystem::absolute(options.output);
+    auto wtConfig = std::filesystem::absolute(options.wtConfig);
+    bool removesWorkDirectory = options.workDirectory.empty();
+    if (removesWorkDirectory) {
+        options.workDirectory = std::filesystem::temp_directory_path() / ("cgs-load-benchmark-" + std::to_string(getpid()));
+    }
+    std::filesystem::create_directories(options.workDirectory / "userFiles");
+    std::filesystem::create_directories(options.workDirectory / "docroot");
+    std::filesystem::current_path(options.workDirectory);
+
+    int exitCode = EXIT_SUCCESS;
+    try {
+        std::string applicationPath { argv[0] };
+        std::vector<std::string> args { "--docroot", "docroot", "--http-listen", "127.0.0.1:" + std::to_string(options.port), "-c", wtConfig.string() };
+
+        // Set up the same way as main.cpp.
+        Wt::WServer server(applicationPath);
+        server.setServerConfiguration(applicationPath, args, WTHTTP_CONFIGURATION);
+        StorageApplication::createDatabaseSession();
+        server.addResource(std::make_shared<ApiResource>(), "/api");
+        server.addResource(std::make_shared<MetricsResource>(), "/metrics");
+        server.addResource(std::make_shared<LoginResource>(), std::string(LoginResource::LOGIN_PATH));
+        server.addEntryPoint(Wt::EntryPointType::Application, [](const Wt::WEnvironment& env) {
+            return std::make_unique<StorageApplication>(env);
+        }, std::string(LoginResource::APPLICATION_PATH));
+        StorageApplication::startServices();
+
+        if (!server.start()) {
+            throw std::runtime_error("The server failed to start");
+        }
+
+        std::map<std::string, Operation> operations;
+        for (const char* name : OPERATION_NAMES) {
+            operations.try_emplace(name);
+        }
+
+        auto start = std::chrono::steady_clock::now();
+        std::vector<std::thread> users;
+        for (int i = 0; i < options.users; ++i) {
+            users.emplace_back(runUser, std::cref(options), i, std::ref(operations));
+        }
+        for (auto& user : users) {
+            user.join();
+        }
+        double elapsedSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        server.stop();
+        StorageApplication::stopServices();
+
+        std::ofstream outputFile(output);
+        outputFile << Wt::Json::serialize(summarize(options, operations, elapsedSeconds)) << std::endl;
+        std::cerr << "Results written to " << output.string() << std::endl;
+    } catch (const std::exception& ex) {
+        std::cerr << "Exception: " << ex.what() << std::endl;
+        exitCode = EXIT_FAILURE;
+    }
+
+    if (removesWorkDirectory) {
+        std::error_code error;
+        std::filesystem::current_path(std::filesystem::temp_directory_path(), error);
+        std::filesystem::remove_all(options.workDirectory, error);
+    }
+    return exitCode;
+}
@@ -0,0 +1,407 @@
+// Microbenchmarks for the model classes, run against generated databases of
+// different sizes to show how each operation scales with the amount of data.
+//
+// Each size gets its own database, filled with plain SQL inserts since going
+// through Wt::Dbo would take far too long for millions of rows. The sizes are
+// given as a comma-separated list of file counts:
+//
+//     build/model-benchmark --rows=10000,100000,1000000
+//
+// All the usual Google Benchmark options, like --benchmark_filter, also work.
+
+#include <Wt/Auth/HashFunction.h>
+#include <Wt/Dbo/Session.h>
+#include <Wt/Dbo/Transaction.h>
+#include <Wt/Dbo/ptr.h>
+#include <Wt/WConfig.h>
+#include <Wt/WServer.h>
+#include <algorithm>
+#include <benchmark/benchmark.h>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <filesystem>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <random>
+#include <sqlite3.h>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <vector>
+#include "BlockDelta.h"
+#include "File.h"
+#include "Folder.h"
+#include "SegmentStore.h"
+#include "SharingLink.h"
+#include "SqliteStatement.h"
+#include "StorageApplication.h"
+#include "User.h"
+
+#include <unistd.h>
+
+namespace {
+
+/**
+ * A generated database and an open session for it.
+ */
+struct Dataset {
+    long long fileCount { 0 };
+    long long folderCount { 0 };
+    long long userCount { 0 };
+    std::filesystem::path directory;
+    std::unique_ptr<Wt::Dbo::Session> databaseSession;
+};
+
+std::filesystem::path g_rootDirectory;
+std::map<long long, Dataset> g_datasets;
+
+}
+
+static std::string getFileName(long long fileIndex)
+{
+    return "file-" + std::to_string(fileIndex) + ".txt";
+}
+
+/**
+ * Fills a database that has just had its tables created.
+ *
+ * There is one folder for every 100 files and one user for every 10,000,
+ * and one in ten files is shared. Files are spread evenly over the folders,
+ * so file `i` is in folder `i % folderCount`. IDs start from 1 in every table.
+ */
+static void populate(const std::filesystem::path& databasePath, Dataset& dataset)
+{
+    sqlite3* database = nullptr;
+    if (sqlite3_open(databasePath.c_str(), &database) != SQLITE_OK) {
+        sqlite3_close(database);
+        throw std::runtime_error("Failed to open " + databasePath.string());
+    }
+    std::unique_ptr<sqlite3, int (*)(sqlite3*)> databaseGuard(database, sqlite3_close);
+
+    // Durability doesn't matter for a database that can be generated again.
+    SqliteStatement::execute(database, "PRAGMA journal_mode = OFF");
+    SqliteStatement::execute(database, "PRAGMA synchronous = OFF");
+    SqliteStatement::execute(database, "BEGIN");
+
+    // Only the hash of one password is needed, since the same one is used
+    // for every user.
+    std::string passwordHash = Wt::Auth::BCryptHashFunction().compute("password", "");
+
+    {
+        SqliteStatement insertUser(database, "INSERT INTO users (id, version, username, password_hash, root_folder_id) VALUES (?, 0, ?, ?, ?)");
+        SqliteStatement insertFolder(database, "INSERT INTO folders (id, version, name, owner_id, parent_id) VALUES (?, 0, ?, ?, ?)");
+        SqliteStatement insertFile(database, "INSERT INTO files (id, version, name, owner_id, parent_id, file_size, extension, mime_type, segment_id, segment_offset) VALUES (?, 0, ?, ?, ?, ?, 'txt', 'text/plain', 0, 0)");
+        SqliteStatement insertSharingLink(database, "INSERT INTO sharing_links (id, version, url_id, file_id) VALUES (?, 0, ?, ?)");
+
+        // Root folders use IDs 1 to userCount, and other folders come after.
+        for (long long user = 1; user <= dataset.userCount; ++user) {
+            insertUser.bind(1, user).bind(2, "user-" + std::to_string(user - 1)).bind(3, passwordHash).bind(4, user).run();
+            insertFolder.bind(1, user).bind(2, std::string("~root")).bind(3, user).bindNull(4).run();
+        }
+        for (long long folder = 0; folder < dataset.folderCount; ++folder) {
+            long long owner = folder % dataset.userCount + 1;
+            insertFolder.bind(1, dataset.userCount + folder + 1).bind(2, "folder-" + std::to_string(folder)).bind(3, owner).bind(4, owner).run();
+        }
+
+        std::mt19937_64 random(dataset.fileCount);
+        std::uniform_int_distribution<long long> sizes(0, 1024 * 1024);
+        for (long long file = 0; file < dataset.fileCount; ++file) {
+            long long folder = file % dataset.folderCount;
+            long long owner = folder % dataset.userCount + 1;
+            insertFile.bind(1, file + 1).bind(2, getFileName(file)).bind(3, owner).bind(4, dataset.userCount + folder + 1).bind(5, sizes(random)).run();
+            if (file % 10 == 0) {
+                insertSharingLink.bind(1, file / 10 + 1).bind(2, "link-" + std::to_string(file)).bind(3, file + 1).run();
+            }
+        }
+    }
+
+    SqliteStatement::execute(database, "COMMIT");
+    SqliteStatement::execute(database, "ANALYZE");
+}
+
+/**
+ * Gets the dataset with a number of files, generating it the first time.
+ *
+ * This also changes the working directory to the dataset's directory, since
+ * file content is stored relative to it.
+ */
+static Dataset& getDataset(long long fileCount)
+{
+    auto& dataset = g_datasets[fileCount];
+    if (!dataset.databaseSession) {
+        dataset.fileCount = fileCount;
+        dataset.folderCount = std::max(1LL, fileCount / 100);
+        dataset.userCount = std::max(1LL, fileCount / 10000);
+        dataset.directory = g_rootDirectory / ("rows-" + std::to_string(fileCount));
+
+        std::filesystem::remove_all(dataset.directory);
+        std::filesystem::create_directories(dataset.directory / "userFiles");
+        auto databasePath = dataset.directory / StorageApplication::DATABASE_PATH;
+
+        std::cerr << "Generating a database with " << fileCount << " files..." << std::endl;
+        // The session creates the tables and indexes, so that the schema is
+        // exactly the same as the real one.
+        StorageApplication::createDatabaseSession(databasePath.string());
+        populate(databasePath, dataset);
+        dataset.databaseSession = StorageApplication::createDatabaseSession(databasePath.string());
+    }
+
+    std::filesystem::current_path(dataset.directory);
+    return dataset;
+}
+
+static void BM_FolderGetFileByName(benchmark::State& state)
+{
+    auto& dataset = getDataset(state.range(0));
+    auto& databaseSession = *dataset.databaseSession;
+    std::mt19937_64 random(1);
+    std::uniform_int_distribution<long long> files(0, dataset.fileCount - 1);
+
+    for (auto _ : state) {
+        long long file = files(random);
+        Wt::Dbo::Transaction transaction(databaseSession);
+        auto folder = databaseSession.load<Folder>(dataset.userCount + file % dataset.folderCount + 1);
+        benchmark::DoNotOptimize(folder->getFileByName(getFileName(file)));
+    }
+}
+
+static void BM_UserFindByUsername(benchmark::State& state)
+{
+    auto& dataset = getDataset(state.range(0));
+    auto& databaseSession = *dataset.databaseSession;
+    std::mt19937_64 random(2);
+    std::uniform_int_distribution<long long> users(0, dataset.userCount - 1);
+
+    for (auto _ : state) {
+        Wt::Dbo::Transaction transaction(databaseSession);
+        benchmark::DoNotOptimize(User::findByUsername(databaseSession, "user-" + std::to_string(users(random))));
+    }
+}
+
+static void BM_SharingLinkGenerateRandomUrlID(benchmark::State& state)
+{
+    for (auto _ : state) {
+        benchmark::DoNotOptimize(SharingLink::generateRandomUrlID());
+    }
+}
+
+static void BM_SharingLinkCreateLink(benchmark::State& state)
+{
+    auto& dataset = getDataset(state.range(0));
+    auto& databaseSession = *dataset.databaseSession;
+    std::mt19937_64 random(3);
+    std::uniform_int_distribution<long long> files(1, dataset.fileCount);
+
+    for (auto _ : state) {
+        state.PauseTiming();
+        Wt::Dbo::ptr<File> file;
+        {
+            Wt::Dbo::Transaction transaction(databaseSession);
+            file = databaseSession.load<File>(files(random));
+        }
+        SharingLink link(file);
+        state.ResumeTiming();
+
+        std::string urlId = link.createLink(&databaseSession);
+
+        // Links are registered with the server, so remove them again to keep
+        // every iteration the same.
+        state.PauseTiming();
+        Wt::WServer::instance()->removeEntryPoint(urlId);
+        state.ResumeTiming();
+    }
+}
+
+/**
+ * Gets content to upload, which is either small enough to be packed into a
+ * segment or just large enough to get a blob of its own.
+ */
+static std::string getUploadContent(bool isPacked)
+{
+    std::size_t packLimit = SegmentStore::instance().getPackLimit();
+    return std::string(isPacked && packLimit >= 4096 ? 4096 : packLimit + 4096, 'x');
+}
+
+/**
+ * Removes the content of an uploaded file, which would normally be done by
+ * BlobGarbageCollector. Packed content stays in its segment until the
+ * segment is compacted, as it does on the server.
+ */
+static void removeContent(const Wt::Dbo::ptr<File>& file)
+{
+    if (!file->isPacked()) {
+        std::filesystem::remove(std::string(File::FILE_SYSTEM_ROOT) + std::to_string(file.id()));
+    }
+}
+
+static void BM_FileUpload(benchmark::State& state, bool isPacked)
+{
+    auto& dataset = getDataset(state.range(0));
+    auto& databaseSession = *dataset.databaseSession;
+    Wt::Dbo::ptr<Folder> folder;
+    {
+        Wt::Dbo::Transaction transaction(databaseSession);
+        folder = databaseSession.load<Folder>(dataset.userCount + 1);
+    }
+    const std::string content = getUploadContent(isPacked);
+
+    for (auto _ : state) {
+        Wt::Dbo::ptr<File> file;
+        {
+            std::istringstream stream(content);
+            Wt::Dbo::Transaction transaction(databaseSession);
+            file = File::upload(databaseSession, "upload.txt", folder->getOwner(), folder, stream);
+        }
+
+        state.PauseTiming();
+        removeContent(file);
+        {
+            Wt::Dbo::Transaction transaction(databaseSession);
+            File::remove(databaseSession, file);
+        }
+        state.ResumeTiming();
+    }
+}
+
+static void BM_FileRemove(benchmark::State& state, bool isPacked)
+{
+    auto& dataset = getDataset(state.range(0));
+    auto& databaseSession = *dataset.databaseSession;
+    Wt::Dbo::ptr<Folder> folder;
+    {
+        Wt::Dbo::Transaction transaction(databaseSession);
+        folder = databaseSession.load<Folder>(dataset.userCount + 1);
+    }
+    const std::string content = getUploadContent(isPacked);
+
+    for (auto _ : state) {
+        state.PauseTiming();
+        Wt::Dbo::ptr<File> file;
+        {
+            std::istringstream stream(content);
+            Wt::Dbo::Transaction transaction(databaseSession);
+            file = File::upload(databaseSession, "remove.txt", folder->getOwner(), folder, stream);
+        }
+        removeContent(file);
+        state.ResumeTiming();
+
+        Wt::Dbo::Transaction transaction(databaseSession);
+        File::remove(databaseSession, file);
+    }
+}
+
+static void BM_BlockDeltaCreateDelta(benchmark::State& state)
+{
+    // A file of the given size with a small edit in the middle, which is the
+    // case that delta uploads are meant for.
+    std::mt19937_64 random(4);
+    std::string oldContent(static_cast<std::size_t>(state.range(0)), '\0');
+    for (auto& byte : oldContent) {
+        byte = static_cast<char>(random());
+    }
+    std::string newContent = oldContent;
+    newContent.insert(newContent.size() / 2, "an edit in the middle of the file");
+
+    std::size_t blockSize = BlockDelta::getBlockSize(oldContent.size());
+    std::istringstream oldStream(oldContent);
+    auto signatures = BlockDelta::computeSignatures(oldStream, blockSize);
+
+    for (auto _ : state) {
+        std::istringstream newStream(newContent);
+        std::ostringstream delta;
+        benchmark::DoNotOptimize(BlockDelta::createDelta(signatures, oldContent.size(), blockSize, newStream, delta));
+    }
+    state.SetBytesProcessed(static_cast<int64_t>(state.iterations()) * static_cast<int64_t>(newContent.size()));
+}
+
+/**
+ * Reads and removes the `--rows` option from the arguments.
+ */
+static std::vector<long long> parseRowCounts(int& argc, char** argv)
+{
+    std::vector<long long> rowCounts { 10000, 100000 };
+    const std::string prefix = "--rows=";
+    // NOLINTBEGIN (cppcoreguidelines-pro-bounds-pointer-arithmetic)
+    for (int i = 1; i < argc; ++i) {
+        std::string argument = argv[i];
+        if (argument.compare(0, prefix.size(), prefix) != 0) {
+            continue;
+        }
+
+        rowCounts.clear();
+        std::istringstream values(argument.substr(prefix.size()));
+        std::string value;
+        while (std::getline(values, value, ',')) {
+            rowCounts.push_back(std::max(1LL, std::stoll(value)));
+        }
+        for (int j = i; j + 1 < argc; ++j) {
+            argv[j] = argv[j + 1];
+        }
+        --argc;
+        --i;
+    }
+    // NOLINTEND
+    return rowCounts;
+}
+
+int main(int argc, char** argv)
+{
+    std::vector<long long> rowCounts;
+    try {
+        rowCounts = parseRowCounts(argc, argv);
+    } catch (const std::exception& ex) {
+        std::cerr << "Invalid --rows: " << ex.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    benchmark::Initialize(&argc, argv);
+    if (benchmark::ReportUnrecognizedArguments(argc, argv)) {
+        return EXIT_FAILURE;
+    }
+
+    g_rootDirectory = std::filesystem::temp_directory_path() / ("cgs-model-benchmark-" + std::to_string(getpid()));
+
+    // Sharing links register themselves with the server, so one has to exist,
+    // although it is never started.
+    std::string applicationPath { argv[0] };
+    Wt::WServer server(applicationPath);
+    server.setServerConfiguration(applicationPath, { "--docroot", g_rootDirectory.string(), "--http-listen", "127.0.0.1:0" }, WTHTTP_CONFIGURATION);
+
+    auto registerSized = [&rowCounts](const char* name, void (*function)(benchmark::State&)) {
+        auto* benchmark = benchmark::RegisterBenchmark(name, function);
+        for (long long rowCount : rowCounts) {
+            benchmark->Arg(rowCount);
+        }
+        benchmark->Unit(benchmark::kMicrosecond);
+    };
+    registerSized("Folder::getFileByName", BM_FolderGetFileByName);
+    registerSized("User::findByUsername", BM_UserFindByUsername);
+    benchmark::RegisterBenchmark("SharingLink::generateRandomUrlID", BM_SharingLinkGenerateRandomUrlID);
+    registerSized("SharingLink::createLink", BM_SharingLinkCreateLink);
+    // Small files are packed into segments, and larger ones get a blob, so
+    // both ways of saving content are measured.
+    registerSized("File::upload/blob", [](benchmark::State& state) { BM_FileUpload(state, false); });
+    registerSized("File::upload/packed", [](benchmark::State& state) { BM_FileUpload(state, true); });
+    registerSized("File::remove/blob", [](benchmark::State& state) { BM_FileRemove(state, false); });
+    registerSized("File::remove/packed", [](benchmark::State& state) { BM_FileRemove(state, true); });
+    benchmark::RegisterBenchmark("BlockDelta::createDelta", BM_BlockDeltaCreateDelta)->Arg(1 << 20)->Arg(64 << 20)->Unit(benchmark::kMillisecond);
+
+    int exitCode = EXIT_SUCCESS;
+    try {
+        benchmark::RunSpecifiedBenchmarks();
+    } catch (const std::exception& ex) {
+        std::cerr << "Exception: " << ex.what() << std::endl;
+        exitCode = EXIT_FAILURE;
+    }
+    benchmark::Shutdown();
+
+    g_datasets.clear();
+    std::error_code error;
+    std::filesystem::current_path(std::filesystem::temp_directory_path(), error);
+    std::filesystem::remove_all(g_rootDirectory, error);
+    return exitCode;
+}
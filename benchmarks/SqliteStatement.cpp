@@ -0,0 +1,54 @@
+#include "SqliteStatement.h"
+
+#include <sqlite3.h>
+#include <stdexcept>
+#include <string>
+
+SqliteStatement::SqliteStatement(sqlite3* database, const char* sql)
+{
+    if (sqlite3_prepare_v2(database, sql, -1, &m_statement, nullptr) != SQLITE_OK) {
+        throw std::runtime_error(std::string("Failed to prepare ") + sql + ": " + sqlite3_errmsg(database));
+    }
+}
+
+SqliteStatement::~SqliteStatement()
+{
+    sqlite3_finalize(m_statement);
+}
+
+SqliteStatement& SqliteStatement::bind(int index, long long value)
+{
+    sqlite3_bind_int64(m_statement, index, value);
+    return *this;
+}
+
+SqliteStatement& SqliteStatement::bind(int index, const std::string& value)
+{
+    sqlite3_bind_text(m_statement, index, value.data(), static_cast<int>(value.size()), SQLITE_TRANSIENT);
+    return *this;
+}
+
+SqliteStatement& SqliteStatement::bindNull(int index)
+{
+    sqlite3_bind_null(m_statement, index);
+    return *this;
+}
+
+void SqliteStatement::run()
+{
+    int result = sqlite3_step(m_statement);
+    sqlite3_reset(m_statement);
+    if (result != SQLITE_DONE) {
+        throw std::runtime_error(std::string("Failed to run a statement: ") + sqlite3_errmsg(sqlite3_db_handle(m_statement)));
+    }
+}
+
+void SqliteStatement::execute(sqlite3* database, const char* sql)
+{
+    char* error = nullptr;
+    if (sqlite3_exec(database, sql, nullptr, nullptr, &error) != SQLITE_OK) {
+        std::string message = error != nullptr ? error : "unknown error";
+        sqlite3_free(error);
+        throw std::runtime_error(std::string("Failed to run ") + sql + ": " + message);
+    }
+}
@@ -0,0 +1,659 @@
+#include "ApiResource.h"
+
+#include <Wt/Dbo/Exception.h>
+#include <Wt/Dbo/FixedSqlConnectionPool.h>
+#include <Wt/Dbo/Session.h>
+#include <Wt/Dbo/Transaction.h>
+#include <Wt/Http/Request.h>
+#include <Wt/Http/Response.h>
+#include <Wt/Http/ResponseContinuation.h>
+#include <Wt/Json/Array.h>
+#include <Wt/Json/Object.h>
+#include <Wt/Json/Serializer.h>
+#include <Wt/Json/Value.h>
+#include <Wt/WString.h>
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <exception>
+#include <iostream>
+#include <istream>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <utility>
+#include <vector>
+#include "ApiTokenCache.h"
+#include "BlobCache.h"
+#include "BlobGarbageCollector.h"
+#include "BlobIo.h"
+#include "BlockDelta.h"
+#include "Change.h"
+#include "Configuration.h"
+#include "DatabaseConnection.h"
+#include "FileResource.h"
+#include "FileVersion.h"
+#include "FolderCache.h"
+#include "Metrics.h"
+#include "QueryTrace.h"
+#include "StorageApplication.h"
+#include "User.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace {
+
+/**
+ * An error that is sent to the client with a specific status code.
+ */
+class ApiError : public std::runtime_error {
+public:
+    ApiError(int status, const std::string& message)
+        : std::runtime_error(message)
+        , m_status(status)
+    {
+    }
+
+    int getStatus() const { return m_status; }
+
+private:
+    int m_status;
+};
+
+}
+
+struct ApiResource::RequestContext {
+    const Wt::Http::Request& request;
+    Wt::Http::Response& response;
+    Wt::Dbo::Session& databaseSession;
+    std::optional<ApiToken::Verification> token;
+    Wt::Dbo::ptr<User> user;
+    bool hasDeletedFiles { false };
+    bool hasRevokedToken { false };
+    std::shared_ptr<DownloadState> download;
+    // The reply is only sent once the transaction has been committed, so that
+    // a failed commit is reported instead of a success.
+    int status { 200 };
+    std::optional<Wt::Json::Object> reply;
+
+    void setReply(Wt::Json::Object object, int replyStatus = 200)
+    {
+        reply = std::move(object);
+        status = replyStatus;
+    }
+};
+
+struct ApiResource::DownloadState {
+    std::string mimeType;
+    // Blobs are read through BlobIo.
+    int fd { -1 };
+    uint64_t size { 0 };
+    std::vector<char> buffer;
+    int64_t bytesRead { 0 };
+    // Popular blobs and all packed content are sent from memory, through the
+    // BlobCache. Other blobs are kept while they are sent if the cache would
+    // take them.
+    std::shared_ptr<const std::string> cachedContent;
+    std::optional<BlobCache::Key> cacheKey;
+    std::string cacheFill;
+    std::chrono::steady_clock::time_point start { std::chrono::steady_clock::now() };
+    uint64_t bytesSent { 0 };
+
+    ~DownloadState()
+    {
+        if (fd >= 0) {
+            close(fd);
+        }
+    }
+};
+
+static void sendJson(Wt::Http::Response& response, const Wt::Json::Object& object, int status = 200)
+{
+    response.setStatus(status);
+    response.setMimeType("application/json");
+    response.out() << Wt::Json::serialize(object, 0);
+}
+
+static void sendError(Wt::Http::Response& response, int status, const std::string& message)
+{
+    Wt::Json::Object error;
+    error["error"] = Wt::WString::fromUTF8(message);
+    sendJson(response, error, status);
+}
+
+static Wt::Json::Object toJson(const Wt::Dbo::ptr<File>& file)
+{
+    Wt::Json::Object object;
+    object["id"] = file.id();
+    object["name"] = Wt::WString::fromUTF8(file->getName());
+    object["parent"] = file->getParent().id();
+    object["size"] = static_cast<long long>(file->getFileSize());
+    object["mimeType"] = Wt::WString::fromUTF8(file->getMimeType());
+    return object;
+}
+
+static Wt::Json::Object toJson(const Wt::Dbo::ptr<Folder>& folder)
+{
+    Wt::Json::Object object;
+    object["id"] = folder.id();
+    object["name"] = Wt::WString::fromUTF8(folder->getName());
+    object["parent"] = folder->getParent() ? Wt::Json::Value(folder->getParent().id()) : Wt::Json::Value::Null;
+    return object;
+}
+
+static Wt::Json::Object toJson(const FolderCache::FileEntry& file, long long parentId)
+{
+    Wt::Json::Object object;
+    object["id"] = file.id;
+    object["name"] = Wt::WString::fromUTF8(file.name);
+    object["parent"] = parentId;
+    object["size"] = static_cast<long long>(file.fileSize);
+    object["mimeType"] = Wt::WString::fromUTF8(file.mimeType);
+    return object;
+}
+
+static Wt::Json::Object toJson(const FolderCache::FolderEntry& folder, long long parentId)
+{
+    Wt::Json::Object object;
+    object["id"] = folder.id;
+    object["name"] = Wt::WString::fromUTF8(folder.name);
+    object["parent"] = parentId;
+    return object;
+}
+
+static Wt::Json::Object toJson(const Change::Entry& change)
+{
+    static const char* const KIND_NAMES[] = { "created", "updated", "deleted" };
+
+    Wt::Json::Object object;
+    object["cursor"] = change.cursor;
+    object["type"] = Wt::WString::fromUTF8(KIND_NAMES[static_cast<int>(change.kind)]);
+    object["element"] = Wt::WString::fromUTF8(change.elementType == Change::ElementType::File ? "file" : "folder");
+    object["id"] = change.elementId;
+    object["parent"] = change.parentId;
+    object["name"] = Wt::WString::fromUTF8(change.name);
+    return object;
+}
+
+static std::string toHex(const std::array<uint8_t, BlockDelta::STRONG_HASH_SIZE>& hash)
+{
+    constexpr const char* DIGITS = "0123456789abcdef";
+    std::string hex;
+    for (uint8_t byte : hash) {
+        hex += DIGITS[byte >> 4];
+        hex += DIGITS[byte & 0xf];
+    }
+    return hex;
+}
+
+static long long parseId(const std::string& id)
+{
+    try {
+        std::size_t length = 0;
+        long long value = std::stoll(id, &length);
+        if (length == id.size()) {
+            return value;
+        }
+    } catch (const std::exception&) {
+    }
+    throw ApiError(404, "Not found.");
+}
+
+static const std::string* getParameter(const Wt::Http::Request& request, const std::string& name)
+{
+    const std::string* value = request.getParameter(name);
+    return value != nullptr && !value->empty() ? value : nullptr;
+}
+
+ApiResource::ApiResource()
+{
+    int connectionCount = static_cast<int>(std::max(1LL, Configuration::getInteger("api-connections", 4)));
+    auto connection = std::make_unique<DatabaseConnection>(std::string(StorageApplication::DATABASE_PATH));
+    m_connectionPool = std::make_unique<Wt::Dbo::FixedSqlConnectionPool>(std::move(connection), connectionCount);
+
+    auto tokenCacheTime = std::chrono::seconds(Configuration::getInteger("api-token-cache-time", 300));
+    auto tokenCacheSize = static_cast<std::size_t>(std::max(1LL, Configuration::getInteger("api-token-cache-size", 10000)));
+    ApiTokenCache::instance().configure(tokenCacheTime, tokenCacheSize);
+}
+
+ApiResource::~ApiResource()
+{
+    beingDeleted();
+}
+
+void ApiResource::handleRequest(const Wt::Http::Request& request, Wt::Http::Response& response)
+{
+    if (auto* continuation = request.continuation()) {
+        continueDownload(Wt::cpp17::any_cast<std::shared_ptr<DownloadState>>(continuation->data()), response);
+        return;
+    }
+
+    // Downloads are measured separately, since most of their time is spent
+    // after this.
+    static auto& requestHistogram = Metrics::instance().getHistogram("cgs_api_request_duration_seconds", "Time taken to handle an API request, not counting download content.", Metrics::Unit::Microseconds);
+    Metrics::ScopedTimer requestTimer(requestHistogram);
+    QueryTrace trace("API request " + request.method() + " " + request.pathInfo());
+
+    // Split the path into its parts, ignoring empty parts so that trailing
+    // slashes don't matter.
+    std::vector<std::string> path;
+    const std::string& pathInfo = request.pathInfo();
+    for (std::size_t start = 0; start < pathInfo.size();) {
+        std::size_t end = std::min(pathInfo.find('/', start), pathInfo.size());
+        if (end > start) {
+            path.push_back(pathInfo.substr(start, end - start));
+        }
+        start = end + 1;
+    }
+
+    Wt::Dbo::Session databaseSession;
+    databaseSession.setConnectionPool(*m_connectionPool);
+    StorageApplication::mapClasses(databaseSession);
+
+    RequestContext context { request, response, databaseSession };
+    try {
+        Wt::Dbo::Transaction transaction(databaseSession);
+        route(context, path);
+        transaction.commit();
+    } catch (const ApiError& ex) {
+        sendError(response, ex.getStatus(), ex.what());
+        return;
+    } catch (const Wt::Dbo::Exception& ex) {
+        // Database errors are the server's problem, and their text shows the
+        // SQL, so the client only learns whether trying again may help.
+        std::cerr << "ApiResource: Database error while handling " << request.method() << " " << pathInfo << ": " << ex.what() << std::endl;
+        if (std::string_view(ex.what()).find("database is locked") != std::string_view::npos) {
+            response.addHeader("Retry-After", "1");
+            sendError(response, 503, "The server is busy. Please try again.");
+        } else {
+            sendError(response, 500, "Internal server error.");
+        }
+        return;
+    } catch (const std::runtime_error& ex) {
+        // Errors from the model classes are caused by invalid requests.
+        sendError(response, 400, ex.what());
+        return;
+    } catch (const std::exception& ex) {
+        std::cerr << "ApiResource: Failed to handle " << request.method() << " " << pathInfo << ": " << ex.what() << std::endl;
+        sendError(response, 500, "Internal server error.");
+        return;
+    }
+
+    if (context.hasDeletedFiles) {
+        BlobGarbageCollector::instance().notify();
+    }
+    if (context.hasRevokedToken) {
+        ApiTokenCache::instance().revoke(context.token->tokenId);
+    }
+    if (context.download) {
+        response.setMimeType(context.download->mimeType);
+        response.addHeader("X-Content-Type-Options", "nosniff");
+        response.setContentLength(context.download->size);
+        continueDownload(context.download, response);
+    } else if (context.reply) {
+        sendJson(response, *context.reply, context.status);
+    } else {
+        response.setStatus(context.status);
+    }
+}
+
+void ApiResource::continueDownload(const std::shared_ptr<DownloadState>& state, Wt::Http::Response& response)
+{
+    if (state->cachedContent) {
+        const std::string& content = *state->cachedContent;
+        auto size = static_cast<std::size_t>(std::min<uint64_t>(CHUNK_SIZE, content.size() - state->bytesSent));
+        response.out().write(content.data() + state->bytesSent, static_cast<std::streamsize>(size));
+        state->bytesSent += size;
+
+        if (state->bytesSent < content.size()) {
+            response.createContinuation()->setData(state);
+        } else {
+            FileResource::recordDownload(state->bytesSent, state->start);
+        }
+        return;
+    }
+
+    // Send what the previous read got, then wait for the next piece without
+    // holding on to a Wt thread.
+    if (state->bytesRead < 0) {
+        std::cerr << "ApiResource: Failed to read a download: " << std::generic_category().message(static_cast<int>(-state->bytesRead)) << std::endl;
+        return;
+    }
+    response.out().write(state->buffer.data(), state->bytesRead);
+    state->bytesSent += static_cast<uint64_t>(state->bytesRead);
+    if (state->cacheKey) {
+        state->cacheFill.append(state->buffer.data(), static_cast<std::size_t>(state->bytesRead));
+    }
+    if (state->bytesSent >= state->size || (state->bytesRead == 0 && !state->buffer.empty())) {
+        if (state->cacheKey) {
+            BlobCache::instance().insert(*state->cacheKey, std::make_shared<const std::string>(std::move(state->cacheFill)));
+        }
+        FileResource::recordDownload(state->bytesSent, state->start);
+        return;
+    }
+
+    state->buffer.resize(static_cast<std::size_t>(std::min<uint64_t>(CHUNK_SIZE, state->size - state->bytesSent)));
+    auto continuation = response.createContinuation();
+    continuation->setData(state);
+    continuation->waitForMoreData();
+    BlobIo::instance().read(state->fd, state->buffer.data(), state->buffer.size(), static_cast<int64_t>(state->bytesSent), [state, continuation](int64_t result) {
+        state->bytesRead = result;
+        continuation->haveMoreData();
+    });
+}
+
+void ApiResource::route(RequestContext& context, const std::vector<std::string>& path)
+{
+    if (path.size() == 1 && path[0] == "tokens" && context.request.method() == "POST") {
+        createToken(context);
+        return;
+    }
+
+    const std::string& authorization = context.request.headerValue("Authorization");
+    const std::string bearerPrefix = "Bearer ";
+    if (authorization.compare(0, bearerPrefix.size(), bearerPrefix) == 0) {
+        context.token = ApiToken::verify(context.databaseSession, authorization.substr(bearerPrefix.size()));
+    }
+    if (!context.token) {
+        context.response.addHeader("WWW-Authenticate", "Bearer");
+        throw ApiError(401, "A valid API token is required.");
+    }
+    // The user is only loaded if a request actually needs it.
+    context.user = context.databaseSession.loadLazy<User>(context.token->userId);
+
+    if (path.size() == 2 && path[0] == "tokens" && path[1] == "current") {
+        if (context.request.method() != "DELETE") {
+            throw ApiError(405, "Method not allowed.");
+        }
+        ApiToken::revoke(context.databaseSession, context.token->tokenId);
+        context.hasRevokedToken = true;
+        context.status = 204;
+    } else if (path.size() >= 2 && path[0] == "folders") {
+        auto folder = findFolder(context, path[1]);
+        if (path.size() == 2) {
+            handleFolder(context, folder);
+        } else if (path.size() == 3 && context.request.method() == "POST" && (path[2] == "folders" || path[2] == "files")) {
+            const std::string* name = getParameter(context.request, "name");
+            if (name == nullptr) {
+                throw ApiError(400, "A name is required.");
+            }
+            if (path[2] == "folders") {
+                context.setReply(toJson(Folder::create(context.databaseSession, *name, folder)), 201);
+            } else {
+                // Replacing a file can remove its oldest version.
+                context.setReply(toJson(File::upload(context.databaseSession, *name, context.user, folder, context.request.in())), 201);
+                context.hasDeletedFiles = true;
+            }
+        } else {
+            throw ApiError(404, "Not found.");
+        }
+    } else if (path.size() >= 2 && path[0] == "files") {
+        auto file = findFile(context, path[1]);
+        if (path.size() == 2) {
+            handleFile(context, file);
+        } else if (path.size() == 3 && path[2] == "content" && context.request.method() == "GET") {
+            downloadFile(context, file);
+        } else if (path.size() == 3 && path[2] == "content" && context.request.method() == "PUT") {
+            patchFile(context, file);
+        } else if (path.size() == 3 && path[2] == "signatures" && context.request.method() == "GET") {
+            sendSignatures(context, file);
+        } else if (path.size() == 3 && path[2] == "versions" && context.request.method() == "GET") {
+            listVersions(context, file);
+        } else if (path.size() == 5 && path[2] == "versions" && path[4] == "restore" && context.request.method() == "POST") {
+            File::restoreVersion(context.databaseSession, file, parseId(path[3]));
+            context.hasDeletedFiles = true;
+            context.setReply(toJson(file));
+        } else {
+            throw ApiError(404, "Not found.");
+        }
+    } else if (path.size() == 1 && path[0] == "changes") {
+        if (context.request.method() != "GET") {
+            throw ApiError(405, "Method not allowed.");
+        }
+        listChanges(context);
+    } else {
+        throw ApiError(404, "Not found.");
+    }
+}
+
+void ApiResource::createToken(RequestContext& context)
+{
+    const std::string* username = getParameter(context.request, "username");
+    const std::string* password = getParameter(context.request, "password");
+    Wt::Dbo::ptr<User> user;
+    if (username != nullptr && password != nullptr) {
+        user = User::findByUsername(context.databaseSession, *username);
+    }
+    if (!user || !user->isPasswordCorrect(*password)) {
+        throw ApiError(401, "Invalid username or password.");
+    }
+
+    Wt::Json::Object object;
+    object["token"] = Wt::WString::fromUTF8(ApiToken::create(context.databaseSession, user));
+    context.setReply(std::move(object), 201);
+}
+
+void ApiResource::handleFolder(RequestContext& context, const Wt::Dbo::ptr<Folder>& folder)
+{
+    const std::string& method = context.request.method();
+    if (method == "GET") {
+        auto listing = FolderCache::instance().get(context.databaseSession, folder.id());
+
+        std::vector<const FolderCache::FolderEntry*> childFolders;
+        for (const auto& childFolder : listing->folders) {
+            childFolders.push_back(&childFolder);
+        }
+        std::sort(childFolders.begin(), childFolders.end(), [](const auto* first, const auto* second) {
+            return first->name < second->name;
+        });
+        Wt::Json::Array folders;
+        for (const auto* childFolder : childFolders) {
+            folders.emplace_back(toJson(*childFolder, folder.id()));
+        }
+
+        std::vector<const FolderCache::FileEntry*> childFiles;
+        for (const auto& file : listing->files) {
+            childFiles.push_back(&file);
+        }
+        std::sort(childFiles.begin(), childFiles.end(), [](const auto* first, const auto* second) {
+            return first->name < second->name;
+        });
+        Wt::Json::Array files;
+        for (const auto* file : childFiles) {
+            files.emplace_back(toJson(*file, folder.id()));
+        }
+
+        auto object = toJson(folder);
+        object["folders"] = std::move(folders);
+        object["files"] = std::move(files);
+        context.setReply(std::move(object));
+    } else if (method == "PATCH") {
+        if (const std::string* name = getParameter(context.request, "name")) {
+            Folder::rename(folder, *name);
+        }
+        if (const std::string* parent = getParameter(context.request, "parent")) {
+            Folder::move(context.databaseSession, folder, findFolder(context, *parent));
+        }
+        context.setReply(toJson(folder));
+    } else if (method == "DELETE") {
+        Folder::removeRecursive(context.databaseSession, folder);
+        context.hasDeletedFiles = true;
+        context.status = 204;
+    } else {
+        throw ApiError(405, "Method not allowed.");
+    }
+}
+
+void ApiResource::handleFile(RequestContext& context, const Wt::Dbo::ptr<File>& file)
+{
+    const std::string& method = context.request.method();
+    if (method == "GET") {
+        context.setReply(toJson(file));
+    } else if (method == "PATCH") {
+        if (const std::string* name = getParameter(context.request, "name")) {
+            File::rename(file, *name);
+        }
+        if (const std::string* parent = getParameter(context.request, "parent")) {
+            File::move(file, findFolder(context, *parent));
+        }
+        context.setReply(toJson(file));
+    } else if (method == "DELETE") {
+        File::remove(context.databaseSession, file);
+        context.hasDeletedFiles = true;
+        context.status = 204;
+    } else {
+        throw ApiError(405, "Method not allowed.");
+    }
+}
+
+void ApiResource::downloadFile(RequestContext& context, const Wt::Dbo::ptr<File>& file)
+{
+    auto state = std::make_shared<DownloadState>();
+    state->size = static_cast<uint64_t>(file->getFileSize());
+    if (!file->isPacked()) {
+        state->fd = open((std::string(File::FILE_SYSTEM_ROOT) + std::to_string(file.id())).c_str(), O_RDONLY | O_CLOEXEC);
+    }
+    if (auto key = state->fd >= 0 ? BlobCache::getKey(state->fd) : std::nullopt) {
+        state->cachedContent = BlobCache::instance().find(*key);
+        if (!state->cachedContent && BlobCache::instance().shouldAdmit(*key)) {
+            state->cacheKey = key;
+            state->cacheFill.reserve(static_cast<std::size_t>(key->size));
+        }
+    }
+    if (file->isPacked()) {
+        state->cachedContent = BlobCache::instance().get(file->getSegmentId(), file->getSegmentOffset(), file->getFileSize());
+    }
+    if (state->fd < 0 && !state->cachedContent) {
+        throw ApiError(404, "The file content is missing.");
+    }
+
+    // The content is sent after the transaction is committed.
+    state->mimeType = file->getMimeType();
+    context.download = std::move(state);
+}
+
+void ApiResource::sendSignatures(RequestContext& context, const Wt::Dbo::ptr<File>& file)
+{
+    static auto& timeHistogram = Metrics::instance().getHistogram("cgs_delta_signature_duration_seconds", "Time taken to compute the block signatures of a file for a delta upload.", Metrics::Unit::Microseconds);
+    Metrics::ScopedTimer timer(timeHistogram);
+
+    auto content = File::openContent(file);
+    if (!content) {
+        throw ApiError(404, "The file content is missing.");
+    }
+    auto size = static_cast<uint64_t>(file->getFileSize());
+
+    // The block size has to match the one that File::applyDelta uses, so it
+    // comes from the size of the content itself.
+    std::size_t blockSize = BlockDelta::getBlockSize(size);
+    Wt::Json::Array blocks;
+    for (const auto& signature : BlockDelta::computeSignatures(*content, blockSize)) {
+        Wt::Json::Object block;
+        block["weak"] = static_cast<long long>(signature.weakHash);
+        block["strong"] = Wt::WString::fromUTF8(toHex(signature.strongHash));
+        blocks.emplace_back(std::move(block));
+    }
+
+    Wt::Json::Object object;
+    object["basis"] = file.version();
+    object["size"] = static_cast<long long>(size);
+    object["blockSize"] = static_cast<long long>(blockSize);
+    object["blocks"] = std::move(blocks);
+    context.setReply(std::move(object));
+}
+
+void ApiResource::patchFile(RequestContext& context, const Wt::Dbo::ptr<File>& file)
+{
+    // The file's version changes whenever it is saved, so a delta made
+    // against older content can't be applied by mistake.
+    const std::string* basis = getParameter(context.request, "basis");
+    if (basis == nullptr || *basis != std::to_string(file.version())) {
+        throw ApiError(409, "The file has changed since its signatures were read.");
+    }
+
+    File::applyDelta(context.databaseSession, file, context.request.in());
+    context.hasDeletedFiles = true;
+    context.setReply(toJson(file));
+}
+
+void ApiResource::listVersions(RequestContext& context, const Wt::Dbo::ptr<File>& file)
+{
+    Wt::Json::Array versions;
+    for (const auto& version : FileVersion::list(context.databaseSession, file.id())) {
+        Wt::Json::Object object;
+        object["id"] = version.id;
+        object["size"] = static_cast<long long>(version.fileSize);
+        object["mimeType"] = Wt::WString::fromUTF8(version.mimeType);
+        object["created"] = static_cast<long long>(version.creationTime.toTime_t());
+        versions.emplace_back(std::move(object));
+    }
+
+    Wt::Json::Object object;
+    object["versions"] = std::move(versions);
+    context.setReply(std::move(object));
+}
+
+void ApiResource::listChanges(RequestContext& context)
+{
+    Wt::Json::Object object;
+    Wt::Json::Array changes;
+    bool hasMore = false;
+
+    const std::string* since = getParameter(context.request, "since");
+    if (since == nullptr) {
+        object["cursor"] = Change::getLatestCursor(context.databaseSession, context.user.id());
+    } else {
+        long long cursor = 0;
+        try {
+            std::size_t length = 0;
+            cursor = std::stoll(*since, &length);
+            if (length != since->size() || cursor < 0) {
+                throw std::invalid_argument("trailing characters");
+            }
+        } catch (const std::exception&) {
+            throw ApiError(400, "The cursor is not valid.");
+        }
+
+        // One more change than is sent is read, to know if there are more.
+        auto entries = Change::getSince(context.databaseSession, context.user.id(), cursor, MAX_CHANGES + 1);
+        hasMore = entries.size() > MAX_CHANGES;
+        if (hasMore) {
+            entries.pop_back();
+        }
+        for (const auto& entry : entries) {
+            changes.emplace_back(toJson(entry));
+        }
+        object["cursor"] = entries.empty() ? cursor : entries.back().cursor;
+    }
+
+    object["changes"] = std::move(changes);
+    object["hasMore"] = hasMore;
+    context.setReply(std::move(object));
+}
+
+Wt::Dbo::ptr<Folder> ApiResource::findFolder(RequestContext& context, const std::string& id)
+{
+    if (id == "root") {
+        return context.user->getRootFolder();
+    }
+
+    Wt::Dbo::ptr<Folder> folder = context.databaseSession.find<Folder>().where("id = ? AND owner_id = ?").bind(parseId(id)).bind(context.user.id());
+    if (!folder) {
+        throw ApiError(404, "Folder not found.");
+    }
+    return folder;
+}
+
+Wt::Dbo::ptr<File> ApiResource::findFile(RequestContext& context, const std::string& id)
+{
+    Wt::Dbo::ptr<File> file = context.databaseSession.find<File>().where("id = ? AND owner_id = ?").bind(parseId(id)).bind(context.user.id());
+    if (!file) {
+        throw ApiError(404, "File not found.");
+    }
+    return file;
+}
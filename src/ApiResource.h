@@ -0,0 +1,137 @@
+/**
+ * \class ApiResource
+ *
+ * A stateless JSON API for programs that use Cloud Goose Storage.
+ *
+ * Unlike the web interface, the API doesn't create a `StorageApplication` for
+ * each client. Every request is handled on its own with a database connection
+ * from a shared pool, so a client costs little more than the request itself.
+ *
+ * Requests other than `POST /api/tokens` must have an
+ * `Authorization: Bearer <token>` header. The API has these endpoints:
+ *
+ *  - `POST /api/tokens` with `username` and `password` parameters creates a
+ *    token.
+ *  - `DELETE /api/tokens/current` revokes the token used for the request.
+ *  - `GET /api/folders/<id>` lists a folder. `root` can be used as the ID of
+ *    the user's root folder.
+ *  - `POST /api/folders/<id>/folders?name=<name>` creates a folder.
+ *  - `POST /api/folders/<id>/files?name=<name>` uploads the request body as a
+ *    new file, or as new content for the file with that name. The body must
+ *    not be sent as form data.
+ *  - `PATCH /api/folders/<id>?name=<name>&parent=<id>` renames and/or moves a
+ *    folder.
+ *  - `DELETE /api/folders/<id>` deletes a folder and everything inside it.
+ *  - `GET /api/files/<id>` gets a file's metadata.
+ *  - `GET /api/files/<id>/content` downloads a file.
+ *  - `GET /api/files/<id>/signatures` gets the block signatures of a file's
+ *    content, along with its `basis`, for a delta upload.
+ *  - `PUT /api/files/<id>/content?basis=<basis>` changes a file's content
+ *    with a `BlockDelta` delta in the request body, so that only the changed
+ *    parts of a large file are sent. The basis must be the one that came with
+ *    the signatures that the delta was made with.
+ *  - `GET /api/files/<id>/versions` lists the earlier versions of a file's
+ *    content, newest first.
+ *  - `POST /api/files/<id>/versions/<id>/restore` makes a version the file's
+ *    content again. The content it replaces becomes a new version.
+ *  - `PATCH /api/files/<id>?name=<name>&parent=<id>` renames and/or moves a
+ *    file.
+ *  - `DELETE /api/files/<id>` deletes a file.
+ *  - `GET /api/changes?since=<cursor>` lists the changes to the user's files
+ *    and folders after a cursor, oldest first, along with the cursor to use
+ *    next time. Without `since`, it only returns the latest cursor, which a
+ *    client should get before listing its folders for the first time.
+ *
+ * Errors are returned as `{"error": "<message>"}` with a matching status
+ * code.
+ *
+ * \date 2026-10-19 (last updated)
+ */
+
+#pragma once
+
+#include <Wt/Dbo/SqlConnectionPool.h>
+#include <Wt/Dbo/ptr.h>
+#include <Wt/Http/Request.h>
+#include <Wt/Http/Response.h>
+#include <Wt/WResource.h>
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <vector>
+#include "ApiToken.h"
+#include "File.h"
+#include "Folder.h"
+
+class ApiResource : public Wt::WResource {
+public:
+    /**
+     * Creates the API resource and its database connection pool.
+     *
+     * The size of the pool is read from the `api-connections` property.
+     */
+    ApiResource();
+
+    ~ApiResource() override;
+
+    /**
+     * Handles an API request.
+     *
+     * This is called by Wt, possibly from several threads at once.
+     *
+     * \param request  The request to handle.
+     * \param response The response to write to.
+     */
+    void handleRequest(const Wt::Http::Request& request, Wt::Http::Response& response) override;
+
+private:
+    /**
+     * The amount of file content sent in each piece of a download.
+     */
+    constexpr static std::size_t CHUNK_SIZE = 64 * 1024;
+
+    /**
+     * The most changes sent in one response. Clients ask again with the new
+     * cursor while `hasMore` is true.
+     */
+    constexpr static std::size_t MAX_CHANGES = 1000;
+
+    struct RequestContext;
+    struct DownloadState;
+
+    std::unique_ptr<Wt::Dbo::SqlConnectionPool> m_connectionPool;
+
+    /**
+     * Sends the next piece of a file download.
+     */
+    static void continueDownload(const std::shared_ptr<DownloadState>& state, Wt::Http::Response& response);
+
+    /**
+     * Sends the response for a request, based on its method and path.
+     */
+    static void route(RequestContext& context, const std::vector<std::string>& path);
+
+    static void createToken(RequestContext& context);
+    static void handleFolder(RequestContext& context, const Wt::Dbo::ptr<Folder>& folder);
+    static void handleFile(RequestContext& context, const Wt::Dbo::ptr<File>& file);
+    static void downloadFile(RequestContext& context, const Wt::Dbo::ptr<File>& file);
+    static void sendSignatures(RequestContext& context, const Wt::Dbo::ptr<File>& file);
+    static void patchFile(RequestContext& context, const Wt::Dbo::ptr<File>& file);
+    static void listVersions(RequestContext& context, const Wt::Dbo::ptr<File>& file);
+    static void listChanges(RequestContext& context);
+
+    /**
+     * Looks up a folder owned by the user making the request.
+     *
+     * \exception ApiError If the folder doesn't exist or isn't owned by the
+     *                     user.
+     */
+    static Wt::Dbo::ptr<Folder> findFolder(RequestContext& context, const std::string& id);
+
+    /**
+     * Looks up a file owned by the user making the request.
+     *
+     * \exception ApiError If the file doesn't exist or isn't owned by the user.
+     */
+    static Wt::Dbo::ptr<File> findFile(RequestContext& context, const std::string& id);
+};
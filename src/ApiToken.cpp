@@ -0,0 +1,125 @@
+#include "ApiToken.h"
+
+#include <Wt/Dbo/Session.h>
+#include <Wt/WRandom.h>
+#include <exception>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <utility>
+#include "ApiTokenCache.h"
+#include "Configuration.h"
+
+// The number of random characters in the secret part of a token.
+constexpr int SECRET_LENGTH = 32;
+
+// The number of random characters in a generated token key.
+constexpr int KEY_LENGTH = 64;
+
+/**
+ * Gets the key used to hash token secrets.
+ *
+ * The key comes from the `api-token-key` property. If that isn't set, a
+ * random key is generated the first time and kept in `ApiToken::KEY_PATH`,
+ * so that tokens stay valid when the server restarts.
+ */
+static const std::string& getKey()
+{
+    static const std::string key = [] {
+        std::string configuredKey = Configuration::getString("api-token-key", "");
+        if (!configuredKey.empty()) {
+            return configuredKey;
+        }
+
+        const std::filesystem::path keyPath(ApiToken::KEY_PATH);
+        std::ifstream keyFile(keyPath, std::ios::binary);
+        std::string storedKey((std::istreambuf_iterator<char>(keyFile)), std::istreambuf_iterator<char>());
+        if (!storedKey.empty()) {
+            return storedKey;
+        }
+
+        std::string newKey = Wt::WRandom::generateId(KEY_LENGTH);
+        {
+            std::ofstream newKeyFile(keyPath, std::ios::binary | std::ios::trunc);
+            newKeyFile << newKey;
+            if (!newKeyFile.flush()) {
+                throw std::runtime_error("Failed to save the API token key");
+            }
+        }
+        std::error_code error;
+        std::filesystem::permissions(keyPath, std::filesystem::perms::owner_read | std::filesystem::perms::owner_write, error);
+        if (error) {
+            std::cerr << "ApiToken: Failed to restrict access to " << keyPath << ": " << error.message() << std::endl;
+        }
+        return newKey;
+    }();
+    return key;
+}
+
+ApiToken::ApiToken(Wt::Dbo::ptr<User> user, const std::string& secret)
+    : m_secretHash(Sha256::toHex(hashSecret(secret)))
+    , m_user(std::move(user))
+    , m_creationTime(Wt::WDateTime::currentDateTime())
+{
+}
+
+std::string ApiToken::create(Wt::Dbo::Session& databaseSession, Wt::Dbo::ptr<User> user)
+{
+    std::string secret = Wt::WRandom::generateId(SECRET_LENGTH);
+    auto token = databaseSession.addNew<ApiToken>(std::move(user), secret);
+    databaseSession.flush();
+    return std::to_string(token.id()) + "." + secret;
+}
+
+std::optional<ApiToken::Verification> ApiToken::verify(Wt::Dbo::Session& databaseSession, const std::string& token)
+{
+    auto separator = token.find('.');
+    if (separator == std::string::npos) {
+        return std::nullopt;
+    }
+
+    long long tokenId = 0;
+    try {
+        tokenId = std::stoll(token.substr(0, separator));
+    } catch (const std::exception&) {
+        return std::nullopt;
+    }
+
+    auto secretHash = hashSecret(std::string_view(token).substr(separator + 1));
+    auto& cache = ApiTokenCache::instance();
+    if (auto userId = cache.find(tokenId, secretHash)) {
+        return Verification { tokenId, *userId };
+    }
+
+    auto generation = cache.getGeneration();
+    Wt::Dbo::ptr<ApiToken> apiToken = databaseSession.find<ApiToken>().where("id = ?").bind(tokenId);
+    if (!apiToken) {
+        return std::nullopt;
+    }
+
+    auto storedHash = Sha256::fromHex(apiToken->m_secretHash);
+    if (!storedHash || !Sha256::isEqual(*storedHash, secretHash)) {
+        return std::nullopt;
+    }
+
+    long long userId = apiToken->m_user.id();
+    cache.insert(tokenId, secretHash, userId, generation);
+    return Verification { tokenId, userId };
+}
+
+void ApiToken::revoke(Wt::Dbo::Session& databaseSession, long long tokenId)
+{
+    Wt::Dbo::ptr<ApiToken> apiToken = databaseSession.find<ApiToken>().where("id = ?").bind(tokenId);
+    if (apiToken) {
+        apiToken.remove();
+    }
+}
+
+Sha256::Digest ApiToken::hashSecret(std::string_view secret)
+{
+    return Sha256::hmac(getKey(), secret);
+}
@@ -0,0 +1,143 @@
+/**
+ * \class ApiToken
+ *
+ * A token that lets a program use the HTTP API on behalf of a user.
+ *
+ * Tokens look like `<id>.<secret>`. Only a hash of the secret is stored, so
+ * the token itself is only known when it is created.
+ *
+ * Secrets are long and random, so unlike passwords they don't need a slow
+ * hash. An HMAC-SHA256 keyed with a server secret is used instead, which takes
+ * microseconds to check. Recently verified tokens are also remembered by the
+ * `ApiTokenCache`, so most requests don't read the token from the database.
+ *
+ * \date 2026-10-19 (last updated)
+ */
+
+#pragma once
+
+#include <Wt/Dbo/Dbo.h>
+#include <Wt/Dbo/WtSqlTraits.h>
+#include <Wt/WDateTime.h>
+#include <optional>
+#include <string>
+#include <string_view>
+#include "Sha256.h"
+#include "User.h"
+
+class ApiToken {
+public:
+    /**
+     * The file that the server's token key is stored in, if the
+     * `api-token-key` property is not set.
+     */
+    constexpr static std::string_view KEY_PATH = "CloudGooseStorage.key";
+
+    /**
+     * The result of verifying a token.
+     */
+    struct Verification {
+        long long tokenId;
+        long long userId;
+    };
+
+private:
+    std::string m_secretHash;
+    Wt::Dbo::ptr<User> m_user;
+    Wt::WDateTime m_creationTime;
+
+public:
+    /**
+     * Creates a new token.
+     *
+     * \param user   The user that the token belongs to.
+     * \param secret The secret part of the token.
+     */
+    ApiToken(Wt::Dbo::ptr<User> user, const std::string& secret);
+
+    /**
+     * Creates a new token with default values for all metadata.
+     *
+     * This should never be used directly by application code, but it is
+     * required by `Wt::Dbo`.
+     */
+    [[deprecated("only for use by Wt::Dbo")]] ApiToken() = default;
+
+    /**
+     * Creates a new token for a user.
+     *
+     * This requires a Wt::Dbo::Transaction to be currently active.
+     *
+     * \param databaseSession The database session to use.
+     * \param user            The user that the token belongs to.
+     * \return                The token, which must be given to the client
+     *                        since it can't be found again.
+     */
+    static std::string create(Wt::Dbo::Session& databaseSession, Wt::Dbo::ptr<User> user);
+
+    /**
+     * Checks the token that a client sent.
+     *
+     * The database is only used if the token isn't in the `ApiTokenCache`.
+     *
+     * This requires a Wt::Dbo::Transaction to be currently active.
+     *
+     * \param databaseSession The database session to use.
+     * \param token           The token sent by the client.
+     * \return                The IDs of the token and its user, or an empty
+     *                        optional if the token is not valid.
+     */
+    static std::optional<Verification> verify(Wt::Dbo::Session& databaseSession, const std::string& token);
+
+    /**
+     * Deletes a token.
+     *
+     * `ApiTokenCache::revoke` must be called once the transaction has been
+     * committed.
+     *
+     * This requires a Wt::Dbo::Transaction to be currently active.
+     *
+     * \param databaseSession The database session to use.
+     * \param tokenId         The ID of the token to delete.
+     */
+    static void revoke(Wt::Dbo::Session& databaseSession, long long tokenId);
+
+    /**
+     * Gets the user that this token belongs to.
+     *
+     * \return The user.
+     */
+    Wt::Dbo::ptr<User> getUser() const { return m_user; }
+
+    /**
+     * Gets the time that this token was created.
+     *
+     * \return The creation time, in UTC.
+     */
+    const Wt::WDateTime& getCreationTime() const { return m_creationTime; }
+
+    /**
+     * Hashes the secret part of a token.
+     *
+     * \param secret The secret.
+     * \return       The HMAC-SHA256 of the secret, keyed with the server's
+     *               token key.
+     */
+    static Sha256::Digest hashSecret(std::string_view secret);
+
+    /**
+     * Persists changes to the database.
+     *
+     * This should never be used directly by application code, but it is
+     * required by `Wt::Dbo`.
+     *
+     * \param action The database action to perform.
+     */
+    template <class Action>
+    void persist(Action& action)
+    {
+        Wt::Dbo::field(action, m_secretHash, "secret_hash");
+        Wt::Dbo::belongsTo(action, m_user, "user", Wt::Dbo::OnDeleteCascade);
+        Wt::Dbo::field(action, m_creationTime, "creation_time");
+    }
+};
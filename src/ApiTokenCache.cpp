@@ -0,0 +1,64 @@
+#include "ApiTokenCache.h"
+
+#include <iterator>
+#include <mutex>
+#include <shared_mutex>
+
+ApiTokenCache& ApiTokenCache::instance()
+{
+    static ApiTokenCache cache;
+    return cache;
+}
+
+void ApiTokenCache::configure(std::chrono::seconds timeToLive, std::size_t maxSize)
+{
+    std::unique_lock lock(m_mutex);
+    m_timeToLive = timeToLive;
+    m_maxSize = maxSize;
+    m_entries.clear();
+}
+
+std::optional<long long> ApiTokenCache::find(long long tokenId, const Sha256::Digest& secretHash) const
+{
+    std::shared_lock lock(m_mutex);
+    auto entry = m_entries.find(tokenId);
+    if (entry == m_entries.end() || entry->second.expiryTime <= std::chrono::steady_clock::now()
+        || !Sha256::isEqual(entry->second.secretHash, secretHash)) {
+        return std::nullopt;
+    }
+    return entry->second.userId;
+}
+
+uint64_t ApiTokenCache::getGeneration() const
+{
+    std::shared_lock lock(m_mutex);
+    return m_generation;
+}
+
+void ApiTokenCache::insert(long long tokenId, const Sha256::Digest& secretHash, long long userId, uint64_t generation)
+{
+    std::unique_lock lock(m_mutex);
+    if (generation != m_generation || m_timeToLive.count() <= 0) {
+        return;
+    }
+
+    const auto now = std::chrono::steady_clock::now();
+    if (m_entries.size() >= m_maxSize) {
+        for (auto entry = m_entries.begin(); entry != m_entries.end();) {
+            entry = entry->second.expiryTime <= now ? m_entries.erase(entry) : std::next(entry);
+        }
+        // Still full of live entries, so start over rather than spending time
+        // picking which ones to drop.
+        if (m_entries.size() >= m_maxSize) {
+            m_entries.clear();
+        }
+    }
+    m_entries.insert_or_assign(tokenId, Entry { secretHash, userId, now + m_timeToLive });
+}
+
+void ApiTokenCache::revoke(long long tokenId)
+{
+    std::unique_lock lock(m_mutex);
+    m_entries.erase(tokenId);
+    ++m_generation;
+}
@@ -0,0 +1,101 @@
+/**
+ * \class ApiTokenCache
+ *
+ * Remembers recently verified API tokens, so that most requests don't need to
+ * look up their token in the database.
+ *
+ * Entries expire after a configurable time, and are removed right away when a
+ * token is revoked. A revocation also stops any verification that was already
+ * in progress from adding the revoked token back.
+ *
+ * \date 2026-10-19 (last updated)
+ */
+
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <shared_mutex>
+#include <unordered_map>
+#include "Sha256.h"
+
+class ApiTokenCache {
+public:
+    /**
+     * Gets the token cache for this server.
+     *
+     * \return The token cache.
+     */
+    static ApiTokenCache& instance();
+
+    ApiTokenCache(const ApiTokenCache&) = delete;
+    ApiTokenCache& operator=(const ApiTokenCache&) = delete;
+
+    /**
+     * Changes the cache's settings.
+     *
+     * \param timeToLive How long a verified token is trusted without checking
+     *                   the database again. 0 disables the cache.
+     * \param maxSize    The maximum number of tokens to remember.
+     */
+    void configure(std::chrono::seconds timeToLive, std::size_t maxSize);
+
+    /**
+     * Looks up a verified token.
+     *
+     * \param tokenId    The ID of the token.
+     * \param secretHash The hash of the secret that the client sent.
+     * \return           The ID of the token's user, or an empty optional if
+     *                   the token isn't cached or the secret doesn't match.
+     */
+    std::optional<long long> find(long long tokenId, const Sha256::Digest& secretHash) const;
+
+    /**
+     * Gets the current revocation generation.
+     *
+     * This must be read before checking a token in the database, and passed to
+     * `insert` afterwards.
+     *
+     * \return The generation.
+     */
+    uint64_t getGeneration() const;
+
+    /**
+     * Remembers a token that was verified with the database.
+     *
+     * Nothing is remembered if a token was revoked since `generation` was
+     * read, since the database may have been read before the revocation.
+     *
+     * \param tokenId    The ID of the token.
+     * \param secretHash The hash of the token's secret.
+     * \param userId     The ID of the token's user.
+     * \param generation The generation from before the database was checked.
+     */
+    void insert(long long tokenId, const Sha256::Digest& secretHash, long long userId, uint64_t generation);
+
+    /**
+     * Forgets a token.
+     *
+     * This must be called after the token's deletion has been committed.
+     *
+     * \param tokenId The ID of the token.
+     */
+    void revoke(long long tokenId);
+
+private:
+    struct Entry {
+        Sha256::Digest secretHash;
+        long long userId;
+        std::chrono::steady_clock::time_point expiryTime;
+    };
+
+    mutable std::shared_mutex m_mutex;
+    std::unordered_map<long long, Entry> m_entries;
+    std::chrono::seconds m_timeToLive { 300 };
+    std::size_t m_maxSize { 10000 };
+    uint64_t m_generation { 0 };
+
+    ApiTokenCache() = default;
+};
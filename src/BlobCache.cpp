@@ -0,0 +1,223 @@
+#include "BlobCache.h"
+
+#include <algorithm>
+#include <bit>
+#include <cerrno>
+#include <utility>
+#include "Configuration.h"
+#include "Histogram.h"
+#include "Metrics.h"
+#include "SegmentStore.h"
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// The sketch has about this many counters per row for each cached byte, so
+// that popular blobs rarely share counters even when most are small.
+constexpr std::size_t BYTES_PER_COUNTER = 16 * 1024;
+
+// SplitMix64, which spreads nearby inode numbers over the whole sketch.
+static uint64_t mix(uint64_t value)
+{
+    value += 0x9e3779b97f4a7c15ULL;
+    value = (value ^ (value >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    value = (value ^ (value >> 27)) * 0x94d049bb133111ebULL;
+    return value ^ (value >> 31);
+}
+
+std::size_t BlobCache::KeyHash::operator()(const Key& key) const
+{
+    uint64_t hash = mix(key.device);
+    hash = mix(hash ^ key.inode);
+    hash = mix(hash ^ static_cast<uint64_t>(key.size));
+    hash = mix(hash ^ static_cast<uint64_t>(key.modificationTime));
+    return static_cast<std::size_t>(mix(hash ^ static_cast<uint64_t>(key.isPacked)));
+}
+
+BlobCache& BlobCache::instance()
+{
+    static BlobCache cache;
+    return cache;
+}
+
+BlobCache::BlobCache()
+    : m_maxSize(static_cast<std::size_t>(std::max(0LL, Configuration::getInteger("blob-cache-size", 256))) * 1024 * 1024)
+    , m_maxEntrySize(static_cast<std::size_t>(std::max(0LL, Configuration::getInteger("blob-cache-max-file-size", 16))) * 1024 * 1024)
+{
+    std::size_t width = std::bit_ceil(std::clamp<std::size_t>(m_maxSize / BYTES_PER_COUNTER, 1024, 1 << 20));
+    for (auto& row : m_sketch) {
+        row.assign(width, 0);
+    }
+    m_sketchMask = width - 1;
+    // TinyLFU halves the counts after about ten lookups per counter.
+    m_sampleSize = width * 10;
+}
+
+std::optional<BlobCache::Key> BlobCache::getKey(int fd)
+{
+    struct stat status {};
+    if (fstat(fd, &status) != 0 || !S_ISREG(status.st_mode)) {
+        return std::nullopt;
+    }
+    return Key {
+        static_cast<uint64_t>(status.st_dev),
+        static_cast<uint64_t>(status.st_ino),
+        static_cast<int64_t>(status.st_size),
+        static_cast<int64_t>(status.st_mtim.tv_sec) * 1000000000 + status.st_mtim.tv_nsec,
+        false,
+    };
+}
+
+BlobCache::Key BlobCache::getKey(long long segmentId, int64_t offset, int64_t size)
+{
+    return Key { static_cast<uint64_t>(segmentId), static_cast<uint64_t>(offset), size, 0, true };
+}
+
+std::shared_ptr<const std::string> BlobCache::find(const Key& key)
+{
+    static auto& hits = Metrics::instance().getHistogram("cgs_blob_cache_hit_bytes", "Size of each download served from the blob cache.", Metrics::Unit::Bytes);
+    static auto& misses = Metrics::instance().getHistogram("cgs_blob_cache_miss_bytes", "Size of each download that the blob cache couldn't serve.", Metrics::Unit::Bytes);
+    if (m_maxSize == 0) {
+        return nullptr;
+    }
+
+    std::lock_guard lock(m_mutex);
+    increment(key);
+    auto entry = m_entries.find(key);
+    if (entry == m_entries.end()) {
+        misses.record(static_cast<uint64_t>(key.size));
+        return nullptr;
+    }
+    m_lru.splice(m_lru.begin(), m_lru, entry->second.lruPosition);
+    hits.record(static_cast<uint64_t>(key.size));
+    return entry->second.content;
+}
+
+bool BlobCache::shouldAdmit(const Key& key)
+{
+    std::lock_guard lock(m_mutex);
+    return canAdmit(key);
+}
+
+void BlobCache::insert(const Key& key, std::shared_ptr<const std::string> content)
+{
+    std::lock_guard lock(m_mutex);
+    if (static_cast<int64_t>(content->size()) != key.size || !canAdmit(key)) {
+        return;
+    }
+
+    while (m_size + content->size() > m_maxSize) {
+        auto victim = m_entries.find(m_lru.back());
+        m_size -= victim->second.content->size();
+        m_entries.erase(victim);
+        m_lru.pop_back();
+    }
+    m_size += content->size();
+    m_lru.push_front(key);
+    m_entries.emplace(key, Entry { std::move(content), m_lru.begin() });
+}
+
+std::shared_ptr<const std::string> BlobCache::get(const std::string& path)
+{
+    if (m_maxSize == 0) {
+        return nullptr;
+    }
+    int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return nullptr;
+    }
+
+    // The key comes from the open blob, so the content read below is always
+    // the content that the key describes.
+    std::shared_ptr<const std::string> content;
+    if (auto key = getKey(fd)) {
+        content = find(*key);
+        if (!content && shouldAdmit(*key)) {
+            auto loaded = std::make_shared<std::string>(static_cast<std::size_t>(key->size), '\0');
+            std::size_t bytesRead = 0;
+            while (bytesRead < loaded->size()) {
+                ssize_t result = pread(fd, loaded->data() + bytesRead, loaded->size() - bytesRead, static_cast<off_t>(bytesRead));
+                if (result < 0 && errno == EINTR) {
+                    continue;
+                }
+                if (result <= 0) {
+                    break;
+                }
+                bytesRead += static_cast<std::size_t>(result);
+            }
+            if (bytesRead == loaded->size()) {
+                content = loaded;
+                insert(*key, std::move(loaded));
+            }
+        }
+    }
+    close(fd);
+    return content;
+}
+
+std::shared_ptr<const std::string> BlobCache::get(long long segmentId, int64_t offset, int64_t size)
+{
+    auto key = getKey(segmentId, offset, size);
+    if (auto content = find(key)) {
+        return content;
+    }
+
+    // Packed content is small and read all at once, so it is kept whether or
+    // not it is cached.
+    auto loaded = SegmentStore::read(segmentId, offset, size);
+    if (!loaded) {
+        return nullptr;
+    }
+    auto content = std::make_shared<const std::string>(std::move(*loaded));
+    insert(key, content);
+    return content;
+}
+
+void BlobCache::increment(const Key& key)
+{
+    uint64_t hash = KeyHash()(key);
+    for (std::size_t row = 0; row < SKETCH_DEPTH; ++row) {
+        uint8_t& count = m_sketch[row][mix(hash + row) & m_sketchMask];
+        if (count < MAX_COUNT) {
+            ++count;
+        }
+    }
+
+    if (++m_sampleCount >= m_sampleSize) {
+        for (auto& sketchRow : m_sketch) {
+            for (auto& count : sketchRow) {
+                count /= 2;
+            }
+        }
+        m_sampleCount /= 2;
+    }
+}
+
+uint8_t BlobCache::estimate(const Key& key) const
+{
+    uint64_t hash = KeyHash()(key);
+    uint8_t count = MAX_COUNT;
+    for (std::size_t row = 0; row < SKETCH_DEPTH; ++row) {
+        count = std::min(count, m_sketch[row][mix(hash + row) & m_sketchMask]);
+    }
+    return count;
+}
+
+bool BlobCache::canAdmit(const Key& key) const
+{
+    auto size = static_cast<std::size_t>(key.size);
+    if (m_maxSize == 0 || key.size <= 0 || size > m_maxEntrySize || size > m_maxSize || m_entries.count(key) > 0) {
+        return false;
+    }
+
+    uint8_t count = estimate(key);
+    std::size_t freeSize = m_maxSize - m_size;
+    for (auto victim = m_lru.rbegin(); freeSize < size && victim != m_lru.rend(); ++victim) {
+        if (estimate(*victim) >= count) {
+            return false;
+        }
+        freeSize += static_cast<std::size_t>(victim->size);
+    }
+    return true;
+}
@@ -0,0 +1,178 @@
+/**
+ * \class BlobCache
+ *
+ * Keeps the content of frequently downloaded blobs in memory, shared by every
+ * session, sharing link and API request, so that a popular file is sent
+ * without reading it from disk each time.
+ *
+ * Blobs are identified by their inode and modification time rather than by
+ * their file, since new content always replaces a blob with a new inode.
+ * Entries for replaced or deleted blobs are never found again and are evicted
+ * like any other cold entry. Content packed into a segment is identified by
+ * its place in the segment, which never changes, since segments are only
+ * appended to.
+ *
+ * Admission follows TinyLFU: every lookup is counted in a small count-min
+ * sketch, and a blob is only added when it has been requested more often
+ * than the least recently used entries it would evict. This keeps one-off
+ * downloads of large files from pushing out the files that everyone is
+ * downloading. The counts are halved periodically, so popularity fades.
+ *
+ * \date 2026-10-19 (last updated)
+ */
+
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+class BlobCache {
+public:
+    /**
+     * Identifies a version of a blob on disk, or some packed content.
+     */
+    struct Key {
+        // For packed content, the segment ID and the offset in the segment.
+        uint64_t device;
+        uint64_t inode;
+        int64_t size;
+        int64_t modificationTime;
+        bool isPacked;
+
+        bool operator==(const Key& other) const = default;
+    };
+
+    /**
+     * Gets the blob cache for this server.
+     *
+     * \return The blob cache.
+     */
+    static BlobCache& instance();
+
+    BlobCache(const BlobCache&) = delete;
+    BlobCache& operator=(const BlobCache&) = delete;
+
+    /**
+     * Gets the key of an open blob.
+     *
+     * \param fd The blob.
+     * \return   The key, or `std::nullopt` if the blob couldn't be checked.
+     */
+    static std::optional<Key> getKey(int fd);
+
+    /**
+     * Gets the key of some content packed into a segment.
+     *
+     * \param segmentId The ID of the segment.
+     * \param offset    Where the content starts in the segment.
+     * \param size      The size of the content.
+     * \return          The key.
+     */
+    static Key getKey(long long segmentId, int64_t offset, int64_t size);
+
+    /**
+     * Looks up a blob, and counts the request towards its popularity.
+     *
+     * \param key The key of the blob.
+     * \return    The content, or nullptr if it isn't cached.
+     */
+    std::shared_ptr<const std::string> find(const Key& key);
+
+    /**
+     * Checks whether a blob would be added to the cache, so that callers
+     * only keep its content when it is worth it.
+     *
+     * \param key The key of the blob.
+     * \return    Whether `insert` would add it right now.
+     */
+    bool shouldAdmit(const Key& key);
+
+    /**
+     * Adds a blob to the cache, if it is popular enough.
+     *
+     * \param key     The key of the blob.
+     * \param content The whole content of the blob.
+     */
+    void insert(const Key& key, std::shared_ptr<const std::string> content);
+
+    /**
+     * Gets the content of a blob from the cache, reading it into the cache if
+     * it is popular enough.
+     *
+     * \param path The path of the blob.
+     * \return     The content, or nullptr if the blob should be read from
+     *             disk as usual.
+     */
+    std::shared_ptr<const std::string> get(const std::string& path);
+
+    /**
+     * Gets some content packed into a segment, from the cache if it is there,
+     * and adds it to the cache if it is popular enough.
+     *
+     * \param segmentId The ID of the segment.
+     * \param offset    Where the content starts in the segment.
+     * \param size      The size of the content.
+     * \return          The content, or nullptr if it couldn't be read.
+     */
+    std::shared_ptr<const std::string> get(long long segmentId, int64_t offset, int64_t size);
+
+private:
+    struct KeyHash {
+        std::size_t operator()(const Key& key) const;
+    };
+
+    struct Entry {
+        std::shared_ptr<const std::string> content;
+        std::list<Key>::iterator lruPosition;
+    };
+
+    // The count-min sketch has one row of counters for each hash function.
+    constexpr static std::size_t SKETCH_DEPTH = 4;
+    constexpr static uint8_t MAX_COUNT = 15;
+
+    std::mutex m_mutex;
+    std::unordered_map<Key, Entry, KeyHash> m_entries;
+    // Most recently used first.
+    std::list<Key> m_lru;
+    std::size_t m_size { 0 };
+    std::size_t m_maxSize;
+    std::size_t m_maxEntrySize;
+
+    std::array<std::vector<uint8_t>, SKETCH_DEPTH> m_sketch;
+    std::size_t m_sketchMask { 0 };
+    // Lookups since the counts were last halved.
+    std::size_t m_sampleCount { 0 };
+    std::size_t m_sampleSize { 0 };
+
+    BlobCache();
+
+    /**
+     * Counts a request for a blob.
+     *
+     * The mutex must be locked.
+     */
+    void increment(const Key& key);
+
+    /**
+     * Estimates how often a blob was requested recently.
+     *
+     * The mutex must be locked.
+     */
+    uint8_t estimate(const Key& key) const;
+
+    /**
+     * Checks whether the least recently used entries that would make room
+     * for a blob were all requested less often than it.
+     *
+     * The mutex must be locked.
+     */
+    bool canAdmit(const Key& key) const;
+};
@@ -0,0 +1,65 @@
+/**
+ * \class BlobDeletion
+ *
+ * A file content blob that is waiting to be deleted from the real filesystem.
+ *
+ * Deleting a blob is slow compared to deleting a database row, so instead of
+ * deleting blobs while a transaction is open, a `BlobDeletion` is added in the
+ * same transaction that removes the files. The `BlobGarbageCollector` then
+ * deletes the blobs in the background. Since the queue is stored in the
+ * database, no blobs are forgotten if the server stops in between.
+ *
+ * \date 2026-10-19 (last updated)
+ */
+
+#pragma once
+
+#include <Wt/Dbo/Dbo.h>
+#include <string>
+#include <utility>
+
+class BlobDeletion {
+private:
+    std::string m_path;
+
+public:
+    /**
+     * Creates a new pending blob deletion.
+     *
+     * \param path The path of the blob, relative to `File::FILE_SYSTEM_ROOT`.
+     */
+    explicit BlobDeletion(std::string path)
+        : m_path(std::move(path))
+    {
+    }
+
+    /**
+     * Creates a new pending blob deletion with default values for all
+     * metadata.
+     *
+     * This should never be used directly by application code, but it is
+     * required by `Wt::Dbo`.
+     */
+    [[deprecated("only for use by Wt::Dbo")]] BlobDeletion() = default;
+
+    /**
+     * Gets the path of the blob to delete.
+     *
+     * \return The path, relative to `File::FILE_SYSTEM_ROOT`.
+     */
+    const std::string& getPath() const { return m_path; }
+
+    /**
+     * Persists changes to the database.
+     *
+     * This should never be used directly by application code, but it is
+     * required by `Wt::Dbo`.
+     *
+     * \param action The database action to perform.
+     */
+    template <class Action>
+    void persist(Action& action)
+    {
+        Wt::Dbo::field(action, m_path, "path");
+    }
+};
@@ -0,0 +1,135 @@
+#include "BlobGarbageCollector.h"
+
+#include <Wt/Dbo/Exception.h>
+#include <Wt/Dbo/Transaction.h>
+#include <exception>
+#include <filesystem>
+#include <iostream>
+#include <string>
+#include <system_error>
+#include <utility>
+#include <vector>
+#include "BlobDeletion.h"
+#include "BlobIo.h"
+#include "File.h"
+#include "PreviewGenerator.h"
+#include "StorageApplication.h"
+
+BlobGarbageCollector& BlobGarbageCollector::instance()
+{
+    static BlobGarbageCollector garbageCollector;
+    return garbageCollector;
+}
+
+BlobGarbageCollector::~BlobGarbageCollector()
+{
+    stop();
+}
+
+void BlobGarbageCollector::start()
+{
+    std::lock_guard lock(m_mutex);
+    if (m_thread.joinable()) {
+        return;
+    }
+
+    // Always check the queue on startup in case the server stopped before it
+    // was emptied.
+    m_hasWork = true;
+    m_isStopping = false;
+    m_thread = std::thread(&BlobGarbageCollector::run, this);
+}
+
+void BlobGarbageCollector::stop()
+{
+    {
+        std::lock_guard lock(m_mutex);
+        m_isStopping = true;
+    }
+    m_condition.notify_all();
+
+    if (m_thread.joinable()) {
+        m_thread.join();
+    }
+}
+
+void BlobGarbageCollector::notify()
+{
+    {
+        std::lock_guard lock(m_mutex);
+        m_hasWork = true;
+    }
+    m_condition.notify_all();
+}
+
+void BlobGarbageCollector::run()
+{
+    auto databaseSession = StorageApplication::createDatabaseSession();
+
+    while (true) {
+        {
+            std::unique_lock lock(m_mutex);
+            m_condition.wait_for(lock, IDLE_INTERVAL, [this] { return m_hasWork || m_isStopping; });
+            if (m_isStopping) {
+                return;
+            }
+            m_hasWork = false;
+        }
+
+        try {
+            while (collectBatch(*databaseSession) == BATCH_SIZE) {
+                std::lock_guard lock(m_mutex);
+                if (m_isStopping) {
+                    return;
+                }
+            }
+        } catch (const std::exception& ex) {
+            // Most likely the database was busy. The entries are still queued,
+            // so they will be retried later.
+            std::cerr << "BlobGarbageCollector: Failed to delete blobs: " << ex.what() << std::endl;
+        }
+    }
+}
+
+std::size_t BlobGarbageCollector::collectBatch(Wt::Dbo::Session& databaseSession)
+{
+    // Deleting the blobs happens outside of any transaction so that the
+    // database isn't locked while waiting for the filesystem.
+    std::vector<std::pair<long long, std::string>> batch;
+    {
+        Wt::Dbo::Transaction transaction(databaseSession);
+        auto deletions = databaseSession.find<BlobDeletion>().orderBy("id").limit(BATCH_SIZE).resultList();
+        for (const auto& deletion : deletions) {
+            batch.emplace_back(deletion.id(), deletion->getPath());
+        }
+    }
+    if (batch.empty()) {
+        return 0;
+    }
+
+    // The blobs and their previews are deleted together, so that the kernel
+    // can work on all of them at once.
+    std::vector<std::string> paths;
+    paths.reserve(batch.size() * 2);
+    for (const auto& [id, path] : batch) {
+        paths.push_back((std::filesystem::path(File::FILE_SYSTEM_ROOT) / path).string());
+        paths.push_back((std::filesystem::path(File::FILE_SYSTEM_ROOT) / PreviewGenerator::PREVIEW_FOLDER / path).string());
+    }
+    auto errors = BlobIo::instance().unlinkAll(paths);
+    for (std::size_t i = 0; i < batch.size(); ++i) {
+        if (errors[2 * i] != 0) {
+            // The entry is still removed from the queue so that one broken
+            // blob can't hold up the rest of the queue. If the blob is still
+            // there, the OrphanScanner will find it later.
+            std::cerr << "BlobGarbageCollector: Failed to delete " << batch[i].second << ": " << std::generic_category().message(errors[2 * i]) << std::endl;
+        }
+    }
+
+    // The batch is ordered by ID, so this removes exactly the handled entries.
+    {
+        Wt::Dbo::Transaction transaction(databaseSession);
+        databaseSession.execute("DELETE FROM blob_deletions WHERE id <= ?").bind(batch.back().first).run();
+    }
+
+    return batch.size();
+}
@@ -0,0 +1,84 @@
+/**
+ * \class BlobGarbageCollector
+ *
+ * Deletes queued file content blobs on a background thread.
+ *
+ * There is one garbage collector for the whole server. Code that removes
+ * files adds a `BlobDeletion` in the same transaction, and calls `notify` after
+ * the transaction has been committed.
+ *
+ * \date 2026-10-19 (last updated)
+ */
+
+#pragma once
+
+#include <Wt/Dbo/Session.h>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+#include <thread>
+
+class BlobGarbageCollector {
+public:
+    /**
+     * Gets the garbage collector for this server.
+     *
+     * \return The garbage collector.
+     */
+    static BlobGarbageCollector& instance();
+
+    ~BlobGarbageCollector();
+
+    BlobGarbageCollector(const BlobGarbageCollector&) = delete;
+    BlobGarbageCollector& operator=(const BlobGarbageCollector&) = delete;
+
+    /**
+     * Starts the background thread.
+     */
+    void start();
+
+    /**
+     * Stops the background thread, waiting for the current batch to finish.
+     *
+     * Any blobs that are still queued will be deleted after the next start.
+     */
+    void stop();
+
+    /**
+     * Wakes up the background thread to delete newly queued blobs.
+     */
+    void notify();
+
+private:
+    /**
+     * The maximum number of blobs to delete per transaction.
+     */
+    constexpr static std::size_t BATCH_SIZE = 256;
+
+    /**
+     * How often to check the queue when nobody calls `notify`.
+     */
+    constexpr static std::chrono::minutes IDLE_INTERVAL { 1 };
+
+    std::thread m_thread;
+    std::mutex m_mutex;
+    std::condition_variable m_condition;
+    bool m_hasWork { true };
+    bool m_isStopping { false };
+
+    BlobGarbageCollector() = default;
+
+    /**
+     * The main loop of the background thread.
+     */
+    void run();
+
+    /**
+     * Deletes one batch of queued blobs.
+     *
+     * \param databaseSession The database session to use.
+     * \return                The number of queue entries that were handled.
+     */
+    std::size_t collectBatch(Wt::Dbo::Session& databaseSession);
+};
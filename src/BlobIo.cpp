@@ -0,0 +1,579 @@
+#include "BlobIo.h"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <new>
+#include <optional>
+#include <stdexcept>
+#include <utility>
+#include "Configuration.h"
+#include "Metrics.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <linux/io_uring.h>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#endif
+
+// Uploads are written in buffers of this size. It is a multiple of the
+// alignment that O_DIRECT needs, so every full buffer can bypass the cache.
+constexpr std::size_t WRITE_BUFFER_SIZE = 1024 * 1024;
+constexpr std::size_t DIRECT_ALIGNMENT = 4096;
+
+struct BlobIo::Operation {
+    enum class Kind {
+        Read,
+        Write,
+        Unlink,
+    };
+
+    Kind kind;
+    int fd;
+    char* buffer;
+    std::size_t size;
+    int64_t offset;
+    std::string path;
+    Callback callback;
+};
+
+#ifdef __linux__
+
+// The user data of the completion for the poll that wakes up the ring thread.
+// Operations use their address, which is never 0.
+constexpr uint64_t WAKE_USER_DATA = 0;
+
+// The submission and completion queues shared with the kernel. There is no
+// liburing on every server, so this uses the system calls directly.
+struct BlobIo::Ring {
+    int fd { -1 };
+    int wakeFd { -1 };
+    void* sqRing { MAP_FAILED };
+    std::size_t sqRingSize { 0 };
+    void* cqRing { MAP_FAILED };
+    std::size_t cqRingSize { 0 };
+    io_uring_sqe* sqes { static_cast<io_uring_sqe*>(MAP_FAILED) };
+    std::size_t sqesSize { 0 };
+
+    unsigned* sqHead { nullptr };
+    unsigned* sqTail { nullptr };
+    unsigned* sqMask { nullptr };
+    unsigned* sqArray { nullptr };
+    unsigned* cqHead { nullptr };
+    unsigned* cqTail { nullptr };
+    unsigned* cqMask { nullptr };
+    io_uring_cqe* cqes { nullptr };
+
+    ~Ring()
+    {
+        if (sqes != MAP_FAILED) {
+            munmap(sqes, sqesSize);
+        }
+        if (cqRing != MAP_FAILED && cqRing != sqRing) {
+            munmap(cqRing, cqRingSize);
+        }
+        if (sqRing != MAP_FAILED) {
+            munmap(sqRing, sqRingSize);
+        }
+        if (wakeFd >= 0) {
+            close(wakeFd);
+        }
+        if (fd >= 0) {
+            close(fd);
+        }
+    }
+
+    /**
+     * Sets up a ring, or returns nullptr with `errno` set if io_uring isn't
+     * available.
+     */
+    static std::unique_ptr<Ring> create(unsigned entries)
+    {
+        io_uring_params params {};
+        auto ring = std::make_unique<Ring>();
+        ring->fd = static_cast<int>(syscall(__NR_io_uring_setup, entries, &params));
+        if (ring->fd < 0) {
+            return nullptr;
+        }
+
+        ring->sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+        ring->cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+        bool isSingleMapping = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+        if (isSingleMapping) {
+            ring->sqRingSize = ring->cqRingSize = std::max(ring->sqRingSize, ring->cqRingSize);
+        }
+        ring->sqRing = mmap(nullptr, ring->sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQ_RING);
+        if (ring->sqRing == MAP_FAILED) {
+            return nullptr;
+        }
+        ring->cqRing = isSingleMapping ? ring->sqRing : mmap(nullptr, ring->cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_CQ_RING);
+        if (ring->cqRing == MAP_FAILED) {
+            return nullptr;
+        }
+        ring->sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+        ring->sqes = static_cast<io_uring_sqe*>(mmap(nullptr, ring->sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQES));
+        if (ring->sqes == MAP_FAILED) {
+            return nullptr;
+        }
+        ring->wakeFd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+        if (ring->wakeFd < 0) {
+            return nullptr;
+        }
+
+        auto* sq = static_cast<char*>(ring->sqRing);
+        auto* cq = static_cast<char*>(ring->cqRing);
+        ring->sqHead = reinterpret_cast<unsigned*>(sq + params.sq_off.head);
+        ring->sqTail = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+        ring->sqMask = reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+        ring->sqArray = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+        ring->cqHead = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+        ring->cqTail = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+        ring->cqMask = reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+        ring->cqes = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+        return ring;
+    }
+
+    /**
+     * Gets the next free submission entry, cleared, and advances the local
+     * copy of the tail.
+     */
+    io_uring_sqe& prepare(unsigned& tail)
+    {
+        unsigned index = tail & *sqMask;
+        sqArray[index] = index;
+        ++tail;
+        io_uring_sqe& sqe = sqes[index];
+        std::memset(&sqe, 0, sizeof(sqe));
+        return sqe;
+    }
+
+    /**
+     * Wakes up the ring thread.
+     */
+    void wake() const
+    {
+        uint64_t value = 1;
+        [[maybe_unused]] auto written = ::write(wakeFd, &value, sizeof(value));
+    }
+};
+
+#else
+
+struct BlobIo::Ring {
+    static std::unique_ptr<Ring> create(unsigned)
+    {
+        errno = ENOSYS;
+        return nullptr;
+    }
+
+    void wake() const { }
+};
+
+#endif
+
+namespace {
+
+/**
+ * Waits for a queued operation to finish.
+ */
+class Completion {
+public:
+    BlobIo::Callback callback() const
+    {
+        return [state = m_state](int64_t result) {
+            std::lock_guard lock(state->mutex);
+            state->result = result;
+            state->condition.notify_all();
+        };
+    }
+
+    int64_t wait() const
+    {
+        std::unique_lock lock(m_state->mutex);
+        m_state->condition.wait(lock, [this] { return m_state->result.has_value(); });
+        return *m_state->result;
+    }
+
+private:
+    struct State {
+        std::mutex mutex;
+        std::condition_variable condition;
+        std::optional<int64_t> result;
+    };
+
+    std::shared_ptr<State> m_state { std::make_shared<State>() };
+};
+
+struct AlignedDeleter {
+    void operator()(char* buffer) const { std::free(buffer); }
+};
+
+}
+
+// Turns O_DIRECT on or off for an open file.
+static bool setDirect(int fd, bool isDirect)
+{
+#ifdef O_DIRECT
+    int flags = fcntl(fd, F_GETFL);
+    if (flags < 0) {
+        return false;
+    }
+    return fcntl(fd, F_SETFL, isDirect ? flags | O_DIRECT : flags & ~O_DIRECT) == 0;
+#else
+    return !isDirect;
+#endif
+}
+
+BlobIo& BlobIo::instance()
+{
+    static BlobIo blobIo;
+    return blobIo;
+}
+
+BlobIo::BlobIo() = default;
+
+BlobIo::~BlobIo()
+{
+    stop();
+}
+
+void BlobIo::start()
+{
+    std::lock_guard lock(m_mutex);
+    if (m_engine != Engine::Inline) {
+        return;
+    }
+
+    m_queueDepth = static_cast<unsigned>(std::clamp(Configuration::getInteger("blob-io-queue-depth", 256), 2LL, 4096LL));
+    m_directSize = std::max(0LL, Configuration::getInteger("blob-io-direct-size", 64)) * 1024 * 1024;
+    std::string engine = Configuration::getString("blob-io-engine", "auto");
+    m_isStopping = false;
+
+    if (engine != "threads") {
+        m_ring = Ring::create(m_queueDepth);
+        if (m_ring) {
+            m_engine = Engine::IoUring;
+            m_threads.emplace_back(&BlobIo::runRing, this);
+            return;
+        }
+        std::cerr << "BlobIo: io_uring isn't available, so a thread pool is used instead: " << std::strerror(errno) << std::endl;
+    }
+
+    auto threadCount = std::clamp(Configuration::getInteger("blob-io-threads", 4), 1LL, 64LL);
+    m_engine = Engine::Threads;
+    for (long long i = 0; i < threadCount; ++i) {
+        m_threads.emplace_back(&BlobIo::runThread, this);
+    }
+}
+
+void BlobIo::stop()
+{
+    {
+        std::lock_guard lock(m_mutex);
+        m_isStopping = true;
+        if (m_ring) {
+            m_ring->wake();
+        }
+    }
+    m_condition.notify_all();
+
+    for (auto& thread : m_threads) {
+        thread.join();
+    }
+    m_threads.clear();
+
+    std::lock_guard lock(m_mutex);
+    m_engine = Engine::Inline;
+    m_ring.reset();
+}
+
+void BlobIo::read(int fd, char* buffer, std::size_t size, int64_t offset, Callback callback)
+{
+    submit(std::make_unique<Operation>(Operation { Operation::Kind::Read, fd, buffer, size, offset, std::string(), std::move(callback) }));
+}
+
+void BlobIo::write(int fd, const char* buffer, std::size_t size, int64_t offset, Callback callback)
+{
+    // The buffer is only ever read from.
+    submit(std::make_unique<Operation>(Operation { Operation::Kind::Write, fd, const_cast<char*>(buffer), size, offset, std::string(), std::move(callback) }));
+}
+
+void BlobIo::unlink(std::string path, Callback callback)
+{
+    submit(std::make_unique<Operation>(Operation { Operation::Kind::Unlink, -1, nullptr, 0, 0, std::move(path), std::move(callback) }));
+}
+
+std::vector<int> BlobIo::unlinkAll(const std::vector<std::string>& paths)
+{
+    // Queueing everything before waiting lets the kernel handle the
+    // deletions together.
+    std::vector<Completion> completions(paths.size());
+    for (std::size_t i = 0; i < paths.size(); ++i) {
+        unlink(paths[i], completions[i].callback());
+    }
+
+    std::vector<int> errors;
+    errors.reserve(paths.size());
+    for (const auto& completion : completions) {
+        int64_t result = completion.wait();
+        errors.push_back(result == -ENOENT ? 0 : static_cast<int>(-result));
+    }
+    return errors;
+}
+
+int64_t BlobIo::writeFile(const std::string& path, std::string_view head, std::istream& content)
+{
+    int fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0666);
+    if (fd < 0) {
+        throw std::runtime_error("The file couldn't be saved.");
+    }
+
+    std::array<std::unique_ptr<char, AlignedDeleter>, 2> buffers;
+    for (auto& buffer : buffers) {
+        buffer.reset(static_cast<char*>(std::aligned_alloc(DIRECT_ALIGNMENT, WRITE_BUFFER_SIZE)));
+        if (!buffer) {
+            close(fd);
+            ::unlink(path.c_str());
+            throw std::bad_alloc();
+        }
+    }
+
+    std::size_t headOffset = 0;
+    auto fill = [&](char* buffer) {
+        std::size_t size = std::min(head.size() - headOffset, WRITE_BUFFER_SIZE);
+        std::memcpy(buffer, head.data() + headOffset, size);
+        headOffset += size;
+        if (size < WRITE_BUFFER_SIZE) {
+            content.read(buffer + size, static_cast<std::streamsize>(WRITE_BUFFER_SIZE - size));
+            size += static_cast<std::size_t>(content.gcount());
+        }
+        return size;
+    };
+
+    int64_t offset = 0;
+    bool isDirect = false;
+    bool canUseDirect = m_directSize > 0;
+    bool isFailed = false;
+    std::size_t current = 0;
+    std::size_t size = fill(buffers[current].get());
+    while (size > 0) {
+        // O_DIRECT is only changed while nothing is being written, and only
+        // used for whole buffers, which keeps every write aligned.
+        bool shouldBeDirect = canUseDirect && offset >= m_directSize && size == WRITE_BUFFER_SIZE;
+        if (shouldBeDirect != isDirect) {
+            if (setDirect(fd, shouldBeDirect)) {
+                isDirect = shouldBeDirect;
+            } else if (shouldBeDirect) {
+                canUseDirect = false;
+            }
+        }
+
+        char* buffer = buffers[current].get();
+        Completion completion;
+        write(fd, buffer, size, offset, completion.callback());
+        std::size_t nextSize = fill(buffers[1 - current].get());
+        int64_t result = completion.wait();
+
+        std::size_t written = 0;
+        while (true) {
+            if (result == -EINVAL && isDirect) {
+                // The filesystem doesn't support O_DIRECT, so the rest is
+                // written through the cache.
+                setDirect(fd, false);
+                isDirect = false;
+                canUseDirect = false;
+            } else if (result <= 0) {
+                isFailed = true;
+                break;
+            } else {
+                written += static_cast<std::size_t>(result);
+            }
+            if (written >= size) {
+                break;
+            }
+            Completion retry;
+            write(fd, buffer + written, size - written, offset + static_cast<int64_t>(written), retry.callback());
+            result = retry.wait();
+        }
+        if (isFailed) {
+            break;
+        }
+
+        offset += static_cast<int64_t>(size);
+        current = 1 - current;
+        size = nextSize;
+    }
+
+    if (close(fd) != 0 || isFailed || content.bad()) {
+        ::unlink(path.c_str());
+        throw std::runtime_error("The file couldn't be saved.");
+    }
+    return offset;
+}
+
+void BlobIo::submit(std::unique_ptr<Operation> operation)
+{
+    {
+        std::lock_guard lock(m_mutex);
+        if (m_engine != Engine::Inline && !m_isStopping) {
+            m_pending.push_back(std::move(operation));
+            if (m_engine == Engine::IoUring) {
+                m_ring->wake();
+            }
+        }
+    }
+    if (!operation) {
+        m_condition.notify_one();
+        return;
+    }
+    operation->callback(perform(*operation));
+}
+
+void BlobIo::runRing()
+{
+#ifdef __linux__
+    static auto& batchHistogram = Metrics::instance().getHistogram("cgs_blob_io_batch_size", "Blob I/O operations handed to the kernel at once.", Metrics::Unit::Count);
+
+    Ring& ring = *m_ring;
+    unsigned inFlight = 0;
+    bool isWakeArmed = false;
+    std::vector<std::pair<std::unique_ptr<Operation>, int64_t>> completed;
+    while (true) {
+        std::vector<std::unique_ptr<Operation>> batch;
+        bool isStopping = false;
+        {
+            std::lock_guard lock(m_mutex);
+            // One entry is kept for the wake-up poll, and at most a queue's
+            // worth of operations is in flight, so completions never
+            // overflow.
+            while (inFlight + batch.size() + 1 < m_queueDepth && !m_pending.empty()) {
+                batch.push_back(std::move(m_pending.front()));
+                m_pending.pop_front();
+            }
+            isStopping = m_isStopping && m_pending.empty();
+        }
+        if (isStopping && inFlight == 0 && batch.empty()) {
+            return;
+        }
+
+        unsigned tail = *ring.sqTail;
+        if (!isWakeArmed) {
+            io_uring_sqe& sqe = ring.prepare(tail);
+            sqe.opcode = IORING_OP_POLL_ADD;
+            sqe.fd = ring.wakeFd;
+            sqe.poll32_events = POLLIN;
+            sqe.user_data = WAKE_USER_DATA;
+            isWakeArmed = true;
+        }
+        for (auto& operation : batch) {
+            io_uring_sqe& sqe = ring.prepare(tail);
+            switch (operation->kind) {
+            case Operation::Kind::Read:
+            case Operation::Kind::Write:
+                sqe.opcode = operation->kind == Operation::Kind::Read ? IORING_OP_READ : IORING_OP_WRITE;
+                sqe.fd = operation->fd;
+                sqe.addr = reinterpret_cast<uint64_t>(operation->buffer);
+                sqe.len = static_cast<uint32_t>(std::min<std::size_t>(operation->size, 0x7ffff000));
+                sqe.off = static_cast<uint64_t>(operation->offset);
+                break;
+            case Operation::Kind::Unlink:
+                sqe.opcode = IORING_OP_UNLINKAT;
+                sqe.fd = AT_FDCWD;
+                sqe.addr = reinterpret_cast<uint64_t>(operation->path.c_str());
+                break;
+            }
+            sqe.user_data = reinterpret_cast<uint64_t>(operation.release());
+            ++inFlight;
+        }
+        std::atomic_ref<unsigned>(*ring.sqTail).store(tail, std::memory_order_release);
+        if (!batch.empty()) {
+            batchHistogram.record(batch.size());
+        }
+
+        // This submits the batch and waits for at least one completion. New
+        // operations complete the wake-up poll.
+        while (true) {
+            unsigned unsubmitted = tail - std::atomic_ref<unsigned>(*ring.sqHead).load(std::memory_order_acquire);
+            if (syscall(__NR_io_uring_enter, ring.fd, unsubmitted, 1, IORING_ENTER_GETEVENTS, nullptr, 0) >= 0 || errno != EINTR) {
+                break;
+            }
+        }
+
+        unsigned head = *ring.cqHead;
+        unsigned completionTail = std::atomic_ref<unsigned>(*ring.cqTail).load(std::memory_order_acquire);
+        for (; head != completionTail; ++head) {
+            const io_uring_cqe& cqe = ring.cqes[head & *ring.cqMask];
+            if (cqe.user_data == WAKE_USER_DATA) {
+                uint64_t value = 0;
+                [[maybe_unused]] auto bytesRead = ::read(ring.wakeFd, &value, sizeof(value));
+                isWakeArmed = false;
+                continue;
+            }
+            std::unique_ptr<Operation> operation(reinterpret_cast<Operation*>(cqe.user_data));
+            --inFlight;
+            int64_t result = cqe.res;
+            if (result == -EINVAL || result == -EOPNOTSUPP) {
+                // Older kernels don't know every operation.
+                result = perform(*operation);
+            }
+            completed.emplace_back(std::move(operation), result);
+        }
+        std::atomic_ref<unsigned>(*ring.cqHead).store(head, std::memory_order_release);
+
+        for (auto& [operation, result] : completed) {
+            operation->callback(result);
+        }
+        completed.clear();
+    }
+#endif
+}
+
+void BlobIo::runThread()
+{
+    while (true) {
+        std::unique_ptr<Operation> operation;
+        {
+            std::unique_lock lock(m_mutex);
+            m_condition.wait(lock, [this] { return !m_pending.empty() || m_isStopping; });
+            if (m_pending.empty()) {
+                return;
+            }
+            operation = std::move(m_pending.front());
+            m_pending.pop_front();
+        }
+        operation->callback(perform(*operation));
+    }
+}
+
+int64_t BlobIo::perform(const Operation& operation)
+{
+    while (true) {
+        ssize_t result = 0;
+        switch (operation.kind) {
+        case Operation::Kind::Read:
+            result = pread(operation.fd, operation.buffer, operation.size, static_cast<off_t>(operation.offset));
+            break;
+        case Operation::Kind::Write:
+            result = pwrite(operation.fd, operation.buffer, operation.size, static_cast<off_t>(operation.offset));
+            break;
+        case Operation::Kind::Unlink:
+            result = ::unlink(operation.path.c_str());
+            break;
+        }
+        if (result >= 0) {
+            return result;
+        }
+        if (errno != EINTR) {
+            return -errno;
+        }
+    }
+}
@@ -0,0 +1,171 @@
+/**
+ * \class BlobIo
+ *
+ * Reads, writes and deletes blobs without tying up a thread for each
+ * operation that waits for the disk.
+ *
+ * Operations are queued and handed to the kernel in batches through io_uring
+ * by a single background thread, which also runs their callbacks. Where
+ * io_uring isn't available, for example when it is blocked by a seccomp
+ * filter, a small pool of threads does the same work with ordinary system
+ * calls. The engine is chosen by the `blob-io-engine` property. Before
+ * `start()` and after `stop()`, operations run on the calling thread.
+ *
+ * Callbacks are run on the background thread, so they must be quick. They
+ * get the number of bytes read or written, or a negated `errno` value.
+ *
+ * \date 2026-10-19 (last updated)
+ */
+
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <istream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+class BlobIo {
+public:
+    /**
+     * Called when an operation has finished, with the number of bytes read
+     * or written, 0 for a deletion, or a negated `errno` value.
+     */
+    using Callback = std::function<void(int64_t result)>;
+
+    /**
+     * Gets the blob I/O engine for this server.
+     *
+     * \return The engine.
+     */
+    static BlobIo& instance();
+
+    ~BlobIo();
+
+    BlobIo(const BlobIo&) = delete;
+    BlobIo& operator=(const BlobIo&) = delete;
+
+    /**
+     * Reads the configuration and starts the background threads.
+     */
+    void start();
+
+    /**
+     * Stops the background threads, after finishing every queued operation.
+     */
+    void stop();
+
+    /**
+     * Queues a read. The buffer must stay valid until the callback is run.
+     *
+     * This can be called from any thread.
+     *
+     * \param fd       The file to read from.
+     * \param buffer   Where to put the content.
+     * \param size     The most bytes to read.
+     * \param offset   Where to start reading in the file.
+     * \param callback Called with the number of bytes read.
+     */
+    void read(int fd, char* buffer, std::size_t size, int64_t offset, Callback callback);
+
+    /**
+     * Queues a write. The buffer must stay valid until the callback is run.
+     *
+     * This can be called from any thread.
+     *
+     * \param fd       The file to write to.
+     * \param buffer   The content.
+     * \param size     The number of bytes to write.
+     * \param offset   Where to start writing in the file.
+     * \param callback Called with the number of bytes written.
+     */
+    void write(int fd, const char* buffer, std::size_t size, int64_t offset, Callback callback);
+
+    /**
+     * Queues the deletion of a file.
+     *
+     * This can be called from any thread.
+     *
+     * \param path     The path of the file.
+     * \param callback Called with 0 once the file is deleted.
+     */
+    void unlink(std::string path, Callback callback);
+
+    /**
+     * Deletes several files at once, and waits for all of them.
+     *
+     * \param paths The paths of the files.
+     * \return      For each path, 0 if the file was deleted or didn't exist,
+     *              and otherwise the `errno` value.
+     */
+    std::vector<int> unlinkAll(const std::vector<std::string>& paths);
+
+    /**
+     * Writes content to a new file, reading the next part of the content
+     * while the previous one is being written. Files larger than the
+     * `blob-io-direct-size` property bypass the page cache after that size,
+     * so that one large upload doesn't push everything else out of it.
+     *
+     * \param path    The path of the file, which is replaced if it exists.
+     * \param head    Content that was already read from the start of the
+     *                stream.
+     * \param content The rest of the content.
+     * \return        The size of the file.
+     * \exception std::runtime_error If the file couldn't be written. It is
+     *                               removed again.
+     */
+    int64_t writeFile(const std::string& path, std::string_view head, std::istream& content);
+
+private:
+    enum class Engine {
+        Inline,
+        IoUring,
+        Threads,
+    };
+
+    struct Operation;
+    struct Ring;
+
+    Engine m_engine { Engine::Inline };
+    unsigned m_queueDepth { 256 };
+    int64_t m_directSize { 64 * 1024 * 1024 };
+
+    std::unique_ptr<Ring> m_ring;
+    std::vector<std::thread> m_threads;
+    std::deque<std::unique_ptr<Operation>> m_pending;
+    std::mutex m_mutex;
+    std::condition_variable m_condition;
+    bool m_isStopping { false };
+
+    BlobIo();
+
+    /**
+     * Queues an operation, or runs it straight away if the engine isn't
+     * running.
+     */
+    void submit(std::unique_ptr<Operation> operation);
+
+    /**
+     * The main loop of the io_uring thread.
+     */
+    void runRing();
+
+    /**
+     * The main loop of each thread in the thread pool.
+     */
+    void runThread();
+
+    /**
+     * Runs an operation on the calling thread with ordinary system calls.
+     *
+     * \return The result for the operation's callback.
+     */
+    static int64_t perform(const Operation& operation);
+};
@@ -0,0 +1,394 @@
+#include "BlockDelta.h"
+
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <istream>
+#include <limits>
+#include <optional>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <unordered_map>
+#include <vector>
+#include "Sha256.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+constexpr std::size_t MIN_BLOCK_SIZE = 4 * 1024;
+constexpr std::size_t MAX_BLOCK_SIZE = 1024 * 1024;
+// New content is read, and sent in literal commands, in pieces of this size.
+constexpr std::size_t PIECE_SIZE = 1024 * 1024;
+constexpr std::string_view MAGIC = "CGSD";
+
+namespace {
+
+/**
+ * Closes a file descriptor when it goes out of scope.
+ */
+class FileDescriptor {
+public:
+    explicit FileDescriptor(int fd)
+        : m_fd(fd)
+    {
+    }
+
+    ~FileDescriptor()
+    {
+        if (m_fd >= 0) {
+            close(m_fd);
+        }
+    }
+
+    FileDescriptor(const FileDescriptor&) = delete;
+    FileDescriptor& operator=(const FileDescriptor&) = delete;
+
+    int get() const { return m_fd; }
+
+private:
+    int m_fd;
+};
+
+}
+
+template <class Integer>
+static void writeInteger(std::ostream& output, Integer value)
+{
+    std::array<char, sizeof(Integer)> bytes {};
+    for (std::size_t i = 0; i < bytes.size(); ++i) {
+        bytes[i] = static_cast<char>((value >> (8 * i)) & 0xff);
+    }
+    output.write(bytes.data(), bytes.size());
+}
+
+template <class Integer>
+static Integer readInteger(std::istream& input)
+{
+    std::array<char, sizeof(Integer)> bytes {};
+    if (!input.read(bytes.data(), bytes.size())) {
+        throw std::runtime_error("The delta ended early.");
+    }
+    Integer value = 0;
+    for (std::size_t i = 0; i < bytes.size(); ++i) {
+        value |= static_cast<Integer>(static_cast<uint8_t>(bytes[i])) << (8 * i);
+    }
+    return value;
+}
+
+static void writeAll(int fd, const char* data, std::size_t size, uint64_t& offset)
+{
+    while (size > 0) {
+        ssize_t written = pwrite(fd, data, size, static_cast<off_t>(offset));
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            throw std::runtime_error("The file couldn't be saved.");
+        }
+        data += written;
+        size -= static_cast<std::size_t>(written);
+        offset += static_cast<uint64_t>(written);
+    }
+}
+
+// Copies part of one file into another. Where the filesystem supports it,
+// copy_file_range shares the blocks instead of writing them again.
+static void copyRange(int inputFd, uint64_t inputOffset, int outputFd, uint64_t& outputOffset, uint64_t length)
+{
+#ifdef __linux__
+    while (length > 0) {
+        auto input = static_cast<off_t>(inputOffset);
+        auto output = static_cast<off_t>(outputOffset);
+        ssize_t copied = copy_file_range(inputFd, &input, outputFd, &output, length, 0);
+        if (copied < 0 && errno == EINTR) {
+            continue;
+        }
+        if (copied <= 0) {
+            // Some filesystems can't do this, so fall back to copying the
+            // rest by hand.
+            break;
+        }
+        inputOffset += static_cast<uint64_t>(copied);
+        outputOffset += static_cast<uint64_t>(copied);
+        length -= static_cast<uint64_t>(copied);
+    }
+#endif
+
+    std::vector<char> buffer(std::min<uint64_t>(length, PIECE_SIZE));
+    while (length > 0) {
+        ssize_t bytesRead = pread(inputFd, buffer.data(), std::min<uint64_t>(length, buffer.size()), static_cast<off_t>(inputOffset));
+        if (bytesRead < 0 && errno == EINTR) {
+            continue;
+        }
+        if (bytesRead <= 0) {
+            throw std::runtime_error("The file's current content couldn't be read.");
+        }
+        writeAll(outputFd, buffer.data(), static_cast<std::size_t>(bytesRead), outputOffset);
+        inputOffset += static_cast<uint64_t>(bytesRead);
+        length -= static_cast<uint64_t>(bytesRead);
+    }
+}
+
+std::size_t BlockDelta::getBlockSize(uint64_t fileSize)
+{
+    // Like rsync, use about the square root of the size, which balances the
+    // size of the signatures against the amount sent again for each change.
+    auto target = static_cast<std::size_t>(std::sqrt(static_cast<double>(fileSize)));
+    std::size_t blockSize = MIN_BLOCK_SIZE;
+    while (blockSize < target && blockSize < MAX_BLOCK_SIZE) {
+        blockSize *= 2;
+    }
+    return blockSize;
+}
+
+uint32_t BlockDelta::getWeakHash(std::string_view block)
+{
+    uint32_t sum = 0;
+    uint32_t weightedSum = 0;
+    for (std::size_t i = 0; i < block.size(); ++i) {
+        auto byte = static_cast<uint8_t>(block[i]);
+        sum += byte;
+        weightedSum += static_cast<uint32_t>(block.size() - i) * byte;
+    }
+    return (sum & 0xffff) | (weightedSum << 16);
+}
+
+uint32_t BlockDelta::rollWeakHash(uint32_t hash, std::size_t blockSize, uint8_t removed, uint8_t added)
+{
+    uint32_t sum = (hash - removed + added) & 0xffff;
+    uint32_t weightedSum = ((hash >> 16) - static_cast<uint32_t>(blockSize) * removed + sum) & 0xffff;
+    return sum | (weightedSum << 16);
+}
+
+std::array<uint8_t, BlockDelta::STRONG_HASH_SIZE> BlockDelta::getStrongHash(std::string_view block)
+{
+    auto digest = Sha256::hash(block);
+    std::array<uint8_t, STRONG_HASH_SIZE> strongHash {};
+    std::copy_n(digest.begin(), strongHash.size(), strongHash.begin());
+    return strongHash;
+}
+
+std::vector<BlockDelta::BlockSignature> BlockDelta::computeSignatures(std::istream& content, std::size_t blockSize)
+{
+    std::vector<BlockSignature> signatures;
+    std::string block(blockSize, '\0');
+    while (content.read(block.data(), static_cast<std::streamsize>(block.size())) || content.gcount() > 0) {
+        std::string_view data(block.data(), static_cast<std::size_t>(content.gcount()));
+        signatures.push_back(BlockSignature { getWeakHash(data), getStrongHash(data) });
+    }
+    return signatures;
+}
+
+BlockDelta::Result BlockDelta::createDelta(const std::vector<BlockSignature>& signatures, uint64_t oldSize, std::size_t blockSize, std::istream& content, std::ostream& delta)
+{
+    delta.write(MAGIC.data(), MAGIC.size());
+    writeInteger<uint32_t>(delta, static_cast<uint32_t>(blockSize));
+
+    // Only whole blocks can match in the middle of the content. A shorter
+    // last block can only match at the end.
+    uint64_t wholeBlockCount = oldSize / blockSize;
+    std::unordered_multimap<uint32_t, uint64_t> blockIndexes;
+    for (uint64_t i = 0; i < wholeBlockCount && i < signatures.size(); ++i) {
+        blockIndexes.emplace(signatures[i].weakHash, i);
+    }
+
+    Result result;
+    uint64_t copyStart = 0;
+    uint32_t copyCount = 0;
+    auto flushCopy = [&] {
+        if (copyCount > 0) {
+            delta.put('C');
+            writeInteger<uint64_t>(delta, copyStart);
+            writeInteger<uint32_t>(delta, copyCount);
+            copyCount = 0;
+        }
+    };
+    auto addCopy = [&](uint64_t blockIndex, uint64_t length) {
+        if (copyCount == 0 || copyStart + copyCount != blockIndex || copyCount == std::numeric_limits<uint32_t>::max()) {
+            flushCopy();
+            copyStart = blockIndex;
+        }
+        ++copyCount;
+        result.copiedBytes += length;
+        result.size += length;
+    };
+    auto addLiteral = [&](const char* data, std::size_t size) {
+        if (size == 0) {
+            return;
+        }
+        flushCopy();
+        delta.put('L');
+        writeInteger<uint32_t>(delta, static_cast<uint32_t>(size));
+        delta.write(data, static_cast<std::streamsize>(size));
+        result.literalBytes += size;
+        result.size += size;
+    };
+
+    // The buffer holds the new content that hasn't been sent yet, from
+    // `begin`. The block being checked starts at `position`.
+    std::vector<char> buffer;
+    std::size_t begin = 0;
+    std::size_t position = 0;
+    std::size_t end = 0;
+    bool isAtEnd = false;
+    auto fill = [&](std::size_t size) {
+        if (end - position >= size || isAtEnd) {
+            return;
+        }
+        if (begin > 0) {
+            std::memmove(buffer.data(), buffer.data() + begin, end - begin);
+            position -= begin;
+            end -= begin;
+            begin = 0;
+        }
+        buffer.resize(std::max(buffer.size(), end + std::max(size, PIECE_SIZE)));
+        while (end - position < size && !isAtEnd) {
+            content.read(buffer.data() + end, static_cast<std::streamsize>(buffer.size() - end));
+            end += static_cast<std::size_t>(content.gcount());
+            isAtEnd = content.gcount() == 0;
+        }
+    };
+    auto findBlock = [&](uint32_t weakHash) -> std::optional<uint64_t> {
+        auto [first, last] = blockIndexes.equal_range(weakHash);
+        if (first == last) {
+            return std::nullopt;
+        }
+        auto strongHash = getStrongHash(std::string_view(buffer.data() + position, blockSize));
+        for (auto match = first; match != last; ++match) {
+            if (signatures[match->second].strongHash == strongHash) {
+                return match->second;
+            }
+        }
+        return std::nullopt;
+    };
+
+    uint32_t weakHash = 0;
+    bool hasWeakHash = false;
+    while (true) {
+        // One byte after the block is needed to roll the hash.
+        fill(blockSize + 1);
+        if (end - position < blockSize) {
+            break;
+        }
+        if (!hasWeakHash) {
+            weakHash = getWeakHash(std::string_view(buffer.data() + position, blockSize));
+            hasWeakHash = true;
+        }
+
+        if (auto blockIndex = findBlock(weakHash)) {
+            addLiteral(buffer.data() + begin, position - begin);
+            addCopy(*blockIndex, blockSize);
+            position += blockSize;
+            begin = position;
+            hasWeakHash = false;
+            continue;
+        }
+
+        if (end - position == blockSize) {
+            break;
+        }
+        weakHash = rollWeakHash(weakHash, blockSize, static_cast<uint8_t>(buffer[position]), static_cast<uint8_t>(buffer[position + blockSize]));
+        ++position;
+        if (position - begin >= PIECE_SIZE) {
+            addLiteral(buffer.data() + begin, position - begin);
+            begin = position;
+        }
+    }
+
+    // The old content's last block may still match the end of the new
+    // content.
+    std::size_t lastBlockSize = static_cast<std::size_t>(oldSize % blockSize);
+    if (lastBlockSize > 0 && signatures.size() > wholeBlockCount && end - begin >= lastBlockSize) {
+        std::string_view tail(buffer.data() + end - lastBlockSize, lastBlockSize);
+        const auto& signature = signatures[wholeBlockCount];
+        if (getWeakHash(tail) == signature.weakHash && getStrongHash(tail) == signature.strongHash) {
+            addLiteral(buffer.data() + begin, end - lastBlockSize - begin);
+            addCopy(wholeBlockCount, lastBlockSize);
+            begin = end;
+        }
+    }
+    addLiteral(buffer.data() + begin, end - begin);
+    flushCopy();
+    delta.put('E');
+    return result;
+}
+
+BlockDelta::Result BlockDelta::applyDelta(std::istream& delta, const std::filesystem::path& oldPath, uint64_t oldOffset, uint64_t oldSize, const std::filesystem::path& outputPath)
+{
+    std::string magic(MAGIC.size(), '\0');
+    if (!delta.read(magic.data(), static_cast<std::streamsize>(magic.size())) || magic != MAGIC) {
+        throw std::runtime_error("The request body is not a delta.");
+    }
+
+    FileDescriptor oldFile(open(oldPath.c_str(), O_RDONLY | O_CLOEXEC));
+    if (oldFile.get() < 0) {
+        throw std::runtime_error("The file's current content couldn't be read.");
+    }
+    std::size_t blockSize = getBlockSize(oldSize);
+    if (readInteger<uint32_t>(delta) != blockSize) {
+        throw std::runtime_error("The delta was made with the wrong block size.");
+    }
+    uint64_t blockCount = (oldSize + blockSize - 1) / blockSize;
+
+    FileDescriptor outputFile(open(outputPath.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0666));
+    if (outputFile.get() < 0) {
+        throw std::runtime_error("The file couldn't be saved.");
+    }
+
+    Result result;
+    try {
+        std::vector<char> buffer;
+        bool isFinished = false;
+        while (!isFinished) {
+            switch (readInteger<uint8_t>(delta)) {
+            case 'C': {
+                auto blockIndex = readInteger<uint64_t>(delta);
+                auto count = readInteger<uint32_t>(delta);
+                if (count == 0 || blockIndex >= blockCount || count > blockCount - blockIndex) {
+                    throw std::runtime_error("The delta copies blocks that don't exist.");
+                }
+                uint64_t offset = blockIndex * blockSize;
+                uint64_t length = std::min<uint64_t>(static_cast<uint64_t>(count) * blockSize, oldSize - offset);
+                if (length > oldSize * MAX_COPY_FACTOR - result.copiedBytes) {
+                    throw std::runtime_error("The delta makes the file too large.");
+                }
+                copyRange(oldFile.get(), oldOffset + offset, outputFile.get(), result.size, length);
+                result.copiedBytes += length;
+                break;
+            }
+            case 'L': {
+                auto length = readInteger<uint32_t>(delta);
+                result.literalBytes += length;
+                buffer.resize(std::min<std::size_t>(length, PIECE_SIZE));
+                while (length > 0) {
+                    auto pieceSize = std::min<std::size_t>(length, buffer.size());
+                    if (!delta.read(buffer.data(), static_cast<std::streamsize>(pieceSize))) {
+                        throw std::runtime_error("The delta ended early.");
+                    }
+                    writeAll(outputFile.get(), buffer.data(), pieceSize, result.size);
+                    length -= static_cast<uint32_t>(pieceSize);
+                }
+                break;
+            }
+            case 'E':
+                isFinished = true;
+                break;
+            default:
+                throw std::runtime_error("The delta is not valid.");
+            }
+        }
+    } catch (...) {
+        std::error_code error;
+        std::filesystem::remove(outputPath, error);
+        throw;
+    }
+    return result;
+}
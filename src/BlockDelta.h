@@ -0,0 +1,152 @@
+/**
+ * \class BlockDelta
+ *
+ * Sends only the changed parts of a file, in the same way as rsync.
+ *
+ * The server splits the current content of a file into blocks and gives the
+ * client a signature of each one: a weak hash that can be rolled along the
+ * new content one byte at a time, and a strong hash to confirm matches. The
+ * client then sends a delta, which copies the blocks that it found anywhere in
+ * the new content and includes the bytes in between. The server builds the
+ * new content from the old content and the delta.
+ *
+ * A delta starts with `CGSD` and the block size as a 32-bit little-endian
+ * integer, followed by these commands:
+ *
+ *  - `C`, a 64-bit block index and a 32-bit block count copies blocks from
+ *    the old content.
+ *  - `L`, a 32-bit length and that many bytes adds new content.
+ *  - `E` ends the delta.
+ *
+ * \date 2026-10-19 (last updated)
+ */
+
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <istream>
+#include <ostream>
+#include <string_view>
+#include <vector>
+
+class BlockDelta {
+public:
+    BlockDelta() = delete;
+
+    /**
+     * The number of bytes of SHA-256 kept as the strong hash of a block.
+     */
+    constexpr static std::size_t STRONG_HASH_SIZE = 16;
+
+    /**
+     * How many times over a delta may copy the old content in total.
+     *
+     * A copy command is a few bytes, so without a limit a small delta could
+     * build a file large enough to fill the disk. The bytes that a delta adds
+     * are already limited by the size of the request.
+     */
+    constexpr static uint64_t MAX_COPY_FACTOR = 2;
+
+    /**
+     * The signature of one block of a file.
+     */
+    struct BlockSignature {
+        uint32_t weakHash;
+        std::array<uint8_t, STRONG_HASH_SIZE> strongHash;
+    };
+
+    /**
+     * What a delta was made of.
+     */
+    struct Result {
+        uint64_t size { 0 };
+        uint64_t copiedBytes { 0 };
+        uint64_t literalBytes { 0 };
+    };
+
+    /**
+     * Chooses the block size for a file.
+     *
+     * Larger files get larger blocks, so that their signatures stay small.
+     *
+     * \param fileSize The size of the file.
+     * \return         A power of two between 4 KiB and 1 MiB.
+     */
+    static std::size_t getBlockSize(uint64_t fileSize);
+
+    /**
+     * Computes the weak hash of a block.
+     *
+     * \param block The block.
+     * \return      The hash.
+     */
+    static uint32_t getWeakHash(std::string_view block);
+
+    /**
+     * Moves a weak hash along by one byte.
+     *
+     * \param hash      The hash of the block before it moved.
+     * \param blockSize The size of the block.
+     * \param removed   The byte that is no longer in the block.
+     * \param added     The byte that is now at the end of the block.
+     * \return          The hash of the block after it moved.
+     */
+    static uint32_t rollWeakHash(uint32_t hash, std::size_t blockSize, uint8_t removed, uint8_t added);
+
+    /**
+     * Computes the strong hash of a block.
+     *
+     * \param block The block.
+     * \return      The hash.
+     */
+    static std::array<uint8_t, STRONG_HASH_SIZE> getStrongHash(std::string_view block);
+
+    /**
+     * Computes the signatures of all of the blocks of some content. The last
+     * block may be shorter than the others.
+     *
+     * \param content   The content.
+     * \param blockSize The block size, as returned by `getBlockSize`.
+     * \return          The signatures, in order.
+     */
+    static std::vector<BlockSignature> computeSignatures(std::istream& content, std::size_t blockSize);
+
+    /**
+     * Creates a delta that turns the old content into the new content.
+     *
+     * This is what a client does. The server doesn't need it, but it shows
+     * how deltas are made and is used by the benchmarks.
+     *
+     * \param signatures The signatures of the old content.
+     * \param oldSize    The size of the old content.
+     * \param blockSize  The block size that the signatures were computed with.
+     * \param content    The new content.
+     * \param delta      Where to write the delta.
+     * \return           What the delta was made of.
+     */
+    static Result createDelta(const std::vector<BlockSignature>& signatures, uint64_t oldSize, std::size_t blockSize, std::istream& content, std::ostream& delta);
+
+    /**
+     * Builds new content from old content and a delta.
+     *
+     * Copied blocks are shared with the old content instead of being written
+     * again, when the filesystem supports it.
+     *
+     * \param delta      The delta sent by the client.
+     * \param oldPath    The file with the old content.
+     * \param oldOffset  Where the old content starts in that file.
+     * \param oldSize    The size of the old content.
+     * \param outputPath The file to create with the new content, which must
+     *                   not exist yet.
+     * \return           What the delta was made of.
+     * \exception std::runtime_error If the delta is not valid for the old
+     *                               content, copies more than
+     *                               `MAX_COPY_FACTOR` times the old content,
+     *                               or the new content couldn't be written.
+     *                               The output file is removed.
+     */
+    static Result applyDelta(std::istream& delta, const std::filesystem::path& oldPath, uint64_t oldOffset, uint64_t oldSize, const std::filesystem::path& outputPath);
+};
@@ -0,0 +1,51 @@
+#include "Change.h"
+
+#include <Wt/Dbo/Session.h>
+#include <cstddef>
+#include <string>
+#include <tuple>
+#include <utility>
+#include <vector>
+#include "File.h"
+#include "Folder.h"
+
+// Both of these only read a range of the changes_owner index.
+constexpr const char* CHANGES_SINCE_QUERY = "SELECT id, kind, element_type, element_id, parent_id, name FROM changes WHERE owner_id = ? AND id > ? ORDER BY id LIMIT ?";
+constexpr const char* LATEST_CHANGE_QUERY = "SELECT id FROM changes WHERE owner_id = ? ORDER BY id DESC LIMIT 1";
+
+Change::Change(Wt::Dbo::ptr<User> owner, Kind kind, ElementType elementType, long long elementId, long long parentId, std::string name)
+    : m_owner(std::move(owner))
+    , m_kind(kind)
+    , m_elementType(elementType)
+    , m_elementId(elementId)
+    , m_parentId(parentId)
+    , m_name(std::move(name))
+{
+}
+
+void Change::record(Wt::Dbo::Session& databaseSession, Kind kind, const Wt::Dbo::ptr<File>& file)
+{
+    databaseSession.addNew<Change>(file->getOwner(), kind, ElementType::File, file.id(), file->getParent().id(), file->getName());
+}
+
+void Change::record(Wt::Dbo::Session& databaseSession, Kind kind, const Wt::Dbo::ptr<Folder>& folder)
+{
+    databaseSession.addNew<Change>(folder->getOwner(), kind, ElementType::Folder, folder.id(), folder->getParent().id(), folder->getName());
+}
+
+std::vector<Change::Entry> Change::getSince(Wt::Dbo::Session& databaseSession, long long ownerId, long long cursor, std::size_t limit)
+{
+    auto query = databaseSession.query<std::tuple<long long, Kind, ElementType, long long, long long, std::string>>(CHANGES_SINCE_QUERY).bind(ownerId).bind(cursor).bind(static_cast<long long>(limit));
+
+    std::vector<Entry> changes;
+    for (const auto& [id, kind, elementType, elementId, parentId, name] : query.resultList()) {
+        changes.push_back(Entry { id, kind, elementType, elementId, parentId, name });
+    }
+    return changes;
+}
+
+long long Change::getLatestCursor(Wt::Dbo::Session& databaseSession, long long ownerId)
+{
+    // This is 0 if there are no changes.
+    return databaseSession.query<long long>(LATEST_CHANGE_QUERY).bind(ownerId).resultValue();
+}
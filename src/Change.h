@@ -0,0 +1,169 @@
+/**
+ * \class Change
+ *
+ * An entry in the change journal, which records every change to a user's
+ * files and folders so that sync clients can ask what changed since they
+ * last looked instead of listing every folder again.
+ *
+ * Changes are added in the same transaction as the change itself, so the
+ * journal never disagrees with the files and folders. The ID of each change
+ * is its position in the journal, which clients keep as a cursor. SQLite only
+ * lets one transaction write at a time, so changes that are committed later
+ * always get larger IDs and a cursor never skips past a change.
+ *
+ * Changes are looked up with an index on the owner and ID, so asking about an
+ * account that hasn't changed is a single index lookup.
+ *
+ * \date 2026-10-19 (last updated)
+ */
+
+#pragma once
+
+#include <Wt/Dbo/Dbo.h>
+#include <cstddef>
+#include <string>
+#include <vector>
+#include "User.h"
+
+class File;
+class Folder;
+
+class Change {
+public:
+    /**
+     * What happened to a file or folder.
+     */
+    enum class Kind {
+        Created,
+        // Renamed and/or moved.
+        Updated,
+        // Deleting a folder deletes everything inside it, which is not
+        // recorded separately.
+        Deleted,
+    };
+
+    /**
+     * Whether a change is to a file or a folder.
+     */
+    enum class ElementType {
+        File,
+        Folder,
+    };
+
+    /**
+     * A change read from the journal.
+     */
+    struct Entry {
+        long long cursor;
+        Kind kind;
+        ElementType elementType;
+        long long elementId;
+        long long parentId;
+        std::string name;
+    };
+
+private:
+    Wt::Dbo::ptr<User> m_owner;
+    Kind m_kind { Kind::Created };
+    ElementType m_elementType { ElementType::File };
+    long long m_elementId { 0 };
+    long long m_parentId { 0 };
+    std::string m_name;
+
+public:
+    /**
+     * Creates a new change.
+     *
+     * \param owner       The owner of the file or folder.
+     * \param kind        What happened to it.
+     * \param elementType Whether it is a file or a folder.
+     * \param elementId   The ID of the file or folder.
+     * \param parentId    The ID of the folder that contains it afterwards, or
+     *                    that contained it before it was deleted.
+     * \param name        Its name afterwards, or before it was deleted.
+     */
+    Change(Wt::Dbo::ptr<User> owner, Kind kind, ElementType elementType, long long elementId, long long parentId, std::string name);
+
+    /**
+     * Creates a new change with default values for all metadata.
+     *
+     * This should never be used directly by application code, but it is
+     * required by `Wt::Dbo`.
+     */
+    [[deprecated("only for use by Wt::Dbo")]] Change() = default;
+
+    /**
+     * Records a change to a file.
+     *
+     * A new file must have been flushed, so that it has an ID, and a deleted
+     * file must be recorded before it is removed.
+     *
+     * This requires a Wt::Dbo::Transaction to be currently active.
+     *
+     * \param databaseSession The database session to use.
+     * \param kind            What happened to the file.
+     * \param file            The file, after the change.
+     */
+    static void record(Wt::Dbo::Session& databaseSession, Kind kind, const Wt::Dbo::ptr<File>& file);
+
+    /**
+     * Records a change to a folder.
+     *
+     * The same rules as for files apply.
+     *
+     * This requires a Wt::Dbo::Transaction to be currently active.
+     *
+     * \param databaseSession The database session to use.
+     * \param kind            What happened to the folder.
+     * \param folder          The folder, after the change.
+     */
+    static void record(Wt::Dbo::Session& databaseSession, Kind kind, const Wt::Dbo::ptr<Folder>& folder);
+
+    /**
+     * Gets the changes to a user's files and folders after a cursor, oldest
+     * first.
+     *
+     * This requires a Wt::Dbo::Transaction to be currently active.
+     *
+     * \param databaseSession The database session to use.
+     * \param ownerId         The ID of the user.
+     * \param cursor          The cursor of the last change that the client
+     *                        has seen, or 0 for the start of the journal.
+     * \param limit           The most changes to return.
+     * \return                The changes.
+     */
+    static std::vector<Entry> getSince(Wt::Dbo::Session& databaseSession, long long ownerId, long long cursor, std::size_t limit);
+
+    /**
+     * Gets the cursor of a user's latest change, which a client that has
+     * just listed everything can use to only get later changes.
+     *
+     * This requires a Wt::Dbo::Transaction to be currently active.
+     *
+     * \param databaseSession The database session to use.
+     * \param ownerId         The ID of the user.
+     * \return                The cursor, or 0 if nothing has changed yet.
+     */
+    static long long getLatestCursor(Wt::Dbo::Session& databaseSession, long long ownerId);
+
+    /**
+     * Persists changes to the database.
+     *
+     * This should never be used directly by application code, but it is
+     * required by `Wt::Dbo`.
+     *
+     * \param action The database action to perform.
+     */
+    template <class Action>
+    void persist(Action& action)
+    {
+        Wt::Dbo::belongsTo(action, m_owner, "owner", Wt::Dbo::OnDeleteCascade);
+        Wt::Dbo::field(action, m_kind, "kind");
+        Wt::Dbo::field(action, m_elementType, "element_type");
+        // Deleted files and folders keep their changes, so these are not
+        // foreign keys.
+        Wt::Dbo::field(action, m_elementId, "element_id");
+        Wt::Dbo::field(action, m_parentId, "parent_id");
+        Wt::Dbo::field(action, m_name, "name");
+    }
+};
@@ -0,0 +1,125 @@
+#include "Chunk.h"
+
+#include <Wt/Dbo/Session.h>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <istream>
+#include <ostream>
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <vector>
+#include "BlobDeletion.h"
+#include "File.h"
+#include "Sha256.h"
+
+// Cutting where the top 16 bits of the hash are zero gives chunks of about
+// 64 KiB after the minimum size.
+constexpr uint64_t CUT_MASK = 0xffffULL << 48;
+
+// Random values for each byte, for the gear hash that finds where to cut.
+static constexpr std::array<uint64_t, 256> createGearTable()
+{
+    // SplitMix64, so that the table is the same on every server.
+    std::array<uint64_t, 256> table {};
+    uint64_t state = 0;
+    for (auto& value : table) {
+        state += 0x9e3779b97f4a7c15ULL;
+        uint64_t mixed = state;
+        mixed = (mixed ^ (mixed >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        mixed = (mixed ^ (mixed >> 27)) * 0x94d049bb133111ebULL;
+        value = mixed ^ (mixed >> 31);
+    }
+    return table;
+}
+
+static constexpr std::array<uint64_t, 256> GEAR_TABLE = createGearTable();
+
+// Adds one chunk to the store, or uses it again if it is already there.
+static long long storeChunk(Wt::Dbo::Session& databaseSession, const std::string& content)
+{
+    std::string hash = Sha256::toHex(Sha256::hash(content));
+    long long chunkId = databaseSession.query<long long>("SELECT id FROM chunks WHERE hash = ?").bind(hash).resultValue();
+    if (chunkId != 0) {
+        databaseSession.execute("UPDATE chunks SET reference_count = reference_count + 1 WHERE id = ?").bind(chunkId).run();
+        return chunkId;
+    }
+
+    databaseSession.execute("INSERT INTO chunks (version, hash, size, reference_count) VALUES (0, ?, ?, 1)").bind(hash).bind(static_cast<long long>(content.size())).run();
+    chunkId = databaseSession.query<long long>("SELECT id FROM chunks WHERE hash = ?").bind(hash).resultValue();
+
+    auto path = Chunk::getPath(chunkId);
+    std::ofstream file(path, std::ios::binary);
+    file.write(content.data(), static_cast<std::streamsize>(content.size()));
+    if (!file.flush()) {
+        std::error_code error;
+        std::filesystem::remove(path, error);
+        throw std::runtime_error("The file's previous version couldn't be saved.");
+    }
+    return chunkId;
+}
+
+std::filesystem::path Chunk::getPath(long long chunkId)
+{
+    return std::filesystem::path(File::FILE_SYSTEM_ROOT) / CHUNK_FOLDER / std::to_string(chunkId);
+}
+
+std::vector<long long> Chunk::store(Wt::Dbo::Session& databaseSession, std::istream& content)
+{
+    std::error_code error;
+    std::filesystem::create_directories(std::filesystem::path(File::FILE_SYSTEM_ROOT) / CHUNK_FOLDER, error);
+
+    std::vector<long long> chunkIds;
+    std::string chunk;
+    chunk.reserve(MAX_SIZE);
+    std::array<char, 64 * 1024> buffer {};
+    uint64_t hash = 0;
+    while (content.read(buffer.data(), buffer.size()) || content.gcount() > 0) {
+        auto size = static_cast<std::size_t>(content.gcount());
+        std::size_t start = 0;
+        for (std::size_t i = 0; i < size; ++i) {
+            hash = (hash << 1) + GEAR_TABLE[static_cast<uint8_t>(buffer[i])];
+            std::size_t chunkSize = chunk.size() + i + 1 - start;
+            if ((chunkSize >= MIN_SIZE && (hash & CUT_MASK) == 0) || chunkSize >= MAX_SIZE) {
+                chunk.append(buffer.data() + start, i + 1 - start);
+                chunkIds.push_back(storeChunk(databaseSession, chunk));
+                chunk.clear();
+                start = i + 1;
+                hash = 0;
+            }
+        }
+        chunk.append(buffer.data() + start, size - start);
+    }
+    if (!chunk.empty()) {
+        chunkIds.push_back(storeChunk(databaseSession, chunk));
+    }
+    return chunkIds;
+}
+
+void Chunk::release(Wt::Dbo::Session& databaseSession, const std::vector<long long>& chunkIds)
+{
+    for (long long chunkId : chunkIds) {
+        databaseSession.execute("UPDATE chunks SET reference_count = reference_count - 1 WHERE id = ?").bind(chunkId).run();
+    }
+
+    // The content is deleted in the background once this is committed.
+    for (long long chunkId : std::set<long long>(chunkIds.begin(), chunkIds.end())) {
+        std::string path = (std::filesystem::path(CHUNK_FOLDER) / std::to_string(chunkId)).string();
+        databaseSession.execute("INSERT INTO blob_deletions (version, path) SELECT 0, ? FROM chunks WHERE id = ? AND reference_count <= 0").bind(path).bind(chunkId).run();
+        databaseSession.execute("DELETE FROM chunks WHERE id = ? AND reference_count <= 0").bind(chunkId).run();
+    }
+}
+
+void Chunk::read(const std::vector<long long>& chunkIds, std::ostream& content)
+{
+    for (long long chunkId : chunkIds) {
+        std::ifstream file(getPath(chunkId), std::ios::binary);
+        if (!file || !(content << file.rdbuf())) {
+            throw std::runtime_error("The file's previous version couldn't be read.");
+        }
+    }
+}
@@ -0,0 +1,123 @@
+/**
+ * \class Chunk
+ *
+ * A piece of file content in the chunk store, which holds the content of old
+ * file versions.
+ *
+ * Content is split where a rolling hash of the last few bytes matches a
+ * pattern, so an edit only changes the chunks around it, even if it moves
+ * everything after it. Chunks are found by their SHA-256 hash, and each one
+ * is only stored once however many versions use it.
+ *
+ * The number of versions using each chunk is counted in the database, and a
+ * chunk is queued for the `BlobGarbageCollector` in the same transaction that
+ * stops using it for the last time. Each chunk is stored in a file named after
+ * its ID rather than its hash, so a chunk that is being deleted is never
+ * confused with a new one that has the same content.
+ *
+ * Versions are added and removed by many sessions at once, so chunks are only
+ * changed with SQL statements and never loaded as objects.
+ *
+ * \date 2026-10-19 (last updated)
+ */
+
+#pragma once
+
+#include <Wt/Dbo/Dbo.h>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <istream>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+class Chunk {
+public:
+    /**
+     * The folder in `File::FILE_SYSTEM_ROOT` where chunks are stored.
+     */
+    constexpr static std::string_view CHUNK_FOLDER = ".chunks";
+
+    /**
+     * The smallest size of a chunk, other than the last one of some content.
+     */
+    constexpr static std::size_t MIN_SIZE = 16 * 1024;
+
+    /**
+     * The largest size of a chunk.
+     */
+    constexpr static std::size_t MAX_SIZE = 256 * 1024;
+
+private:
+    std::string m_hash;
+    int64_t m_size { 0 };
+    int m_referenceCount { 0 };
+
+public:
+    /**
+     * Creates a new chunk with default values for all metadata.
+     *
+     * This should never be used directly by application code, but it is
+     * required by `Wt::Dbo`.
+     */
+    [[deprecated("only for use by Wt::Dbo")]] Chunk() = default;
+
+    /**
+     * Gets the path of a chunk's content.
+     *
+     * \param chunkId The ID of the chunk.
+     * \return        The path.
+     */
+    static std::filesystem::path getPath(long long chunkId);
+
+    /**
+     * Splits content into chunks and adds them to the store. Chunks that are
+     * already stored are used again.
+     *
+     * This requires a Wt::Dbo::Transaction to be currently active.
+     *
+     * \param databaseSession The database session to use.
+     * \param content         The content.
+     * \return                The IDs of the chunks, in order.
+     * \exception std::runtime_error If a chunk couldn't be saved.
+     */
+    static std::vector<long long> store(Wt::Dbo::Session& databaseSession, std::istream& content);
+
+    /**
+     * Stops using chunks that were returned by `store`. Chunks that aren't
+     * used any more are queued for deletion.
+     *
+     * This requires a Wt::Dbo::Transaction to be currently active.
+     *
+     * \param databaseSession The database session to use.
+     * \param chunkIds        The IDs of the chunks.
+     */
+    static void release(Wt::Dbo::Session& databaseSession, const std::vector<long long>& chunkIds);
+
+    /**
+     * Writes out the content of chunks.
+     *
+     * \param chunkIds The IDs of the chunks, in order.
+     * \param content  Where to write the content.
+     * \exception std::runtime_error If a chunk couldn't be read.
+     */
+    static void read(const std::vector<long long>& chunkIds, std::ostream& content);
+
+    /**
+     * Persists changes to the database.
+     *
+     * This should never be used directly by application code, but it is
+     * required by `Wt::Dbo`.
+     *
+     * \param action The database action to perform.
+     */
+    template <class Action>
+    void persist(Action& action)
+    {
+        Wt::Dbo::field(action, m_hash, "hash");
+        Wt::Dbo::field(action, m_size, "size");
+        Wt::Dbo::field(action, m_referenceCount, "reference_count");
+    }
+};
@@ -0,0 +1,36 @@
+#include "Configuration.h"
+
+#include <Wt/WServer.h>
+#include <exception>
+#include <iostream>
+#include <string>
+
+std::string Configuration::getString(const std::string& name, const std::string& defaultValue)
+{
+    const auto* server = Wt::WServer::instance();
+    std::string value;
+    if (!server || !server->readConfigurationProperty(name, value)) {
+        return defaultValue;
+    }
+    return value;
+}
+
+long long Configuration::getInteger(const std::string& name, long long defaultValue)
+{
+    std::string value = getString(name, "");
+    if (value.empty()) {
+        return defaultValue;
+    }
+
+    try {
+        std::size_t parsedLength = 0;
+        long long result = std::stoll(value, &parsedLength);
+        if (parsedLength == value.size()) {
+            return result;
+        }
+    } catch (const std::exception&) {
+        // Handled below.
+    }
+    std::cerr << "Configuration: Property " << name << " is not an integer, using " << defaultValue << std::endl;
+    return defaultValue;
+}
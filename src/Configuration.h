@@ -0,0 +1,40 @@
+/**
+ * \class Configuration
+ *
+ * Reads settings from the `<properties>` section of `wt_config.xml`.
+ *
+ * Every setting has a default value, so none of the properties need to be in
+ * the configuration file.
+ *
+ * \date 2026-10-19 (last updated)
+ */
+
+#pragma once
+
+#include <string>
+
+class Configuration {
+public:
+    Configuration() = delete;
+
+    /**
+     * Reads a text property.
+     *
+     * \param name         The name of the property.
+     * \param defaultValue The value to use if the property isn't set.
+     * \return             The value of the property.
+     */
+    static std::string getString(const std::string& name, const std::string& defaultValue);
+
+    /**
+     * Reads an integer property.
+     *
+     * If the property is set to something that isn't an integer, a warning is
+     * logged and the default value is used.
+     *
+     * \param name         The name of the property.
+     * \param defaultValue The value to use if the property isn't set.
+     * \return             The value of the property.
+     */
+    static long long getInteger(const std::string& name, long long defaultValue);
+};
@@ -0,0 +1,94 @@
+#include "DatabaseConnection.h"
+
+#include <Wt/Dbo/SqlConnection.h>
+#include <Wt/Dbo/backend/Sqlite3.h>
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <sqlite3.h>
+#include <string>
+#include "File.h"
+#include "FolderCache.h"
+#include "FolderChangeBus.h"
+#include "Histogram.h"
+#include "Metrics.h"
+#include "QueryTrace.h"
+
+static Histogram& getQueryHistogram()
+{
+    static auto& histogram = Metrics::instance().getHistogram("cgs_db_query_duration_seconds", "Time taken to run a database statement.", Metrics::Unit::Microseconds);
+    return histogram;
+}
+
+static Histogram& getTransactionHistogram()
+{
+    static auto& histogram = Metrics::instance().getHistogram("cgs_db_transaction_duration_seconds", "Time from the start to the end of a database transaction.", Metrics::Unit::Microseconds);
+    return histogram;
+}
+
+// Reference: https://www.sqlite.org/c3ref/trace_v2.html
+static int traceStatement(unsigned int type, void* /* context */, void* statement, void* data)
+{
+    if (type == SQLITE_TRACE_PROFILE) {
+        auto microseconds = static_cast<uint64_t>(*static_cast<sqlite3_int64*>(data) / 1000);
+        getQueryHistogram().record(microseconds);
+
+        // The SQL without its values, so that passwords and the like are
+        // never logged.
+        const char* sql = sqlite3_sql(static_cast<sqlite3_stmt*>(statement));
+        QueryTrace::record(sql != nullptr ? sql : "", microseconds);
+    }
+    return 0;
+}
+
+DatabaseConnection::DatabaseConnection(const std::string& path)
+    : Wt::Dbo::backend::Sqlite3(path)
+{
+    installTrace();
+}
+
+DatabaseConnection::DatabaseConnection(const DatabaseConnection& other)
+    : Wt::Dbo::backend::Sqlite3(other)
+{
+    installTrace();
+}
+
+std::unique_ptr<Wt::Dbo::SqlConnection> DatabaseConnection::clone() const
+{
+    return std::make_unique<DatabaseConnection>(*this);
+}
+
+void DatabaseConnection::startTransaction()
+{
+    Wt::Dbo::backend::Sqlite3::startTransaction();
+    m_transactionStart = std::chrono::steady_clock::now();
+}
+
+void DatabaseConnection::commitTransaction()
+{
+    Wt::Dbo::backend::Sqlite3::commitTransaction();
+    recordTransaction();
+    File::endTransaction(true);
+    FolderChangeBus::instance().publish(FolderCache::endTransaction());
+}
+
+void DatabaseConnection::rollbackTransaction()
+{
+    Wt::Dbo::backend::Sqlite3::rollbackTransaction();
+    recordTransaction();
+    File::endTransaction(false);
+    FolderCache::endTransaction();
+}
+
+void DatabaseConnection::installTrace()
+{
+    if (sqlite3_trace_v2(connection(), SQLITE_TRACE_PROFILE, traceStatement, this) != SQLITE_OK) {
+        std::cerr << "DatabaseConnection: Failed to install the statement trace" << std::endl;
+    }
+}
+
+void DatabaseConnection::recordTransaction()
+{
+    getTransactionHistogram().record(Metrics::getMicrosecondsSince(m_transactionStart));
+}
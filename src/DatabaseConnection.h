@@ -0,0 +1,62 @@
+/**
+ * \class DatabaseConnection
+ *
+ * The SQLite connection used for all database sessions.
+ *
+ * This is a normal `Wt::Dbo` SQLite connection that also measures how long
+ * each statement and transaction takes, for the `/metrics` page and for
+ * `QueryTrace`, and tells `File` and `FolderCache` when each transaction ends. The
+ * folders changed by each committed transaction are published to
+ * `FolderChangeBus`.
+ *
+ * \date 2026-10-19 (last updated)
+ */
+
+#pragma once
+
+#include <Wt/Dbo/SqlConnection.h>
+#include <Wt/Dbo/backend/Sqlite3.h>
+#include <chrono>
+#include <memory>
+#include <string>
+
+class DatabaseConnection : public Wt::Dbo::backend::Sqlite3 {
+public:
+    /**
+     * Opens a connection to a database file.
+     *
+     * \param path The path of the database file.
+     */
+    explicit DatabaseConnection(const std::string& path);
+
+    /**
+     * Opens another connection to the same database as `other`.
+     *
+     * This is used by `clone`, which connection pools use to open their
+     * connections.
+     *
+     * \param other The connection to copy.
+     */
+    DatabaseConnection(const DatabaseConnection& other);
+
+    DatabaseConnection& operator=(const DatabaseConnection&) = delete;
+
+    std::unique_ptr<Wt::Dbo::SqlConnection> clone() const override;
+
+    void startTransaction() override;
+    void commitTransaction() override;
+    void rollbackTransaction() override;
+
+private:
+    std::chrono::steady_clock::time_point m_transactionStart;
+
+    /**
+     * Asks SQLite to report each statement after it has run.
+     */
+    void installTrace();
+
+    /**
+     * Records the time taken by the current transaction.
+     */
+    void recordTransaction();
+};
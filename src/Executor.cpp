@@ -0,0 +1,206 @@
+#include "Executor.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <iostream>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "Configuration.h"
+#include "Histogram.h"
+#include "Metrics.h"
+
+struct Executor::Task {
+    std::function<void()> work;
+    std::chrono::steady_clock::time_point queueTime;
+};
+
+struct Executor::Worker {
+    std::mutex mutex;
+    std::deque<std::unique_ptr<Task>> tasks;
+};
+
+struct Executor::PoolState {
+    std::string name;
+    std::vector<std::unique_ptr<Worker>> workers;
+    std::vector<std::thread> threads;
+    // Work posted from outside the pool is spread over the threads in turn.
+    std::atomic<std::size_t> nextWorker { 0 };
+    // Tasks in all of the queues, so that idle threads know when to look.
+    std::atomic<std::size_t> queuedCount { 0 };
+    std::mutex mutex;
+    std::condition_variable condition;
+    bool isStopping { false };
+    Histogram* lengthHistogram { nullptr };
+    Histogram* waitHistogram { nullptr };
+};
+
+// The pool and queue of the current thread, if it belongs to the executor.
+static thread_local const void* t_pool = nullptr;
+static thread_local std::size_t t_workerIndex = 0;
+
+Executor& Executor::instance()
+{
+    static Executor executor;
+    return executor;
+}
+
+Executor::Executor()
+{
+    for (auto pool : { Pool::Cpu, Pool::Io }) {
+        auto state = std::make_unique<PoolState>();
+        state->name = pool == Pool::Cpu ? "cpu" : "io";
+        state->lengthHistogram = &Metrics::instance().getHistogram("cgs_executor_" + state->name + "_queue_length", "Tasks waiting in the " + state->name + " pool, counted each time a task is posted.", Metrics::Unit::Count);
+        state->waitHistogram = &Metrics::instance().getHistogram("cgs_executor_" + state->name + "_queue_wait_seconds", "Time that tasks waited in the " + state->name + " pool before they started.", Metrics::Unit::Microseconds);
+        m_pools[static_cast<std::size_t>(pool)] = std::move(state);
+    }
+}
+
+Executor::~Executor()
+{
+    stop();
+}
+
+void Executor::start()
+{
+    std::unique_lock lock(m_stateMutex);
+    if (m_isRunning) {
+        return;
+    }
+
+    auto coreCount = static_cast<long long>(std::max(1U, std::thread::hardware_concurrency()));
+    long long cpuThreads = Configuration::getInteger("executor-cpu-threads", 0);
+    std::array<long long, 2> threadCounts {
+        std::clamp(cpuThreads > 0 ? cpuThreads : coreCount, 1LL, 256LL),
+        std::clamp(Configuration::getInteger("executor-io-threads", 8), 1LL, 256LL),
+    };
+
+    for (std::size_t i = 0; i < m_pools.size(); ++i) {
+        auto& pool = *m_pools[i];
+        pool.isStopping = false;
+        pool.workers.clear();
+        for (long long j = 0; j < threadCounts[i]; ++j) {
+            pool.workers.push_back(std::make_unique<Worker>());
+        }
+        for (std::size_t j = 0; j < pool.workers.size(); ++j) {
+            pool.threads.emplace_back(&Executor::runWorker, std::ref(pool), j);
+        }
+    }
+    m_isRunning = true;
+}
+
+void Executor::stop()
+{
+    {
+        // Work that is still running may post more work, which then runs
+        // straight away instead of waiting for this lock.
+        std::unique_lock lock(m_stateMutex);
+        if (!m_isRunning) {
+            return;
+        }
+        m_isRunning = false;
+    }
+
+    for (auto& pool : m_pools) {
+        {
+            std::lock_guard poolLock(pool->mutex);
+            pool->isStopping = true;
+        }
+        pool->condition.notify_all();
+    }
+    for (auto& pool : m_pools) {
+        for (auto& thread : pool->threads) {
+            thread.join();
+        }
+        pool->threads.clear();
+    }
+}
+
+void Executor::post(Pool pool, std::function<void()> work)
+{
+    {
+        std::shared_lock lock(m_stateMutex);
+        if (m_isRunning) {
+            auto& state = *m_pools[static_cast<std::size_t>(pool)];
+            // Work posted from one of the pool's own threads stays on that
+            // thread's queue, where it is most likely to find its data still
+            // in the cache.
+            std::size_t workerIndex = t_pool == &state ? t_workerIndex : state.nextWorker.fetch_add(1, std::memory_order_relaxed) % state.workers.size();
+            {
+                auto& worker = *state.workers[workerIndex];
+                std::lock_guard workerLock(worker.mutex);
+                worker.tasks.push_back(std::make_unique<Task>(Task { std::move(work), std::chrono::steady_clock::now() }));
+            }
+            state.lengthHistogram->record(state.queuedCount.fetch_add(1) + 1);
+            {
+                std::lock_guard poolLock(state.mutex);
+            }
+            state.condition.notify_one();
+            return;
+        }
+    }
+
+    try {
+        work();
+    } catch (const std::exception& ex) {
+        std::cerr << "Executor: Work failed: " << ex.what() << std::endl;
+    }
+}
+
+bool Executor::isWorkerOf(Pool pool) const
+{
+    return t_pool != nullptr && t_pool == m_pools[static_cast<std::size_t>(pool)].get();
+}
+
+void Executor::runWorker(PoolState& pool, std::size_t workerIndex)
+{
+    t_pool = &pool;
+    t_workerIndex = workerIndex;
+
+    while (true) {
+        auto task = take(pool, workerIndex);
+        if (!task) {
+            std::unique_lock lock(pool.mutex);
+            pool.condition.wait(lock, [&pool] { return pool.queuedCount.load() > 0 || pool.isStopping; });
+            if (pool.isStopping && pool.queuedCount.load() == 0) {
+                return;
+            }
+            continue;
+        }
+
+        pool.waitHistogram->record(Metrics::getMicrosecondsSince(task->queueTime));
+        try {
+            task->work();
+        } catch (const std::exception& ex) {
+            std::cerr << "Executor: Work failed: " << ex.what() << std::endl;
+        }
+    }
+}
+
+std::unique_ptr<Executor::Task> Executor::take(PoolState& pool, std::size_t workerIndex)
+{
+    // A thread takes the oldest task from its own queue, and the newest from
+    // the others, so that owners and thieves rarely want the same task.
+    for (std::size_t i = 0; i < pool.workers.size(); ++i) {
+        auto& worker = *pool.workers[(workerIndex + i) % pool.workers.size()];
+        std::lock_guard lock(worker.mutex);
+        if (worker.tasks.empty()) {
+            continue;
+        }
+        std::unique_ptr<Task> task;
+        if (i == 0) {
+            task = std::move(worker.tasks.front());
+            worker.tasks.pop_front();
+        } else {
+            task = std::move(worker.tasks.back());
+            worker.tasks.pop_back();
+        }
+        pool.queuedCount.fetch_sub(1);
+        return task;
+    }
+    return nullptr;
+}
@@ -0,0 +1,159 @@
+/**
+ * \class Executor
+ *
+ * Runs blocking work on its own threads, so that a slow disk or a slow hash
+ * doesn't hold up the Wt threads that handle every session's events.
+ *
+ * There are two pools: `Pool::Cpu` for work that keeps a core busy, like
+ * hashing passwords, and `Pool::Io` for work that mostly waits for the disk,
+ * like saving uploads. The CPU pool has a thread per core by default, so busy
+ * work queues up instead of slowing everything down. Each thread has its own
+ * queue, and takes work from the other queues of its pool when its own is
+ * empty.
+ *
+ * Work from a session usually finishes by changing widgets, which has to
+ * happen in the session. `postAndResume` does that with `Wt::WServer::post`.
+ * Before `start()` and after `stop()`, work runs on the calling thread.
+ *
+ * \date 2026-10-19 (last updated)
+ */
+
+#pragma once
+
+#include <Wt/WApplication.h>
+#include <Wt/WServer.h>
+#include <array>
+#include <cstddef>
+#include <functional>
+#include <future>
+#include <memory>
+#include <shared_mutex>
+#include <string>
+#include <type_traits>
+#include <utility>
+
+class Executor {
+public:
+    /**
+     * A pool of threads for one kind of work.
+     */
+    enum class Pool {
+        Cpu,
+        Io,
+    };
+
+    /**
+     * Gets the executor for this server.
+     *
+     * \return The executor.
+     */
+    static Executor& instance();
+
+    ~Executor();
+
+    Executor(const Executor&) = delete;
+    Executor& operator=(const Executor&) = delete;
+
+    /**
+     * Reads the configuration and starts the threads of both pools.
+     */
+    void start();
+
+    /**
+     * Stops the threads, after finishing all of the work that was posted.
+     */
+    void stop();
+
+    /**
+     * Queues work on a pool.
+     *
+     * This can be called from any thread. Exceptions thrown by the work are
+     * logged.
+     *
+     * \param pool The pool to run the work on.
+     * \param work The work.
+     */
+    void post(Pool pool, std::function<void()> work);
+
+    /**
+     * Runs work on a pool and waits for its result.
+     *
+     * This doesn't free the calling thread, but it keeps the amount of
+     * such work running at once to the size of the pool. Work that is
+     * already running on the pool runs the new work itself, so that it can't
+     * wait for a thread that is waiting for it.
+     *
+     * \param pool The pool to run the work on.
+     * \param work The work.
+     * \return     The work's result.
+     * \exception  Anything thrown by the work.
+     */
+    template <class Work>
+    std::invoke_result_t<Work&> run(Pool pool, Work work)
+    {
+        using Result = std::invoke_result_t<Work&>;
+        if (isWorkerOf(pool)) {
+            return work();
+        }
+        auto task = std::make_shared<std::packaged_task<Result()>>(std::move(work));
+        auto result = task->get_future();
+        post(pool, [task] { (*task)(); });
+        return result.get();
+    }
+
+    /**
+     * Queues work on a pool, and passes its result to a function that runs
+     * in the current session once the work is done.
+     *
+     * This must be called from a Wt session. Nothing is run in the session if
+     * it has ended in the meantime, so `resume` can use the session's widgets
+     * as long as they outlive the session's pending events, or are checked
+     * with a `Wt::Core::observing_ptr`. The work must not throw.
+     *
+     * \param pool   The pool to run the work on.
+     * \param work   The work, which doesn't have access to the session.
+     * \param resume Called with the result of the work, in the session.
+     */
+    template <class Work, class Resume>
+    void postAndResume(Pool pool, Work work, Resume resume)
+    {
+        auto* application = Wt::WApplication::instance();
+        application->enableUpdates(true);
+        post(pool, [server = Wt::WServer::instance(), sessionId = application->sessionId(), work = std::move(work), resume = std::move(resume)]() mutable {
+            server->post(sessionId, [resume = std::move(resume), result = work()]() mutable {
+                resume(std::move(result));
+                auto* application = Wt::WApplication::instance();
+                application->triggerUpdate();
+                application->enableUpdates(false);
+            });
+        });
+    }
+
+private:
+    struct Task;
+    struct Worker;
+    struct PoolState;
+
+    std::array<std::unique_ptr<PoolState>, 2> m_pools;
+    // Held exclusively while starting or stopping, so that work is never
+    // queued on a pool whose threads have already finished.
+    std::shared_mutex m_stateMutex;
+    bool m_isRunning { false };
+
+    Executor();
+
+    /**
+     * Checks whether the calling thread belongs to a pool.
+     */
+    bool isWorkerOf(Pool pool) const;
+
+    /**
+     * The main loop of each thread.
+     */
+    static void runWorker(PoolState& pool, std::size_t workerIndex);
+
+    /**
+     * Takes the next task for a thread, from its own queue or another one.
+     */
+    static std::unique_ptr<Task> take(PoolState& pool, std::size_t workerIndex);
+};
@@ -1,25 +1,357 @@
 #include "File.h"
 
-#include <Wt/WFileResource.h>
+#include <Wt/Dbo/FixedSqlConnectionPool.h>
+#include <Wt/Dbo/Session.h>
+#include <Wt/Dbo/Transaction.h>
 #include <Wt/WGlobal.h>
+#include <Wt/WRandom.h>
 #include <Wt/WResource.h>
+#include <algorithm>
+#include <chrono>
 #include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
 #include <memory>
+#include <optional>
+#include <sstream>
+#include <stdexcept>
 #include <string>
+#include <string_view>
+#include <system_error>
+#include <tuple>
 #include <utility>
+#include <vector>
+#include "BlobDeletion.h"
+#include "BlobIo.h"
+#include "BlockDelta.h"
+#include "Change.h"
+#include "Configuration.h"
+#include "DatabaseConnection.h"
+#include "FileResource.h"
+#include "FileVersion.h"
+#include "Folder.h"
+#include "FolderCache.h"
+#include "Metrics.h"
+#include "MimeType.h"
+#include "PreviewGenerator.h"
+#include "SegmentStore.h"
+#include "StorageApplication.h"
 #include "StorageElement.h"
 #include "User.h"
 
-File::File(std::string name, Wt::Dbo::ptr<User> owner, Wt::Dbo::ptr<Folder> parent, int64_t fileSize)
+// New content for files, which replaces their content once the transaction
+// that changed them has been committed, by the ID of the file. An empty path
+// means that the new content was packed into a segment.
+static thread_local std::vector<std::pair<long long, std::string>> t_stagedContent;
+
+// Chooses where to write new content for a file, which is moved into place
+// by File::endTransaction.
+static std::string stageContent(long long fileId)
+{
+    // Only names made of digits are blobs, so the orphan scanner leaves this
+    // alone.
+    std::string stagedPath = std::string(File::FILE_SYSTEM_ROOT) + std::to_string(fileId) + "." + Wt::WRandom::generateId(16);
+    t_stagedContent.emplace_back(fileId, stagedPath);
+    return stagedPath;
+}
+
+// Notes that new content for a file was packed into a segment, so that any
+// old blob is removed by File::endTransaction.
+static void stagePackedContent(long long fileId)
+{
+    t_stagedContent.emplace_back(fileId, std::string());
+}
+
+File::File(std::string name, Wt::Dbo::ptr<User> owner, Wt::Dbo::ptr<Folder> parent, int64_t fileSize, std::string mimeType)
     : StorageElement(std::move(name), std::move(owner), std::move(parent))
     , m_fileSize(fileSize)
+    , m_mimeType(std::move(mimeType))
+{
+    m_extension = MimeType::getExtension(getName());
+}
+
+void File::setName(std::string name)
+{
+    m_extension = MimeType::getExtension(name);
+    StorageElement::setName(std::move(name));
+}
+
+Wt::Dbo::ptr<File> File::upload(Wt::Dbo::Session& databaseSession, std::string name, Wt::Dbo::ptr<User> owner, Wt::Dbo::ptr<Folder> parent, std::istream& content)
+{
+    if (name.empty()) {
+        throw std::runtime_error("A file name is required.");
+    }
+    auto start = std::chrono::steady_clock::now();
+
+    // The type is detected from the start of the content. Reading one byte
+    // more than the pack limit also shows whether the file is small enough to
+    // be packed into a segment.
+    std::size_t packLimit = SegmentStore::instance().getPackLimit();
+    std::string head(std::max(MimeType::HEADER_SIZE, packLimit + 1), '\0');
+    content.read(head.data(), static_cast<std::streamsize>(head.size()));
+    head.resize(static_cast<std::size_t>(content.gcount()));
+    auto mimeType = MimeType::detect(std::string_view(head).substr(0, MimeType::HEADER_SIZE), MimeType::getExtension(name));
+    bool isPacked = packLimit > 0 && head.size() <= packLimit;
+
+    // Uploading a file with the same name as an existing one replaces its
+    // content, and keeps the old content as a version.
+    FolderCache::invalidate(parent.id());
+    Wt::Dbo::ptr<File> file = parent->getFileByName(name);
+    bool isNewVersion = static_cast<bool>(file);
+    if (isNewVersion) {
+        FileVersion::create(databaseSession, file);
+    } else {
+        file = databaseSession.addNew<File>(std::move(name), std::move(owner), std::move(parent), 0, std::string(mimeType));
+        databaseSession.flush();
+    }
+
+    auto fileSize = static_cast<int64_t>(head.size());
+    SegmentStore::Location location {};
+    {
+        PreviewGenerator::UploadGuard uploadGuard;
+        if (isPacked) {
+            location = SegmentStore::instance().append(head);
+            stagePackedContent(file.id());
+        } else {
+            std::string filePath = isNewVersion ? stageContent(file.id()) : std::string(FILE_SYSTEM_ROOT) + std::to_string(file.id());
+            fileSize = BlobIo::instance().writeFile(filePath, head, content);
+        }
+    }
+
+    auto modifiableFile = file.modify();
+    modifiableFile->m_fileSize = fileSize;
+    modifiableFile->m_segmentId = location.segmentId;
+    modifiableFile->m_segmentOffset = location.offset;
+    modifiableFile->setMimeType(std::string(mimeType));
+    Change::record(databaseSession, isNewVersion ? Change::Kind::Updated : Change::Kind::Created, file);
+    // Staged content gets its preview once it is in place.
+    if (!isNewVersion && !isPacked) {
+        PreviewGenerator::instance().enqueue(file.id());
+    }
+
+    static auto& byteHistogram = Metrics::instance().getHistogram("cgs_upload_bytes", "Size of uploaded files.", Metrics::Unit::Bytes);
+    static auto& timeHistogram = Metrics::instance().getHistogram("cgs_upload_duration_seconds", "Time taken to save an uploaded file.", Metrics::Unit::Microseconds);
+    byteHistogram.record(static_cast<uint64_t>(fileSize));
+    timeHistogram.record(Metrics::getMicrosecondsSince(start));
+    return file;
+}
+
+void File::applyDelta(Wt::Dbo::Session& databaseSession, const Wt::Dbo::ptr<File>& file, std::istream& delta)
 {
+    static auto& copiedHistogram = Metrics::instance().getHistogram("cgs_delta_upload_copied_bytes", "Bytes of delta uploads that were copied from the file's previous content.", Metrics::Unit::Bytes);
+    static auto& literalHistogram = Metrics::instance().getHistogram("cgs_delta_upload_literal_bytes", "Bytes of delta uploads that were sent by the client.", Metrics::Unit::Bytes);
+    static auto& timeHistogram = Metrics::instance().getHistogram("cgs_delta_upload_duration_seconds", "Time taken to build a file's new content from a delta upload.", Metrics::Unit::Microseconds);
+    Metrics::ScopedTimer timer(timeHistogram);
+
+    // The new content always gets its own blob, since deltas are only worth
+    // sending for large files.
+    auto basisPath = file->isPacked() ? SegmentStore::getPath(file->m_segmentId) : std::filesystem::path(std::string(FILE_SYSTEM_ROOT) + std::to_string(file.id()));
+    std::string stagedPath = stageContent(file.id());
+    auto result = BlockDelta::applyDelta(delta, basisPath, static_cast<uint64_t>(file->m_segmentOffset), static_cast<uint64_t>(file->m_fileSize), stagedPath);
+    auto mimeType = MimeType::detectFile(stagedPath, file->getName());
+    FileVersion::create(databaseSession, file);
+
+    FolderCache::invalidate(file->getParent().id());
+    auto modifiableFile = file.modify();
+    modifiableFile->m_fileSize = static_cast<int64_t>(result.size);
+    modifiableFile->m_segmentId = 0;
+    modifiableFile->m_segmentOffset = 0;
+    modifiableFile->setMimeType(std::string(mimeType));
+    Change::record(databaseSession, Change::Kind::Updated, file);
+
+    copiedHistogram.record(result.copiedBytes);
+    literalHistogram.record(result.literalBytes);
+}
+
+void File::restoreVersion(Wt::Dbo::Session& databaseSession, const Wt::Dbo::ptr<File>& file, long long versionId)
+{
+    Wt::Dbo::ptr<FileVersion> version = databaseSession.find<FileVersion>().where("id = ? AND file_id = ?").bind(versionId).bind(file.id());
+    if (!version) {
+        throw std::runtime_error("The file has no such version.");
+    }
+
+    int64_t fileSize = version->getFileSize();
+    std::string mimeType = version->getMimeType();
+    std::size_t packLimit = SegmentStore::instance().getPackLimit();
+    bool isPacked = packLimit > 0 && static_cast<uint64_t>(fileSize) <= packLimit;
+
+    // The version is read first, since saving the current content as a
+    // version may remove the oldest one.
+    std::ostringstream packedContent;
+    if (isPacked) {
+        version->read(packedContent);
+    } else {
+        std::ofstream destination(stageContent(file.id()), std::ios::binary);
+        version->read(destination);
+        if (!destination.flush()) {
+            throw std::runtime_error("The file couldn't be saved.");
+        }
+    }
+    FileVersion::create(databaseSession, file);
+
+    SegmentStore::Location location {};
+    if (isPacked) {
+        location = SegmentStore::instance().append(packedContent.str());
+        stagePackedContent(file.id());
+    }
+
+    FolderCache::invalidate(file->getParent().id());
+    auto modifiableFile = file.modify();
+    modifiableFile->m_fileSize = fileSize;
+    modifiableFile->m_segmentId = location.segmentId;
+    modifiableFile->m_segmentOffset = location.offset;
+    modifiableFile->setMimeType(std::move(mimeType));
+    Change::record(databaseSession, Change::Kind::Updated, file);
+}
+
+void File::endTransaction(bool isCommitted)
+{
+    for (const auto& [fileId, stagedPath] : std::exchange(t_stagedContent, {})) {
+        std::error_code error;
+        if (!isCommitted) {
+            if (!stagedPath.empty()) {
+                std::filesystem::remove(stagedPath, error);
+            }
+            continue;
+        }
+
+        std::string filePath = std::string(FILE_SYSTEM_ROOT) + std::to_string(fileId);
+        if (stagedPath.empty()) {
+            std::filesystem::remove(filePath, error);
+        } else {
+            std::filesystem::rename(stagedPath, filePath, error);
+            if (error) {
+                std::cerr << "File: Failed to replace the content of file " << fileId << ": " << error.message() << std::endl;
+                std::filesystem::remove(stagedPath, error);
+                continue;
+            }
+        }
+
+        // The old preview is removed first, since the generator skips files
+        // that already have one.
+        std::filesystem::remove(PreviewGenerator::getPreviewPath(fileId), error);
+        PreviewGenerator::instance().enqueue(fileId);
+    }
+}
+
+std::unique_ptr<std::istream> File::openContent(const Wt::Dbo::ptr<File>& file)
+{
+    return openContent(file.id(), file->m_segmentId, file->m_segmentOffset, file->m_fileSize);
+}
+
+std::unique_ptr<std::istream> File::openContent(long long fileId, long long segmentId, int64_t segmentOffset, int64_t fileSize)
+{
+    if (segmentId == 0) {
+        auto content = std::make_unique<std::ifstream>(std::string(FILE_SYSTEM_ROOT) + std::to_string(fileId), std::ios::binary);
+        if (!*content) {
+            return nullptr;
+        }
+        return content;
+    }
+
+    // Packed content is small, so it is read all at once.
+    auto packedContent = SegmentStore::read(segmentId, segmentOffset, fileSize);
+    if (!packedContent) {
+        return nullptr;
+    }
+    return std::make_unique<std::istringstream>(std::move(*packedContent));
+}
+
+std::unique_ptr<std::istream> File::openContent(long long fileId)
+{
+    // Content in its own blob is found without the database.
+    if (auto content = openContent(fileId, 0, 0, 0)) {
+        return content;
+    }
+
+    auto packedContent = findPackedContent(fileId);
+    if (!packedContent) {
+        return nullptr;
+    }
+    return openContent(fileId, packedContent->segmentId, packedContent->offset, packedContent->size);
+}
+
+std::optional<File::PackedContent> File::findPackedContent(long long fileId)
+{
+    // Packed files are the most common kind, so this happens for most
+    // downloads and previews, which must not each open a new connection.
+    static Wt::Dbo::FixedSqlConnectionPool connectionPool = [] {
+        int connectionCount = static_cast<int>(std::max(1LL, Configuration::getInteger("content-lookup-connections", 4)));
+        auto connection = std::make_unique<DatabaseConnection>(std::string(StorageApplication::DATABASE_PATH));
+        return Wt::Dbo::FixedSqlConnectionPool(std::move(connection), connectionCount);
+    }();
+
+    // Only a raw query is needed, so the classes aren't mapped.
+    Wt::Dbo::Session databaseSession;
+    databaseSession.setConnectionPool(connectionPool);
+    Wt::Dbo::Transaction transaction(databaseSession);
+    auto rows = databaseSession.query<std::tuple<long long, long long, long long>>("SELECT segment_id, segment_offset, file_size FROM files WHERE id = ?").bind(fileId).resultList();
+    for (const auto& [segmentId, offset, size] : rows) {
+        if (segmentId > 0) {
+            return PackedContent { segmentId, offset, size };
+        }
+    }
+    return std::nullopt;
+}
+
+void File::rename(const Wt::Dbo::ptr<File>& file, std::string name)
+{
+    if (name.empty()) {
+        throw std::runtime_error("A file name is required.");
+    }
+    if (name != file->getName() && file->getParent()->getFileByName(name)) {
+        throw std::runtime_error("Another file already has this name.");
+    }
+
+    std::string header;
+    if (auto content = openContent(file)) {
+        header.resize(MimeType::HEADER_SIZE);
+        content->read(header.data(), static_cast<std::streamsize>(header.size()));
+        header.resize(static_cast<std::size_t>(content->gcount()));
+    }
+    auto mimeType = MimeType::detect(header, MimeType::getExtension(name));
+
+    FolderCache::invalidate(file->getParent().id());
+    auto modifiableFile = file.modify();
+    modifiableFile->setName(std::move(name));
+    modifiableFile->setMimeType(std::string(mimeType));
+    Change::record(*file.session(), Change::Kind::Updated, file);
+}
+
+void File::move(const Wt::Dbo::ptr<File>& file, const Wt::Dbo::ptr<Folder>& destination)
+{
+    if (file->getParent() == destination) {
+        throw std::runtime_error("The file is already in this folder. Please specify a different folder.");
+    }
+
+    if (destination->getFileByName(file->getName())) {
+        throw std::runtime_error("Another file with this name exists in your destination folder. Please specify a different folder or rename this file.");
+    }
+
+    FolderCache::invalidate(file->getParent().id());
+    FolderCache::invalidate(destination.id());
+    file.modify()->setParent(destination);
+    Change::record(*file.session(), Change::Kind::Updated, file);
 }
 
 std::shared_ptr<Wt::WResource> File::createResource(Wt::Dbo::ptr<File> file)
 {
-    std::string filePath = std::string(FILE_SYSTEM_ROOT) + std::to_string(file.id());
-    auto resource = std::make_shared<Wt::WFileResource>("application/octet-stream", filePath);
-    resource->suggestFileName(file->getName());
+    return createResource(FolderCache::FileEntry { file.id(), file->getName(), file->getFileSize(), file->getExtension(), file->getMimeType() });
+}
+
+std::shared_ptr<Wt::WResource> File::createResource(const FolderCache::FileEntry& file)
+{
+    auto resource = std::make_shared<FileResource>(file.mimeType.empty() ? std::string(MimeType::UNKNOWN) : file.mimeType, file.id, file.fileSize);
+    resource->suggestFileName(file.name);
     return resource;
 }
+
+void File::remove(Wt::Dbo::Session& databaseSession, Wt::Dbo::ptr<File> file)
+{
+    FolderCache::invalidate(file->getParent().id());
+    Change::record(databaseSession, Change::Kind::Deleted, file);
+    FileVersion::removeAll(databaseSession, "SELECT ?", file.id());
+    databaseSession.addNew<BlobDeletion>(std::to_string(file.id()));
+    file.remove();
+}
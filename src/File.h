@@ -12,7 +12,12 @@
 #include <Wt/Dbo/Dbo.h>
 #include <Wt/WResource.h>
 #include <cstdint>
+#include <istream>
 #include <memory>
+#include <optional>
+#include <string>
+#include "FolderCache.h"
+#include "SessionMemory.h"
 #include "SharingLink.h"
 #include "StorageElement.h"
 
@@ -23,10 +28,29 @@ public:
      */
     constexpr static const std::string_view FILE_SYSTEM_ROOT = "./userFiles/";
 
+    /**
+     * Where some content is packed into a `SegmentStore` segment. Segments
+     * are only ever appended to, so this always refers to the same content.
+     */
+    struct PackedContent {
+        long long segmentId;
+        int64_t offset;
+        int64_t size;
+    };
+
 private:
     // int64_t is chosen due to uint64_t not being supported in sqlite
     int64_t m_fileSize { 0 };
+    // Small files are packed into a `SegmentStore` segment, and other files
+    // have their own blob, named after the ID, with a segment ID of 0.
+    long long m_segmentId { 0 };
+    int64_t m_segmentOffset { 0 };
+    // Both of these are stored so that sorting by type can use an index, and
+    // so that neither has to be worked out again for every download.
+    std::string m_extension;
+    std::string m_mimeType;
     Wt::Dbo::collection<Wt::Dbo::ptr<SharingLink>> m_sharingLinks;
+    SessionMemory::Tracker<File> m_memoryTracker;
 
 public:
     /**
@@ -39,10 +63,12 @@ public:
      * \param owner  The owner of this file.
      * \param parent The folder that this file is contained in.
      * \param fileSize The size of the file.
+     * \param mimeType The type of the file's content.
      *
      * \see FileUploadPage::uploadFile
+     * \see MimeType::detectFile
      */
-    File(std::string name, Wt::Dbo::ptr<User> owner, Wt::Dbo::ptr<Folder> parent, int64_t fileSize);
+    File(std::string name, Wt::Dbo::ptr<User> owner, Wt::Dbo::ptr<Folder> parent, int64_t fileSize, std::string mimeType);
 
     /**
      * Creates a new file with default values for all metadata.
@@ -52,27 +78,234 @@ public:
      */
     [[deprecated("only for use by Wt::Dbo")]] File() = default;
 
+    /**
+     * Gets the size of this file's content.
+     *
+     * \return The size in bytes.
+     */
+    int64_t getFileSize() const { return m_fileSize; }
+
+    /**
+     * Checks whether this file's content is packed into a segment instead of
+     * having its own blob.
+     *
+     * \return Whether the content is packed.
+     */
+    bool isPacked() const { return m_segmentId != 0; }
+
+    /**
+     * Gets the segment that this file's content is packed into.
+     *
+     * \return The ID of the segment, or 0 if the content isn't packed.
+     */
+    long long getSegmentId() const { return m_segmentId; }
+
+    /**
+     * Gets where this file's content starts in its segment.
+     *
+     * \return The offset in bytes.
+     */
+    int64_t getSegmentOffset() const { return m_segmentOffset; }
+
+    /**
+     * Gets the extension of this file's name.
+     *
+     * \return The extension in lowercase, without the `.`.
+     */
+    const std::string& getExtension() const { return m_extension; }
+
+    /**
+     * Gets the type of this file's content.
+     *
+     * \return The MIME type that was detected when the file was uploaded.
+     */
+    const std::string& getMimeType() const { return m_mimeType; }
+
+    /**
+     * Renames this file, and updates its extension and MIME type to match.
+     *
+     * This hides `StorageElement::setName`, so that the extension can't get
+     * out of sync with the name.
+     *
+     * \param name The new name for this file.
+     */
+    void setName(std::string name);
+
+    /**
+     * Sets the type of this file's content.
+     *
+     * \param mimeType The new MIME type.
+     */
+    void setMimeType(std::string mimeType) { m_mimeType = std::move(mimeType); }
+
+    /**
+     * Creates a new file and saves its content. If the folder already has a
+     * file with that name, its content is replaced instead, and the old
+     * content is kept as a `FileVersion`.
+     *
+     * The content is copied into `FILE_SYSTEM_ROOT` while the file's type is
+     * detected, and the file is queued for a preview. Content up to
+     * `SegmentStore::getPackLimit` is packed into a segment instead.
+     *
+     * This requires a Wt::Dbo::Transaction to be currently active.
+     *
+     * \param databaseSession The database session to use.
+     * \param name            The name of the file.
+     * \param owner           The owner of the file, if it is new.
+     * \param parent          The folder to create the file in.
+     * \param content         The content of the file.
+     * \return                The new or changed file.
+     * \exception std::runtime_error If the name is empty, or if the content
+     *                               couldn't be saved.
+     */
+    static Wt::Dbo::ptr<File> upload(Wt::Dbo::Session& databaseSession, std::string name, Wt::Dbo::ptr<User> owner, Wt::Dbo::ptr<Folder> parent, std::istream& content);
+
+    /**
+     * Builds new content for a file from its current content and a delta,
+     * and keeps the old content as a `FileVersion`.
+     *
+     * This requires a Wt::Dbo::Transaction to be currently active.
+     *
+     * \param databaseSession The database session to use.
+     * \param file            The file to change.
+     * \param delta           A delta made against the file's current content.
+     * \exception std::runtime_error If the delta is not valid, or the new
+     *                               content couldn't be saved.
+     * \see BlockDelta
+     */
+    static void applyDelta(Wt::Dbo::Session& databaseSession, const Wt::Dbo::ptr<File>& file, std::istream& delta);
+
+    /**
+     * Replaces a file's content with one of its versions, and keeps the
+     * current content as a new version.
+     *
+     * This requires a Wt::Dbo::Transaction to be currently active.
+     *
+     * \param databaseSession The database session to use.
+     * \param file            The file to change.
+     * \param versionId       The ID of the version.
+     * \exception std::runtime_error If the file has no such version, or the
+     *                               content couldn't be saved.
+     */
+    static void restoreVersion(Wt::Dbo::Session& databaseSession, const Wt::Dbo::ptr<File>& file, long long versionId);
+
+    /**
+     * Puts the new content of files that were changed in the current
+     * transaction in place, or discards it.
+     *
+     * New content is written next to the current content, which is left
+     * alone until the transaction is committed so that a rollback leaves the
+     * file as it was. This is called by `DatabaseConnection` when a
+     * transaction ends.
+     *
+     * \param isCommitted Whether the transaction was committed.
+     */
+    static void endTransaction(bool isCommitted);
+
+    /**
+     * Opens a file's content for reading.
+     *
+     * \param file The file.
+     * \return     The content, or a null pointer if it is missing.
+     */
+    static std::unique_ptr<std::istream> openContent(const Wt::Dbo::ptr<File>& file);
+
+    /**
+     * Opens a file's content for reading, from a listing that includes where
+     * the content is stored.
+     *
+     * \param fileId        The ID of the file.
+     * \param segmentId     The segment that the content is packed into, or 0.
+     * \param segmentOffset Where the content starts in its segment.
+     * \param fileSize      The size of the content.
+     * \return              The content, or a null pointer if it is missing.
+     */
+    static std::unique_ptr<std::istream> openContent(long long fileId, long long segmentId, int64_t segmentOffset, int64_t fileSize);
+
+    /**
+     * Opens a file's content for reading, knowing only its ID.
+     *
+     * Content that isn't in its own blob is found with `findPackedContent`,
+     * so this is meant for code that runs outside of any session.
+     *
+     * \param fileId The ID of the file.
+     * \return       The content, or a null pointer if it is missing.
+     */
+    static std::unique_ptr<std::istream> openContent(long long fileId);
+
+    /**
+     * Looks up where a file's content is packed into a segment.
+     *
+     * This uses a small pool of database connections shared by every thread,
+     * from the `content-lookup-connections` property, so it is cheap enough
+     * to do for each download.
+     *
+     * \param fileId The ID of the file.
+     * \return       Where the content is, or `std::nullopt` if the file
+     *               doesn't exist or has its own blob.
+     */
+    static std::optional<PackedContent> findPackedContent(long long fileId);
+
+    /**
+     * Renames a file, detecting its type again from its content and new name.
+     *
+     * This requires a Wt::Dbo::Transaction to be currently active.
+     *
+     * \param file The file to rename.
+     * \param name The new name for the file.
+     * \exception std::runtime_error If the name is empty or already used.
+     */
+    static void rename(const Wt::Dbo::ptr<File>& file, std::string name);
+
+    /**
+     * Moves a file to a different folder.
+     *
+     * This requires a Wt::Dbo::Transaction to be currently active.
+     *
+     * \param file        The file to move.
+     * \param destination The new containing folder.
+     * \exception std::runtime_error If there was a problem moving the file.
+     */
+    static void move(const Wt::Dbo::ptr<File>& file, const Wt::Dbo::ptr<Folder>& destination);
+
     /**
      * Creates a WResource that can be used to download a file.
      *
      * This method is static because it needs to access the ID of the file,
      * which is only available with a Wt::Dbo::ptr.
      *
-     * The MIME type (which browsers use to determine file type) will be set to
-     * `application/octet-stream`, which is the file type for generic data.
-     * This is done for two reasons:
-     *
-     *  1. The browser will download the file instead of attempting to display
-     *     it, even if the actual data is a file type that the browser
-     *     recognizes.
-     *  2. We don't keep track of the MIME type, nor do we have a lookup table
-     *     to find one from the file extension.
+     * The MIME type (which browsers use to determine file type) is the one
+     * stored with the file. The resource always asks the browser to download
+     * the file instead of displaying it.
      *
      * \param file The file to create a resource for.
      * \return A WResource that will respond with this file.
      */
     static std::shared_ptr<Wt::WResource> createResource(Wt::Dbo::ptr<File> file);
 
+    /**
+     * Creates a WResource that can be used to download a file, from a cached
+     * folder listing.
+     *
+     * \param file The file to create a resource for.
+     * \return A WResource that will respond with this file.
+     */
+    static std::shared_ptr<Wt::WResource> createResource(const FolderCache::FileEntry& file);
+
+    /**
+     * Deletes a file.
+     *
+     * The file's content is queued for the `BlobGarbageCollector` instead of
+     * being deleted right away, so the collector should be notified once the
+     * transaction has been committed.
+     *
+     * This requires a Wt::Dbo::Transaction to be currently active.
+     *
+     * \param databaseSession The database session to use.
+     * \param file            The file to delete.
+     */
+    static void remove(Wt::Dbo::Session& databaseSession, Wt::Dbo::ptr<File> file);
+
     /**
      * Persists changes to the database.
      *
@@ -86,6 +319,10 @@ public:
     {
         StorageElement::persist(action);
         Wt::Dbo::field(action, m_fileSize, "file_size");
+        Wt::Dbo::field(action, m_segmentId, "segment_id");
+        Wt::Dbo::field(action, m_segmentOffset, "segment_offset");
+        Wt::Dbo::field(action, m_extension, "extension");
+        Wt::Dbo::field(action, m_mimeType, "mime_type");
         Wt::Dbo::hasMany(action, m_sharingLinks, Wt::Dbo::ManyToOne, "file");
     }
 };
@@ -0,0 +1,123 @@
+#include "FileResource.h"
+
+#include <Wt/Http/Request.h>
+#include <Wt/Http/Response.h>
+#include <Wt/Http/ResponseContinuation.h>
+#include <Wt/WFileResource.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <system_error>
+#include <utility>
+#include "BlobCache.h"
+#include "File.h"
+#include "Histogram.h"
+#include "Metrics.h"
+
+FileResource::FileResource(const std::string& mimeType, long long fileId, int64_t fileSize)
+    : Wt::WFileResource(mimeType, std::string(File::FILE_SYSTEM_ROOT) + std::to_string(fileId))
+    , m_fileId(fileId)
+    , m_fileSize(static_cast<uint64_t>(fileSize))
+{
+}
+
+FileResource::~FileResource()
+{
+    beingDeleted();
+}
+
+struct FileResource::CachedDownload {
+    std::shared_ptr<const std::string> content;
+    std::size_t bytesSent { 0 };
+    std::chrono::steady_clock::time_point start;
+};
+
+void FileResource::handleRequest(const Wt::Http::Request& request, Wt::Http::Response& response)
+{
+    auto start = std::chrono::steady_clock::now();
+    if (auto* responseContinuation = request.continuation()) {
+        auto data = responseContinuation->data();
+        if (auto* download = Wt::cpp17::any_cast<std::shared_ptr<CachedDownload>>(&data)) {
+            continueCachedDownload(*download, response);
+            return;
+        }
+    } else if (request.headerValue("Range").empty()) {
+        // Popular blobs are sent from memory. Requests for part of a file are
+        // rare, so they are left to Wt::WFileResource.
+        if (auto content = BlobCache::instance().get(fileName())) {
+            response.setMimeType(mimeType());
+            response.setContentLength(content->size());
+            continueCachedDownload(std::make_shared<CachedDownload>(CachedDownload { std::move(content), 0, start }), response);
+            return;
+        }
+    }
+
+    const void* continuation = request.continuation();
+    if (continuation) {
+        std::lock_guard lock(m_mutex);
+        auto match = m_downloadStarts.find(continuation);
+        if (match != m_downloadStarts.end()) {
+            start = match->second;
+            m_downloadStarts.erase(match);
+        }
+    }
+
+    // Packed content has no blob of its own, and is sent from memory through
+    // the BlobCache. Where the content is gets checked on every download,
+    // since the file's content can be replaced while this resource exists.
+    std::error_code error;
+    if (!continuation && !std::filesystem::exists(fileName(), error)) {
+        if (auto packedContent = File::findPackedContent(m_fileId)) {
+            auto content = BlobCache::instance().get(packedContent->segmentId, packedContent->offset, packedContent->size);
+            if (!content) {
+                response.setStatus(404);
+                return;
+            }
+            response.setMimeType(mimeType());
+            response.setContentLength(content->size());
+            continueCachedDownload(std::make_shared<CachedDownload>(CachedDownload { std::move(content), 0, start }), response);
+            return;
+        }
+    }
+
+    Wt::WFileResource::handleRequest(request, response);
+
+    // The same continuation is used for every piece of a download.
+    if (response.continuation()) {
+        std::lock_guard lock(m_mutex);
+        m_downloadStarts[response.continuation()] = start;
+    } else {
+        recordDownload(m_fileSize, start);
+    }
+}
+
+void FileResource::recordDownload(uint64_t bytes, std::chrono::steady_clock::time_point start)
+{
+    static auto& byteHistogram = Metrics::instance().getHistogram("cgs_download_bytes", "Size of downloaded files.", Metrics::Unit::Bytes);
+    static auto& timeHistogram = Metrics::instance().getHistogram("cgs_download_duration_seconds", "Time taken to send a downloaded file.", Metrics::Unit::Microseconds);
+    byteHistogram.record(bytes);
+    timeHistogram.record(Metrics::getMicrosecondsSince(start));
+}
+
+void FileResource::continueCachedDownload(const std::shared_ptr<CachedDownload>& download, Wt::Http::Response& response)
+{
+    std::size_t size = std::min(CHUNK_SIZE, download->content->size() - download->bytesSent);
+    response.out().write(download->content->data() + download->bytesSent, static_cast<std::streamsize>(size));
+    download->bytesSent += size;
+
+    if (download->bytesSent < download->content->size()) {
+        response.createContinuation()->setData(download);
+    } else {
+        recordDownload(download->bytesSent, download->start);
+    }
+}
+
+void FileResource::handleAbort(const Wt::Http::Request& request)
+{
+    std::lock_guard lock(m_mutex);
+    m_downloadStarts.erase(request.continuation());
+}
@@ -0,0 +1,81 @@
+/**
+ * \class FileResource
+ *
+ * A resource that downloads the content of a file and records how long the
+ * download took.
+ *
+ * Large downloads are sent in pieces by `Wt::WFileResource`, so the time is
+ * measured from the first piece to the last. Popular blobs, and all content
+ * that is packed into a `SegmentStore` segment, are sent from the `BlobCache`.
+ *
+ * \date 2026-10-19 (last updated)
+ */
+
+#pragma once
+
+#include <Wt/Http/Request.h>
+#include <Wt/Http/Response.h>
+#include <Wt/WFileResource.h>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+
+class FileResource : public Wt::WFileResource {
+public:
+    /**
+     * Creates a new resource for a file.
+     *
+     * \param mimeType The MIME type to send the file with.
+     * \param fileId   The ID of the file.
+     * \param fileSize The size of the file, in bytes.
+     */
+    FileResource(const std::string& mimeType, long long fileId, int64_t fileSize);
+
+    ~FileResource() override;
+
+    /**
+     * Handles a request for the file.
+     *
+     * This is called by Wt, once for each piece of the file.
+     *
+     * \param request  The request to handle.
+     * \param response The response to write to.
+     */
+    void handleRequest(const Wt::Http::Request& request, Wt::Http::Response& response) override;
+
+    /**
+     * Records a finished download in the download metrics.
+     *
+     * \param bytes The number of bytes that were sent.
+     * \param start When the download started.
+     */
+    static void recordDownload(uint64_t bytes, std::chrono::steady_clock::time_point start);
+
+protected:
+    void handleAbort(const Wt::Http::Request& request) override;
+
+private:
+    /**
+     * The amount of cached content sent in each piece of a download.
+     */
+    constexpr static std::size_t CHUNK_SIZE = 64 * 1024;
+
+    struct CachedDownload;
+
+    long long m_fileId;
+    uint64_t m_fileSize;
+
+    // The start times of downloads that have more pieces to send, by their
+    // continuations.
+    std::mutex m_mutex;
+    std::map<const void*, std::chrono::steady_clock::time_point> m_downloadStarts;
+
+    /**
+     * Sends the next piece of a download from the cache.
+     */
+    static void continueCachedDownload(const std::shared_ptr<CachedDownload>& download, Wt::Http::Response& response);
+};
@@ -9,6 +9,7 @@
 
 #include "FileStoragePage.h"
 
+#include <Wt/Core/observing_ptr.hpp>
 #include <Wt/Dbo/Transaction.h>
 #include <Wt/WBreak.h>
 #include <Wt/WGlobal.h>
@@ -17,10 +18,15 @@
 #include <Wt/WMessageBox.h>
 #include <Wt/WPushButton.h>
 #include <Wt/WText.h>
+#include <exception>
 #include <filesystem>
 #include <fstream>
+#include <functional>
+#include <iostream>
 #include <optional>
-#include "FileViewPage.h"
+#include <system_error>
+#include <utility>
+#include "Executor.h"
 #include "Folder.h"
 #include "StorageApplication.h"
 
@@ -36,7 +42,7 @@ FileStoragePage::FileStoragePage(Wt::Dbo::ptr<User> user, Wt::Dbo::Session& sess
 
     homeButton->clicked().connect([this] {
         auto* application = StorageApplication::instance();
-        application->switchPage(std::make_unique<FileViewPage>(m_loggedInUser, *m_databaseSession, m_parentFolder));
+        application->setInternalPath(StorageApplication::getFolderPath(m_parentFolder.id()), true);
     });
 
     setStyleClass("file-storage-page");
@@ -54,50 +60,53 @@ FileStoragePage::FileStoragePage(Wt::Dbo::ptr<User> user, Wt::Dbo::Session& sess
     uploadButton->clicked().connect(fileUpload, &Wt::WFileUpload::upload);
     fileUpload->uploaded().connect([this, fileUpload, uploadButton, filenameInput] {
         uploadButton->disable();
-        auto filename = FileStoragePage::uploadFile(fileUpload, filenameInput->text().toUTF8(), m_parentFolder);
-        if (!(fileUpload->empty()) && filename) {
+        if (fileUpload->empty()) {
             auto* messageBox = addChild(std::make_unique<Wt::WMessageBox>(
-                "File uploaded as: " + *filename,
-                "Press home to view file or you can upload more files",
+                "No file selected",
+                "<p>Please select a file prior to upload.</p>",
                 Wt::Icon::Information,
                 Wt::StandardButton::Ok));
-
-            filenameInput->setText("");
-
             messageBox->setModal(false);
-            messageBox->buttonClicked().connect([this, messageBox, &uploadButton] {
+            messageBox->buttonClicked().connect([this, messageBox, uploadButton] {
                 uploadButton->enable();
                 removeChild(messageBox);
             });
             messageBox->show();
-        } else {
-            if (fileUpload->empty()) {
+            return;
+        }
+
+        // The page stays responsive while the file is saved.
+        uploadFile(fileUpload, filenameInput->text().toUTF8(), m_parentFolder, [this, uploadButton, filenameInput](std::optional<std::string> filename) {
+            if (filename) {
                 auto* messageBox = addChild(std::make_unique<Wt::WMessageBox>(
-                    "No file selected",
-                    "<p>Please select a file prior to upload.</p>",
+                    "File uploaded as: " + *filename,
+                    "Press home to view file or you can upload more files",
                     Wt::Icon::Information,
                     Wt::StandardButton::Ok));
+
+                filenameInput->setText("");
+
                 messageBox->setModal(false);
-                messageBox->buttonClicked().connect([this, messageBox, &uploadButton] {
+                messageBox->buttonClicked().connect([this, messageBox, uploadButton] {
                     uploadButton->enable();
                     removeChild(messageBox);
                 });
                 messageBox->show();
-            } else if (!filename) {
+            } else {
                 auto* messageBox = addChild(std::make_unique<Wt::WMessageBox>(
                     "File couldn't be uploaded",
-                    "<p>There already existed a file with that name.</p>"
+                    "<p>The file couldn't be saved.</p>"
                     "<p>Please Try again</p>",
                     Wt::Icon::Information,
                     Wt::StandardButton::Ok));
                 messageBox->setModal(false);
-                messageBox->buttonClicked().connect([this, messageBox, &uploadButton] {
+                messageBox->buttonClicked().connect([this, messageBox, uploadButton] {
                     uploadButton->enable();
                     removeChild(messageBox);
                 });
                 messageBox->show();
             }
-        }
+        });
     });
 
     fileUpload->fileTooLarge().connect([this] {
@@ -122,41 +131,47 @@ FileStoragePage::FileStoragePage(Wt::Dbo::ptr<User> user, Wt::Dbo::Session& sess
     });
 }
 
-std::optional<std::string> FileStoragePage::uploadFile(Wt::WFileUpload* fileUpload, const std::string& fileName, Wt::Dbo::ptr<Folder> m_parentFolder)
+void FileStoragePage::uploadFile(Wt::WFileUpload* fileUpload, const std::string& fileName, Wt::Dbo::ptr<Folder> m_parentFolder, std::function<void(std::optional<std::string>)> onSaved)
 {
-    Wt::Dbo::Transaction transaction(*m_databaseSession);
-
-    const std::string tempFileName = fileUpload->spoolFileName(); // The uploaded filename
     const std::string defaultName = fileUpload->clientFileName().toUTF8();
     const size_t fileExtensionPosition = defaultName.find_last_of('.');
     std::string name = (fileName.empty() ? defaultName : fileName);
 
-    if (fileUpload->empty()) {
-        return "Error";
-    }
-
     if (fileExtensionPosition != std::string::npos) {
         name += (fileName.empty() ? "" : defaultName.substr(fileExtensionPosition));
     }
 
-    auto possFile = m_parentFolder->getFileByName(name);
-    if (possFile || possFile.isDirty()) {
-        return std::nullopt;
-    }
-
-    // getting file size
-    std::filesystem::path tempFilePath { tempFileName };
-    auto fsize = static_cast<int64_t>(std::filesystem::file_size(tempFilePath));
-
-    auto savedFile = m_databaseSession->addNew<File>(name, m_loggedInUser, std::move(m_parentFolder), fsize);
-    m_databaseSession->flush();
-
-    std::string fileId = std::string(File::FILE_SYSTEM_ROOT) + std::to_string(savedFile.id());
-    std::ifstream sourceFile(tempFileName, std::ios::binary);
-    std::ofstream destinationFile(fileId, std::ios::binary);
-
-    destinationFile << sourceFile.rdbuf();
-    sourceFile.close();
-    destinationFile.close();
-    return name;
+    // The upload widget deletes its spooled file when the next upload starts,
+    // so the file is taken over and removed once it has been saved.
+    std::string tempFileName = fileUpload->spoolFileName(); // The uploaded filename
+    fileUpload->stealSpooledFile();
+
+    // The session's database session can't be used from another thread, so
+    // the file is saved with one of its own.
+    long long userId = m_loggedInUser.id();
+    long long folderId = m_parentFolder.id();
+    Wt::Core::observing_ptr<FileStoragePage> page(this);
+    Executor::instance().postAndResume(
+        Executor::Pool::Io,
+        [tempFileName, name, userId, folderId]() -> std::optional<std::string> {
+            std::optional<std::string> savedName = name;
+            try {
+                auto databaseSession = StorageApplication::createDatabaseSession();
+                Wt::Dbo::Transaction transaction(*databaseSession);
+                std::ifstream sourceFile(tempFileName, std::ios::binary);
+                File::upload(*databaseSession, name, databaseSession->load<User>(userId), databaseSession->load<Folder>(folderId), sourceFile);
+                transaction.commit();
+            } catch (const std::exception& ex) {
+                std::cerr << "FileStoragePage: Failed to save " << name << ": " << ex.what() << std::endl;
+                savedName = std::nullopt;
+            }
+            std::error_code error;
+            std::filesystem::remove(tempFileName, error);
+            return savedName;
+        },
+        [page, onSaved = std::move(onSaved)](std::optional<std::string> savedName) {
+            if (page) {
+                onSaved(std::move(savedName));
+            }
+        });
 }
@@ -11,6 +11,9 @@
 
 #include <Wt/WContainerWidget.h>
 #include <Wt/WFileUpload.h>
+#include <functional>
+#include <optional>
+#include <string>
 #include "Folder.h"
 #include "User.h"
 
@@ -35,14 +38,17 @@ private:
      * Uploads a file selected by the user.
      *
      * In addition to storing the file metadata in the database, this function
-     * stores the file content to the server's file system.
+     * stores the file content to the server's file system. This happens on
+     * the `Executor`'s I/O pool, so the session can handle other events in
+     * the meantime.
      *
      * \param fileUpload A file upload widget where the file to upload has been
      *                   selected.
      * \param fileName   The name to use for the uploaded file, or an empty string
      *                   to use the default.
      * \param parentFolder   The parent folder being passed to which the file will be uploaded
-     * \return           The name of the uploaded file.
+     * \param onSaved    Called in the session with the name of the uploaded file,
+     *                   or `std::nullopt` if it couldn't be saved.
      */
-    std::optional<std::string> uploadFile(Wt::WFileUpload* fileUpload, const std::string& fileName, Wt::Dbo::ptr<Folder> parentFolder);
+    void uploadFile(Wt::WFileUpload* fileUpload, const std::string& fileName, Wt::Dbo::ptr<Folder> parentFolder, std::function<void(std::optional<std::string>)> onSaved);
 };
@@ -0,0 +1,104 @@
+#include "FileVersion.h"
+
+#include <Wt/Dbo/Session.h>
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <tuple>
+#include <utility>
+#include <vector>
+#include "Chunk.h"
+#include "Configuration.h"
+#include "File.h"
+#include "Metrics.h"
+
+static std::vector<unsigned char> encodeChunkIds(const std::vector<long long>& chunkIds)
+{
+    std::vector<unsigned char> bytes;
+    bytes.reserve(chunkIds.size() * sizeof(uint64_t));
+    for (long long chunkId : chunkIds) {
+        for (std::size_t i = 0; i < sizeof(uint64_t); ++i) {
+            bytes.push_back(static_cast<unsigned char>((static_cast<uint64_t>(chunkId) >> (8 * i)) & 0xff));
+        }
+    }
+    return bytes;
+}
+
+static std::vector<long long> decodeChunkIds(const std::vector<unsigned char>& bytes)
+{
+    std::vector<long long> chunkIds;
+    for (std::size_t start = 0; start + sizeof(uint64_t) <= bytes.size(); start += sizeof(uint64_t)) {
+        uint64_t chunkId = 0;
+        for (std::size_t i = 0; i < sizeof(uint64_t); ++i) {
+            chunkId |= static_cast<uint64_t>(bytes[start + i]) << (8 * i);
+        }
+        chunkIds.push_back(static_cast<long long>(chunkId));
+    }
+    return chunkIds;
+}
+
+// Removes versions along with their uses of chunks. The rows are read before
+// anything is changed, since Wt::Dbo can't run other statements while it is
+// still reading results.
+static void removeVersions(Wt::Dbo::Session& databaseSession, Wt::Dbo::collection<std::tuple<long long, std::vector<unsigned char>>> versions)
+{
+    std::vector<std::tuple<long long, std::vector<unsigned char>>> rows(versions.begin(), versions.end());
+    for (const auto& [versionId, chunkIds] : rows) {
+        Chunk::release(databaseSession, decodeChunkIds(chunkIds));
+        databaseSession.execute("DELETE FROM file_versions WHERE id = ?").bind(versionId).run();
+    }
+}
+
+FileVersion::FileVersion(Wt::Dbo::ptr<File> file, int64_t fileSize, std::string mimeType, const std::vector<long long>& chunkIds)
+    : m_file(std::move(file))
+    , m_fileSize(fileSize)
+    , m_mimeType(std::move(mimeType))
+    , m_creationTime(Wt::WDateTime::currentDateTime())
+    , m_chunkIds(encodeChunkIds(chunkIds))
+{
+}
+
+void FileVersion::read(std::ostream& content) const
+{
+    Chunk::read(decodeChunkIds(m_chunkIds), content);
+}
+
+void FileVersion::create(Wt::Dbo::Session& databaseSession, const Wt::Dbo::ptr<File>& file)
+{
+    static const long long versionLimit = std::max(0LL, Configuration::getInteger("file-version-limit", 10));
+    static auto& timeHistogram = Metrics::instance().getHistogram("cgs_file_version_duration_seconds", "Time taken to save the previous content of a file as a version.", Metrics::Unit::Microseconds);
+    if (versionLimit == 0) {
+        return;
+    }
+    Metrics::ScopedTimer timer(timeHistogram);
+
+    auto content = File::openContent(file);
+    if (!content) {
+        throw std::runtime_error("The file's current content couldn't be read.");
+    }
+    auto chunkIds = Chunk::store(databaseSession, *content);
+    databaseSession.addNew<FileVersion>(file, file->getFileSize(), file->getMimeType(), chunkIds);
+    databaseSession.flush();
+
+    removeVersions(databaseSession, databaseSession.query<std::tuple<long long, std::vector<unsigned char>>>("SELECT id, chunk_ids FROM file_versions WHERE file_id = ? ORDER BY id DESC LIMIT -1 OFFSET ?").bind(file.id()).bind(versionLimit).resultList());
+}
+
+std::vector<FileVersion::Entry> FileVersion::list(Wt::Dbo::Session& databaseSession, long long fileId)
+{
+    // This only reads a range of the file_versions_file index.
+    auto query = databaseSession.query<std::tuple<long long, int64_t, std::string, Wt::WDateTime>>("SELECT id, file_size, mime_type, creation_time FROM file_versions WHERE file_id = ? ORDER BY id DESC").bind(fileId);
+
+    std::vector<Entry> versions;
+    for (const auto& [id, fileSize, mimeType, creationTime] : query.resultList()) {
+        versions.push_back(Entry { id, fileSize, mimeType, creationTime });
+    }
+    return versions;
+}
+
+void FileVersion::removeAll(Wt::Dbo::Session& databaseSession, const std::string& fileIdsQuery, long long parameter)
+{
+    removeVersions(databaseSession, databaseSession.query<std::tuple<long long, std::vector<unsigned char>>>("SELECT id, chunk_ids FROM file_versions WHERE file_id IN (" + fileIdsQuery + ")").bind(parameter).resultList());
+}
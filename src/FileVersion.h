@@ -0,0 +1,144 @@
+/**
+ * \class FileVersion
+ *
+ * An earlier version of a file's content.
+ *
+ * The current content of a file is always in its own blob, so reading it
+ * doesn't depend on versions at all. When the content is replaced, the old
+ * content is split into `Chunk`s, which it shares with the file's other
+ * versions. Keeping many versions of a file that changes a little at a time
+ * only costs about as much as the changes.
+ *
+ * Only the newest versions are kept, up to the `file-version-limit`
+ * property.
+ *
+ * \date 2026-10-19 (last updated)
+ */
+
+#pragma once
+
+#include <Wt/Dbo/Dbo.h>
+#include <Wt/Dbo/WtSqlTraits.h>
+#include <Wt/WDateTime.h>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+class File;
+
+class FileVersion {
+public:
+    /**
+     * A version in a list of versions.
+     */
+    struct Entry {
+        long long id;
+        int64_t fileSize;
+        std::string mimeType;
+        Wt::WDateTime creationTime;
+    };
+
+private:
+    Wt::Dbo::ptr<File> m_file;
+    int64_t m_fileSize { 0 };
+    std::string m_mimeType;
+    Wt::WDateTime m_creationTime;
+    // The IDs of the chunks, as 64-bit little-endian integers.
+    std::vector<unsigned char> m_chunkIds;
+
+public:
+    /**
+     * Creates a new version.
+     *
+     * \param file     The file that this is a version of.
+     * \param fileSize The size of the content.
+     * \param mimeType The type of the content.
+     * \param chunkIds The chunks that make up the content.
+     */
+    FileVersion(Wt::Dbo::ptr<File> file, int64_t fileSize, std::string mimeType, const std::vector<long long>& chunkIds);
+
+    /**
+     * Creates a new version with default values for all metadata.
+     *
+     * This should never be used directly by application code, but it is
+     * required by `Wt::Dbo`.
+     */
+    [[deprecated("only for use by Wt::Dbo")]] FileVersion() = default;
+
+    /**
+     * Gets the size of this version's content.
+     *
+     * \return The size in bytes.
+     */
+    int64_t getFileSize() const { return m_fileSize; }
+
+    /**
+     * Gets the type of this version's content.
+     *
+     * \return The MIME type.
+     */
+    const std::string& getMimeType() const { return m_mimeType; }
+
+    /**
+     * Writes out this version's content.
+     *
+     * \param content Where to write the content.
+     * \exception std::runtime_error If the content couldn't be read.
+     */
+    void read(std::ostream& content) const;
+
+    /**
+     * Saves the current content of a file as a new version, before it is
+     * replaced. The oldest versions are removed if there are too many.
+     *
+     * This requires a Wt::Dbo::Transaction to be currently active.
+     *
+     * \param databaseSession The database session to use.
+     * \param file            The file.
+     * \exception std::runtime_error If the content couldn't be saved.
+     */
+    static void create(Wt::Dbo::Session& databaseSession, const Wt::Dbo::ptr<File>& file);
+
+    /**
+     * Lists the versions of a file, newest first.
+     *
+     * This requires a Wt::Dbo::Transaction to be currently active.
+     *
+     * \param databaseSession The database session to use.
+     * \param fileId          The ID of the file.
+     * \return                The versions.
+     */
+    static std::vector<Entry> list(Wt::Dbo::Session& databaseSession, long long fileId);
+
+    /**
+     * Removes all of the versions of some files, before the files are
+     * removed.
+     *
+     * This requires a Wt::Dbo::Transaction to be currently active.
+     *
+     * \param databaseSession The database session to use.
+     * \param fileIdsQuery    An SQL query that selects the IDs of the files,
+     *                        with one parameter.
+     * \param parameter       The value of the parameter.
+     */
+    static void removeAll(Wt::Dbo::Session& databaseSession, const std::string& fileIdsQuery, long long parameter);
+
+    /**
+     * Persists changes to the database.
+     *
+     * This should never be used directly by application code, but it is
+     * required by `Wt::Dbo`.
+     *
+     * \param action The database action to perform.
+     */
+    template <class Action>
+    void persist(Action& action)
+    {
+        Wt::Dbo::belongsTo(action, m_file, "file");
+        Wt::Dbo::field(action, m_fileSize, "file_size");
+        Wt::Dbo::field(action, m_mimeType, "mime_type");
+        Wt::Dbo::field(action, m_creationTime, "creation_time");
+        Wt::Dbo::field(action, m_chunkIds, "chunk_ids");
+    }
+};
@@ -3,35 +3,44 @@
 #include <Wt/Dbo/Session.h>
 #include <Wt/Dbo/Transaction.h>
 #include <Wt/Dbo/ptr.h>
+#include <Wt/WDialog.h>
+#include <Wt/WImage.h>
 #include <Wt/WLabel.h>
 #include <Wt/WLineEdit.h>
+#include <Wt/WLink.h>
 #include <Wt/WMessageBox.h>
 #include <Wt/WPushButton.h>
+#include <Wt/WStackedWidget.h>
 #include <Wt/WText.h>
 #include <algorithm>
-#include <cctype>
-#include <filesystem>
 #include <memory>
-#include <utility>
+#include <stdexcept>
 #include <string>
+#include <tuple>
+#include <utility>
 #include <vector>
-#include "File.h"
-#include "FileStoragePage.h"
-#include "FileWidget.h"
+#include "BlobGarbageCollector.h"
 #include "Folder.h"
-#include "FolderStoragePage.h"
-#include "FolderWidget.h"
-#include "LoginPage.h"
+#include "FolderArchiveResource.h"
+#include "FolderCache.h"
+#include "FolderChangeBus.h"
+#include "FolderView.h"
+#include "Metrics.h"
 #include "StorageApplication.h"
 #include "User.h"
 
-FileViewPage::FileViewPage(const Wt::Dbo::ptr<User>& user, Wt::Dbo::Session& session, Wt::Dbo::ptr<Folder> parentFolder)
+FileViewPage::FileViewPage(const Wt::Dbo::ptr<User>& user, Wt::Dbo::Session& session)
     : m_databaseSession(&session)
     , m_user(user)
-    , m_parentFolder(std::move(parentFolder))
 {
     setStyleClass("fileview-page");
 
+    {
+        Wt::Dbo::Transaction transaction(*m_databaseSession);
+        m_username = user->getUsername();
+        m_rootFolderId = user->getRootFolder().id();
+    }
+
     // Header
     auto* headerContainer = addNew<Wt::WContainerWidget>();
     headerContainer->setStyleClass("header-container");
@@ -39,7 +48,7 @@ FileViewPage::FileViewPage(const Wt::Dbo::ptr<User>& user, Wt::Dbo::Session& ses
     auto* logo = headerContainer->addNew<Wt::WImage>("/CloudGooseStorageLogoWithoutText.png");
     logo->addStyleClass("logo-without-text");
 
-    auto* userText = headerContainer->addNew<Wt::WText>(user->getUsername() + "'s Cloud Goose Storage");
+    auto* userText = headerContainer->addNew<Wt::WText>(m_username + "'s Cloud Goose Storage");
     userText->setStyleClass("header");
 
     auto* logOutButton = headerContainer->addNew<Wt::WPushButton>("Log Out");
@@ -55,6 +64,51 @@ FileViewPage::FileViewPage(const Wt::Dbo::ptr<User>& user, Wt::Dbo::Session& ses
     auto* addFolderButton = sidebar->addNew<Wt::WPushButton>("Add Folder");
     addFolderButton->setStyleClass("upload-button");
 
+    m_downloadFolderButton = sidebar->addNew<Wt::WPushButton>("Download Folder");
+    m_downloadFolderButton->setStyleClass("upload-button");
+
+    // These are hidden in the root folder, which can't be moved or deleted.
+    m_moveFolderButton = sidebar->addNew<Wt::WPushButton>("Move Folder");
+    m_moveFolderButton->setStyleClass("upload-button");
+    m_moveFolderButton->clicked().connect([this] {
+        auto* moveBox = addChild(std::make_unique<Wt::WDialog>("What folder would you like to move this folder to?"));
+        moveBox->contents()->addNew<Wt::WLabel>("Folder name:");
+        auto* name = moveBox->contents()->addNew<Wt::WLineEdit>();
+        auto* dialogText = moveBox->contents()->addNew<Wt::WText>("");
+        auto* submit = moveBox->footer()->addNew<Wt::WPushButton>("Move");
+        auto* cancel = moveBox->footer()->addNew<Wt::WPushButton>("Cancel");
+        moveBox->rejectWhenEscapePressed();
+        submit->clicked().connect([this, moveBox, name, dialogText] {
+            if (moveFolder(name->text().toUTF8(), dialogText)) {
+                moveBox->accept();
+            }
+        });
+
+        cancel->clicked().connect(moveBox, &Wt::WDialog::accept);
+        moveBox->finished().connect([this, moveBox] {
+            removeChild(moveBox);
+        });
+        moveBox->show();
+    });
+
+    m_deleteFolderButton = sidebar->addNew<Wt::WPushButton>("Delete Folder");
+    m_deleteFolderButton->setStyleClass("upload-button");
+    m_deleteFolderButton->clicked().connect([this] {
+        auto* deleteBox = addChild(std::make_unique<Wt::WMessageBox>(
+            "Are you sure you want to delete this folder?",
+            "Everything inside it will also be deleted. This action cannot be undone.",
+            Wt::Icon::Warning,
+            Wt::StandardButton::Yes | Wt::StandardButton::No));
+        deleteBox->rejectWhenEscapePressed();
+        deleteBox->buttonClicked().connect([this, deleteBox](Wt::StandardButton button) {
+            if (button == Wt::StandardButton::Yes) {
+                deleteFolder();
+            }
+            removeChild(deleteBox);
+        });
+        deleteBox->show();
+    });
+
     auto* tagText = sidebar->addNew<Wt::WText>("Filters");
     tagText->setStyleClass("section-text");
     auto* tagContainer = sidebar->addNew<Wt::WContainerWidget>();
@@ -67,124 +121,42 @@ FileViewPage::FileViewPage(const Wt::Dbo::ptr<User>& user, Wt::Dbo::Session& ses
     fileSizeSort->setStyleClass("filter-element");
     typeSort->setStyleClass("filter-element");
 
-    auto* mainContainer = addNew<Wt::WContainerWidget>();
-    mainContainer->addStyleClass("main-container");
-
-    std::string folderPath;
-    {
-        Wt::Dbo::Transaction transaction(*m_databaseSession);
-        auto rootFolder = user->getRootFolder();
-        std::string rootFolderName = rootFolder->getName();
-
-        auto pathParent = m_parentFolder;
-
-        while (pathParent != rootFolder) {
-            folderPath = pathParent->getName() + "/" + folderPath;
-            pathParent = pathParent->getParent();
-        }
-
-        if (folderPath.empty()) {
-            folderPath = rootFolderName;
-        } else {
-            folderPath = rootFolderName + "/" + folderPath;
-        }
-    }
-
-    auto* currentPathContainer = mainContainer->addNew<Wt::WContainerWidget>();
-    currentPathContainer->setStyleClass("current-path-container");
-
-    auto* parentFolderButton = currentPathContainer->addNew<ParentFolderButton>(this);
-
-    auto* currentPathText = currentPathContainer->addNew<Wt::WText>(folderPath);
-    currentPathText->setStyleClass("current-path");
+    m_folderViews = addNew<Wt::WStackedWidget>();
+    m_folderViews->addStyleClass("main-container");
 
-    auto* folderText = mainContainer->addNew<Wt::WText>("Folders");
-    folderText->setStyleClass("section-text");
-
-    parentFolderButton->clicked().connect([this] {
-        auto* application = StorageApplication::instance();
-
-        if (!(m_parentFolder->getParent())) {
-            application->switchPage(std::make_unique<FileViewPage>(m_user, *m_databaseSession, m_parentFolder));
-        } else {
-            auto grandParent = m_parentFolder->getParent();
-            application->switchPage(std::make_unique<FileViewPage>(m_user, *m_databaseSession, grandParent));
-        }
+    m_subscriberId = FolderChangeBus::instance().subscribe([this](const std::vector<long long>& folderIds) {
+        updateFolders(folderIds);
     });
 
-    auto* folderContainer = mainContainer->addNew<Wt::WContainerWidget>();
-    folderContainer->setStyleClass("section-container");
-    {
-        Wt::Dbo::Transaction transaction(*m_databaseSession);
-        const auto& folders = m_parentFolder->getFolders();
-
-        if (folders.empty()) {
-            folderContainer->addNew<Wt::WText>("No Folders");
-        } else {
-            for (const auto& folder : folders) {
-                auto* folderWidget = folderContainer->addNew<FolderWidget>(*m_databaseSession, folder);
-
-                folderWidget->clicked().connect([this, folder] {
-                    auto* application = StorageApplication::instance();
-                    application->switchPage(std::make_unique<FileViewPage>(m_user, *m_databaseSession, folder));
-                });
-            }
-        }
-    }
-
-    auto* fileText = mainContainer->addNew<Wt::WText>("Files");
-    fileText->setStyleClass("section-text");
-    auto* fileContainer = mainContainer->addNew<Wt::WContainerWidget>();
-    fileContainer->setStyleClass("section-container");
-
-    {
-        Wt::Dbo::Transaction transaction(*m_databaseSession);
-        auto files = m_parentFolder->getFiles();
-
-        addFiles(fileContainer, files);
-    }
-
-    nameSort->clicked().connect([this, user, fileContainer] {
-        Wt::Dbo::Transaction transaction(*m_databaseSession);
-        auto files = m_parentFolder->getFiles();
-        files = (m_hasSorted) ? files.find().orderBy("name ASC") : files.find().orderBy("name DESC");
-        m_hasSorted = !m_hasSorted;
-
-        addFiles(fileContainer, files);
+    nameSort->clicked().connect([this] {
+        m_currentView->sortFiles([](const FolderCache::FileEntry& first, const FolderCache::FileEntry& second) {
+            return first.name < second.name;
+        });
     });
 
-    typeSort->clicked().connect([this, user, fileContainer] {
-        Wt::Dbo::Transaction transaction(*m_databaseSession);
-        auto files = m_parentFolder->getFiles();
-
-        files = (m_hasSorted) ? files.find().orderBy("CASE WHEN INSTR(name, '.') > 0 THEN SUBSTR(name, INSTR(name, '.') + 1) ELSE name END ASC") : files.find().orderBy("CASE WHEN INSTR(name, '.') > 0 THEN SUBSTR(name, INSTR(name, '.') + 1) ELSE name END DESC");
-        m_hasSorted = !m_hasSorted;
-
-        addFiles(fileContainer, files);
+    typeSort->clicked().connect([this] {
+        m_currentView->sortFiles([](const FolderCache::FileEntry& first, const FolderCache::FileEntry& second) {
+            return std::tie(first.extension, first.name) < std::tie(second.extension, second.name);
+        });
     });
 
-    fileSizeSort->clicked().connect([this, user, fileContainer] {
-        Wt::Dbo::Transaction transaction(*m_databaseSession);
-        auto files = m_parentFolder->getFiles();
-
-        files = (m_hasSorted) ? files.find().orderBy("file_size ASC") : files.find().orderBy("file_size DESC");
-        m_hasSorted = !m_hasSorted;
-
-        addFiles(fileContainer, files);
+    fileSizeSort->clicked().connect([this] {
+        m_currentView->sortFiles([](const FolderCache::FileEntry& first, const FolderCache::FileEntry& second) {
+            return first.fileSize < second.fileSize;
+        });
     });
-    logOutButton->clicked().connect([this] {
-        auto* application = StorageApplication::instance();
-        application->switchPage(std::make_unique<LoginPage>(*m_databaseSession));
+    logOutButton->clicked().connect([] {
+        StorageApplication::instance()->logOut();
     });
 
     fileUploadButton->clicked().connect([this] {
         auto* application = StorageApplication::instance();
-        application->switchPage(std::make_unique<FileStoragePage>(m_user, *m_databaseSession, m_parentFolder));
+        application->setInternalPath(StorageApplication::getFolderPath(m_currentView->getFolderId()) + "/upload", true);
     });
 
     addFolderButton->clicked().connect([this] {
         auto* application = StorageApplication::instance();
-        application->switchPage(std::make_unique<FolderStoragePage>(m_user, *m_databaseSession, m_parentFolder));
+        application->setInternalPath(StorageApplication::getFolderPath(m_currentView->getFolderId()) + "/new-folder", true);
     });
 
     sidebar->addNew<Wt::WText>("Search")->setStyleClass("section-text");
@@ -195,122 +167,175 @@ FileViewPage::FileViewPage(const Wt::Dbo::ptr<User>& user, Wt::Dbo::Session& ses
     auto* searchButton = sidebar->addNew<Wt::WPushButton>("Search");
     searchButton->setStyleClass("search-button");
 
-    searchButton->clicked().connect([this, searchInput, fileContainer] {
+    searchButton->clicked().connect([this, searchInput] {
         std::string query = searchInput->text().toUTF8();
-        filterFiles(fileContainer, query);
+        m_currentView->filterFiles(query);
     });
 }
 
-void FileViewPage::addFiles(Wt::WContainerWidget* fileContainer, const Wt::Dbo::collection<Wt::Dbo::ptr<File>>& files) const
+FileViewPage::~FileViewPage()
 {
-    fileContainer->clear();
-    if (files.empty()) {
-        fileContainer->addNew<Wt::WText>("No Files");
-    } else {
-        for (const auto& file : files) {
-            auto* fileWidget = fileContainer->addNew<FileWidget>(m_user, *m_databaseSession, file, m_parentFolder);
-
-            fileWidget->deleteFile().connect([this, file, fileContainer, fileWidget] {
-                deleteFile(file->getName(), fileContainer, fileWidget);
-            });
-
-            fileWidget->moveFile().connect([this, file, fileContainer, fileWidget] {
-                fileContainer->removeWidget(fileWidget);
-                {
-                    Wt::Dbo::Transaction transaction(*m_databaseSession);
-                    auto files = m_parentFolder->getFiles();
-
-                    if (files.empty()) {
-                        fileContainer->addNew<Wt::WText>("No Files");
-                    }
-                }
-            });
-        }
-    }
+    FolderChangeBus::instance().unsubscribe(m_subscriberId);
 }
 
-void FileViewPage::deleteFile(const std::string& name, Wt::WContainerWidget* fileContainer, FileWidget* fileWidget) const
+bool FileViewPage::showFolder(long long folderId)
 {
-    // removing from database
-    Wt::Dbo::Transaction transaction(*m_databaseSession);
-    Wt::Dbo::ptr<File> fileToDelete = m_parentFolder->getFileByName(name);
-    fileToDelete.remove();
-
-    // removing from internal storage
-    std::string fileid = std::string(File::FILE_SYSTEM_ROOT) + std::to_string(fileToDelete.id());
+    static auto& buildHistogram = Metrics::instance().getHistogram("cgs_page_build_duration_seconds", "Time taken to build the view of a folder in the file view page, including its database queries.", Metrics::Unit::Microseconds);
 
-    std::filesystem::path filePath { fileid };
-    std::filesystem::remove(filePath);
+    auto cachedView = std::find_if(m_cachedViews.begin(), m_cachedViews.end(), [folderId](FolderView* view) {
+        return view->getFolderId() == folderId;
+    });
 
-    // re-rendering files
-    fileContainer->removeWidget(fileWidget);
-    {
+    // A cached view is only reused while it matches the cached listing, which
+    // doesn't need any queries.
+    FolderView* view = nullptr;
+    if (cachedView != m_cachedViews.end()) {
         Wt::Dbo::Transaction transaction(*m_databaseSession);
-        auto files = m_parentFolder->getFiles();
+        view = *cachedView;
+        m_cachedViews.erase(cachedView);
+        if (view->getListing() != FolderCache::instance().get(*m_databaseSession, folderId)) {
+            removeView(view);
+            view = nullptr;
+        }
+    }
+
+    if (!view) {
+        Metrics::ScopedTimer buildTimer(buildHistogram);
+
+        // Everything shown in the view is read up front, with a fixed number
+        // of queries however deep or large the folder is.
+        std::vector<FolderCache::FolderEntry> path;
+        std::shared_ptr<const FolderCache::Listing> listing;
+        {
+            Wt::Dbo::Transaction transaction(*m_databaseSession);
+            path = Folder::getPath(*m_databaseSession, folderId);
+            // Someone else's folder is treated as if it doesn't exist.
+            if (path.empty() || path.front().id != m_rootFolderId) {
+                return false;
+            }
+            listing = FolderCache::instance().get(*m_databaseSession, folderId);
+        }
 
-        if (files.empty()) {
-            fileContainer->addNew<Wt::WText>("No Files");
+        if (m_cachedViews.size() >= MAX_CACHED_VIEWS) {
+            removeView(m_cachedViews.front());
+            m_cachedViews.erase(m_cachedViews.begin());
         }
+        view = m_folderViews->addNew<FolderView>(m_user, *m_databaseSession, std::move(path), std::move(listing));
+        FolderChangeBus::instance().watch(m_subscriberId, folderId);
     }
+
+    m_cachedViews.push_back(view);
+    m_currentView = view;
+    m_folderViews->setCurrentWidget(view);
+
+    // Root folders all have the same placeholder name, so use the username
+    // instead.
+    std::string archiveName = view->isRoot() ? m_username : view->getPath().back().name;
+    m_downloadFolderButton->setLink(Wt::WLink(std::make_shared<FolderArchiveResource>(folderId, archiveName)));
+    m_moveFolderButton->setHidden(view->isRoot());
+    m_deleteFolderButton->setHidden(view->isRoot());
+    return true;
 }
 
-FileViewPage::ParentFolderButton::ParentFolderButton(FileViewPage* page)
-    : Wt::WPushButton("Parent Folder")
-    , m_page(page)
+void FileViewPage::removeView(FolderView* view)
 {
-    addStyleClass("back-button");
-    acceptDrops(std::string(FILE_MIME_TYPE));
+    FolderChangeBus::instance().unwatch(m_subscriberId, view->getFolderId());
+    m_folderViews->removeWidget(view);
 }
 
-void FileViewPage::ParentFolderButton::dropEvent(Wt::WDropEvent dropEvent)
+void FileViewPage::clearCachedViews()
 {
-    // FileWidget has a separate drag handle widget that is draggable, so the
-    // drop events come from that.
-    auto* sourceWidget = dynamic_cast<Wt::WWidget*>(dropEvent.source());
-    if (!sourceWidget) {
-        std::cerr << "ParentFolderButton: Received drop that wasn't from a widget of any kind" << std::endl;
-        return;
+    for (auto* view : m_cachedViews) {
+        removeView(view);
     }
-    auto* fileWidget = dynamic_cast<FileWidget*>(sourceWidget->parent());
-    if (!fileWidget) {
-        std::cerr << "ParentFolderButton: Received drop that wasn't from a FileWidget" << std::endl;
-        return;
+    m_cachedViews.clear();
+    m_currentView = nullptr;
+}
+
+void FileViewPage::updateFolders(const std::vector<long long>& folderIds)
+{
+    static auto& updateHistogram = Metrics::instance().getHistogram("cgs_folder_view_update_duration_seconds", "Time taken to update the kept folder views of a session after their folders changed.", Metrics::Unit::Microseconds);
+    Metrics::ScopedTimer updateTimer(updateHistogram);
+
+    bool isCurrentViewRemoved = false;
+    for (long long folderId : folderIds) {
+        auto cachedView = std::find_if(m_cachedViews.begin(), m_cachedViews.end(), [folderId](FolderView* view) {
+            return view->getFolderId() == folderId;
+        });
+        if (cachedView == m_cachedViews.end()) {
+            continue;
+        }
+
+        // Every session watching the folder shares the listing, so it is only
+        // loaded from the database once.
+        std::shared_ptr<const FolderCache::Listing> listing;
+        bool exists = true;
+        {
+            Wt::Dbo::Transaction transaction(*m_databaseSession);
+            listing = FolderCache::instance().get(*m_databaseSession, folderId);
+            // A deleted folder looks empty, so only then is it looked up.
+            if (listing->folders.empty() && listing->files.empty()) {
+                exists = !Folder::getPath(*m_databaseSession, folderId).empty();
+            }
+        }
+
+        if (exists) {
+            (*cachedView)->update(std::move(listing));
+            continue;
+        }
+        isCurrentViewRemoved = isCurrentViewRemoved || *cachedView == m_currentView;
+        removeView(*cachedView);
+        m_cachedViews.erase(cachedView);
     }
 
-    Wt::Dbo::Transaction transaction(*m_page->m_databaseSession);
-    try {
-        fileWidget->moveFile(m_page->m_parentFolder->getParent());
-    } catch (const std::runtime_error& ex) {
-        std::cerr << "ParentFolderButton: Failed to move file: " << ex.what() << std::endl;
-        transaction.rollback();
-        return;
+    if (isCurrentViewRemoved) {
+        m_currentView = nullptr;
+        auto* application = StorageApplication::instance();
+        application->setInternalPath(StorageApplication::getFolderPath(m_rootFolderId), true);
     }
 }
 
-void FileViewPage::filterFiles(Wt::WContainerWidget* fileContainer, const std::string& query) const
+void FileViewPage::deleteFolder()
 {
-    fileContainer->clear();
-    Wt::Dbo::Transaction transaction(*m_databaseSession);
-    auto files = m_parentFolder->getFiles();
+    const auto& path = m_currentView->getPath();
+    long long parentId = path[path.size() - 2].id;
+    {
+        Wt::Dbo::Transaction transaction(*m_databaseSession);
+        Folder::removeRecursive(*m_databaseSession, m_currentView->getFolder());
+    }
+    BlobGarbageCollector::instance().notify();
 
-    std::vector<Wt::Dbo::ptr<File>> filteredFiles;
+    // The deleted folders may still have cached views.
+    clearCachedViews();
+    auto* application = StorageApplication::instance();
+    application->setInternalPath(StorageApplication::getFolderPath(parentId), true);
+}
 
-    for (const auto& file : files) {
-        std::string fileName = file->getName();
-        std::transform(fileName.begin(), fileName.end(), fileName.begin(), ::tolower);
-        std::string lowerQuery = query;
-        std::transform(lowerQuery.begin(), lowerQuery.end(), lowerQuery.begin(), ::tolower);
+bool FileViewPage::moveFolder(const std::string& name, Wt::WText* dialogText)
+{
+    long long folderId = m_currentView->getFolderId();
+    {
+        Wt::Dbo::Transaction transaction(*m_databaseSession);
+        auto folderQuery = m_databaseSession->find<Folder>().where("name = ? AND owner_id = ?").bind(name).bind(m_user.id()).limit(1);
+        Wt::Dbo::ptr<Folder> destination = folderQuery.resultValue();
 
-        if (fileName.find(lowerQuery) != std::string::npos) {
-            filteredFiles.push_back(file);
+        if (!destination) {
+            dialogText->setText("A folder with that name does not exist.");
+            return false;
         }
-    }
 
-    if (filteredFiles.empty()) {
-        fileContainer->addNew<Wt::WText>("No Files");
-    } else {
-        for (const auto& file : filteredFiles) {
-            fileContainer->addNew<FileWidget>(m_user, *m_databaseSession, file, m_parentFolder)->setStyleClass("section-element file-element");
+        try {
+            Folder::move(*m_databaseSession, m_currentView->getFolder(), destination);
+        } catch (const std::runtime_error& ex) {
+            dialogText->setText(ex.what());
+            transaction.rollback();
+            return false;
         }
     }
+
+    // Rebuild the view so that the path shows the folder's new location. The
+    // internal path stays the same, so the folder is shown directly.
+    clearCachedViews();
+    showFolder(folderId);
+    return true;
 }
@@ -3,16 +3,26 @@
  *
  * A page where users can see their files and folders
  *
+ * The header and sidebar stay the same while the user moves between folders,
+ * and only the `FolderView` below them is changed. The views of the last few
+ * folders are kept, so going back to one of them doesn't rebuild it. Kept
+ * views are updated through `FolderChangeBus` when their folders change.
+ *
  * \authors Arjun Sharma, Joshua Nathan Ming, Matthew Lucas Otchet, Raj Brahmbhatt
- * \date 2023-11-28 (last updated)
+ * \date 2026-10-19 (last updated)
  */
 
 #pragma once
 
 #include <Wt/WContainerWidget.h>
 #include <Wt/WPushButton.h>
-#include "File.h"
-#include "FileWidget.h"
+#include <Wt/WStackedWidget.h>
+#include <Wt/WText.h>
+#include <cstddef>
+#include <string>
+#include <vector>
+#include "FolderCache.h"
+#include "FolderView.h"
 #include "User.h"
 
 class FileViewPage : public Wt::WContainerWidget {
@@ -25,71 +35,90 @@ public:
     constexpr static std::string_view FILE_MIME_TYPE = "application/x.cloud-goose-storage.file";
 
     /**
-     * Creates a new `FileViewPage`.
+     * Creates a new `FileViewPage`, which doesn't show any folder until
+     * `showFolder` is called.
      *
      * \param user The logged-in user, who will see all their files and folders
      * \param session The database session to use.
-     * \param parentFolder The current folder that the FileViewPage is on
      */
-    explicit FileViewPage(const Wt::Dbo::ptr<User>& user, Wt::Dbo::Session& session, Wt::Dbo::ptr<Folder> parentFolder);
+    explicit FileViewPage(const Wt::Dbo::ptr<User>& user, Wt::Dbo::Session& session);
 
-private:
-    Wt::Dbo::Session* m_databaseSession;
-    Wt::Dbo::ptr<User> m_user;
-    Wt::Dbo::ptr<Folder> m_parentFolder;
-    bool m_hasSorted { false };
+    ~FileViewPage() override;
+
+    FileViewPage(const FileViewPage&) = delete;
+    FileViewPage& operator=(const FileViewPage&) = delete;
 
     /**
-     * Adds ths files into the file container to be viewed
+     * Shows one of the user's folders.
      *
-     * \param fileContainer The container that holds all the FileWidget Elements
-     * \param files The sorted files
+     * \param folderId The ID of the folder.
+     * \return         `false` if the folder doesn't exist or belongs to
+     *                 someone else, in which case nothing changes.
      */
-    void addFiles(Wt::WContainerWidget* fileContainer, const Wt::Dbo::collection<Wt::Dbo::ptr<File>>& files) const;
+    bool showFolder(long long folderId);
+
+    /**
+     * Gets the ID of the user's root folder.
+     *
+     * \return The root folder's ID.
+     */
+    long long getRootFolderId() const { return m_rootFolderId; }
+
+private:
+    // Each view is a few widgets per file, so only a handful are kept.
+    constexpr static std::size_t MAX_CACHED_VIEWS = 8;
+
+    Wt::Dbo::Session* m_databaseSession;
+    Wt::Dbo::ptr<User> m_user;
+    std::string m_username;
+    long long m_rootFolderId { 0 };
+    Wt::WPushButton* m_downloadFolderButton;
+    Wt::WPushButton* m_moveFolderButton;
+    Wt::WPushButton* m_deleteFolderButton;
+    Wt::WStackedWidget* m_folderViews;
+    // Least recently shown first, so the current view is last.
+    std::vector<FolderView*> m_cachedViews;
+    FolderView* m_currentView { nullptr };
+    long long m_subscriberId;
 
     /**
-     * Deletes a file from the database
-     * \param name the name of the file to be deleted
-     * \param fileContainer the file container object that needs to be redisplayed without the deleted file
-     * \param fileWidget the widget that will be deleted in the file view page
+     * Removes a view and stops watching its folder. The view must already
+     * have been removed from `m_cachedViews`.
      */
-    void deleteFile(const std::string& name, Wt::WContainerWidget* fileContainer, FileWidget* fileWidget) const;
+    void removeView(FolderView* view);
 
     /**
-    * Filters files based on a query and displays them in the file container.
+     * Updates the kept views of folders that changed.
+     *
+     * A view whose folder was deleted is removed, and if it was being shown,
+     * the user's root folder is shown instead.
      *
-     * \param fileContainer The container that holds all the FileWidget Elements
-     * \param query The query string to filter files by name
+     * \param folderIds The IDs of the folders that changed.
      */
-    void filterFiles(Wt::WContainerWidget* fileContainer, const std::string& query) const;
+    void updateFolders(const std::vector<long long>& folderIds);
 
     /**
-     * A button that links to the parent folder.
+     * Removes every view, including the current one, so that they are rebuilt
+     * when they are next shown.
      *
-     * This class is an implementation detail of FileViewPage, so that's why
-     * it's a nested class. Coupling is not a concern here.
+     * This is needed when a folder is moved or deleted, since that changes the
+     * path shown by every view inside it.
      */
-    class ParentFolderButton : public Wt::WPushButton {
-    public:
-        /**
-         * Creates a new "Parent Folder" button.
-         *
-         * \param page The FileViewPage that contains this button.
-         */
-        explicit ParentFolderButton(FileViewPage* page);
+    void clearCachedViews();
 
-    protected:
-        /**
-         * Handles a drop event.
-         *
-         * This implementation will handle drop events from FileWidget by moving
-         * the file to the page's parent folder.
-         *
-         * \param dropEvent The event to handle.
-         */
-        void dropEvent(Wt::WDropEvent dropEvent) override;
+    /**
+     * Deletes the current folder and everything inside it, then switches to
+     * the folder that contained it.
+     */
+    void deleteFolder();
 
-    private:
-        FileViewPage* m_page;
-    };
+    /**
+     * Moves the current folder into a different folder.
+     *
+     * \param name       The name of the destination folder.
+     * \param dialogText The text in the move dialog, which is used to show
+     *                   errors.
+     * \return           Whether the folder was moved.
+     */
+    bool moveFolder(const std::string& name, Wt::WText* dialogText);
 };
@@ -1,11 +1,13 @@
 #include "FileWidget.h"
 
+#include <Wt/Dbo/Exception.h>
 #include <Wt/Dbo/Transaction.h>
 #include <Wt/Dbo/ptr.h>
 #include <Wt/WAnchor.h>
 #include <Wt/WDialog.h>
 #include <Wt/WEnvironment.h>
 #include <Wt/WGlobal.h>
+#include <Wt/WImage.h>
 #include <Wt/WLabel.h>
 #include <Wt/WLineEdit.h>
 #include <Wt/WLink.h>
@@ -14,25 +16,29 @@
 #include <Wt/WPushButton.h>
 #include <Wt/WText.h>
 #include <cstddef>
+#include <functional>
 #include <memory>
+#include <stdexcept>
 #include <string>
 #include <utility>
 #include "File.h"
 #include "FileViewPage.h"
 #include "Folder.h"
+#include "PreviewGenerator.h"
+#include "PreviewResource.h"
 #include "SharingLink.h"
 #include "StorageApplication.h"
 #include "User.h"
 
-FileWidget::FileWidget(Wt::Dbo::ptr<User> user, Wt::Dbo::Session& session, const Wt::Dbo::ptr<File>& file, Wt::Dbo::ptr<Folder> parentFolder)
+FileWidget::FileWidget(Wt::Dbo::ptr<User> user, Wt::Dbo::Session& session, const FolderCache::FileEntry& file, Wt::Dbo::ptr<Folder> parentFolder)
     : Wt::WAnchor(Wt::WLink(File::createResource(file)))
     , m_databaseSession(&session)
     , m_user(std::move(user))
-    , m_file(file)
+    , m_file(session.loadLazy<File>(file.id))
     , m_parentFolder(std::move(parentFolder))
 {
     setStyleClass("file-element section-element");
-    setAttributeValue("download", file->getName());
+    setAttributeValue("download", file.name);
 
     auto* dragHandle = addNew<Wt::WText>(u"\u2261"); // Looks like three horizontal lines
     dragHandle->setStyleClass("drag-handle");
@@ -45,9 +51,25 @@ FileWidget::FileWidget(Wt::Dbo::ptr<User> user, Wt::Dbo::Session& session, const
 
     // Allows the user to see the full file name on hover even if it's too long
     // to show on screen normally.
-    setToolTip(m_file->getName());
+    setToolTip(file.name);
+
+    switch (PreviewGenerator::getStatus(m_file.id())) {
+    case PreviewGenerator::Status::Available: {
+        auto* preview = addNew<Wt::WImage>(Wt::WLink(std::make_shared<PreviewResource>(m_file.id())));
+        preview->setStyleClass("file-preview");
+        preview->setAlternateText("");
+        break;
+    }
+    case PreviewGenerator::Status::Missing:
+        // Files uploaded before previews existed, or that didn't fit in the
+        // queue, get their preview once they are seen.
+        PreviewGenerator::instance().enqueue(m_file.id());
+        break;
+    case PreviewGenerator::Status::Unavailable:
+        break;
+    }
 
-    auto* fileName = addNew<Wt::WText>(m_file->getName());
+    auto* fileName = addNew<Wt::WText>(file.name);
     fileName->setStyleClass("file-element");
     // Use the Unicode "Midline Horizontal Ellipsis" character to make the ...
     // vertically centered.
@@ -64,7 +86,6 @@ FileWidget::FileWidget(Wt::Dbo::ptr<User> user, Wt::Dbo::Session& session, const
         renameBox->rejectWhenEscapePressed();
         submit->clicked().connect([this, name, renameBox, fileName, dialogText] {
             renameFile(name->text().toUTF8(), *fileName, *renameBox, dialogText);
-            fileName->setText(m_file->getName());
         });
 
         cancel->clicked().connect(renameBox, &Wt::WDialog::accept);
@@ -74,8 +95,11 @@ FileWidget::FileWidget(Wt::Dbo::ptr<User> user, Wt::Dbo::Session& session, const
         renameBox->show();
     });
 
+    // The move and delete dialogs belong to the root widget, since this widget
+    // is deleted once its file is moved or deleted.
     popUpMenu->addItem("move")->triggered().connect([this] {
-        auto moveBox = std::make_shared<Wt::WDialog>("What folder would you like to move your file to?");
+        auto* root = StorageApplication::instance()->root();
+        auto* moveBox = root->addChild(std::make_unique<Wt::WDialog>("What folder would you like to move your file to?"));
         moveBox->contents()->addNew<Wt::WLabel>("Folder name:");
         auto* name = moveBox->contents()->addNew<Wt::WLineEdit>();
         auto* dialogText = moveBox->contents()->addNew<Wt::WText>("");
@@ -86,25 +110,26 @@ FileWidget::FileWidget(Wt::Dbo::ptr<User> user, Wt::Dbo::Session& session, const
             moveFile(name->text().toUTF8(), *moveBox, dialogText);
         });
 
-        cancel->clicked().connect([moveBox] {
-            moveBox->accept();
+        cancel->clicked().connect(moveBox, &Wt::WDialog::accept);
+        moveBox->finished().connect([root, moveBox] {
+            root->removeChild(moveBox);
         });
-
         moveBox->show();
     });
 
     popUpMenu->addItem("delete")->triggered().connect([this] {
-        auto deleteBox = std::make_shared<Wt::WMessageBox>();
+        auto* root = StorageApplication::instance()->root();
+        auto* deleteBox = root->addChild(std::make_unique<Wt::WMessageBox>());
         deleteBox->setWindowTitle("Are you sure you want to delete this file?");
         deleteBox->setText("This action cannot be undone.");
         deleteBox->setStandardButtons(Wt::StandardButton::Yes | Wt::StandardButton::No);
         deleteBox->rejectWhenEscapePressed();
 
-        deleteBox->buttonClicked().connect([this, deleteBox](Wt::StandardButton button) {
+        deleteBox->buttonClicked().connect([this, root, deleteBox](Wt::StandardButton button) {
             if (button == Wt::StandardButton::Yes) {
                 m_deleteFile.emit();
             }
-            deleteBox->accept();
+            root->removeChild(deleteBox);
         });
 
         deleteBox->show();
@@ -139,22 +164,17 @@ FileWidget::FileWidget(Wt::Dbo::ptr<User> user, Wt::Dbo::Session& session, const
 
 void FileWidget::renameFile(const std::string& name, Wt::WText& fileName, Wt::WDialog& renameBox, Wt::WText* dialogText)
 {
-    const size_t fileExtensionPosition = m_file->getName().find_last_of('.');
-    std::string nameWithExtension;
-    nameWithExtension = fileExtensionPosition != std::string::npos ? name + m_file->getName().substr(fileExtensionPosition) : name;
-    Wt::Dbo::Transaction transaction(*m_databaseSession);
-
-    auto duplicateQuery = m_parentFolder->getFileByName(nameWithExtension);
-
-    if (duplicateQuery) {
-        dialogText->setText("Another file already has this name.");
+    try {
+        changeFile([this, &name] {
+            const size_t fileExtensionPosition = m_file->getName().find_last_of('.');
+            std::string nameWithExtension;
+            nameWithExtension = fileExtensionPosition != std::string::npos ? name + m_file->getName().substr(fileExtensionPosition) : name;
+            File::rename(m_file, nameWithExtension);
+        });
+    } catch (const std::runtime_error& ex) {
+        dialogText->setText(ex.what());
         return;
     }
-    if (fileExtensionPosition != std::string::npos) {
-        m_file.modify()->setName(name + m_file->getName().substr(fileExtensionPosition));
-    } else {
-        m_file.modify()->setName(name);
-    }
     fileName.setText(m_file->getName());
     this->setLink(File::createResource(m_file));
     renameBox.accept();
@@ -162,16 +182,17 @@ void FileWidget::renameFile(const std::string& name, Wt::WText& fileName, Wt::WD
 
 void FileWidget::moveFile(const std::string& name, Wt::WDialog& moveBox, Wt::WText* dialogText)
 {
-    Wt::Dbo::Transaction transaction(*m_databaseSession);
-    auto folderQuery = m_databaseSession->find<Folder>().where("name = ?").bind(name).limit(1);
+    Wt::Dbo::ptr<Folder> foundFolder;
+    {
+        Wt::Dbo::Transaction transaction(*m_databaseSession);
+        foundFolder = m_databaseSession->find<Folder>().where("name = ?").bind(name).limit(1).resultValue();
+    }
 
-    if (folderQuery.resultList().empty()) {
+    if (!foundFolder) {
         dialogText->setText("A folder with that name does not exist.");
         return;
     }
 
-    Wt::Dbo::ptr<Folder> foundFolder = folderQuery.resultValue();
-
     try {
         moveFile(foundFolder);
     } catch (const std::runtime_error& ex) {
@@ -184,15 +205,38 @@ void FileWidget::moveFile(const std::string& name, Wt::WDialog& moveBox, Wt::WTe
 
 void FileWidget::moveFile(Wt::Dbo::ptr<Folder> folder)
 {
-    if (m_file->getParent() == folder) {
-        throw std::runtime_error("The file is already in this folder. Please specify a different folder.");
-    }
+    changeFile([this, &folder] {
+        File::move(m_file, folder);
+    });
+    m_moveFile.emit();
+}
 
-    auto duplicateFile = folder->getFileByName(m_file->getName());
-    if (duplicateFile) {
-        throw std::runtime_error("Another file with this name exists in your destination folder. Please specify a different folder or rename this file.");
+void FileWidget::changeFile(const std::function<void()>& change)
+{
+    for (int attempt = 0;; ++attempt) {
+        Wt::Dbo::Transaction transaction(*m_databaseSession);
+        try {
+            change();
+            // Flushing here means that a stale file is found while the
+            // transaction can still be rolled back.
+            m_databaseSession->flush();
+            transaction.commit();
+            return;
+        } catch (const Wt::Dbo::StaleObjectException&) {
+            transaction.rollback();
+            m_databaseSession->discardUnflushed();
+            if (attempt > 0) {
+                throw std::runtime_error("The file was changed somewhere else. Please try again.");
+            }
+            m_file.reread();
+        } catch (const Wt::Dbo::ObjectNotFoundException&) {
+            transaction.rollback();
+            m_databaseSession->discardUnflushed();
+            throw std::runtime_error("The file no longer exists.");
+        } catch (...) {
+            transaction.rollback();
+            m_databaseSession->discardUnflushed();
+            throw;
+        }
     }
-
-    m_file.modify()->setParent(folder);
-    m_moveFile.emit();
 }
@@ -13,9 +13,11 @@
 #include <Wt/WContainerWidget.h>
 #include <Wt/WGlobal.h>
 #include <Wt/WResource.h>
+#include <functional>
 #include <string>
 #include "File.h"
 #include "Folder.h"
+#include "FolderCache.h"
 #include "User.h"
 
 class FileWidget : public Wt::WAnchor {
@@ -23,12 +25,22 @@ public:
     /**
      * Creates a new `FileWidget`.
      *
+     * The widget is built from the cached listing, and the file itself is
+     * only loaded when it is renamed, moved or deleted.
+     *
      * \param user The logged-in user, who will see all their files and folders
      * \param session The database session to use.
      * \param file the current file of the widget
      * \param parentFolder the folder this file is stored in
      */
-    explicit FileWidget(Wt::Dbo::ptr<User> user, Wt::Dbo::Session& session, const Wt::Dbo::ptr<File>& file, Wt::Dbo::ptr<Folder> parentFolder);
+    explicit FileWidget(Wt::Dbo::ptr<User> user, Wt::Dbo::Session& session, const FolderCache::FileEntry& file, Wt::Dbo::ptr<Folder> parentFolder);
+
+    /**
+     * Gets the file of this `FileWidget`.
+     *
+     * \return The file, which is loaded when it is first used.
+     */
+    const Wt::Dbo::ptr<File>& getFile() const { return m_file; }
 
     /**
      * Getting the signal to delete file: used by the file view page to display deleted files
@@ -47,13 +59,23 @@ public:
     /**
      * Moves the file of this 'FileWidget' to the specified folder.
      *
-     * This requires a Wt::Dbo::Transaction to be currently active.
-     *
      * \param folder The destination folder.
      * \exception std::runtime_error If there was a problem moving the file.
      */
     void moveFile(Wt::Dbo::ptr<Folder> folder);
 
+    /**
+     * Changes the file of this `FileWidget` in a transaction of its own.
+     *
+     * Compacting a segment moves the content of the files in it, which makes
+     * the file that this widget loaded out of date. The file is then reread
+     * and the change is made again.
+     *
+     * \param change Makes the change.
+     * \exception std::runtime_error If there was a problem making the change.
+     */
+    void changeFile(const std::function<void()>& change);
+
 private:
     Wt::Dbo::Session* m_databaseSession;
     Wt::Dbo::ptr<User> m_user;
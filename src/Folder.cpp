@@ -1,7 +1,43 @@
 #include "Folder.h"
 
+#include <Wt/Dbo/Session.h>
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+#include <tuple>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "Change.h"
+#include "FileVersion.h"
+#include "FolderCache.h"
 #include "StorageElement.h"
 
+// Selects the IDs of a folder (bound as the first parameter) and all of the
+// folders inside it, at any depth.
+static const std::string SUBTREE_FOLDER_IDS = "WITH RECURSIVE subtree(id) AS ("
+                                              "SELECT ? UNION ALL "
+                                              "SELECT folders.id FROM folders JOIN subtree ON folders.parent_id = subtree.id"
+                                              ") SELECT id FROM subtree";
+
+// Selects the IDs of a folder (bound as the first parameter) and all of the
+// folders that contain it.
+static const std::string ANCESTOR_FOLDER_IDS = "WITH RECURSIVE ancestors(id, parent_id) AS ("
+                                               "SELECT id, parent_id FROM folders WHERE id = ? UNION ALL "
+                                               "SELECT folders.id, folders.parent_id FROM folders JOIN ancestors ON folders.id = ancestors.parent_id"
+                                               ") SELECT id FROM ancestors";
+
+// Root folders have no parent, which is read as 0 since IDs start at 1.
+static const std::string PATH_QUERY = "SELECT id, name, COALESCE(parent_id, 0) FROM folders WHERE id IN (" + ANCESTOR_FOLDER_IDS + ")";
+static const std::string SUBTREE_FOLDERS_QUERY = "SELECT id FROM folders WHERE id IN (" + SUBTREE_FOLDER_IDS + ")";
+static const std::string COUNT_SUBTREE_FILES_QUERY = "SELECT COUNT(1) FROM files WHERE parent_id IN (" + SUBTREE_FOLDER_IDS + ")";
+static const std::string QUEUE_SUBTREE_BLOBS_STATEMENT = "INSERT INTO blob_deletions (version, path) SELECT 0, CAST(id AS TEXT) FROM files WHERE parent_id IN (" + SUBTREE_FOLDER_IDS + ")";
+static const std::string SUBTREE_FILE_IDS_QUERY = "SELECT id FROM files WHERE parent_id IN (" + SUBTREE_FOLDER_IDS + ")";
+static const std::string DELETE_SUBTREE_SHARING_LINKS_STATEMENT = "DELETE FROM sharing_links WHERE file_id IN (SELECT id FROM files WHERE parent_id IN (" + SUBTREE_FOLDER_IDS + "))";
+static const std::string DELETE_SUBTREE_FILES_STATEMENT = "DELETE FROM files WHERE parent_id IN (" + SUBTREE_FOLDER_IDS + ")";
+static const std::string DELETE_SUBTREE_FOLDERS_STATEMENT = "DELETE FROM folders WHERE id IN (" + SUBTREE_FOLDER_IDS + ")";
+static const std::string IS_IN_SUBTREE_QUERY = "SELECT COUNT(1) FROM folders WHERE id = ? AND id IN (" + SUBTREE_FOLDER_IDS + ")";
+
 Folder::Folder(std::string name, Wt::Dbo::ptr<User> owner, Wt::Dbo::ptr<Folder> parent)
     : StorageElement(std::move(name), std::move(owner), std::move(parent))
 {
@@ -18,3 +54,105 @@ Wt::Dbo::ptr<Folder> Folder::getFolderByName(const std::string& name) const
     auto fileQuery = m_folders.find().where("name = ?").bind(name).limit(1);
     return fileQuery.resultValue();
 }
+
+std::vector<FolderCache::FolderEntry> Folder::getPath(Wt::Dbo::Session& databaseSession, long long folderId)
+{
+    std::unordered_map<long long, std::pair<std::string, long long>> folders;
+    for (const auto& [id, name, parentId] : databaseSession.query<std::tuple<long long, std::string, long long>>(PATH_QUERY).bind(folderId).resultList()) {
+        folders.emplace(id, std::make_pair(name, parentId));
+    }
+
+    std::vector<FolderCache::FolderEntry> path;
+    for (auto folder = folders.find(folderId); folder != folders.end() && path.size() < folders.size(); folder = folders.find(folder->second.second)) {
+        path.push_back(FolderCache::FolderEntry { folder->first, folder->second.first });
+    }
+    std::reverse(path.begin(), path.end());
+    return path;
+}
+
+Wt::Dbo::ptr<Folder> Folder::create(Wt::Dbo::Session& databaseSession, std::string name, const Wt::Dbo::ptr<Folder>& parent)
+{
+    if (name.empty()) {
+        throw std::runtime_error("You must enter a folder name.");
+    }
+    if (parent->getFolderByName(name)) {
+        throw std::runtime_error("There already exists a folder with that name.");
+    }
+
+    FolderCache::invalidate(parent.id());
+    auto folder = databaseSession.addNew<Folder>(std::move(name), parent->getOwner(), parent);
+    databaseSession.flush();
+    Change::record(databaseSession, Change::Kind::Created, folder);
+    return folder;
+}
+
+void Folder::rename(const Wt::Dbo::ptr<Folder>& folder, std::string name)
+{
+    if (!folder->getParent()) {
+        throw std::runtime_error("A root folder cannot be renamed.");
+    }
+    if (name.empty()) {
+        throw std::runtime_error("You must enter a folder name.");
+    }
+    if (name != folder->getName() && folder->getParent()->getFolderByName(name)) {
+        throw std::runtime_error("There already exists a folder with that name.");
+    }
+
+    FolderCache::invalidate(folder->getParent().id());
+    folder.modify()->setName(std::move(name));
+    Change::record(*folder.session(), Change::Kind::Updated, folder);
+}
+
+int Folder::removeRecursive(Wt::Dbo::Session& databaseSession, const Wt::Dbo::ptr<Folder>& folder)
+{
+    if (!folder->getParent()) {
+        throw std::runtime_error("A root folder cannot be deleted.");
+    }
+
+    // Make sure that any pending changes are visible to the statements below.
+    databaseSession.flush();
+
+    const long long folderId = folder.id();
+    int fileCount = databaseSession.query<int>(COUNT_SUBTREE_FILES_QUERY).bind(folderId);
+
+    // Sessions may still be showing folders inside this one.
+    FolderCache::invalidate(folder->getParent().id());
+    for (long long subfolderId : databaseSession.query<long long>(SUBTREE_FOLDERS_QUERY).bind(folderId).resultList()) {
+        FolderCache::invalidate(subfolderId);
+    }
+
+    Change::record(databaseSession, Change::Kind::Deleted, folder);
+    databaseSession.execute(QUEUE_SUBTREE_BLOBS_STATEMENT).bind(folderId).run();
+    FileVersion::removeAll(databaseSession, SUBTREE_FILE_IDS_QUERY, folderId);
+    databaseSession.execute(DELETE_SUBTREE_SHARING_LINKS_STATEMENT).bind(folderId).run();
+    databaseSession.execute(DELETE_SUBTREE_FILES_STATEMENT).bind(folderId).run();
+    databaseSession.execute(DELETE_SUBTREE_FOLDERS_STATEMENT).bind(folderId).run();
+
+    return fileCount;
+}
+
+void Folder::move(Wt::Dbo::Session& databaseSession, const Wt::Dbo::ptr<Folder>& folder, const Wt::Dbo::ptr<Folder>& destination)
+{
+    if (!folder->getParent()) {
+        throw std::runtime_error("A root folder cannot be moved.");
+    }
+    if (folder->getParent() == destination) {
+        throw std::runtime_error("The folder is already in this folder. Please specify a different folder.");
+    }
+
+    int cycleCount = databaseSession.query<int>(IS_IN_SUBTREE_QUERY).bind(destination.id()).bind(folder.id());
+    if (cycleCount > 0) {
+        throw std::runtime_error("A folder cannot be moved into itself. Please specify a different folder.");
+    }
+
+    if (destination->getFolderByName(folder->getName())) {
+        throw std::runtime_error("Another folder with this name exists in your destination folder. Please specify a different folder or rename this folder.");
+    }
+
+    // Everything inside the folder refers to it by ID, so only this one row
+    // and the listings of the two parents need to change.
+    FolderCache::invalidate(folder->getParent().id());
+    FolderCache::invalidate(destination.id());
+    folder.modify()->setParent(destination);
+    Change::record(databaseSession, Change::Kind::Updated, folder);
+}
@@ -13,12 +13,16 @@
 #include <Wt/Dbo/Field.h>
 #include <Wt/Dbo/collection.h>
 #include <string_view>
+#include <vector>
 #include "File.h"
+#include "FolderCache.h"
+#include "SessionMemory.h"
 
 class Folder : public StorageElement {
 private:
     Wt::Dbo::collection<Wt::Dbo::ptr<File>> m_files;
     Wt::Dbo::collection<Wt::Dbo::ptr<Folder>> m_folders;
+    SessionMemory::Tracker<Folder> m_memoryTracker;
 
 public:
     /**
@@ -68,6 +72,74 @@ public:
      */
     Wt::Dbo::ptr<Folder> getFolderByName(const std::string& name) const;
 
+    /**
+     * Gets the folders from a user's root folder down to a folder, using a
+     * single query however deep the folder is.
+     *
+     * This requires a Wt::Dbo::Transaction to be currently active.
+     *
+     * \param databaseSession The database session to use.
+     * \param folderId        The ID of the folder.
+     * \return                The folders, starting with the root folder and
+     *                        ending with the requested one, or nothing if
+     *                        the folder doesn't exist.
+     */
+    static std::vector<FolderCache::FolderEntry> getPath(Wt::Dbo::Session& databaseSession, long long folderId);
+
+    /**
+     * Creates a new folder inside another folder.
+     *
+     * This requires a Wt::Dbo::Transaction to be currently active.
+     *
+     * \param databaseSession The database session to use.
+     * \param name            The name of the new folder.
+     * \param parent          The folder to create the new folder in.
+     * \return                The new folder.
+     * \exception std::runtime_error If the name is empty or already used.
+     */
+    static Wt::Dbo::ptr<Folder> create(Wt::Dbo::Session& databaseSession, std::string name, const Wt::Dbo::ptr<Folder>& parent);
+
+    /**
+     * Renames a folder.
+     *
+     * This requires a Wt::Dbo::Transaction to be currently active.
+     *
+     * \param folder The folder to rename.
+     * \param name   The new name for the folder.
+     * \exception std::runtime_error If the folder is a root folder, or if the
+     *                               name is empty or already used.
+     */
+    static void rename(const Wt::Dbo::ptr<Folder>& folder, std::string name);
+
+    /**
+     * Deletes a folder along with every file and folder inside it.
+     *
+     * The rows are deleted with a fixed number of statements no matter how
+     * large the folder is. The content of the deleted files is queued for the
+     * `BlobGarbageCollector`, which should be notified once the transaction has
+     * been committed.
+     *
+     * This requires a Wt::Dbo::Transaction to be currently active.
+     *
+     * \param databaseSession The database session to use.
+     * \param folder          The folder to delete.
+     * \return                The number of files that were deleted.
+     * \exception std::runtime_error If the folder is a root folder.
+     */
+    static int removeRecursive(Wt::Dbo::Session& databaseSession, const Wt::Dbo::ptr<Folder>& folder);
+
+    /**
+     * Moves a folder, along with everything inside it, to a different folder.
+     *
+     * This requires a Wt::Dbo::Transaction to be currently active.
+     *
+     * \param databaseSession The database session to use.
+     * \param folder          The folder to move.
+     * \param destination     The new containing folder.
+     * \exception std::runtime_error If there was a problem moving the folder.
+     */
+    static void move(Wt::Dbo::Session& databaseSession, const Wt::Dbo::ptr<Folder>& folder, const Wt::Dbo::ptr<Folder>& destination);
+
     /**
      * Persists changes to the database.
      *
@@ -0,0 +1,152 @@
+#include "FolderArchiveResource.h"
+
+#include <Wt/Dbo/Transaction.h>
+#include <Wt/Http/Request.h>
+#include <Wt/Http/Response.h>
+#include <array>
+#include <cstdint>
+#include <iostream>
+#include <istream>
+#include <memory>
+#include <optional>
+#include <string>
+#include <utility>
+#include <vector>
+#include "File.h"
+#include "Folder.h"
+#include "StorageApplication.h"
+#include "User.h"
+
+struct FolderArchiveResource::ArchiveState {
+    struct Entry {
+        std::string path;
+        // Empty for directories.
+        std::optional<long long> fileId;
+        // Where the file's content is stored.
+        long long segmentId { 0 };
+        int64_t segmentOffset { 0 };
+        int64_t fileSize { 0 };
+    };
+
+    explicit ArchiveState(ZipStreamWriter::Method method)
+        : writer(method)
+    {
+    }
+
+    std::vector<Entry> entries;
+    std::size_t nextEntry { 0 };
+    std::unique_ptr<std::istream> currentFile;
+    ZipStreamWriter writer;
+    bool isFinished { false };
+};
+
+/**
+ * Makes a file or folder name safe to use as a single ZIP path component.
+ */
+static std::string sanitizeName(std::string name)
+{
+    for (auto& character : name) {
+        if (character == '/' || character == '\\') {
+            character = '_';
+        }
+    }
+    if (name.empty() || name == "." || name == "..") {
+        name = "_";
+    }
+    return name;
+}
+
+FolderArchiveResource::FolderArchiveResource(long long folderId, const std::string& archiveName, ZipStreamWriter::Method method)
+    : m_folderId(folderId)
+    , m_method(method)
+{
+    suggestFileName(sanitizeName(archiveName) + ".zip");
+}
+
+FolderArchiveResource::~FolderArchiveResource()
+{
+    beingDeleted();
+}
+
+void FolderArchiveResource::handleRequest(const Wt::Http::Request& request, Wt::Http::Response& response)
+{
+    std::shared_ptr<ArchiveState> state;
+    if (auto* continuation = request.continuation()) {
+        state = Wt::cpp17::any_cast<std::shared_ptr<ArchiveState>>(continuation->data());
+    } else {
+        state = std::make_shared<ArchiveState>(m_method);
+        if (!listEntries(*state)) {
+            response.setStatus(404);
+            return;
+        }
+        response.setMimeType("application/zip");
+    }
+
+    std::array<char, 32 * 1024> buffer {};
+    while (!state->isFinished && state->writer.bufferedSize() < CHUNK_SIZE) {
+        if (state->currentFile) {
+            state->currentFile->read(buffer.data(), buffer.size());
+            state->writer.write(buffer.data(), static_cast<std::size_t>(state->currentFile->gcount()));
+            if (!*state->currentFile) {
+                state->currentFile.reset();
+                state->writer.endFile();
+            }
+        } else if (state->nextEntry < state->entries.size()) {
+            const auto& entry = state->entries[state->nextEntry++];
+            if (!entry.fileId) {
+                state->writer.addDirectory(entry.path);
+                continue;
+            }
+
+            state->currentFile = File::openContent(*entry.fileId, entry.segmentId, entry.segmentOffset, entry.fileSize);
+            if (!state->currentFile) {
+                std::cerr << "FolderArchiveResource: Skipping file with missing content: " << *entry.fileId << std::endl;
+                continue;
+            }
+            state->writer.beginFile(entry.path);
+        } else {
+            state->writer.finish();
+            state->isFinished = true;
+        }
+    }
+
+    state->writer.drainTo(response.out());
+    if (!state->isFinished) {
+        // Wt calls handleRequest again once this piece has been sent.
+        auto* continuation = response.createContinuation();
+        continuation->setData(state);
+    }
+}
+
+bool FolderArchiveResource::listEntries(ArchiveState& state) const
+{
+    // Resources are handled outside of the user's session, so they need their
+    // own database session.
+    auto databaseSession = StorageApplication::createDatabaseSession();
+    Wt::Dbo::Transaction transaction(*databaseSession);
+
+    Wt::Dbo::ptr<Folder> rootFolder = databaseSession->find<Folder>().where("id = ?").bind(m_folderId).resultValue();
+    if (!rootFolder) {
+        return false;
+    }
+
+    // Depth-first walk, keeping the folder's path inside the archive next to
+    // each folder that still needs to be visited.
+    std::vector<std::pair<Wt::Dbo::ptr<Folder>, std::string>> pendingFolders;
+    pendingFolders.emplace_back(rootFolder, "");
+    while (!pendingFolders.empty()) {
+        auto [folder, prefix] = std::move(pendingFolders.back());
+        pendingFolders.pop_back();
+
+        for (const auto& file : folder->getFiles()) {
+            state.entries.push_back({ prefix + sanitizeName(file->getName()), file.id(), file->getSegmentId(), file->getSegmentOffset(), file->getFileSize() });
+        }
+        for (const auto& subfolder : folder->getFolders()) {
+            std::string path = prefix + sanitizeName(subfolder->getName()) + "/";
+            state.entries.push_back({ path, std::nullopt, 0, 0, 0 });
+            pendingFolders.emplace_back(subfolder, std::move(path));
+        }
+    }
+
+    return true;
+}
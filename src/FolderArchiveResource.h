@@ -0,0 +1,68 @@
+/**
+ * \class FolderArchiveResource
+ *
+ * A resource that downloads a folder and everything inside it as a ZIP file.
+ *
+ * The archive is streamed to the client in small pieces while the files are
+ * being read, so it is never stored on disk or fully in memory.
+ *
+ * \date 2026-10-19 (last updated)
+ */
+
+#pragma once
+
+#include <Wt/Dbo/ptr.h>
+#include <Wt/Http/Request.h>
+#include <Wt/Http/Response.h>
+#include <Wt/WResource.h>
+#include <memory>
+#include <string>
+#include "Folder.h"
+#include "ZipStreamWriter.h"
+
+class FolderArchiveResource : public Wt::WResource {
+public:
+    /**
+     * Creates a new resource for downloading a folder.
+     *
+     * \param folderId    The ID of the folder to download.
+     * \param archiveName The name to suggest for the archive, without `.zip`.
+     * \param method      The compression method to use for files in the
+     *                    archive.
+     */
+    explicit FolderArchiveResource(long long folderId, const std::string& archiveName, ZipStreamWriter::Method method = ZipStreamWriter::Method::Deflate);
+
+    ~FolderArchiveResource() override;
+
+    /**
+     * Handles a request for the archive.
+     *
+     * This is called by Wt, once for every piece of the archive.
+     *
+     * \param request  The request to handle.
+     * \param response The response to write to.
+     */
+    void handleRequest(const Wt::Http::Request& request, Wt::Http::Response& response) override;
+
+private:
+    /**
+     * The amount of archive data sent in each piece of the response.
+     */
+    constexpr static std::size_t CHUNK_SIZE = 64 * 1024;
+
+    struct ArchiveState;
+
+    long long m_folderId;
+    ZipStreamWriter::Method m_method;
+
+    /**
+     * Lists every file and folder inside the folder being downloaded.
+     *
+     * This only reads metadata from the database. File contents are read
+     * later, one piece at a time.
+     *
+     * \param state The state to add the entries to.
+     * \return      `false` if the folder no longer exists, or `true` otherwise.
+     */
+    bool listEntries(ArchiveState& state) const;
+};
@@ -0,0 +1,137 @@
+#include "FolderCache.h"
+
+#include <Wt/Dbo/Session.h>
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <tuple>
+#include <utility>
+#include <unordered_set>
+#include "Configuration.h"
+#include "Histogram.h"
+#include "Metrics.h"
+
+// Reads the folders and files in a folder (bound as both parameters) together,
+// so that a listing always takes one query.
+static const std::string LISTING_QUERY = "SELECT 0, id, name, 0, '', '' FROM folders WHERE parent_id = ? "
+                                         "UNION ALL SELECT 1, id, name, file_size, extension, mime_type FROM files WHERE parent_id = ? "
+                                         "ORDER BY 1, 2";
+
+thread_local std::unordered_set<long long> FolderCache::t_pendingFolderIds;
+
+FolderCache& FolderCache::instance()
+{
+    static FolderCache cache;
+    return cache;
+}
+
+FolderCache::FolderCache()
+    : m_maxSize(static_cast<std::size_t>(std::max(0LL, Configuration::getInteger("folder-cache-size", 200000))))
+{
+}
+
+std::shared_ptr<const FolderCache::Listing> FolderCache::get(Wt::Dbo::Session& databaseSession, long long folderId)
+{
+    static auto& hits = Metrics::instance().getHistogram("cgs_folder_cache_hit_entries", "Number of files and folders in each folder listing served from the folder cache.", Metrics::Unit::Count);
+    static auto& misses = Metrics::instance().getHistogram("cgs_folder_cache_miss_entries", "Number of files and folders in each folder listing loaded from the database.", Metrics::Unit::Count);
+
+    // A folder that this thread is changing may differ from what everyone
+    // else can see, so it can't come from or go into the cache.
+    if (t_pendingFolderIds.count(folderId) > 0) {
+        return load(databaseSession, folderId);
+    }
+
+    uint64_t version = 0;
+    {
+        std::lock_guard lock(m_mutex);
+        auto entry = m_entries.find(folderId);
+        if (entry != m_entries.end()) {
+            m_lru.splice(m_lru.begin(), m_lru, entry->second.lruPosition);
+            hits.record(entry->second.size - 1);
+            return entry->second.listing;
+        }
+        version = m_versions[getVersionIndex(folderId)];
+    }
+
+    auto listing = load(databaseSession, folderId);
+    std::size_t size = listing->folders.size() + listing->files.size() + 1;
+    misses.record(size - 1);
+
+    std::lock_guard lock(m_mutex);
+    // The folder changed while it was being loaded, so the listing may
+    // already be out of date.
+    if (version != m_versions[getVersionIndex(folderId)] || size > m_maxSize || m_entries.count(folderId) > 0) {
+        return listing;
+    }
+
+    while (m_size + size > m_maxSize) {
+        erase(m_lru.back());
+    }
+    m_lru.push_front(folderId);
+    m_entries.emplace(folderId, Entry { listing, size, m_lru.begin() });
+    m_size += size;
+    return listing;
+}
+
+void FolderCache::invalidate(long long folderId)
+{
+    t_pendingFolderIds.insert(folderId);
+
+    auto& cache = instance();
+    std::lock_guard lock(cache.m_mutex);
+    cache.erase(folderId);
+}
+
+std::unordered_set<long long> FolderCache::endTransaction()
+{
+    if (t_pendingFolderIds.empty()) {
+        return {};
+    }
+
+    // Anything loaded by another thread before the commit has to be dropped
+    // too, which changing the versions again takes care of.
+    auto& cache = instance();
+    {
+        std::lock_guard lock(cache.m_mutex);
+        for (long long folderId : t_pendingFolderIds) {
+            cache.erase(folderId);
+        }
+    }
+    return std::exchange(t_pendingFolderIds, {});
+}
+
+void FolderCache::erase(long long folderId)
+{
+    ++m_versions[getVersionIndex(folderId)];
+
+    auto entry = m_entries.find(folderId);
+    if (entry == m_entries.end()) {
+        return;
+    }
+    m_size -= entry->second.size;
+    m_lru.erase(entry->second.lruPosition);
+    m_entries.erase(entry);
+}
+
+std::size_t FolderCache::getVersionIndex(long long folderId)
+{
+    return static_cast<std::size_t>(static_cast<unsigned long long>(folderId) % VERSION_COUNT);
+}
+
+std::shared_ptr<const FolderCache::Listing> FolderCache::load(Wt::Dbo::Session& databaseSession, long long folderId)
+{
+    auto listing = std::make_shared<Listing>();
+
+    auto rowQuery = databaseSession.query<std::tuple<int, long long, std::string, long long, std::string, std::string>>(LISTING_QUERY).bind(folderId).bind(folderId);
+    for (const auto& [isFile, id, name, fileSize, extension, mimeType] : rowQuery.resultList()) {
+        if (isFile != 0) {
+            listing->files.push_back(FileEntry { id, name, fileSize, extension, mimeType });
+        } else {
+            listing->folders.push_back(FolderEntry { id, name });
+        }
+    }
+
+    return listing;
+}
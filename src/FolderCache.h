@@ -0,0 +1,127 @@
+/**
+ * \class FolderCache
+ *
+ * Remembers what is inside recently viewed folders, shared by every session,
+ * so that pages can list a folder without querying the database.
+ *
+ * Each listing is an immutable snapshot that sessions can keep using while
+ * the folder changes. The model functions that add, rename, move or delete
+ * files and folders invalidate the listings that they change. The cache is
+ * updated again once the transaction has been committed, so a listing that
+ * was read before the commit can't be added back afterwards.
+ *
+ * \date 2026-10-19 (last updated)
+ */
+
+#pragma once
+
+#include <Wt/Dbo/Session.h>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+class FolderCache {
+public:
+    struct FileEntry {
+        long long id;
+        std::string name;
+        int64_t fileSize;
+        std::string extension;
+        std::string mimeType;
+    };
+
+    struct FolderEntry {
+        long long id;
+        std::string name;
+    };
+
+    struct Listing {
+        // Both are in the order that the rows were created.
+        std::vector<FolderEntry> folders;
+        std::vector<FileEntry> files;
+    };
+
+    /**
+     * Gets the folder cache for this server.
+     *
+     * \return The folder cache.
+     */
+    static FolderCache& instance();
+
+    FolderCache(const FolderCache&) = delete;
+    FolderCache& operator=(const FolderCache&) = delete;
+
+    /**
+     * Gets what is inside a folder, loading it from the database if it isn't
+     * cached.
+     *
+     * This requires a Wt::Dbo::Transaction to be currently active.
+     *
+     * \param databaseSession The database session to load the folder with.
+     * \param folderId        The ID of the folder.
+     * \return                The folder's contents.
+     */
+    std::shared_ptr<const Listing> get(Wt::Dbo::Session& databaseSession, long long folderId);
+
+    /**
+     * Forgets what is inside a folder because it is being changed.
+     *
+     * This must be called in the transaction that changes the folder. Until
+     * that transaction ends, the folder is always loaded from the database on
+     * this thread, and is never cached.
+     *
+     * \param folderId The ID of the folder.
+     */
+    static void invalidate(long long folderId);
+
+    /**
+     * Forgets the folders that were invalidated in the transaction that just
+     * ended on this thread.
+     *
+     * This is called by `DatabaseConnection` after every commit and rollback.
+     *
+     * \return The IDs of the folders that were invalidated.
+     */
+    static std::unordered_set<long long> endTransaction();
+
+private:
+    struct Entry {
+        std::shared_ptr<const Listing> listing;
+        std::size_t size;
+        std::list<long long>::iterator lruPosition;
+    };
+
+    // Folders share a version with every folder whose ID has the same
+    // remainder, which keeps the number of versions fixed.
+    constexpr static std::size_t VERSION_COUNT = 1024;
+
+    thread_local static std::unordered_set<long long> t_pendingFolderIds;
+
+    std::mutex m_mutex;
+    std::unordered_map<long long, Entry> m_entries;
+    // Most recently used first.
+    std::list<long long> m_lru;
+    std::array<uint64_t, VERSION_COUNT> m_versions {};
+    std::size_t m_size { 0 };
+    std::size_t m_maxSize;
+
+    FolderCache();
+
+    /**
+     * Removes a folder's listing and changes its version.
+     *
+     * The mutex must be locked.
+     */
+    void erase(long long folderId);
+
+    static std::size_t getVersionIndex(long long folderId);
+
+    static std::shared_ptr<const Listing> load(Wt::Dbo::Session& databaseSession, long long folderId);
+};
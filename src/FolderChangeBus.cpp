@@ -0,0 +1,135 @@
+#include "FolderChangeBus.h"
+
+#include <Wt/WApplication.h>
+#include <Wt/WServer.h>
+#include <mutex>
+#include <string>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+#include "Histogram.h"
+#include "Metrics.h"
+
+FolderChangeBus& FolderChangeBus::instance()
+{
+    static FolderChangeBus bus;
+    return bus;
+}
+
+long long FolderChangeBus::subscribe(Handler handler)
+{
+    auto* application = Wt::WApplication::instance();
+    application->enableUpdates(true);
+
+    std::lock_guard lock(m_mutex);
+    long long subscriberId = m_nextSubscriberId++;
+    auto& subscriber = m_subscribers[subscriberId];
+    subscriber.sessionId = application->sessionId();
+    subscriber.handler = std::move(handler);
+    return subscriberId;
+}
+
+void FolderChangeBus::unsubscribe(long long subscriberId)
+{
+    std::lock_guard lock(m_mutex);
+    auto subscriber = m_subscribers.find(subscriberId);
+    if (subscriber == m_subscribers.end()) {
+        return;
+    }
+
+    for (long long folderId : subscriber->second.watchedFolderIds) {
+        auto watchers = m_watchers.find(folderId);
+        watchers->second.erase(subscriberId);
+        if (watchers->second.empty()) {
+            m_watchers.erase(watchers);
+        }
+    }
+    m_subscribers.erase(subscriber);
+}
+
+void FolderChangeBus::watch(long long subscriberId, long long folderId)
+{
+    std::lock_guard lock(m_mutex);
+    auto subscriber = m_subscribers.find(subscriberId);
+    if (subscriber == m_subscribers.end()) {
+        return;
+    }
+    subscriber->second.watchedFolderIds.insert(folderId);
+    m_watchers[folderId].insert(subscriberId);
+}
+
+void FolderChangeBus::unwatch(long long subscriberId, long long folderId)
+{
+    std::lock_guard lock(m_mutex);
+    auto subscriber = m_subscribers.find(subscriberId);
+    if (subscriber == m_subscribers.end() || subscriber->second.watchedFolderIds.erase(folderId) == 0) {
+        return;
+    }
+    auto watchers = m_watchers.find(folderId);
+    watchers->second.erase(subscriberId);
+    if (watchers->second.empty()) {
+        m_watchers.erase(watchers);
+    }
+}
+
+void FolderChangeBus::publish(const std::unordered_set<long long>& folderIds)
+{
+    // Tools and benchmarks change folders without a server to post to.
+    auto* server = Wt::WServer::instance();
+    if (server == nullptr || folderIds.empty()) {
+        return;
+    }
+
+    std::vector<std::pair<std::string, long long>> updates;
+    {
+        std::lock_guard lock(m_mutex);
+        for (long long folderId : folderIds) {
+            auto watchers = m_watchers.find(folderId);
+            if (watchers == m_watchers.end()) {
+                continue;
+            }
+            for (long long subscriberId : watchers->second) {
+                auto& subscriber = m_subscribers.at(subscriberId);
+                subscriber.changedFolderIds.insert(folderId);
+                // A session that already has an update on the way gets
+                // this change with it.
+                if (!subscriber.isUpdatePosted) {
+                    subscriber.isUpdatePosted = true;
+                    updates.emplace_back(subscriber.sessionId, subscriberId);
+                }
+            }
+        }
+    }
+
+    for (const auto& [sessionId, subscriberId] : updates) {
+        server->post(sessionId, [this, subscriberId = subscriberId] {
+            deliver(subscriberId);
+        });
+    }
+}
+
+void FolderChangeBus::deliver(long long subscriberId)
+{
+    static auto& batchHistogram = Metrics::instance().getHistogram("cgs_folder_change_batch_folders", "Number of changed folders sent to a browser session in each update.", Metrics::Unit::Count);
+
+    std::vector<long long> folderIds;
+    Handler handler;
+    {
+        std::lock_guard lock(m_mutex);
+        auto subscriber = m_subscribers.find(subscriberId);
+        if (subscriber == m_subscribers.end()) {
+            return;
+        }
+        folderIds.assign(subscriber->second.changedFolderIds.begin(), subscriber->second.changedFolderIds.end());
+        subscriber->second.changedFolderIds.clear();
+        subscriber->second.isUpdatePosted = false;
+        handler = subscriber->second.handler;
+    }
+    if (folderIds.empty()) {
+        return;
+    }
+
+    batchHistogram.record(folderIds.size());
+    handler(folderIds);
+    Wt::WApplication::instance()->triggerUpdate();
+}
@@ -0,0 +1,112 @@
+/**
+ * \class FolderChangeBus
+ *
+ * Tells browser sessions when folders that they are showing change, so that
+ * they can update their pages without being refreshed.
+ *
+ * Every committed transaction publishes the folders that it changed, which
+ * are the same ones that it invalidated in `FolderCache`. Each session that
+ * watches one of them is sent an update with `Wt::WServer::post`. Changes
+ * that arrive before the session has handled its update are added to that
+ * update, so a burst of changes only wakes each session once.
+ *
+ * \date 2026-10-19 (last updated)
+ */
+
+#pragma once
+
+#include <functional>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+class FolderChangeBus {
+public:
+    /**
+     * Handles the folders that changed since the handler was last called.
+     */
+    using Handler = std::function<void(const std::vector<long long>& folderIds)>;
+
+    /**
+     * Gets the folder change bus for this server.
+     *
+     * \return The folder change bus.
+     */
+    static FolderChangeBus& instance();
+
+    FolderChangeBus(const FolderChangeBus&) = delete;
+    FolderChangeBus& operator=(const FolderChangeBus&) = delete;
+
+    /**
+     * Adds a subscriber for the current session, and turns on server push for
+     * it.
+     *
+     * This must be called while handling an event of a `Wt::WApplication`.
+     * The handler is always called in that session, which must unsubscribe
+     * before the handler stops being valid.
+     *
+     * \param handler The function to call when watched folders change.
+     * \return        The ID of the subscriber.
+     */
+    long long subscribe(Handler handler);
+
+    /**
+     * Removes a subscriber, along with any update that hasn't been handled.
+     *
+     * \param subscriberId The ID of the subscriber.
+     */
+    void unsubscribe(long long subscriberId);
+
+    /**
+     * Starts telling a subscriber about changes to a folder.
+     *
+     * \param subscriberId The ID of the subscriber.
+     * \param folderId     The ID of the folder.
+     */
+    void watch(long long subscriberId, long long folderId);
+
+    /**
+     * Stops telling a subscriber about changes to a folder.
+     *
+     * \param subscriberId The ID of the subscriber.
+     * \param folderId     The ID of the folder.
+     */
+    void unwatch(long long subscriberId, long long folderId);
+
+    /**
+     * Tells the subscribers that watch any of these folders that they have
+     * changed.
+     *
+     * This is called by `DatabaseConnection` after every commit.
+     *
+     * \param folderIds The IDs of the folders that changed.
+     */
+    void publish(const std::unordered_set<long long>& folderIds);
+
+private:
+    struct Subscriber {
+        std::string sessionId;
+        Handler handler;
+        std::unordered_set<long long> watchedFolderIds;
+        // Changes that haven't been handled yet.
+        std::unordered_set<long long> changedFolderIds;
+        bool isUpdatePosted { false };
+    };
+
+    std::mutex m_mutex;
+    std::unordered_map<long long, Subscriber> m_subscribers;
+    // The subscribers watching each folder.
+    std::unordered_map<long long, std::unordered_set<long long>> m_watchers;
+    long long m_nextSubscriberId { 1 };
+
+    FolderChangeBus() = default;
+
+    /**
+     * Calls a subscriber's handler with the changes that it hasn't handled.
+     *
+     * This runs in the subscriber's session.
+     */
+    void deliver(long long subscriberId);
+};
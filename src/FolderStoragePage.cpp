@@ -10,7 +10,8 @@
 #include <Wt/WText.h>
 #include <fstream>
 #include <optional>
-#include "FileViewPage.h"
+#include <stdexcept>
+#include <string>
 #include "Folder.h"
 #include "StorageApplication.h"
 
@@ -24,7 +25,7 @@ FolderStoragePage::FolderStoragePage(Wt::Dbo::ptr<User> user, Wt::Dbo::Session&
 
     homeButton->clicked().connect([this] {
         auto* application = StorageApplication::instance();
-        application->switchPage(std::make_unique<FileViewPage>(m_loggedInUser, *m_databaseSession, m_parentFolder));
+        application->setInternalPath(StorageApplication::getFolderPath(m_parentFolder.id()), true);
     });
 
     setStyleClass("file-storage-page");
@@ -40,31 +41,13 @@ FolderStoragePage::FolderStoragePage(Wt::Dbo::ptr<User> user, Wt::Dbo::Session&
     uploadButton->clicked().connect([this, folderNameInput] {
         Wt::Dbo::Transaction transaction(*m_databaseSession);
         auto folderNameString = folderNameInput->text().toUTF8();
-        bool isDuplicateName = false;
 
-        for (const auto& folder : m_parentFolder->getFolders()) {
-            if (folder->getName() == folderNameString) {
-                isDuplicateName = true;
-                break;
-            }
-        }
-
-        if (isDuplicateName || folderNameString.empty()) {
+        try {
+            Folder::create(*m_databaseSession, folderNameString, m_parentFolder);
+        } catch (const std::runtime_error& ex) {
             auto* messageBox = addChild(std::make_unique<Wt::WMessageBox>(
                 "Folder cannot be added",
-                isDuplicateName ? "<p>There already exists a folder with that name.</p>" : "<p>You must enter a fileName.</p>"
-                                                                                           "<p>Please try again</p>",
-                Wt::Icon::Information,
-                Wt::StandardButton::Ok));
-            messageBox->setModal(false);
-            messageBox->buttonClicked().connect([this, messageBox] {
-                removeChild(messageBox);
-            });
-            messageBox->show();
-        } else {
-            auto* messageBox = addChild(std::make_unique<Wt::WMessageBox>(
-                "Folder added as: " + folderNameString,
-                "Press home to go back or you can add more folders.",
+                std::string("<p>") + ex.what() + "</p><p>Please try again</p>",
                 Wt::Icon::Information,
                 Wt::StandardButton::Ok));
             messageBox->setModal(false);
@@ -72,9 +55,18 @@ FolderStoragePage::FolderStoragePage(Wt::Dbo::ptr<User> user, Wt::Dbo::Session&
                 removeChild(messageBox);
             });
             messageBox->show();
-
-            m_databaseSession->addNew<Folder>(std::move(folderNameString), m_loggedInUser, m_parentFolder);
-            m_databaseSession->flush();
+            return;
         }
+
+        auto* messageBox = addChild(std::make_unique<Wt::WMessageBox>(
+            "Folder added as: " + folderNameString,
+            "Press home to go back or you can add more folders.",
+            Wt::Icon::Information,
+            Wt::StandardButton::Ok));
+        messageBox->setModal(false);
+        messageBox->buttonClicked().connect([this, messageBox] {
+            removeChild(messageBox);
+        });
+        messageBox->show();
     });
 }
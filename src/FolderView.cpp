@@ -0,0 +1,314 @@
+#include "FolderView.h"
+
+#include <Wt/Dbo/Session.h>
+#include <Wt/Dbo/Transaction.h>
+#include <Wt/Dbo/ptr.h>
+#include <Wt/WPushButton.h>
+#include <Wt/WText.h>
+#include <algorithm>
+#include <cctype>
+#include <cstddef>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <tuple>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+#include "BlobGarbageCollector.h"
+#include "File.h"
+#include "FileViewPage.h"
+#include "FileWidget.h"
+#include "Folder.h"
+#include "FolderCache.h"
+#include "FolderWidget.h"
+#include "StorageApplication.h"
+#include "User.h"
+
+FolderView::FolderView(Wt::Dbo::ptr<User> user, Wt::Dbo::Session& session, std::vector<FolderCache::FolderEntry> path, std::shared_ptr<const FolderCache::Listing> listing)
+    : m_databaseSession(&session)
+    , m_user(std::move(user))
+    , m_folder(session.loadLazy<Folder>(path.back().id))
+    , m_path(std::move(path))
+    , m_listing(std::move(listing))
+{
+    setStyleClass("folder-view");
+
+    std::string folderPath = m_path.front().name;
+    for (std::size_t i = 1; i < m_path.size(); ++i) {
+        folderPath += "/" + m_path[i].name;
+    }
+    if (!isRoot()) {
+        folderPath += "/";
+    }
+
+    auto* currentPathContainer = addNew<Wt::WContainerWidget>();
+    currentPathContainer->setStyleClass("current-path-container");
+
+    auto* parentFolderButton = currentPathContainer->addNew<ParentFolderButton>(this);
+
+    auto* currentPathText = currentPathContainer->addNew<Wt::WText>(folderPath);
+    currentPathText->setStyleClass("current-path");
+
+    long long parentId = isRoot() ? getFolderId() : m_path[m_path.size() - 2].id;
+    parentFolderButton->clicked().connect([parentId] {
+        auto* application = StorageApplication::instance();
+        application->setInternalPath(StorageApplication::getFolderPath(parentId), true);
+    });
+
+    auto* folderText = addNew<Wt::WText>("Folders");
+    folderText->setStyleClass("section-text");
+
+    m_folderContainer = addNew<Wt::WContainerWidget>();
+    m_folderContainer->setStyleClass("section-container");
+    for (const auto& folder : m_listing->folders) {
+        addFolderWidget(folder);
+    }
+
+    auto* fileText = addNew<Wt::WText>("Files");
+    fileText->setStyleClass("section-text");
+    m_fileContainer = addNew<Wt::WContainerWidget>();
+    m_fileContainer->setStyleClass("section-container");
+
+    addFiles(m_listing->files);
+}
+
+void FolderView::update(std::shared_ptr<const FolderCache::Listing> listing)
+{
+    std::unordered_map<long long, const FolderCache::FolderEntry*> oldFolders;
+    for (const auto& folder : m_listing->folders) {
+        oldFolders.emplace(folder.id, &folder);
+    }
+    std::unordered_set<long long> folderIds;
+    for (const auto& folder : listing->folders) {
+        folderIds.insert(folder.id);
+        auto widget = m_folderWidgets.find(folder.id);
+        auto oldFolder = oldFolders.find(folder.id);
+        if (widget == m_folderWidgets.end()) {
+            addFolderWidget(folder);
+        } else if (oldFolder == oldFolders.end() || oldFolder->second->name != folder.name) {
+            int index = m_folderContainer->indexOf(widget->second);
+            m_folderContainer->removeWidget(widget->second);
+            addFolderWidget(folder, index);
+        }
+    }
+    for (auto widget = m_folderWidgets.begin(); widget != m_folderWidgets.end();) {
+        if (folderIds.count(widget->first) == 0) {
+            m_folderContainer->removeWidget(widget->second);
+            widget = m_folderWidgets.erase(widget);
+        } else {
+            ++widget;
+        }
+    }
+
+    std::unordered_map<long long, const FolderCache::FileEntry*> oldFiles;
+    for (const auto& file : m_listing->files) {
+        oldFiles.emplace(file.id, &file);
+    }
+    std::unordered_set<long long> fileIds;
+    for (const auto& file : listing->files) {
+        if (!matchesFilter(file.name)) {
+            continue;
+        }
+        fileIds.insert(file.id);
+        auto widget = m_fileWidgets.find(file.id);
+        auto oldFile = oldFiles.find(file.id);
+        if (widget == m_fileWidgets.end()) {
+            addFileWidget(file);
+        } else if (oldFile == oldFiles.end() || std::tie(oldFile->second->name, oldFile->second->fileSize, oldFile->second->mimeType) != std::tie(file.name, file.fileSize, file.mimeType)) {
+            int index = m_fileContainer->indexOf(widget->second);
+            m_fileContainer->removeWidget(widget->second);
+            addFileWidget(file, index);
+        }
+    }
+    for (auto widget = m_fileWidgets.begin(); widget != m_fileWidgets.end();) {
+        if (fileIds.count(widget->first) == 0) {
+            m_fileContainer->removeWidget(widget->second);
+            widget = m_fileWidgets.erase(widget);
+        } else {
+            ++widget;
+        }
+    }
+
+    m_listing = std::move(listing);
+    updateEmptyText();
+}
+
+std::shared_ptr<const FolderCache::Listing> FolderView::loadListing() const
+{
+    // Wt::Dbo only starts the transaction in the database if the listing
+    // isn't cached.
+    Wt::Dbo::Transaction transaction(*m_databaseSession);
+    return FolderCache::instance().get(*m_databaseSession, getFolderId());
+}
+
+void FolderView::sortFiles(bool (*isLess)(const FolderCache::FileEntry&, const FolderCache::FileEntry&))
+{
+    // Sorting copies the cached listing, since other sessions share it.
+    m_listing = loadListing();
+    std::vector<FolderCache::FileEntry> files;
+    for (const auto& file : m_listing->files) {
+        if (matchesFilter(file.name)) {
+            files.push_back(file);
+        }
+    }
+    if (m_hasSorted) {
+        std::stable_sort(files.begin(), files.end(), isLess);
+    } else {
+        std::stable_sort(files.rbegin(), files.rend(), isLess);
+    }
+    m_hasSorted = !m_hasSorted;
+
+    addFiles(files);
+}
+
+void FolderView::addFiles(const std::vector<FolderCache::FileEntry>& files)
+{
+    m_fileContainer->clear();
+    m_fileWidgets.clear();
+    m_noFilesText = nullptr;
+    for (const auto& file : files) {
+        addFileWidget(file);
+    }
+    updateEmptyText();
+}
+
+void FolderView::addFolderWidget(const FolderCache::FolderEntry& folder, int index)
+{
+    auto folderWidget = std::make_unique<FolderWidget>(*m_databaseSession, folder);
+    folderWidget->clicked().connect([folderId = folder.id] {
+        auto* application = StorageApplication::instance();
+        application->setInternalPath(StorageApplication::getFolderPath(folderId), true);
+    });
+
+    auto* widget = index < 0 ? m_folderContainer->addWidget(std::move(folderWidget)) : m_folderContainer->insertWidget(index, std::move(folderWidget));
+    m_folderWidgets[folder.id] = widget;
+}
+
+void FolderView::addFileWidget(const FolderCache::FileEntry& file, int index)
+{
+    auto fileWidget = std::make_unique<FileWidget>(m_user, *m_databaseSession, file, m_folder);
+    auto* widget = fileWidget.get();
+    fileWidget->deleteFile().connect([this, widget] {
+        deleteFile(widget->getFile(), widget);
+    });
+    fileWidget->moveFile().connect([this, widget] {
+        removeFileWidget(widget);
+    });
+
+    if (index < 0) {
+        m_fileContainer->addWidget(std::move(fileWidget));
+    } else {
+        m_fileContainer->insertWidget(index, std::move(fileWidget));
+    }
+    m_fileWidgets[file.id] = widget;
+}
+
+void FolderView::updateEmptyText()
+{
+    if (m_folderWidgets.empty() && !m_noFoldersText) {
+        m_noFoldersText = m_folderContainer->addNew<Wt::WText>("No Folders");
+    } else if (!m_folderWidgets.empty() && m_noFoldersText) {
+        m_folderContainer->removeWidget(m_noFoldersText);
+        m_noFoldersText = nullptr;
+    }
+
+    if (m_fileWidgets.empty() && !m_noFilesText) {
+        m_noFilesText = m_fileContainer->addNew<Wt::WText>("No Files");
+    } else if (!m_fileWidgets.empty() && m_noFilesText) {
+        m_fileContainer->removeWidget(m_noFilesText);
+        m_noFilesText = nullptr;
+    }
+}
+
+bool FolderView::matchesFilter(const std::string& name) const
+{
+    std::string fileName = name;
+    std::transform(fileName.begin(), fileName.end(), fileName.begin(), ::tolower);
+    std::string lowerQuery = m_filterQuery;
+    std::transform(lowerQuery.begin(), lowerQuery.end(), lowerQuery.begin(), ::tolower);
+
+    return fileName.find(lowerQuery) != std::string::npos;
+}
+
+void FolderView::removeFileWidget(FileWidget* fileWidget)
+{
+    m_fileWidgets.erase(fileWidget->getFile().id());
+    m_fileContainer->removeWidget(fileWidget);
+
+    // The view matches the folder again, so it can still be reused.
+    m_listing = loadListing();
+    updateEmptyText();
+}
+
+void FolderView::deleteFile(const Wt::Dbo::ptr<File>& file, FileWidget* fileWidget)
+{
+    // removing from database
+    try {
+        fileWidget->changeFile([this, &file] {
+            File::remove(*m_databaseSession, file);
+        });
+    } catch (const std::runtime_error& ex) {
+        std::cerr << "FolderView: Failed to delete file: " << ex.what() << std::endl;
+        return;
+    }
+
+    // removing from internal storage happens in the background once the
+    // transaction has been committed
+    BlobGarbageCollector::instance().notify();
+
+    // re-rendering files
+    removeFileWidget(fileWidget);
+}
+
+void FolderView::filterFiles(const std::string& query)
+{
+    m_filterQuery = query;
+    m_listing = loadListing();
+
+    std::vector<FolderCache::FileEntry> filteredFiles;
+    for (const auto& file : m_listing->files) {
+        if (matchesFilter(file.name)) {
+            filteredFiles.push_back(file);
+        }
+    }
+
+    addFiles(filteredFiles);
+}
+
+FolderView::ParentFolderButton::ParentFolderButton(FolderView* view)
+    : Wt::WPushButton("Parent Folder")
+    , m_view(view)
+{
+    addStyleClass("back-button");
+    acceptDrops(std::string(FileViewPage::FILE_MIME_TYPE));
+}
+
+void FolderView::ParentFolderButton::dropEvent(Wt::WDropEvent dropEvent)
+{
+    // FileWidget has a separate drag handle widget that is draggable, so the
+    // drop events come from that.
+    auto* sourceWidget = dynamic_cast<Wt::WWidget*>(dropEvent.source());
+    if (!sourceWidget) {
+        std::cerr << "ParentFolderButton: Received drop that wasn't from a widget of any kind" << std::endl;
+        return;
+    }
+    auto* fileWidget = dynamic_cast<FileWidget*>(sourceWidget->parent());
+    if (!fileWidget) {
+        std::cerr << "ParentFolderButton: Received drop that wasn't from a FileWidget" << std::endl;
+        return;
+    }
+    if (m_view->isRoot()) {
+        std::cerr << "ParentFolderButton: Received drop in the root folder, which has no parent" << std::endl;
+        return;
+    }
+
+    const auto& path = m_view->getPath();
+    try {
+        fileWidget->moveFile(m_view->m_databaseSession->loadLazy<Folder>(path[path.size() - 2].id));
+    } catch (const std::runtime_error& ex) {
+        std::cerr << "ParentFolderButton: Failed to move file: " << ex.what() << std::endl;
+    }
+}
@@ -0,0 +1,210 @@
+/**
+ * \class FolderView
+ *
+ * The contents of one folder in the file view page: the path to the folder,
+ * the folders inside it and its files.
+ *
+ * `FileViewPage` keeps the views of recently visited folders, so a view is
+ * built once from a `FolderCache` listing and shown again until that listing
+ * changes. When another session changes the folder, `update` only changes
+ * the rows that differ.
+ *
+ * \date 2026-10-19 (last updated)
+ */
+
+#pragma once
+
+#include <Wt/WContainerWidget.h>
+#include <Wt/WPushButton.h>
+#include <Wt/WText.h>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "File.h"
+#include "FileWidget.h"
+#include "Folder.h"
+#include "FolderCache.h"
+#include "FolderWidget.h"
+#include "User.h"
+
+class FolderView : public Wt::WContainerWidget {
+public:
+    /**
+     * Creates a new `FolderView`.
+     *
+     * \param user    The logged-in user, who owns the folder.
+     * \param session The database session to use.
+     * \param path    The folders from the user's root folder to this folder,
+     *                as returned by `Folder::getPath`.
+     * \param listing What is inside the folder.
+     */
+    explicit FolderView(Wt::Dbo::ptr<User> user, Wt::Dbo::Session& session, std::vector<FolderCache::FolderEntry> path, std::shared_ptr<const FolderCache::Listing> listing);
+
+    /**
+     * Gets the ID of the folder shown by this view.
+     *
+     * \return The folder's ID.
+     */
+    long long getFolderId() const { return m_path.back().id; }
+
+    /**
+     * Gets the folder shown by this view.
+     *
+     * \return The folder, which is loaded when it is first used.
+     */
+    const Wt::Dbo::ptr<Folder>& getFolder() const { return m_folder; }
+
+    /**
+     * Gets the folders from the user's root folder to this folder.
+     *
+     * \return The path, starting with the root folder.
+     */
+    const std::vector<FolderCache::FolderEntry>& getPath() const { return m_path; }
+
+    /**
+     * Checks if this view shows the user's root folder.
+     *
+     * \return Whether the folder is the root folder.
+     */
+    bool isRoot() const { return m_path.size() == 1; }
+
+    /**
+     * Gets the listing that this view matches.
+     *
+     * If `FolderCache` returns a different listing, the folder has changed
+     * since the view was built.
+     *
+     * \return The listing.
+     */
+    const std::shared_ptr<const FolderCache::Listing>& getListing() const { return m_listing; }
+
+    /**
+     * Changes the view to match a newer listing of the folder.
+     *
+     * Rows for new files and folders are added at the end, rows for removed
+     * ones are removed, and rows that changed are replaced where they are.
+     * Everything else is left alone.
+     *
+     * \param listing The folder's current contents.
+     */
+    void update(std::shared_ptr<const FolderCache::Listing> listing);
+
+    /**
+     * Shows the files sorted in ascending and descending order in turn.
+     *
+     * \param isLess Whether a file comes before another in ascending order
+     */
+    void sortFiles(bool (*isLess)(const FolderCache::FileEntry&, const FolderCache::FileEntry&));
+
+    /**
+     * Filters files based on a query and displays them in the file container.
+     *
+     * \param query The query string to filter files by name
+     */
+    void filterFiles(const std::string& query);
+
+private:
+    Wt::Dbo::Session* m_databaseSession;
+    Wt::Dbo::ptr<User> m_user;
+    Wt::Dbo::ptr<Folder> m_folder;
+    std::vector<FolderCache::FolderEntry> m_path;
+    std::shared_ptr<const FolderCache::Listing> m_listing;
+    Wt::WContainerWidget* m_folderContainer;
+    Wt::WContainerWidget* m_fileContainer;
+    // The rows currently shown, by the ID of their folder or file.
+    std::unordered_map<long long, FolderWidget*> m_folderWidgets;
+    std::unordered_map<long long, FileWidget*> m_fileWidgets;
+    // "No Folders" and "No Files", when they are shown.
+    Wt::WText* m_noFoldersText { nullptr };
+    Wt::WText* m_noFilesText { nullptr };
+    std::string m_filterQuery;
+    bool m_hasSorted { false };
+
+    /**
+     * Gets what is inside the folder now from the `FolderCache`.
+     *
+     * \return The folder's contents.
+     */
+    std::shared_ptr<const FolderCache::Listing> loadListing() const;
+
+    /**
+     * Adds ths files into the file container to be viewed
+     *
+     * \param files The sorted files
+     */
+    void addFiles(const std::vector<FolderCache::FileEntry>& files);
+
+    /**
+     * Adds a row for a folder.
+     *
+     * This doesn't hide "No Folders", which `updateEmptyText` does.
+     *
+     * \param folder The folder.
+     * \param index  Where to insert the row, or -1 to add it at the end.
+     */
+    void addFolderWidget(const FolderCache::FolderEntry& folder, int index = -1);
+
+    /**
+     * Adds a row for a file.
+     *
+     * \param file  The file.
+     * \param index Where to insert the row, or -1 to add it at the end.
+     */
+    void addFileWidget(const FolderCache::FileEntry& file, int index = -1);
+
+    /**
+     * Shows or hides the "No Folders" and "No Files" text, depending on
+     * whether there are any rows.
+     */
+    void updateEmptyText();
+
+    /**
+     * Checks if a file's name contains the current search query.
+     */
+    bool matchesFilter(const std::string& name) const;
+
+    /**
+     * Removes a file's widget after the file was moved or deleted.
+     *
+     * \param fileWidget The widget to remove.
+     */
+    void removeFileWidget(FileWidget* fileWidget);
+
+    /**
+     * Deletes a file from the database
+     * \param file the file to be deleted
+     * \param fileWidget the widget that will be deleted in the file view page
+     */
+    void deleteFile(const Wt::Dbo::ptr<File>& file, FileWidget* fileWidget);
+
+    /**
+     * A button that links to the parent folder.
+     *
+     * This class is an implementation detail of FolderView, so that's why
+     * it's a nested class. Coupling is not a concern here.
+     */
+    class ParentFolderButton : public Wt::WPushButton {
+    public:
+        /**
+         * Creates a new "Parent Folder" button.
+         *
+         * \param view The FolderView that contains this button.
+         */
+        explicit ParentFolderButton(FolderView* view);
+
+    protected:
+        /**
+         * Handles a drop event.
+         *
+         * This implementation will handle drop events from FileWidget by moving
+         * the file to the view's parent folder.
+         *
+         * \param dropEvent The event to handle.
+         */
+        void dropEvent(Wt::WDropEvent dropEvent) override;
+
+    private:
+        FolderView* m_view;
+    };
+};
@@ -1,16 +1,15 @@
 #include "FolderWidget.h"
 
-#include <Wt/Dbo/Transaction.h>
 #include <Wt/WEvent.h>
 #include <stdexcept>
 #include "FileViewPage.h"
 #include "FileWidget.h"
 #include "StorageApplication.h"
 
-FolderWidget::FolderWidget(Wt::Dbo::Session& session, Wt::Dbo::ptr<Folder> folder)
-    : Wt::WText(folder->getName())
+FolderWidget::FolderWidget(Wt::Dbo::Session& session, const FolderCache::FolderEntry& folder)
+    : Wt::WText(folder.name)
     , m_databaseSession(&session)
-    , m_folder(std::move(folder))
+    , m_folder(session.loadLazy<Folder>(folder.id))
 {
     setStyleClass("section-element file-element");
     acceptDrops(std::string(FileViewPage::FILE_MIME_TYPE));
@@ -31,12 +30,9 @@ void FolderWidget::dropEvent(Wt::WDropEvent dropEvent)
         return;
     }
 
-    Wt::Dbo::Transaction transaction(*m_databaseSession);
     try {
         fileWidget->moveFile(m_folder);
     } catch (const std::runtime_error& ex) {
         std::cerr << "FolderWidget: Failed to move file: " << ex.what() << std::endl;
-        transaction.rollback();
-        return;
     }
 }
@@ -12,6 +12,7 @@
 #include <Wt/WEvent.h>
 #include <Wt/WText.h>
 #include "Folder.h"
+#include "FolderCache.h"
 #include "User.h"
 
 class FolderWidget : public Wt::WText {
@@ -20,9 +21,10 @@ public:
      * Creates a new `FolderWidget`.
      *
      * \param session The database session to use when moving files to this folder.
-     * \param folder  The folder that this widget represents.
+     * \param folder  The folder that this widget represents, from a cached
+     *                listing.
      */
-    explicit FolderWidget(Wt::Dbo::Session& session, Wt::Dbo::ptr<Folder> folder);
+    explicit FolderWidget(Wt::Dbo::Session& session, const FolderCache::FolderEntry& folder);
 
 protected:
     /**
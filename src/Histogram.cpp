@@ -0,0 +1,88 @@
+#include "Histogram.h"
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cmath>
+#include <cstdint>
+
+constexpr uint64_t SUB_BUCKET_COUNT = uint64_t { 1 } << Histogram::SUB_BUCKET_BITS;
+constexpr uint64_t MAX_VALUE = (uint64_t { 1 } << Histogram::MAX_VALUE_BITS) - 1;
+
+/**
+ * Picks the shard for the calling thread.
+ *
+ * Threads are given shards in turn as they first record something, which
+ * spreads them out more evenly than hashing their IDs.
+ */
+static std::size_t getShardIndex(std::size_t shardCount)
+{
+    static std::atomic<std::size_t> nextShard { 0 };
+    thread_local const std::size_t shard = nextShard.fetch_add(1, std::memory_order_relaxed);
+    return shard % shardCount;
+}
+
+void Histogram::record(uint64_t value)
+{
+    auto& shard = m_shards[getShardIndex(SHARD_COUNT)];
+    shard.bucketCounts[getBucketIndex(value)].fetch_add(1, std::memory_order_relaxed);
+    shard.sum.fetch_add(value, std::memory_order_relaxed);
+}
+
+Histogram::Snapshot Histogram::getSnapshot() const
+{
+    Snapshot snapshot;
+    snapshot.bucketCounts.resize(BUCKET_COUNT);
+    for (const auto& shard : m_shards) {
+        for (std::size_t i = 0; i < BUCKET_COUNT; ++i) {
+            uint64_t bucketCount = shard.bucketCounts[i].load(std::memory_order_relaxed);
+            snapshot.bucketCounts[i] += bucketCount;
+            snapshot.count += bucketCount;
+        }
+        snapshot.sum += shard.sum.load(std::memory_order_relaxed);
+    }
+    return snapshot;
+}
+
+std::size_t Histogram::getBucketIndex(uint64_t value)
+{
+    value = std::min(value, MAX_VALUE);
+    if (value < SUB_BUCKET_COUNT) {
+        return static_cast<std::size_t>(value);
+    }
+
+    // Keep the top SUB_BUCKET_BITS + 1 bits of the value. The highest of
+    // those is always set, so the rest pick the bucket within the power of
+    // two.
+    const int shift = static_cast<int>(std::bit_width(value)) - SUB_BUCKET_BITS - 1;
+    const uint64_t topBits = value >> shift;
+    return static_cast<std::size_t>((static_cast<uint64_t>(shift + 1) << SUB_BUCKET_BITS) + (topBits - SUB_BUCKET_COUNT));
+}
+
+uint64_t Histogram::getBucketUpperBound(std::size_t index)
+{
+    if (index < SUB_BUCKET_COUNT) {
+        return index;
+    }
+
+    const int shift = static_cast<int>(index >> SUB_BUCKET_BITS) - 1;
+    const uint64_t topBits = SUB_BUCKET_COUNT + (index & (SUB_BUCKET_COUNT - 1));
+    return ((topBits + 1) << shift) - 1;
+}
+
+uint64_t Histogram::Snapshot::getPercentile(double percentile) const
+{
+    if (count == 0) {
+        return 0;
+    }
+
+    const auto target = std::max<uint64_t>(1, static_cast<uint64_t>(std::ceil(static_cast<double>(count) * percentile / 100.0)));
+    uint64_t seen = 0;
+    for (std::size_t i = 0; i < bucketCounts.size(); ++i) {
+        seen += bucketCounts[i];
+        if (seen >= target) {
+            return getBucketUpperBound(i);
+        }
+    }
+    return getBucketUpperBound(bucketCounts.size() - 1);
+}
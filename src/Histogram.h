@@ -0,0 +1,107 @@
+/**
+ * \class Histogram
+ *
+ * A thread-safe histogram of non-negative integer values, such as durations
+ * in microseconds or sizes in bytes.
+ *
+ * Buckets are log-linear like an HDR histogram: each power of two is split
+ * into 16 equal buckets, so any recorded value is known to within about 6%
+ * while covering values from 1 up to 2^40 with a fixed, small amount of
+ * memory.
+ *
+ * Recording only does two relaxed atomic additions on a shard picked
+ * by the calling thread, so threads almost never write to the same cache
+ * line.
+ *
+ * \date 2026-10-19 (last updated)
+ */
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+class Histogram {
+public:
+    /**
+     * A point-in-time copy of a histogram's data.
+     */
+    struct Snapshot {
+        std::vector<uint64_t> bucketCounts;
+        uint64_t count { 0 };
+        uint64_t sum { 0 };
+
+        /**
+         * Estimates a percentile of the recorded values.
+         *
+         * \param percentile The percentile to find, from 0 to 100.
+         * \return           The upper bound of the bucket that contains the
+         *                   percentile, or 0 if nothing was recorded.
+         */
+        uint64_t getPercentile(double percentile) const;
+    };
+
+    /**
+     * The number of buckets that each power of two is split into, as a power
+     * of two.
+     */
+    constexpr static int SUB_BUCKET_BITS = 4;
+
+    /**
+     * Values are clamped to below `2^MAX_VALUE_BITS`.
+     */
+    constexpr static int MAX_VALUE_BITS = 40;
+
+    /**
+     * The total number of buckets.
+     */
+    constexpr static std::size_t BUCKET_COUNT = (MAX_VALUE_BITS - SUB_BUCKET_BITS + 1) << SUB_BUCKET_BITS;
+
+    Histogram() = default;
+
+    Histogram(const Histogram&) = delete;
+    Histogram& operator=(const Histogram&) = delete;
+
+    /**
+     * Records a value.
+     *
+     * \param value The value to record.
+     */
+    void record(uint64_t value);
+
+    /**
+     * Copies the current data out of the histogram.
+     *
+     * \return The snapshot.
+     */
+    Snapshot getSnapshot() const;
+
+    /**
+     * Finds the bucket that a value is counted in.
+     *
+     * \param value The value.
+     * \return      The bucket index, less than `BUCKET_COUNT`.
+     */
+    static std::size_t getBucketIndex(uint64_t value);
+
+    /**
+     * Gets the largest value that is counted in a bucket.
+     *
+     * \param index The bucket index.
+     * \return      The upper bound of the bucket, inclusive.
+     */
+    static uint64_t getBucketUpperBound(std::size_t index);
+
+private:
+    constexpr static std::size_t SHARD_COUNT = 8;
+
+    struct alignas(64) Shard {
+        std::array<std::atomic<uint64_t>, BUCKET_COUNT> bucketCounts {};
+        std::atomic<uint64_t> sum { 0 };
+    };
+
+    std::array<Shard, SHARD_COUNT> m_shards;
+};
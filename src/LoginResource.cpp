@@ -0,0 +1,256 @@
+#include "LoginResource.h"
+
+#include <Wt/Dbo/FixedSqlConnectionPool.h>
+#include <Wt/Dbo/Session.h>
+#include <Wt/Dbo/Transaction.h>
+#include <Wt/Http/Request.h>
+#include <Wt/Http/Response.h>
+#include <Wt/WRandom.h>
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <exception>
+#include <iostream>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include "Configuration.h"
+#include "DatabaseConnection.h"
+#include "Executor.h"
+#include "StorageApplication.h"
+#include "User.h"
+
+// Long enough for the browser to follow the redirect to the application.
+constexpr std::chrono::seconds TICKET_LIFETIME { 60 };
+
+constexpr int TICKET_LENGTH = 32;
+
+namespace {
+
+struct Ticket {
+    long long userId;
+    std::chrono::steady_clock::time_point expiry;
+};
+
+struct TicketStore {
+    std::mutex mutex;
+    std::unordered_map<std::string, Ticket> tickets;
+};
+
+}
+
+static std::string escapeHtml(const std::string& text)
+{
+    std::string escaped;
+    for (char character : text) {
+        switch (character) {
+        case '&':
+            escaped += "&amp;";
+            break;
+        case '<':
+            escaped += "&lt;";
+            break;
+        case '>':
+            escaped += "&gt;";
+            break;
+        case '"':
+            escaped += "&quot;";
+            break;
+        default:
+            escaped += character;
+            break;
+        }
+    }
+    return escaped;
+}
+
+static TicketStore& getTicketStore()
+{
+    static TicketStore store;
+    return store;
+}
+
+LoginResource::LoginResource()
+{
+    int connectionCount = static_cast<int>(std::max(1LL, Configuration::getInteger("login-connections", 2)));
+    auto connection = std::make_unique<DatabaseConnection>(std::string(StorageApplication::DATABASE_PATH));
+    m_connectionPool = std::make_unique<Wt::Dbo::FixedSqlConnectionPool>(std::move(connection), connectionCount);
+}
+
+LoginResource::~LoginResource()
+{
+    beingDeleted();
+}
+
+void LoginResource::handleRequest(const Wt::Http::Request& request, Wt::Http::Response& response)
+{
+    bool isCreatingAccount = request.getParameter("create") != nullptr;
+    if (request.method() != "POST") {
+        sendPage(response, isCreatingAccount, "", "", 200);
+        return;
+    }
+
+    if (!isSameOrigin(request)) {
+        sendPage(response, isCreatingAccount, "", "The form was sent from another site. Please try again.", 403);
+        return;
+    }
+
+    const std::string* username = request.getParameter("username");
+    const std::string* password = request.getParameter("password");
+    if (username == nullptr || password == nullptr || username->empty()) {
+        sendPage(response, isCreatingAccount, username != nullptr ? *username : "", "You must enter a username", 400);
+        return;
+    }
+
+    std::string message;
+    std::optional<long long> userId;
+    try {
+        // bcrypt keeps a core busy, so logins take turns on the CPU pool
+        // rather than all hashing at once.
+        userId = Executor::instance().run(Executor::Pool::Cpu, [&] {
+            return authenticate(*username, *password, isCreatingAccount, message);
+        });
+    } catch (const std::exception& ex) {
+        std::cerr << "LoginResource: Failed to log in: " << ex.what() << std::endl;
+        sendPage(response, isCreatingAccount, *username, "Something went wrong. Please try again.", 500);
+        return;
+    }
+    if (!userId) {
+        sendPage(response, isCreatingAccount, *username, message, isCreatingAccount ? 400 : 401);
+        return;
+    }
+
+    // The ticket is only sent to the application, and can't be read by
+    // scripts on the page.
+    std::string cookie = std::string(TICKET_COOKIE) + "=" + issueTicket(*userId)
+        + "; Path=" + std::string(APPLICATION_PATH)
+        + "; Max-Age=" + std::to_string(TICKET_LIFETIME.count())
+        + "; HttpOnly; SameSite=Lax";
+    if (request.urlScheme() == "https") {
+        cookie += "; Secure";
+    }
+    response.addHeader("Set-Cookie", cookie);
+    response.addHeader("Location", std::string(APPLICATION_PATH));
+    response.setStatus(303);
+}
+
+std::optional<long long> LoginResource::authenticate(const std::string& username, const std::string& password, bool isCreatingAccount, std::string& message)
+{
+    Wt::Dbo::Session databaseSession;
+    databaseSession.setConnectionPool(*m_connectionPool);
+    StorageApplication::mapClasses(databaseSession);
+
+    Wt::Dbo::Transaction transaction(databaseSession);
+    Wt::Dbo::ptr<User> user;
+    if (isCreatingAccount) {
+        if (password.empty()) {
+            message = "You must enter a password";
+            return std::nullopt;
+        }
+        try {
+            user = User::create(databaseSession, username, password);
+        } catch (const std::runtime_error& ex) {
+            message = ex.what();
+            transaction.rollback();
+            return std::nullopt;
+        }
+    } else {
+        user = User::findByUsername(databaseSession, username);
+        if (!user || !user->isPasswordCorrect(password)) {
+            message = "Invalid Credentials";
+            return std::nullopt;
+        }
+    }
+
+    // A new user only gets an ID once it has been saved.
+    transaction.commit();
+    return user.id();
+}
+
+bool LoginResource::isSameOrigin(const Wt::Http::Request& request)
+{
+    const std::string& fetchSite = request.headerValue("Sec-Fetch-Site");
+    if (!fetchSite.empty()) {
+        return fetchSite == "same-origin";
+    }
+
+    // Only the host is compared, since a proxy in front of the server may
+    // change the scheme.
+    const std::string& origin = request.headerValue("Origin");
+    if (origin.empty()) {
+        return true;
+    }
+    std::size_t hostStart = origin.find("://");
+    return hostStart != std::string::npos && origin.compare(hostStart + 3, std::string::npos, request.headerValue("Host")) == 0;
+}
+
+std::string LoginResource::issueTicket(long long userId)
+{
+    std::string ticket = Wt::WRandom::generateId(TICKET_LENGTH);
+    auto now = std::chrono::steady_clock::now();
+
+    auto& store = getTicketStore();
+    std::lock_guard lock(store.mutex);
+    // Tickets that were never redeemed are dropped here, so they can't build
+    // up.
+    for (auto entry = store.tickets.begin(); entry != store.tickets.end();) {
+        entry = entry->second.expiry <= now ? store.tickets.erase(entry) : std::next(entry);
+    }
+    store.tickets.emplace(ticket, Ticket { userId, now + TICKET_LIFETIME });
+    return ticket;
+}
+
+std::optional<long long> LoginResource::redeemTicket(const std::string& ticket)
+{
+    auto& store = getTicketStore();
+    std::lock_guard lock(store.mutex);
+    auto entry = store.tickets.find(ticket);
+    if (entry == store.tickets.end()) {
+        return std::nullopt;
+    }
+
+    Ticket redeemed = entry->second;
+    store.tickets.erase(entry);
+    if (redeemed.expiry <= std::chrono::steady_clock::now()) {
+        return std::nullopt;
+    }
+    return redeemed.userId;
+}
+
+void LoginResource::sendPage(Wt::Http::Response& response, bool isCreatingAccount, const std::string& username, const std::string& message, int status)
+{
+    // The same layout and style classes as the application's pages.
+    const std::string title = isCreatingAccount ? "Create Account" : "Log In";
+    const std::string formAction = std::string(LOGIN_PATH) + (isCreatingAccount ? "?create" : "");
+
+    response.setStatus(status);
+    response.setMimeType("text/html; charset=utf-8");
+    response.addHeader("Cache-Control", "no-store");
+
+    auto& out = response.out();
+    out << "<!DOCTYPE html>\n"
+        << "<html lang=\"en\"><head><meta charset=\"utf-8\">"
+        << "<meta name=\"viewport\" content=\"width=device-width, initial-scale=1\">"
+        << "<title>Cloud Goose Storage</title>"
+        << "<link rel=\"stylesheet\" href=\"/cloud-goose-storage.css\">"
+        << "</head><body class=\"root\">"
+        << "<form class=\"login-page\" method=\"post\" action=\"" << formAction << "\">"
+        << "<img class=\"logo\" src=\"/CloudGooseStorageLogo.png\" alt=\"Cloud Goose Storage\">"
+        << "<span class=\"header\">" << title << "</span>"
+        << "<label for=\"username\">Username</label>"
+        << "<input type=\"text\" id=\"username\" name=\"username\" value=\"" << escapeHtml(username) << "\" required>"
+        << "<label for=\"password\">Password</label>"
+        << "<input type=\"password\" id=\"password\" name=\"password\"" << (isCreatingAccount ? " required" : "") << ">"
+        << "<button type=\"submit\">" << title << "</button>"
+        << "<span>" << escapeHtml(message) << "</span>";
+    if (isCreatingAccount) {
+        out << "<a href=\"" << LOGIN_PATH << "\">Already have an account?</a>";
+    } else {
+        out << "<a href=\"" << LOGIN_PATH << "?create\">Don't have an account?</a>";
+    }
+    out << "</form></body></html>\n";
+}
@@ -0,0 +1,115 @@
+/**
+ * \class LoginResource
+ *
+ * The login and create account pages, served without a `StorageApplication`.
+ *
+ * Visitors who haven't logged in only ever reach this resource, which builds
+ * the page as plain HTML and checks the password with a database connection
+ * from a small shared pool. Once someone logs in or creates an account, they
+ * get a short-lived ticket in a cookie and are sent to the application at
+ * `APPLICATION_PATH`, which redeems the ticket. Only then are a Wt session and
+ * its database session created.
+ *
+ *  - `GET /login` shows the login page, and `GET /login?create` shows the
+ *    create account page.
+ *  - `POST /login` with `username` and `password` parameters logs in, or
+ *    creates an account if there is also a `create` parameter. Forms sent
+ *    from other sites are refused, so that nobody can be logged in to
+ *    someone else's account without knowing it.
+ *
+ * \date 2026-10-19 (last updated)
+ */
+
+#pragma once
+
+#include <Wt/Dbo/SqlConnectionPool.h>
+#include <Wt/Http/Request.h>
+#include <Wt/Http/Response.h>
+#include <Wt/WResource.h>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+
+class LoginResource : public Wt::WResource {
+public:
+    /**
+     * The path that the application is deployed at.
+     */
+    constexpr static std::string_view APPLICATION_PATH = "/app";
+
+    /**
+     * The path that this resource is deployed at.
+     */
+    constexpr static std::string_view LOGIN_PATH = "/login";
+
+    /**
+     * The cookie that holds the ticket for the application.
+     */
+    constexpr static std::string_view TICKET_COOKIE = "cgs-login-ticket";
+
+    /**
+     * Creates the login resource and its database connection pool.
+     *
+     * The size of the pool is read from the `login-connections` property.
+     */
+    LoginResource();
+
+    ~LoginResource() override;
+
+    /**
+     * Handles a request for the login page.
+     *
+     * This is called by Wt, possibly from several threads at once.
+     *
+     * \param request  The request to handle.
+     * \param response The response to write to.
+     */
+    void handleRequest(const Wt::Http::Request& request, Wt::Http::Response& response) override;
+
+    /**
+     * Uses up a ticket that was given out when someone logged in.
+     *
+     * Each ticket can only be redeemed once, and only shortly after it was
+     * given out.
+     *
+     * \param ticket The ticket from the `TICKET_COOKIE` cookie.
+     * \return       The ID of the user who logged in, or `std::nullopt` if the
+     *               ticket isn't valid.
+     */
+    static std::optional<long long> redeemTicket(const std::string& ticket);
+
+private:
+    std::unique_ptr<Wt::Dbo::SqlConnectionPool> m_connectionPool;
+
+    /**
+     * Checks the submitted username and password, creating the account first
+     * if requested.
+     *
+     * \return The ID of the user, or `std::nullopt` if `message` was set to
+     *         why the user couldn't log in.
+     */
+    std::optional<long long> authenticate(const std::string& username, const std::string& password, bool isCreatingAccount, std::string& message);
+
+    /**
+     * Checks that a form was sent from a page of this site, using the
+     * `Sec-Fetch-Site` or `Origin` header that browsers add to it.
+     *
+     * Requests with neither header can't come from another site's page, so
+     * they are accepted.
+     */
+    static bool isSameOrigin(const Wt::Http::Request& request);
+
+    /**
+     * Gives out a new ticket for a user who just logged in.
+     */
+    static std::string issueTicket(long long userId);
+
+    /**
+     * Sends the login or create account page.
+     *
+     * \param username The username to fill in.
+     * \param message  An error to show, or an empty string.
+     */
+    static void sendPage(Wt::Http::Response& response, bool isCreatingAccount, const std::string& username, const std::string& message, int status);
+};
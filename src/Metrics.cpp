@@ -0,0 +1,92 @@
+#include "Metrics.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include "Histogram.h"
+
+// Reference: https://prometheus.io/docs/instrumenting/exposition_formats/
+
+/**
+ * Writes a value in the unit that Prometheus expects.
+ */
+static void writeValue(std::ostream& output, uint64_t value, Metrics::Unit unit)
+{
+    if (unit == Metrics::Unit::Microseconds) {
+        // Written by hand to avoid the rounding and exponents of floating
+        // point output.
+        std::string fraction = std::to_string(value % 1000000);
+        output << value / 1000000 << '.' << std::string(6 - fraction.size(), '0') << fraction;
+    } else {
+        output << value;
+    }
+}
+
+Metrics::ScopedTimer::ScopedTimer(Histogram& histogram)
+    : m_histogram(histogram)
+    , m_start(std::chrono::steady_clock::now())
+{
+}
+
+Metrics::ScopedTimer::~ScopedTimer()
+{
+    m_histogram.record(getMicrosecondsSince(m_start));
+}
+
+Metrics& Metrics::instance()
+{
+    static Metrics metrics;
+    return metrics;
+}
+
+Histogram& Metrics::getHistogram(const std::string& name, const std::string& help, Unit unit)
+{
+    std::lock_guard lock(m_mutex);
+    auto& entry = m_histograms[name];
+    if (!entry.histogram) {
+        entry.help = help;
+        entry.unit = unit;
+        entry.histogram = std::make_unique<Histogram>();
+    }
+    return *entry.histogram;
+}
+
+void Metrics::write(std::ostream& output) const
+{
+    std::lock_guard lock(m_mutex);
+    for (const auto& [name, entry] : m_histograms) {
+        auto snapshot = entry.histogram->getSnapshot();
+        output << "# HELP " << name << ' ' << entry.help << '\n';
+        output << "# TYPE " << name << " histogram\n";
+
+        // Prometheus only needs a handful of buckets, so the fine buckets are
+        // added up into one for each power of two. Bucket bounds are
+        // inclusive, so they are one less than the power of two.
+        uint64_t cumulativeCount = 0;
+        for (std::size_t i = 0; i < snapshot.bucketCounts.size(); ++i) {
+            cumulativeCount += snapshot.bucketCounts[i];
+            uint64_t upperBound = Histogram::getBucketUpperBound(i);
+            bool isPowerOfTwoBoundary = ((upperBound + 1) & upperBound) == 0;
+            if (isPowerOfTwoBoundary && i + 1 < snapshot.bucketCounts.size()) {
+                output << name << "_bucket{le=\"";
+                writeValue(output, upperBound, entry.unit);
+                output << "\"} " << cumulativeCount << '\n';
+            }
+        }
+        output << name << "_bucket{le=\"+Inf\"} " << snapshot.count << '\n';
+        output << name << "_sum ";
+        writeValue(output, snapshot.sum, entry.unit);
+        output << '\n';
+        output << name << "_count " << snapshot.count << '\n';
+    }
+}
+
+uint64_t Metrics::getMicrosecondsSince(std::chrono::steady_clock::time_point start)
+{
+    auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start);
+    return static_cast<uint64_t>(std::max<std::chrono::microseconds::rep>(0, elapsed.count()));
+}
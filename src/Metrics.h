@@ -0,0 +1,103 @@
+/**
+ * \class Metrics
+ *
+ * Keeps the histograms that measure how the server is performing, and writes
+ * them out in the Prometheus text format.
+ *
+ * Histograms are registered by name the first time they are used and live for
+ * as long as the program, so callers can keep references to them. Looking up
+ * a histogram takes a lock, so code that records often should look it up once
+ * and keep it in a static variable:
+ *
+ *     static auto& histogram = Metrics::instance().getHistogram("name", "Help text.", Metrics::Unit::Bytes);
+ *     histogram.record(size);
+ *
+ * \date 2026-10-19 (last updated)
+ */
+
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include "Histogram.h"
+
+class Metrics {
+public:
+    /**
+     * The unit of the values in a histogram.
+     */
+    enum class Unit {
+        Count,
+        Bytes,
+        // Written out in seconds, which is what Prometheus expects.
+        Microseconds,
+    };
+
+    /**
+     * Records the time from its creation to its destruction in a histogram, in
+     * microseconds.
+     */
+    class ScopedTimer {
+    public:
+        explicit ScopedTimer(Histogram& histogram);
+        ~ScopedTimer();
+
+        ScopedTimer(const ScopedTimer&) = delete;
+        ScopedTimer& operator=(const ScopedTimer&) = delete;
+
+    private:
+        Histogram& m_histogram;
+        std::chrono::steady_clock::time_point m_start;
+    };
+
+    /**
+     * Gets the metrics for the whole program.
+     *
+     * \return The metrics.
+     */
+    static Metrics& instance();
+
+    /**
+     * Gets a histogram, registering it if it doesn't exist yet.
+     *
+     * \param name The name of the histogram, like `cgs_upload_bytes`. Names of
+     *             histograms measured in microseconds should end in
+     *             `_seconds`, since that is how they are written out.
+     * \param help A description of what is measured.
+     * \param unit The unit of the recorded values.
+     * \return     The histogram, which is never destroyed.
+     */
+    Histogram& getHistogram(const std::string& name, const std::string& help, Unit unit);
+
+    /**
+     * Writes all the histograms in the Prometheus text format.
+     *
+     * \param output The stream to write to.
+     */
+    void write(std::ostream& output) const;
+
+    /**
+     * Gets the time that has passed since a point in time.
+     *
+     * \param start The starting time.
+     * \return      The time that has passed, in microseconds.
+     */
+    static uint64_t getMicrosecondsSince(std::chrono::steady_clock::time_point start);
+
+private:
+    struct Entry {
+        std::string help;
+        Unit unit;
+        std::unique_ptr<Histogram> histogram;
+    };
+
+    mutable std::mutex m_mutex;
+    std::map<std::string, Entry> m_histograms;
+
+    Metrics() = default;
+};
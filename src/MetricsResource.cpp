@@ -0,0 +1,36 @@
+#include "MetricsResource.h"
+
+#include <Wt/Http/Request.h>
+#include <Wt/Http/Response.h>
+#include <iostream>
+#include <string>
+#include "Configuration.h"
+#include "Metrics.h"
+
+MetricsResource::MetricsResource()
+{
+    std::string access = Configuration::getString("metrics-access", "local");
+    if (access != "local" && access != "all") {
+        std::cerr << "MetricsResource: Unknown metrics-access \"" << access << "\", using \"local\"" << std::endl;
+    }
+    m_allowsRemoteAccess = access == "all";
+}
+
+MetricsResource::~MetricsResource()
+{
+    beingDeleted();
+}
+
+void MetricsResource::handleRequest(const Wt::Http::Request& request, Wt::Http::Response& response)
+{
+    const std::string& clientAddress = request.clientAddress();
+    bool isLocal = clientAddress == "127.0.0.1" || clientAddress == "::1" || clientAddress == "::ffff:127.0.0.1";
+    if (!m_allowsRemoteAccess && !isLocal) {
+        response.setStatus(403);
+        return;
+    }
+
+    response.setMimeType("text/plain; version=0.0.4; charset=utf-8");
+    response.addHeader("Cache-Control", "no-store");
+    Metrics::instance().write(response.out());
+}
@@ -0,0 +1,42 @@
+/**
+ * \class MetricsResource
+ *
+ * A resource that shows the server's metrics in the Prometheus text format,
+ * for monitoring tools to collect.
+ *
+ * By default, only requests from the same machine are allowed, since the
+ * metrics show how the server is being used.
+ *
+ * \date 2026-10-19 (last updated)
+ */
+
+#pragma once
+
+#include <Wt/Http/Request.h>
+#include <Wt/Http/Response.h>
+#include <Wt/WResource.h>
+
+class MetricsResource : public Wt::WResource {
+public:
+    /**
+     * Creates the metrics resource.
+     *
+     * Who can see the metrics is read from the `metrics-access` property.
+     */
+    MetricsResource();
+
+    ~MetricsResource() override;
+
+    /**
+     * Handles a request for the metrics.
+     *
+     * This is called by Wt.
+     *
+     * \param request  The request to handle.
+     * \param response The response to write to.
+     */
+    void handleRequest(const Wt::Http::Request& request, Wt::Http::Response& response) override;
+
+private:
+    bool m_allowsRemoteAccess;
+};
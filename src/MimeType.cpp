@@ -0,0 +1,173 @@
+#include "MimeType.h"
+
+#include <algorithm>
+#include <array>
+#include <cctype>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <string_view>
+#include <utility>
+
+// Reference: https://mimesniff.spec.whatwg.org/#matching-a-mime-type-pattern
+
+// Types that can be found from the first bytes of a file.
+constexpr std::array<std::pair<std::string_view, std::string_view>, 13> SIGNATURES { {
+    { "\x89PNG\r\n\x1a\n", "image/png" },
+    { "\xff\xd8\xff", "image/jpeg" },
+    { "GIF87a", "image/gif" },
+    { "GIF89a", "image/gif" },
+    { "%PDF-", "application/pdf" },
+    { "PK\x03\x04", "application/zip" },
+    { "\x1f\x8b\x08", "application/gzip" },
+    { "7z\xbc\xaf\x27\x1c", "application/x-7z-compressed" },
+    { "Rar!\x1a\x07", "application/vnd.rar" },
+    { "ID3", "audio/mpeg" },
+    { "OggS", "audio/ogg" },
+    { "fLaC", "audio/flac" },
+    { "\x1a\x45\xdf\xa3", "video/webm" },
+} };
+
+// Types for files that can't be recognized by their content, mostly text
+// formats. This must be kept sorted by extension.
+constexpr std::array<std::pair<std::string_view, std::string_view>, 31> EXTENSIONS { {
+    { "c", "text/x-c" },
+    { "cpp", "text/x-c++" },
+    { "css", "text/css" },
+    { "csv", "text/csv" },
+    { "doc", "application/msword" },
+    { "docx", "application/vnd.openxmlformats-officedocument.wordprocessingml.document" },
+    { "h", "text/x-c" },
+    { "hpp", "text/x-c++" },
+    { "htm", "text/html" },
+    { "html", "text/html" },
+    { "java", "text/x-java" },
+    { "js", "text/javascript" },
+    { "json", "application/json" },
+    { "md", "text/markdown" },
+    { "mp3", "audio/mpeg" },
+    { "mp4", "video/mp4" },
+    { "odt", "application/vnd.oasis.opendocument.text" },
+    { "ppt", "application/vnd.ms-powerpoint" },
+    { "pptx", "application/vnd.openxmlformats-officedocument.presentationml.presentation" },
+    { "py", "text/x-python" },
+    { "svg", "image/svg+xml" },
+    { "tar", "application/x-tar" },
+    { "ts", "text/typescript" },
+    { "tsv", "text/tab-separated-values" },
+    { "txt", "text/plain" },
+    { "wav", "audio/wav" },
+    { "xls", "application/vnd.ms-excel" },
+    { "xlsx", "application/vnd.openxmlformats-officedocument.spreadsheetml.sheet" },
+    { "xml", "application/xml" },
+    { "yaml", "application/yaml" },
+    { "yml", "application/yaml" },
+} };
+
+// Office documents are ZIP files, so they need to be told apart by extension.
+constexpr std::array<std::string_view, 4> ZIP_BASED_EXTENSIONS { "docx", "odt", "pptx", "xlsx" };
+
+/**
+ * Checks whether data looks like text: UTF-8 with no null characters.
+ *
+ * The last character may be incomplete, since the data is usually cut off at
+ * an arbitrary point.
+ */
+static bool isText(std::string_view data)
+{
+    for (std::size_t i = 0; i < data.size();) {
+        auto byte = static_cast<unsigned char>(data[i]);
+        std::size_t length = 0;
+        if (byte == 0) {
+            return false;
+        }
+        if (byte < 0x80) {
+            length = 1;
+        } else if (byte >= 0xc2 && byte <= 0xdf) {
+            length = 2;
+        } else if (byte >= 0xe0 && byte <= 0xef) {
+            length = 3;
+        } else if (byte >= 0xf0 && byte <= 0xf4) {
+            length = 4;
+        } else {
+            return false;
+        }
+        for (std::size_t j = 1; j < length && i + j < data.size(); ++j) {
+            if ((static_cast<unsigned char>(data[i + j]) & 0xc0) != 0x80) {
+                return false;
+            }
+        }
+        i += length;
+    }
+    return true;
+}
+
+std::string MimeType::getExtension(std::string_view name)
+{
+    auto position = name.find_last_of('.');
+    // A leading dot marks a hidden file, not an extension.
+    if (position == std::string_view::npos || position == 0) {
+        return "";
+    }
+
+    std::string extension(name.substr(position + 1));
+    std::transform(extension.begin(), extension.end(), extension.begin(), [](unsigned char character) {
+        return std::tolower(character);
+    });
+    return extension;
+}
+
+std::string_view MimeType::sniff(std::string_view header)
+{
+    for (const auto& [signature, mimeType] : SIGNATURES) {
+        if (header.substr(0, signature.size()) == signature) {
+            return mimeType;
+        }
+    }
+
+    // These formats have a fixed value after a variable one.
+    if (header.size() >= 12 && header.substr(0, 4) == "RIFF") {
+        if (header.substr(8, 4) == "WEBP") {
+            return "image/webp";
+        }
+        if (header.substr(8, 4) == "WAVE") {
+            return "audio/wav";
+        }
+    }
+    if (header.size() >= 12 && header.substr(4, 4) == "ftyp") {
+        return "video/mp4";
+    }
+    return "";
+}
+
+std::string_view MimeType::detect(std::string_view header, std::string_view extension)
+{
+    std::string_view mimeType = sniff(header);
+    bool isZipBased = std::find(ZIP_BASED_EXTENSIONS.begin(), ZIP_BASED_EXTENSIONS.end(), extension) != ZIP_BASED_EXTENSIONS.end();
+    if (!mimeType.empty() && !(mimeType == "application/zip" && isZipBased)) {
+        return mimeType;
+    }
+
+    auto match = std::lower_bound(EXTENSIONS.begin(), EXTENSIONS.end(), extension, [](const auto& entry, std::string_view value) {
+        return entry.first < value;
+    });
+    if (match != EXTENSIONS.end() && match->first == extension) {
+        return match->second;
+    }
+
+    return isText(header) ? "text/plain" : UNKNOWN;
+}
+
+std::string_view MimeType::detectFile(const std::filesystem::path& path, std::string_view name)
+{
+    std::string header(HEADER_SIZE, '\0');
+    std::ifstream file(path, std::ios::binary);
+    file.read(header.data(), static_cast<std::streamsize>(header.size()));
+    header.resize(static_cast<std::size_t>(file.gcount()));
+    return detect(header, getExtension(name));
+}
+
+bool MimeType::isImage(std::string_view mimeType)
+{
+    return mimeType == "image/png" || mimeType == "image/jpeg" || mimeType == "image/gif" || mimeType == "image/webp";
+}
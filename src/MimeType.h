@@ -0,0 +1,83 @@
+/**
+ * \class MimeType
+ *
+ * Finds the type of a file from its content and name.
+ *
+ * The content is checked first, using the "magic numbers" that most binary
+ * formats start with. If that doesn't identify the file, the extension is
+ * used, and anything left over is either plain text or generic binary data.
+ *
+ * \date 2026-10-19 (last updated)
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <filesystem>
+#include <string>
+#include <string_view>
+
+class MimeType {
+public:
+    MimeType() = delete;
+
+    /**
+     * The MIME type for data of an unknown type.
+     */
+    constexpr static std::string_view UNKNOWN = "application/octet-stream";
+
+    /**
+     * The number of bytes at the start of a file that are used to find its
+     * type.
+     */
+    constexpr static std::size_t HEADER_SIZE = 512;
+
+    /**
+     * Gets the extension of a file name.
+     *
+     * \param name The file name.
+     * \return     The part after the last `.`, in lowercase, or an empty
+     *             string if there is no extension.
+     */
+    static std::string getExtension(std::string_view name);
+
+    /**
+     * Finds the type of a file from its magic number.
+     *
+     * \param header The start of the file, preferably `HEADER_SIZE` bytes
+     *               long.
+     * \return       The MIME type, or an empty string if the content is not
+     *               recognized.
+     */
+    static std::string_view sniff(std::string_view header);
+
+    /**
+     * Finds the type of a file from its content and extension.
+     *
+     * \param header    The start of the file, preferably `HEADER_SIZE` bytes
+     *                  long.
+     * \param extension The extension of the file, as returned by
+     *                  `getExtension`.
+     * \return          The MIME type, which is `UNKNOWN` if nothing matched.
+     */
+    static std::string_view detect(std::string_view header, std::string_view extension);
+
+    /**
+     * Finds the type of a file on disk.
+     *
+     * \param path The file to read.
+     * \param name The name of the file shown to the user, which may be
+     *             different from the name on disk.
+     * \return     The MIME type, which is `UNKNOWN` if nothing matched.
+     */
+    static std::string_view detectFile(const std::filesystem::path& path, std::string_view name);
+
+    /**
+     * Checks whether a MIME type is an image type that can be shown in a
+     * browser.
+     *
+     * \param mimeType The MIME type.
+     * \return         `true` if the type is PNG, JPEG, GIF or WebP.
+     */
+    static bool isImage(std::string_view mimeType);
+};
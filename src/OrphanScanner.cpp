@@ -0,0 +1,336 @@
+#include "OrphanScanner.h"
+
+#include <Wt/Dbo/Transaction.h>
+#include <algorithm>
+#include <cctype>
+#include <exception>
+#include <filesystem>
+#include <iostream>
+#include <string>
+#include <system_error>
+#include <tuple>
+#include "Change.h"
+#include "Configuration.h"
+#include "File.h"
+#include "FileVersion.h"
+#include "FolderCache.h"
+#include "SegmentStore.h"
+#include "StorageApplication.h"
+
+// Blobs are named after their file ID. Anything longer than this can't be an
+// ID, and would overflow when parsed.
+constexpr std::size_t MAX_BLOB_NAME_LENGTH = 18;
+
+// How long to wait after startup before the first scan, so that the scan
+// doesn't compete with the server starting up.
+constexpr std::chrono::minutes STARTUP_DELAY { 5 };
+
+OrphanScanner& OrphanScanner::instance()
+{
+    static OrphanScanner scanner;
+    return scanner;
+}
+
+OrphanScanner::~OrphanScanner()
+{
+    stop();
+}
+
+void OrphanScanner::start()
+{
+    std::lock_guard lock(m_mutex);
+    if (m_thread.joinable()) {
+        return;
+    }
+
+    std::string action = Configuration::getString("orphan-scan-action", "quarantine");
+    if (action == "report") {
+        m_action = Action::Report;
+    } else if (action == "delete") {
+        m_action = Action::Delete;
+    } else {
+        m_action = Action::Quarantine;
+    }
+
+    m_interval = std::chrono::hours(Configuration::getInteger("orphan-scan-interval", 24));
+    m_gracePeriod = std::chrono::minutes(Configuration::getInteger("orphan-scan-grace-period", 60));
+
+    long long operationsPerSecond = Configuration::getInteger("orphan-scan-rate", 500);
+    m_operationInterval = operationsPerSecond > 0 ? std::chrono::nanoseconds(std::chrono::seconds(1)) / operationsPerSecond : std::chrono::nanoseconds(0);
+
+    if (m_interval.count() <= 0) {
+        return;
+    }
+    m_isStopping = false;
+    m_thread = std::thread(&OrphanScanner::run, this);
+}
+
+void OrphanScanner::stop()
+{
+    {
+        std::lock_guard lock(m_mutex);
+        m_isStopping = true;
+    }
+    m_condition.notify_all();
+
+    if (m_thread.joinable()) {
+        m_thread.join();
+    }
+}
+
+OrphanScanner::Report OrphanScanner::scan()
+{
+    auto databaseSession = StorageApplication::createDatabaseSession();
+    Report report;
+    m_nextOperation = std::chrono::steady_clock::now();
+
+    scanBlobs(*databaseSession, report);
+    scanFiles(*databaseSession, report);
+
+    std::cerr << "OrphanScanner: Checked " << report.blobsScanned << " blobs and " << report.filesScanned << " files. Found "
+              << report.orphanBlobs << " orphan blobs using " << report.orphanBytes << " bytes ("
+              << (m_action == Action::Delete ? "reclaimed" : m_action == Action::Quarantine ? "quarantined" : "not changed") << "), "
+              << report.missingBlobs << " files with missing content, and " << report.sizeMismatches << " files with the wrong size." << std::endl;
+
+    std::lock_guard lock(m_mutex);
+    m_lastReport = report;
+    return report;
+}
+
+OrphanScanner::Report OrphanScanner::getLastReport() const
+{
+    std::lock_guard lock(m_mutex);
+    return m_lastReport;
+}
+
+void OrphanScanner::run()
+{
+    auto waitTime = std::chrono::duration_cast<std::chrono::steady_clock::duration>(STARTUP_DELAY);
+    while (true) {
+        {
+            std::unique_lock lock(m_mutex);
+            if (m_condition.wait_for(lock, waitTime, [this] { return m_isStopping; })) {
+                return;
+            }
+        }
+
+        try {
+            scan();
+        } catch (const std::exception& ex) {
+            std::cerr << "OrphanScanner: Scan failed: " << ex.what() << std::endl;
+        }
+        waitTime = m_interval;
+    }
+}
+
+void OrphanScanner::scanBlobs(Wt::Dbo::Session& databaseSession, Report& report)
+{
+    std::vector<std::pair<long long, std::filesystem::path>> batch;
+    batch.reserve(BATCH_SIZE);
+
+    std::error_code error;
+    for (std::filesystem::directory_iterator iterator(File::FILE_SYSTEM_ROOT, error), end; !error && iterator != end; iterator.increment(error)) {
+        if (!throttle()) {
+            return;
+        }
+
+        const auto& entry = *iterator;
+        std::string name = entry.path().filename().string();
+        bool isBlobName = !name.empty() && name.size() <= MAX_BLOB_NAME_LENGTH && std::all_of(name.begin(), name.end(), [](unsigned char character) {
+            return std::isdigit(character);
+        });
+        std::error_code typeError;
+        if (!isBlobName || !entry.is_regular_file(typeError)) {
+            continue;
+        }
+
+        ++report.blobsScanned;
+        batch.emplace_back(std::stoll(name), entry.path());
+        if (batch.size() == BATCH_SIZE) {
+            checkBlobBatch(databaseSession, batch, report);
+            batch.clear();
+        }
+    }
+    if (error) {
+        std::cerr << "OrphanScanner: Failed to list " << File::FILE_SYSTEM_ROOT << ": " << error.message() << std::endl;
+    }
+
+    checkBlobBatch(databaseSession, batch, report);
+}
+
+void OrphanScanner::checkBlobBatch(Wt::Dbo::Session& databaseSession, std::vector<std::pair<long long, std::filesystem::path>>& batch, Report& report)
+{
+    if (batch.empty()) {
+        return;
+    }
+
+    // Directory listings aren't sorted, so sort each batch and merge it with
+    // the (sorted) IDs that exist in the database.
+    std::sort(batch.begin(), batch.end());
+
+    std::string placeholders = "?";
+    for (std::size_t i = 1; i < batch.size(); ++i) {
+        placeholders += ", ?";
+    }
+
+    // A blob left behind by a file whose content is now packed into a segment
+    // is an orphan too.
+    std::vector<long long> existingIds;
+    {
+        Wt::Dbo::Transaction transaction(databaseSession);
+        auto idQuery = databaseSession.query<long long>("SELECT id FROM files").where("segment_id = 0 AND id IN (" + placeholders + ")").orderBy("id");
+        for (const auto& [id, path] : batch) {
+            idQuery.bind(id);
+        }
+        for (long long id : idQuery.resultList()) {
+            existingIds.push_back(id);
+        }
+    }
+
+    // Blobs of uploads that are still in progress don't have a committed row
+    // yet, so leave anything recent alone.
+    const auto cutoff = std::filesystem::file_time_type::clock::now() - m_gracePeriod;
+
+    auto existingId = existingIds.begin();
+    for (const auto& [id, path] : batch) {
+        while (existingId != existingIds.end() && *existingId < id) {
+            ++existingId;
+        }
+        if (existingId != existingIds.end() && *existingId == id) {
+            continue;
+        }
+
+        std::error_code error;
+        auto modifiedTime = std::filesystem::last_write_time(path, error);
+        if (error || modifiedTime > cutoff) {
+            continue;
+        }
+
+        if (!throttle()) {
+            return;
+        }
+        handleOrphanBlob(path, report);
+    }
+}
+
+void OrphanScanner::scanFiles(Wt::Dbo::Session& databaseSession, Report& report)
+{
+    // Walk the table in ID order, one page at a time.
+    long long lastId = 0;
+    while (true) {
+        std::vector<std::tuple<long long, long long, long long, long long>> rows;
+        {
+            Wt::Dbo::Transaction transaction(databaseSession);
+            auto rowQuery = databaseSession.query<std::tuple<long long, long long, long long, long long>>("SELECT id, file_size, segment_id, segment_offset FROM files").where("id > ?").bind(lastId).orderBy("id").limit(BATCH_SIZE);
+            for (const auto& row : rowQuery.resultList()) {
+                rows.push_back(row);
+            }
+        }
+        if (rows.empty()) {
+            return;
+        }
+        lastId = std::get<0>(rows.back());
+
+        std::vector<std::tuple<long long, long long, long long, long long>> missingRows;
+        for (const auto& row : rows) {
+            const auto& [id, fileSize, segmentId, segmentOffset] = row;
+            if (!throttle()) {
+                return;
+            }
+            ++report.filesScanned;
+
+            if (segmentId != 0) {
+                if (!hasContent(id, fileSize, segmentId, segmentOffset)) {
+                    ++report.missingBlobs;
+                    missingRows.push_back(row);
+                }
+                continue;
+            }
+
+            std::error_code error;
+            auto blobSize = std::filesystem::file_size(std::string(File::FILE_SYSTEM_ROOT) + std::to_string(id), error);
+            if (error) {
+                ++report.missingBlobs;
+                missingRows.push_back(row);
+            } else if (static_cast<long long>(blobSize) != fileSize) {
+                ++report.sizeMismatches;
+            }
+        }
+
+        if (m_action == Action::Delete && !missingRows.empty()) {
+            Wt::Dbo::Transaction transaction(databaseSession);
+            for (const auto& [id, fileSize, segmentId, segmentOffset] : missingRows) {
+                // The rows were read before the slow checks above. Since then,
+                // compaction or a new upload may have moved the content, and
+                // the user may have deleted the file, so only rows that are
+                // unchanged and still missing their content are deleted.
+                Wt::Dbo::ptr<File> file = databaseSession.find<File>().where("id = ?").bind(id);
+                if (!file || file->getFileSize() != fileSize || file->getSegmentId() != segmentId || file->getSegmentOffset() != segmentOffset || hasContent(id, fileSize, segmentId, segmentOffset)) {
+                    continue;
+                }
+
+                FolderCache::invalidate(file->getParent().id());
+                Change::record(databaseSession, Change::Kind::Deleted, file);
+                FileVersion::removeAll(databaseSession, "SELECT ?", id);
+                databaseSession.execute("DELETE FROM sharing_links WHERE file_id = ?").bind(id).run();
+                databaseSession.execute("DELETE FROM files WHERE id = ?").bind(id).run();
+            }
+        }
+    }
+}
+
+bool OrphanScanner::hasContent(long long fileId, long long fileSize, long long segmentId, long long segmentOffset)
+{
+    std::error_code error;
+    if (segmentId == 0) {
+        return std::filesystem::exists(std::string(File::FILE_SYSTEM_ROOT) + std::to_string(fileId), error);
+    }
+
+    // Packed content only has to fit in its segment, which holds other
+    // content after it.
+    auto segmentSize = std::filesystem::file_size(SegmentStore::getPath(segmentId), error);
+    return !error && static_cast<long long>(segmentSize) >= segmentOffset + fileSize;
+}
+
+void OrphanScanner::handleOrphanBlob(const std::filesystem::path& path, Report& report)
+{
+    std::error_code error;
+    auto size = std::filesystem::file_size(path, error);
+    if (error) {
+        return;
+    }
+
+    switch (m_action) {
+    case Action::Report:
+        std::cerr << "OrphanScanner: Found orphan blob " << path << std::endl;
+        break;
+    case Action::Quarantine: {
+        auto quarantineFolder = std::filesystem::path(File::FILE_SYSTEM_ROOT) / QUARANTINE_FOLDER;
+        std::filesystem::create_directories(quarantineFolder, error);
+        if (!error) {
+            std::filesystem::rename(path, quarantineFolder / path.filename(), error);
+        }
+        break;
+    }
+    case Action::Delete:
+        std::filesystem::remove(path, error);
+        break;
+    }
+
+    if (error) {
+        std::cerr << "OrphanScanner: Failed to handle orphan blob " << path << ": " << error.message() << std::endl;
+        return;
+    }
+    ++report.orphanBlobs;
+    report.orphanBytes += static_cast<int64_t>(size);
+}
+
+bool OrphanScanner::throttle()
+{
+    std::unique_lock lock(m_mutex);
+    if (m_operationInterval.count() > 0) {
+        m_condition.wait_until(lock, m_nextOperation, [this] { return m_isStopping; });
+        m_nextOperation = std::max(m_nextOperation, std::chrono::steady_clock::now() - std::chrono::seconds(1)) + m_operationInterval;
+    }
+    return !m_isStopping;
+}
@@ -0,0 +1,161 @@
+/**
+ * \class OrphanScanner
+ *
+ * Reconciles the file content blobs in `File::FILE_SYSTEM_ROOT` with the rows
+ * in the `files` table.
+ *
+ * A crash at the wrong moment can leave a blob with no row (an orphan blob),
+ * or a row with no blob. The scanner runs in the background at a limited rate
+ * and looks for both:
+ *
+ *  - Orphan blobs are reported, moved to a quarantine folder, or deleted,
+ *    depending on the `orphan-scan-action` property.
+ *  - Rows with missing content are reported, and deleted if the action is
+ *    `delete`. Content packed into a `SegmentStore` segment is missing if the
+ *    segment ends before it.
+ *
+ * Both directions are checked in fixed-size batches, so memory use doesn't
+ * depend on the number of files.
+ *
+ * \date 2026-10-19 (last updated)
+ */
+
+#pragma once
+
+#include <Wt/Dbo/Session.h>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <filesystem>
+#include <mutex>
+#include <string_view>
+#include <thread>
+#include <utility>
+#include <vector>
+
+class OrphanScanner {
+public:
+    /**
+     * What to do with orphan blobs.
+     */
+    enum class Action {
+        Report,
+        Quarantine,
+        Delete,
+    };
+
+    /**
+     * The results of a single scan.
+     */
+    struct Report {
+        int64_t blobsScanned { 0 };
+        int64_t filesScanned { 0 };
+        int64_t orphanBlobs { 0 };
+        int64_t orphanBytes { 0 };
+        int64_t missingBlobs { 0 };
+        int64_t sizeMismatches { 0 };
+    };
+
+    /**
+     * The folder that orphan blobs are moved to when quarantined, relative to
+     * `File::FILE_SYSTEM_ROOT`.
+     */
+    constexpr static std::string_view QUARANTINE_FOLDER = ".quarantine";
+
+    /**
+     * Gets the orphan scanner for this server.
+     *
+     * \return The orphan scanner.
+     */
+    static OrphanScanner& instance();
+
+    ~OrphanScanner();
+
+    OrphanScanner(const OrphanScanner&) = delete;
+    OrphanScanner& operator=(const OrphanScanner&) = delete;
+
+    /**
+     * Reads the scanner's settings and starts the background thread.
+     *
+     * The scanner is disabled if `orphan-scan-interval` is 0.
+     */
+    void start();
+
+    /**
+     * Stops the background thread, abandoning any scan in progress.
+     */
+    void stop();
+
+    /**
+     * Runs a complete scan on the calling thread.
+     *
+     * \return The results of the scan.
+     */
+    Report scan();
+
+    /**
+     * Gets the results of the most recently completed scan.
+     *
+     * \return The results, which are all zero if no scan has completed yet.
+     */
+    Report getLastReport() const;
+
+private:
+    /**
+     * The number of blobs or rows that are checked together.
+     */
+    constexpr static std::size_t BATCH_SIZE = 500;
+
+    Action m_action { Action::Quarantine };
+    std::chrono::hours m_interval { 24 };
+    std::chrono::minutes m_gracePeriod { 60 };
+    std::chrono::nanoseconds m_operationInterval { 0 };
+    std::chrono::steady_clock::time_point m_nextOperation;
+
+    std::thread m_thread;
+    mutable std::mutex m_mutex;
+    std::condition_variable m_condition;
+    bool m_isStopping { false };
+    Report m_lastReport;
+
+    OrphanScanner() = default;
+
+    /**
+     * The main loop of the background thread.
+     */
+    void run();
+
+    /**
+     * Looks for blobs that don't have a row.
+     */
+    void scanBlobs(Wt::Dbo::Session& databaseSession, Report& report);
+
+    /**
+     * Checks a batch of blobs against the database, handling any orphans.
+     *
+     * \param batch The IDs and paths of the blobs to check. This will be sorted.
+     */
+    void checkBlobBatch(Wt::Dbo::Session& databaseSession, std::vector<std::pair<long long, std::filesystem::path>>& batch, Report& report);
+
+    /**
+     * Looks for rows that don't have a blob.
+     */
+    void scanFiles(Wt::Dbo::Session& databaseSession, Report& report);
+
+    /**
+     * Checks whether a file's content is still where its row says it is.
+     */
+    static bool hasContent(long long fileId, long long fileSize, long long segmentId, long long segmentOffset);
+
+    /**
+     * Reports, quarantines, or deletes an orphan blob.
+     */
+    void handleOrphanBlob(const std::filesystem::path& path, Report& report);
+
+    /**
+     * Waits until the next filesystem operation is allowed by the rate limit.
+     *
+     * \return `false` if the scanner is stopping, or `true` otherwise.
+     */
+    bool throttle();
+};
@@ -0,0 +1,221 @@
+#include "PreviewGenerator.h"
+
+#include <algorithm>
+#include <array>
+#include <exception>
+#include <fstream>
+#include <iostream>
+#include <istream>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include "Configuration.h"
+#include "File.h"
+#include "MimeType.h"
+#include "Thumbnailer.h"
+
+#ifdef __linux__
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+// Lowers the CPU and I/O priority of the calling thread, so that previews only
+// use resources that nothing else wants.
+static void lowerThreadPriority()
+{
+#ifdef __linux__
+    // glibc has no wrapper for ioprio_set. These values are from
+    // linux/ioprio.h.
+    constexpr int IOPRIO_WHO_PROCESS = 1;
+    constexpr int IOPRIO_CLASS_IDLE = 3;
+    constexpr int IOPRIO_CLASS_SHIFT = 13;
+    auto threadId = static_cast<id_t>(syscall(SYS_gettid));
+    if (syscall(SYS_ioprio_set, IOPRIO_WHO_PROCESS, threadId, IOPRIO_CLASS_IDLE << IOPRIO_CLASS_SHIFT) != 0) {
+        std::cerr << "PreviewGenerator: Failed to set I/O priority" << std::endl;
+    }
+    // On Linux, this only affects the calling thread.
+    setpriority(PRIO_PROCESS, threadId, 10);
+#endif
+}
+
+PreviewGenerator::UploadGuard::UploadGuard()
+{
+    auto& generator = PreviewGenerator::instance();
+    std::lock_guard lock(generator.m_mutex);
+    ++generator.m_activeUploads;
+}
+
+PreviewGenerator::UploadGuard::~UploadGuard()
+{
+    auto& generator = PreviewGenerator::instance();
+    {
+        std::lock_guard lock(generator.m_mutex);
+        --generator.m_activeUploads;
+    }
+    generator.m_condition.notify_all();
+}
+
+PreviewGenerator& PreviewGenerator::instance()
+{
+    static PreviewGenerator generator;
+    return generator;
+}
+
+PreviewGenerator::~PreviewGenerator()
+{
+    stop();
+}
+
+void PreviewGenerator::start()
+{
+    std::lock_guard lock(m_mutex);
+    if (!m_threads.empty()) {
+        return;
+    }
+
+    m_maxQueueSize = static_cast<std::size_t>(std::max(1LL, Configuration::getInteger("preview-queue-size", 1000)));
+    long long threadCount = Configuration::getInteger("preview-threads", 1);
+
+    std::error_code error;
+    std::filesystem::create_directories(std::filesystem::path(File::FILE_SYSTEM_ROOT) / PREVIEW_FOLDER, error);
+    if (error) {
+        std::cerr << "PreviewGenerator: Failed to create the preview folder: " << error.message() << std::endl;
+        return;
+    }
+
+    m_isStopping = false;
+    for (long long i = 0; i < threadCount; ++i) {
+        m_threads.emplace_back(&PreviewGenerator::run, this);
+    }
+}
+
+void PreviewGenerator::stop()
+{
+    {
+        std::lock_guard lock(m_mutex);
+        m_isStopping = true;
+    }
+    m_condition.notify_all();
+
+    for (auto& thread : m_threads) {
+        thread.join();
+    }
+
+    std::lock_guard lock(m_mutex);
+    m_threads.clear();
+    m_queue.clear();
+    m_queuedIds.clear();
+}
+
+bool PreviewGenerator::enqueue(long long fileId)
+{
+    {
+        std::lock_guard lock(m_mutex);
+        if (m_threads.empty() || m_queue.size() >= m_maxQueueSize || !m_queuedIds.insert(fileId).second) {
+            return false;
+        }
+        m_queue.push_back(fileId);
+    }
+    m_condition.notify_one();
+    return true;
+}
+
+std::filesystem::path PreviewGenerator::getPreviewPath(long long fileId)
+{
+    return std::filesystem::path(File::FILE_SYSTEM_ROOT) / PREVIEW_FOLDER / std::to_string(fileId);
+}
+
+PreviewGenerator::Status PreviewGenerator::getStatus(long long fileId)
+{
+    std::error_code error;
+    auto size = std::filesystem::file_size(getPreviewPath(fileId), error);
+    if (error) {
+        return Status::Missing;
+    }
+    return size > 0 ? Status::Available : Status::Unavailable;
+}
+
+void PreviewGenerator::run()
+{
+    lowerThreadPriority();
+
+    while (true) {
+        long long fileId = 0;
+        {
+            std::unique_lock lock(m_mutex);
+            m_condition.wait(lock, [this] { return m_isStopping || (!m_queue.empty() && m_activeUploads == 0); });
+            if (m_isStopping) {
+                return;
+            }
+            fileId = m_queue.front();
+            m_queue.pop_front();
+        }
+
+        try {
+            generate(fileId);
+        } catch (const std::exception& ex) {
+            std::cerr << "PreviewGenerator: Failed to create preview of file " << fileId << ": " << ex.what() << std::endl;
+        }
+
+        // Only forget the ID afterwards, so that the same file can't be worked
+        // on by two threads at once.
+        std::lock_guard lock(m_mutex);
+        m_queuedIds.erase(fileId);
+    }
+}
+
+void PreviewGenerator::generate(long long fileId)
+{
+    auto previewPath = getPreviewPath(fileId);
+    if (getStatus(fileId) != Status::Missing) {
+        return;
+    }
+
+    auto content = File::openContent(fileId);
+    if (!content) {
+        // The file was probably deleted after it was queued.
+        return;
+    }
+    auto& file = *content;
+
+    std::array<char, MimeType::HEADER_SIZE> header {};
+    file.read(header.data(), header.size());
+    std::string_view contentType = MimeType::sniff(std::string_view(header.data(), static_cast<std::size_t>(file.gcount())));
+    file.clear();
+    file.seekg(0, std::ios::end);
+    auto size = static_cast<std::uintmax_t>(file.tellg());
+    file.seekg(0);
+
+    std::optional<std::string> preview;
+    if (contentType == "image/png") {
+        preview = Thumbnailer::createPngPreview(file);
+    } else if (MimeType::isImage(contentType)) {
+        // Other image formats can't be scaled down here, but small images are
+        // still cheap enough to show as they are.
+        if (size <= MAX_PASSTHROUGH_SIZE) {
+            preview.emplace(static_cast<std::size_t>(size), '\0');
+            if (!file.read(preview->data(), static_cast<std::streamsize>(size))) {
+                preview.reset();
+            }
+        }
+    } else if (contentType.empty()) {
+        preview = Thumbnailer::createTextPreview(file);
+    }
+
+    // Write to a temporary file first so that a partial preview is never
+    // served.
+    auto temporaryPath = previewPath;
+    temporaryPath += ".tmp";
+    {
+        std::ofstream output(temporaryPath, std::ios::binary | std::ios::trunc);
+        if (preview) {
+            output << *preview;
+        }
+        if (!output.flush()) {
+            throw std::runtime_error("Failed to write " + temporaryPath.string());
+        }
+    }
+    std::filesystem::rename(temporaryPath, previewPath);
+}
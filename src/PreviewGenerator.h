@@ -0,0 +1,145 @@
+/**
+ * \class PreviewGenerator
+ *
+ * Creates file previews on background threads, and caches them on disk.
+ *
+ * Previews are stored in `File::FILE_SYSTEM_ROOT/.previews`, named after the
+ * file ID like the file content itself. An empty preview file means that no
+ * preview can be made for that file, so it isn't tried again.
+ *
+ * The queue has a limited size, and each file is only queued once. The worker
+ * threads run at idle I/O priority, and wait while any uploads are being saved
+ * so that previews never slow down uploads.
+ *
+ * \date 2026-10-19 (last updated)
+ */
+
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <filesystem>
+#include <mutex>
+#include <string_view>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+
+class PreviewGenerator {
+public:
+    /**
+     * The folder that previews are stored in, relative to
+     * `File::FILE_SYSTEM_ROOT`.
+     */
+    constexpr static std::string_view PREVIEW_FOLDER = ".previews";
+
+    /**
+     * The largest image that is used as its own preview when it can't be
+     * scaled down.
+     */
+    constexpr static std::uintmax_t MAX_PASSTHROUGH_SIZE = 512 * 1024;
+
+    /**
+     * Whether a file has a preview.
+     */
+    enum class Status {
+        /// The preview hasn't been created yet.
+        Missing,
+        /// The preview is available.
+        Available,
+        /// No preview can be created for this file.
+        Unavailable,
+    };
+
+    /**
+     * Pauses preview generation while it exists.
+     *
+     * Create one of these while saving an upload.
+     */
+    class UploadGuard {
+    public:
+        UploadGuard();
+        ~UploadGuard();
+
+        UploadGuard(const UploadGuard&) = delete;
+        UploadGuard& operator=(const UploadGuard&) = delete;
+    };
+
+    /**
+     * Gets the preview generator for this server.
+     *
+     * \return The preview generator.
+     */
+    static PreviewGenerator& instance();
+
+    ~PreviewGenerator();
+
+    PreviewGenerator(const PreviewGenerator&) = delete;
+    PreviewGenerator& operator=(const PreviewGenerator&) = delete;
+
+    /**
+     * Reads the generator's settings and starts the worker threads.
+     *
+     * The generator is disabled if `preview-threads` is 0.
+     */
+    void start();
+
+    /**
+     * Stops the worker threads, waiting for the current previews to finish.
+     *
+     * Queued files that weren't handled yet will be queued again the next
+     * time they are shown.
+     */
+    void stop();
+
+    /**
+     * Queues a file to have its preview created.
+     *
+     * \param fileId The ID of the file.
+     * \return       `true` if the file was queued, or `false` if it was
+     *               already queued or the queue is full.
+     */
+    bool enqueue(long long fileId);
+
+    /**
+     * Gets the path to the preview of a file.
+     *
+     * \param fileId The ID of the file.
+     * \return       The path, which may not exist.
+     */
+    static std::filesystem::path getPreviewPath(long long fileId);
+
+    /**
+     * Checks whether a file has a preview.
+     *
+     * \param fileId The ID of the file.
+     * \return       The status of the preview.
+     */
+    static Status getStatus(long long fileId);
+
+private:
+    std::vector<std::thread> m_threads;
+    std::mutex m_mutex;
+    std::condition_variable m_condition;
+    std::deque<long long> m_queue;
+    std::unordered_set<long long> m_queuedIds;
+    std::size_t m_maxQueueSize { 1000 };
+    int m_activeUploads { 0 };
+    bool m_isStopping { false };
+
+    PreviewGenerator() = default;
+
+    /**
+     * The main loop of a worker thread.
+     */
+    void run();
+
+    /**
+     * Creates and saves the preview of a file.
+     *
+     * \param fileId The ID of the file.
+     */
+    static void generate(long long fileId);
+};
@@ -0,0 +1,58 @@
+#include "PreviewResource.h"
+
+#include <Wt/Http/Request.h>
+#include <Wt/Http/Response.h>
+#include <array>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include "MimeType.h"
+#include "PreviewGenerator.h"
+
+PreviewResource::PreviewResource(long long fileId)
+    : m_fileId(fileId)
+{
+}
+
+PreviewResource::~PreviewResource()
+{
+    beingDeleted();
+}
+
+void PreviewResource::handleRequest(const Wt::Http::Request& request, Wt::Http::Response& response)
+{
+    auto previewPath = PreviewGenerator::getPreviewPath(m_fileId);
+    std::error_code error;
+    auto size = std::filesystem::file_size(previewPath, error);
+    auto modifiedTime = std::filesystem::last_write_time(previewPath, error);
+    if (error || size == 0) {
+        response.setStatus(404);
+        return;
+    }
+
+    // Previews are replaced rather than modified, so the size and time are
+    // enough to tell versions apart.
+    std::string eTag = "\"" + std::to_string(m_fileId) + "-" + std::to_string(size) + "-" + std::to_string(modifiedTime.time_since_epoch().count()) + "\"";
+    response.addHeader("ETag", eTag);
+    response.addHeader("Cache-Control", "private, max-age=86400");
+    if (request.headerValue("If-None-Match") == eTag) {
+        response.setStatus(304);
+        return;
+    }
+
+    std::ifstream preview(previewPath, std::ios::binary);
+    std::array<char, MimeType::HEADER_SIZE> header {};
+    preview.read(header.data(), header.size());
+    std::string_view imageType = MimeType::sniff(std::string_view(header.data(), static_cast<std::size_t>(preview.gcount())));
+    preview.clear();
+    preview.seekg(0);
+
+    // Anything that isn't a known image type is a generated text preview.
+    response.setMimeType(imageType.empty() ? "image/svg+xml" : std::string(imageType));
+    response.addHeader("X-Content-Type-Options", "nosniff");
+    response.addHeader("Content-Security-Policy", "default-src 'none'; style-src 'unsafe-inline'");
+    response.setContentLength(size);
+    response.out() << preview.rdbuf();
+}
@@ -0,0 +1,41 @@
+/**
+ * \class PreviewResource
+ *
+ * A resource that shows the preview image of a file.
+ *
+ * Previews are served with an ETag and a long cache lifetime, so browsers only
+ * download each preview once.
+ *
+ * \date 2026-10-19 (last updated)
+ */
+
+#pragma once
+
+#include <Wt/Http/Request.h>
+#include <Wt/Http/Response.h>
+#include <Wt/WResource.h>
+
+class PreviewResource : public Wt::WResource {
+public:
+    /**
+     * Creates a new resource for the preview of a file.
+     *
+     * \param fileId The ID of the file.
+     */
+    explicit PreviewResource(long long fileId);
+
+    ~PreviewResource() override;
+
+    /**
+     * Handles a request for the preview.
+     *
+     * This is called by Wt.
+     *
+     * \param request  The request to handle.
+     * \param response The response to write to.
+     */
+    void handleRequest(const Wt::Http::Request& request, Wt::Http::Response& response) override;
+
+private:
+    long long m_fileId;
+};
@@ -0,0 +1,117 @@
+#include "QueryTrace.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+#include "Configuration.h"
+#include "Metrics.h"
+
+// The number of repeated statements shown for a slow event.
+constexpr std::size_t SHOWN_STATEMENT_COUNT = 5;
+
+namespace {
+
+struct Settings {
+    bool isEnabled { false };
+    bool logsAllStatements { false };
+    uint64_t slowStatementCount { 0 };
+    uint64_t slowMicroseconds { 0 };
+};
+
+}
+
+static const Settings& getSettings()
+{
+    static const Settings settings = [] {
+        Settings result;
+        std::string mode = Configuration::getString("query-trace", "off");
+        if (mode == "slow" || mode == "all") {
+            result.isEnabled = true;
+            result.logsAllStatements = mode == "all";
+        } else if (mode != "off") {
+            std::cerr << "QueryTrace: Unknown query-trace \"" << mode << "\", using \"off\"" << std::endl;
+        }
+        result.slowStatementCount = static_cast<uint64_t>(std::max(0LL, Configuration::getInteger("query-trace-slow-count", 20)));
+        result.slowMicroseconds = static_cast<uint64_t>(std::max(0LL, Configuration::getInteger("query-trace-slow-time", 100))) * 1000;
+        return result;
+    }();
+    return settings;
+}
+
+thread_local QueryTrace* QueryTrace::t_current = nullptr;
+
+QueryTrace::QueryTrace(std::string description)
+    : m_isActive(getSettings().isEnabled)
+{
+    if (!m_isActive) {
+        return;
+    }
+
+    m_description = std::move(description);
+    m_start = std::chrono::steady_clock::now();
+    m_previous = t_current;
+    t_current = this;
+}
+
+QueryTrace::~QueryTrace()
+{
+    if (!m_isActive) {
+        return;
+    }
+    t_current = m_previous;
+
+    const auto& settings = getSettings();
+    uint64_t elapsed = Metrics::getMicrosecondsSince(m_start);
+    bool isSlow = m_statementCount > settings.slowStatementCount || elapsed > settings.slowMicroseconds;
+    if (!isSlow && !settings.logsAllStatements) {
+        return;
+    }
+
+    std::cerr << "QueryTrace: " << (isSlow ? "Slow: " : "") << m_description << ": " << m_statementCount << " statements taking "
+              << m_statementMicroseconds / 1000.0 << " ms, " << elapsed / 1000.0 << " ms in total" << std::endl;
+    if (!isSlow) {
+        return;
+    }
+
+    // The statements that ran most often are the likeliest to be lazy loads
+    // in a loop.
+    std::vector<std::pair<const std::string*, StatementStats>> statements;
+    for (const auto& [sql, stats] : m_statements) {
+        statements.emplace_back(&sql, stats);
+    }
+    std::size_t shownCount = std::min(statements.size(), SHOWN_STATEMENT_COUNT);
+    std::partial_sort(statements.begin(), statements.begin() + static_cast<std::ptrdiff_t>(shownCount), statements.end(), [](const auto& a, const auto& b) {
+        return a.second.count > b.second.count;
+    });
+    for (std::size_t i = 0; i < shownCount; ++i) {
+        const auto& [sql, stats] = statements[i];
+        std::cerr << "QueryTrace:   " << stats.count << "x, " << stats.microseconds / 1000.0 << " ms: " << *sql << std::endl;
+    }
+}
+
+void QueryTrace::record(std::string_view sql, uint64_t microseconds)
+{
+    QueryTrace* trace = t_current;
+    if (trace == nullptr) {
+        return;
+    }
+
+    ++trace->m_statementCount;
+    trace->m_statementMicroseconds += microseconds;
+
+    auto match = trace->m_statements.find(sql);
+    if (match == trace->m_statements.end()) {
+        match = trace->m_statements.emplace(std::string(sql), StatementStats {}).first;
+    }
+    ++match->second.count;
+    match->second.microseconds += microseconds;
+
+    if (getSettings().logsAllStatements) {
+        std::cerr << "QueryTrace: " << trace->m_description << ": " << microseconds / 1000.0 << " ms: " << sql << std::endl;
+    }
+}
@@ -0,0 +1,67 @@
+/**
+ * \class QueryTrace
+ *
+ * Counts the database statements that run while handling one event, to find
+ * events that make too many round trips to the database.
+ *
+ * A `QueryTrace` collects the statements that run on its thread for as long
+ * as it exists. When it is destroyed, events that ran more statements or took
+ * longer than the configured limits are logged along with the statements that
+ * ran most often, which makes lazy loads in loops easy to spot.
+ *
+ * Tracing is off unless the `query-trace` property is set.
+ *
+ * \date 2026-10-19 (last updated)
+ */
+
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <string_view>
+
+class QueryTrace {
+public:
+    /**
+     * Starts collecting the statements run by this thread.
+     *
+     * \param description What is being handled, for the log.
+     */
+    explicit QueryTrace(std::string description);
+
+    /**
+     * Stops collecting, and logs the event if it was slow.
+     */
+    ~QueryTrace();
+
+    QueryTrace(const QueryTrace&) = delete;
+    QueryTrace& operator=(const QueryTrace&) = delete;
+
+    /**
+     * Records a statement that has finished running on this thread.
+     *
+     * This does nothing if no trace is active.
+     *
+     * \param sql          The statement, with `?` in place of values.
+     * \param microseconds The time the statement took.
+     */
+    static void record(std::string_view sql, uint64_t microseconds);
+
+private:
+    struct StatementStats {
+        uint64_t count { 0 };
+        uint64_t microseconds { 0 };
+    };
+
+    static thread_local QueryTrace* t_current;
+
+    bool m_isActive;
+    QueryTrace* m_previous { nullptr };
+    std::string m_description;
+    std::chrono::steady_clock::time_point m_start;
+    uint64_t m_statementCount { 0 };
+    uint64_t m_statementMicroseconds { 0 };
+    std::map<std::string, StatementStats, std::less<>> m_statements;
+};
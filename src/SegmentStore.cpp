@@ -0,0 +1,307 @@
+#include "SegmentStore.h"
+
+#include <Wt/Dbo/Transaction.h>
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <exception>
+#include <iostream>
+#include <stdexcept>
+#include <system_error>
+#include <tuple>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "BlobDeletion.h"
+#include "BlobGarbageCollector.h"
+#include "Configuration.h"
+#include "File.h"
+#include "Metrics.h"
+#include "StorageApplication.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+// Segment IDs have at most this many digits, like blob names.
+constexpr std::size_t MAX_SEGMENT_NAME_LENGTH = 18;
+
+static std::optional<long long> parseSegmentName(const std::string& name)
+{
+    bool isSegmentName = !name.empty() && name.size() <= MAX_SEGMENT_NAME_LENGTH && std::all_of(name.begin(), name.end(), [](unsigned char character) {
+        return std::isdigit(character);
+    });
+    if (!isSegmentName) {
+        return std::nullopt;
+    }
+    return std::stoll(name);
+}
+
+SegmentStore& SegmentStore::instance()
+{
+    static SegmentStore segmentStore;
+    return segmentStore;
+}
+
+SegmentStore::~SegmentStore()
+{
+    stop();
+    if (m_activeFd >= 0) {
+        close(m_activeFd);
+    }
+}
+
+void SegmentStore::start()
+{
+    std::lock_guard lock(m_mutex);
+    if (m_thread.joinable()) {
+        return;
+    }
+
+    m_packLimit = static_cast<std::size_t>(std::max(0LL, Configuration::getInteger("segment-pack-limit", 64 * 1024)));
+    m_segmentSize = std::max(1LL, Configuration::getInteger("segment-size", 64)) * 1024 * 1024;
+    m_interval = std::chrono::minutes(Configuration::getInteger("segment-compaction-interval", 60));
+    m_threshold = std::clamp(Configuration::getInteger("segment-compaction-threshold", 50), 0LL, 100LL);
+
+    if (m_interval.count() <= 0) {
+        return;
+    }
+    m_isStopping = false;
+    m_thread = std::thread(&SegmentStore::run, this);
+}
+
+void SegmentStore::stop()
+{
+    {
+        std::lock_guard lock(m_mutex);
+        m_isStopping = true;
+    }
+    m_condition.notify_all();
+
+    if (m_thread.joinable()) {
+        m_thread.join();
+    }
+}
+
+SegmentStore::Location SegmentStore::append(std::string_view content)
+{
+    // Appends are small, so writing while holding the lock is simpler than
+    // handing out ranges and costs little.
+    std::lock_guard lock(m_appendMutex);
+    if (m_activeFd < 0 || (m_activeSize > 0 && m_activeSize + static_cast<int64_t>(content.size()) > m_segmentSize)) {
+        openSegment();
+    }
+
+    Location location { m_activeSegmentId, m_activeSize };
+    const char* data = content.data();
+    std::size_t remaining = content.size();
+    auto offset = static_cast<off_t>(m_activeSize);
+    while (remaining > 0) {
+        ssize_t written = pwrite(m_activeFd, data, remaining, offset);
+        if (written < 0 && errno == EINTR) {
+            continue;
+        }
+        if (written <= 0) {
+            // Whatever was written is never used, and the compactor reclaims
+            // it with the rest of the segment.
+            m_activeSize = static_cast<int64_t>(offset);
+            throw std::runtime_error("The file couldn't be saved.");
+        }
+        data += written;
+        remaining -= static_cast<std::size_t>(written);
+        offset += written;
+    }
+    m_activeSize = static_cast<int64_t>(offset);
+    return location;
+}
+
+std::optional<std::string> SegmentStore::read(long long segmentId, int64_t offset, int64_t size)
+{
+    int fd = open(getPath(segmentId).c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return std::nullopt;
+    }
+
+    std::string content(static_cast<std::size_t>(size), '\0');
+    std::size_t bytesRead = 0;
+    while (bytesRead < content.size()) {
+        ssize_t result = pread(fd, content.data() + bytesRead, content.size() - bytesRead, static_cast<off_t>(offset) + static_cast<off_t>(bytesRead));
+        if (result < 0 && errno == EINTR) {
+            continue;
+        }
+        if (result <= 0) {
+            break;
+        }
+        bytesRead += static_cast<std::size_t>(result);
+    }
+    close(fd);
+
+    if (bytesRead < content.size()) {
+        return std::nullopt;
+    }
+    return content;
+}
+
+std::filesystem::path SegmentStore::getPath(long long segmentId)
+{
+    return std::filesystem::path(File::FILE_SYSTEM_ROOT) / SEGMENT_FOLDER / std::to_string(segmentId);
+}
+
+void SegmentStore::compact(Wt::Dbo::Session& databaseSession)
+{
+    static auto& timeHistogram = Metrics::instance().getHistogram("cgs_segment_compaction_duration_seconds", "Time taken to compact the segments that small files are packed into.", Metrics::Unit::Microseconds);
+    static auto& reclaimedHistogram = Metrics::instance().getHistogram("cgs_segment_compaction_reclaimed_bytes", "Bytes of unused content removed from segments by each compaction.", Metrics::Unit::Bytes);
+    Metrics::ScopedTimer timer(timeHistogram);
+
+    // Content is appended before the transaction that uses it is committed,
+    // so a segment is only compacted once it had already been replaced by a
+    // newer one at the previous compaction. Segments from before a restart
+    // are never appended to again.
+    long long compactableBefore = 0;
+    {
+        std::lock_guard lock(m_appendMutex);
+        if (m_activeFd < 0) {
+            openSegment();
+        }
+        compactableBefore = m_previousSegmentId != 0 ? m_previousSegmentId : m_firstSegmentId;
+        m_previousSegmentId = m_activeSegmentId;
+    }
+
+    std::vector<std::pair<long long, int64_t>> segments;
+    std::error_code error;
+    auto segmentFolder = std::filesystem::path(File::FILE_SYSTEM_ROOT) / SEGMENT_FOLDER;
+    for (std::filesystem::directory_iterator iterator(segmentFolder, error), end; !error && iterator != end; iterator.increment(error)) {
+        auto segmentId = parseSegmentName(iterator->path().filename().string());
+        std::error_code sizeError;
+        auto size = iterator->file_size(sizeError);
+        if (segmentId && *segmentId < compactableBefore && !sizeError) {
+            segments.emplace_back(*segmentId, static_cast<int64_t>(size));
+        }
+    }
+
+    std::unordered_map<long long, int64_t> usedSizes;
+    {
+        Wt::Dbo::Transaction transaction(databaseSession);
+        auto query = databaseSession.query<std::tuple<long long, long long>>("SELECT segment_id, SUM(file_size) FROM files WHERE segment_id > 0 GROUP BY segment_id");
+        for (const auto& [segmentId, usedSize] : query.resultList()) {
+            usedSizes[segmentId] = usedSize;
+        }
+    }
+
+    uint64_t reclaimedBytes = 0;
+    for (const auto& [segmentId, size] : segments) {
+        int64_t usedSize = usedSizes[segmentId];
+        if (usedSize * 100 >= size * m_threshold) {
+            continue;
+        }
+        if (isStopping()) {
+            break;
+        }
+        if (compactSegment(databaseSession, segmentId)) {
+            reclaimedBytes += static_cast<uint64_t>(size - usedSize);
+        }
+    }
+    reclaimedHistogram.record(reclaimedBytes);
+}
+
+void SegmentStore::run()
+{
+    auto databaseSession = StorageApplication::createDatabaseSession();
+
+    while (true) {
+        {
+            std::unique_lock lock(m_mutex);
+            m_condition.wait_for(lock, m_interval, [this] { return m_isStopping; });
+            if (m_isStopping) {
+                return;
+            }
+        }
+
+        try {
+            compact(*databaseSession);
+        } catch (const std::exception& ex) {
+            // Most likely the database was busy. Nothing is lost, since the
+            // segments are only deleted once nothing uses them.
+            std::cerr << "SegmentStore: Failed to compact segments: " << ex.what() << std::endl;
+        }
+    }
+}
+
+void SegmentStore::openSegment()
+{
+    std::error_code error;
+    auto segmentFolder = std::filesystem::path(File::FILE_SYSTEM_ROOT) / SEGMENT_FOLDER;
+    std::filesystem::create_directories(segmentFolder, error);
+
+    // Segments are never appended to after a restart, so a segment that was
+    // cut short by a crash is only ever read up to content that was saved.
+    long long lastSegmentId = m_activeSegmentId;
+    for (std::filesystem::directory_iterator iterator(segmentFolder, error), end; !error && iterator != end; iterator.increment(error)) {
+        lastSegmentId = std::max(lastSegmentId, parseSegmentName(iterator->path().filename().string()).value_or(0));
+    }
+
+    int fd = open(getPath(lastSegmentId + 1).c_str(), O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0666);
+    if (fd < 0) {
+        throw std::runtime_error("The file couldn't be saved.");
+    }
+    if (m_activeFd >= 0) {
+        close(m_activeFd);
+    }
+    m_activeSegmentId = lastSegmentId + 1;
+    if (m_firstSegmentId == 0) {
+        m_firstSegmentId = m_activeSegmentId;
+    }
+    m_activeFd = fd;
+    m_activeSize = 0;
+}
+
+bool SegmentStore::compactSegment(Wt::Dbo::Session& databaseSession, long long segmentId)
+{
+    std::vector<std::tuple<long long, long long, long long>> files;
+    {
+        Wt::Dbo::Transaction transaction(databaseSession);
+        auto query = databaseSession.query<std::tuple<long long, long long, long long>>("SELECT id, segment_offset, file_size FROM files WHERE segment_id = ?").bind(segmentId);
+        for (const auto& file : query.resultList()) {
+            files.push_back(file);
+        }
+    }
+
+    // The content is copied before the transaction, so that the database
+    // isn't locked while waiting for the filesystem. Files that change in the
+    // meantime are left alone, and the copy of their old content is unused.
+    std::vector<std::pair<std::tuple<long long, long long, long long>, Location>> moves;
+    bool isComplete = true;
+    for (const auto& file : files) {
+        const auto& [fileId, offset, size] = file;
+        auto content = read(segmentId, offset, size);
+        if (!content) {
+            std::cerr << "SegmentStore: Failed to read the content of file " << fileId << " from segment " << segmentId << std::endl;
+            isComplete = false;
+            continue;
+        }
+        moves.emplace_back(file, append(*content));
+    }
+
+    bool isUnused = false;
+    {
+        Wt::Dbo::Transaction transaction(databaseSession);
+        for (const auto& [file, location] : moves) {
+            const auto& [fileId, offset, size] = file;
+            databaseSession.execute("UPDATE files SET version = version + 1, segment_id = ?, segment_offset = ? WHERE id = ? AND segment_id = ? AND segment_offset = ?").bind(location.segmentId).bind(location.offset).bind(fileId).bind(segmentId).bind(offset).run();
+        }
+        if (isComplete && databaseSession.query<long long>("SELECT COUNT(1) FROM files WHERE segment_id = ?").bind(segmentId).resultValue() == 0) {
+            databaseSession.addNew<BlobDeletion>((std::filesystem::path(SEGMENT_FOLDER) / std::to_string(segmentId)).string());
+            isUnused = true;
+        }
+    }
+
+    if (isUnused) {
+        BlobGarbageCollector::instance().notify();
+    }
+    return isUnused;
+}
+
+bool SegmentStore::isStopping()
+{
+    std::lock_guard lock(m_mutex);
+    return m_isStopping;
+}
@@ -0,0 +1,171 @@
+/**
+ * \class SegmentStore
+ *
+ * Packs the content of small files into large append-only segment files, so
+ * that they don't each cost an inode and a partly used filesystem block.
+ *
+ * Segments are stored in `File::FILE_SYSTEM_ROOT/.segments`, named after
+ * their ID. New content is always appended to the newest segment, and a new
+ * segment is started once it reaches the `segment-size` property. A file
+ * records the segment and offset of its content, and its size is the length.
+ *
+ * Content that is replaced or deleted stays in its segment until the
+ * background compactor finds that too little of the segment is still used.
+ * The compactor then copies the content that is still used to the newest
+ * segment, points the files at the copies, and queues the old segment for
+ * the `BlobGarbageCollector`. Moving a file changes its version, so a session
+ * that still has the file loaded can't save the old location back.
+ *
+ * \date 2026-10-19 (last updated)
+ */
+
+#pragma once
+
+#include <Wt/Dbo/Session.h>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <thread>
+
+class SegmentStore {
+public:
+    /**
+     * The folder that segments are stored in, relative to
+     * `File::FILE_SYSTEM_ROOT`.
+     */
+    constexpr static std::string_view SEGMENT_FOLDER = ".segments";
+
+    /**
+     * Where some content was stored.
+     */
+    struct Location {
+        long long segmentId;
+        int64_t offset;
+    };
+
+    /**
+     * Gets the segment store for this server.
+     *
+     * \return The segment store.
+     */
+    static SegmentStore& instance();
+
+    ~SegmentStore();
+
+    SegmentStore(const SegmentStore&) = delete;
+    SegmentStore& operator=(const SegmentStore&) = delete;
+
+    /**
+     * Reads the configuration and starts the compactor's background thread,
+     * unless `segment-compaction-interval` is 0.
+     */
+    void start();
+
+    /**
+     * Stops the compactor, waiting for the current segment to finish.
+     */
+    void stop();
+
+    /**
+     * Gets the size up to which files are packed into segments, from the
+     * `segment-pack-limit` property.
+     *
+     * \return The size in bytes, or 0 if files aren't packed.
+     */
+    std::size_t getPackLimit() const { return m_packLimit; }
+
+    /**
+     * Appends content to the newest segment.
+     *
+     * This can be called from any thread.
+     *
+     * \param content The content.
+     * \return        Where the content was stored.
+     * \exception std::runtime_error If the content couldn't be saved.
+     */
+    Location append(std::string_view content);
+
+    /**
+     * Reads content from a segment.
+     *
+     * \param segmentId The ID of the segment.
+     * \param offset    Where the content starts.
+     * \param size      The size of the content.
+     * \return          The content, or `std::nullopt` if it couldn't be read.
+     */
+    static std::optional<std::string> read(long long segmentId, int64_t offset, int64_t size);
+
+    /**
+     * Gets the path of a segment.
+     *
+     * \param segmentId The ID of the segment.
+     * \return          The path.
+     */
+    static std::filesystem::path getPath(long long segmentId);
+
+    /**
+     * Compacts every older segment where less than
+     * `segment-compaction-threshold` percent of the content is still used.
+     *
+     * This is done periodically by the background thread.
+     *
+     * \param databaseSession The database session to use.
+     */
+    void compact(Wt::Dbo::Session& databaseSession);
+
+private:
+    std::size_t m_packLimit { 64 * 1024 };
+    int64_t m_segmentSize { 64 * 1024 * 1024 };
+    std::chrono::minutes m_interval { 60 };
+    long long m_threshold { 50 };
+
+    // The newest segment, which content is appended to.
+    std::mutex m_appendMutex;
+    long long m_activeSegmentId { 0 };
+    int m_activeFd { -1 };
+    int64_t m_activeSize { 0 };
+    // The first segment started by this process, and the newest segment at
+    // the previous compaction.
+    long long m_firstSegmentId { 0 };
+    long long m_previousSegmentId { 0 };
+
+    std::thread m_thread;
+    std::mutex m_mutex;
+    std::condition_variable m_condition;
+    bool m_isStopping { false };
+
+    SegmentStore() = default;
+
+    /**
+     * The main loop of the background thread.
+     */
+    void run();
+
+    /**
+     * Starts a new segment after the newest one on disk.
+     *
+     * This must be called with `m_appendMutex` held.
+     */
+    void openSegment();
+
+    /**
+     * Moves the content that is still used out of a segment, and queues the
+     * segment for deletion if nothing uses it any more.
+     *
+     * \param databaseSession The database session to use.
+     * \param segmentId       The ID of the segment.
+     * \return                Whether the segment was queued for deletion.
+     */
+    bool compactSegment(Wt::Dbo::Session& databaseSession, long long segmentId);
+
+    /**
+     * Checks whether the background thread has been asked to stop.
+     */
+    bool isStopping();
+};
@@ -0,0 +1,23 @@
+#include "SessionMemory.h"
+
+#include <atomic>
+#include <memory>
+#include "StorageApplication.h"
+
+void SessionMemory::add(std::size_t size)
+{
+    m_objectCount.fetch_add(1, std::memory_order_relaxed);
+    m_byteCount.fetch_add(static_cast<long long>(size), std::memory_order_relaxed);
+}
+
+void SessionMemory::remove(std::size_t size)
+{
+    m_objectCount.fetch_sub(1, std::memory_order_relaxed);
+    m_byteCount.fetch_sub(static_cast<long long>(size), std::memory_order_relaxed);
+}
+
+std::shared_ptr<SessionMemory> SessionMemory::getCurrent()
+{
+    auto* application = StorageApplication::instance();
+    return application != nullptr ? application->getSessionMemory() : nullptr;
+}
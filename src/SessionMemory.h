@@ -0,0 +1,86 @@
+/**
+ * \class SessionMemory
+ *
+ * Counts the database objects that a browser session has loaded, and roughly
+ * how much memory they use.
+ *
+ * `Wt::Dbo` already frees an object once nothing points to it, so what a
+ * session keeps is whatever its widgets point to. Each model class has a
+ * `SessionMemory::Tracker` member that adds its object to the
+ * `SessionMemory` of the application that loaded it, so `StorageApplication`
+ * can tell when a session holds too much. Objects loaded outside of a browser
+ * session, such as by the API or the background tasks, aren't counted.
+ *
+ * \date 2026-10-19 (last updated)
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+
+class SessionMemory {
+public:
+    /**
+     * Counts one object of type `T` for as long as it exists.
+     *
+     * The size only includes the object itself, and not the text stored in
+     * its strings.
+     */
+    template <class T>
+    class Tracker {
+    public:
+        Tracker()
+            : m_memory(getCurrent())
+        {
+            if (m_memory) {
+                m_memory->add(sizeof(T));
+            }
+        }
+
+        Tracker(const Tracker& /* other */)
+            : Tracker()
+        {
+        }
+
+        Tracker& operator=(const Tracker& /* other */) { return *this; }
+
+        ~Tracker()
+        {
+            if (m_memory) {
+                m_memory->remove(sizeof(T));
+            }
+        }
+
+    private:
+        std::shared_ptr<SessionMemory> m_memory;
+    };
+
+    /**
+     * Gets the number of objects that are currently loaded.
+     *
+     * \return The number of objects.
+     */
+    long long getObjectCount() const { return m_objectCount.load(std::memory_order_relaxed); }
+
+    /**
+     * Gets the approximate size of the objects that are currently loaded.
+     *
+     * \return The size in bytes.
+     */
+    long long getByteCount() const { return m_byteCount.load(std::memory_order_relaxed); }
+
+private:
+    std::atomic<long long> m_objectCount { 0 };
+    std::atomic<long long> m_byteCount { 0 };
+
+    void add(std::size_t size);
+    void remove(std::size_t size);
+
+    /**
+     * Gets the memory of the application whose event is being handled on
+     * this thread, if any.
+     */
+    static std::shared_ptr<SessionMemory> getCurrent();
+};
@@ -0,0 +1,218 @@
+#include "Sha256.h"
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+
+// Reference: https://nvlpubs.nist.gov/nistpubs/FIPS/NIST.FIPS.180-4.pdf
+
+constexpr std::array<uint32_t, 64> ROUND_CONSTANTS {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+};
+
+constexpr std::array<uint32_t, 8> INITIAL_STATE {
+    0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19,
+};
+
+static uint32_t rotateRight(uint32_t value, int count)
+{
+    return (value >> count) | (value << (32 - count));
+}
+
+Sha256::Sha256()
+    : m_state(INITIAL_STATE)
+{
+}
+
+void Sha256::update(std::string_view data)
+{
+    const auto* bytes = reinterpret_cast<const uint8_t*>(data.data());
+    std::size_t size = data.size();
+    m_totalSize += size;
+
+    if (m_blockSize > 0) {
+        std::size_t amount = std::min(size, BLOCK_SIZE - m_blockSize);
+        std::copy_n(bytes, amount, m_block.begin() + static_cast<std::ptrdiff_t>(m_blockSize));
+        m_blockSize += amount;
+        bytes += amount;
+        size -= amount;
+        if (m_blockSize < BLOCK_SIZE) {
+            return;
+        }
+        processBlock(m_block.data());
+        m_blockSize = 0;
+    }
+
+    // Full blocks are hashed straight from the input, without copying.
+    for (; size >= BLOCK_SIZE; bytes += BLOCK_SIZE, size -= BLOCK_SIZE) {
+        processBlock(bytes);
+    }
+
+    std::copy_n(bytes, size, m_block.begin());
+    m_blockSize = size;
+}
+
+Sha256::Digest Sha256::finish()
+{
+    const uint64_t totalBits = m_totalSize * 8;
+
+    // Pad with a single 1 bit, then zeros up to the last 8 bytes of a block,
+    // which hold the length.
+    m_block[m_blockSize++] = 0x80;
+    if (m_blockSize > BLOCK_SIZE - 8) {
+        std::fill(m_block.begin() + static_cast<std::ptrdiff_t>(m_blockSize), m_block.end(), 0);
+        processBlock(m_block.data());
+        m_blockSize = 0;
+    }
+    std::fill(m_block.begin() + static_cast<std::ptrdiff_t>(m_blockSize), m_block.end() - 8, 0);
+    for (int i = 0; i < 8; ++i) {
+        m_block[BLOCK_SIZE - 1 - i] = static_cast<uint8_t>(totalBits >> (8 * i));
+    }
+    processBlock(m_block.data());
+
+    Digest digest {};
+    for (std::size_t i = 0; i < m_state.size(); ++i) {
+        for (std::size_t j = 0; j < 4; ++j) {
+            digest[i * 4 + j] = static_cast<uint8_t>(m_state[i] >> (24 - 8 * j));
+        }
+    }
+    return digest;
+}
+
+Sha256::Digest Sha256::hash(std::string_view data)
+{
+    Sha256 sha256;
+    sha256.update(data);
+    return sha256.finish();
+}
+
+Sha256::Digest Sha256::hmac(std::string_view key, std::string_view message)
+{
+    // Reference: https://datatracker.ietf.org/doc/html/rfc2104
+    std::string blockKey(BLOCK_SIZE, '\0');
+    if (key.size() > BLOCK_SIZE) {
+        auto keyHash = hash(key);
+        std::copy(keyHash.begin(), keyHash.end(), blockKey.begin());
+    } else {
+        std::copy(key.begin(), key.end(), blockKey.begin());
+    }
+
+    std::string innerPad = blockKey;
+    std::string outerPad = blockKey;
+    for (std::size_t i = 0; i < BLOCK_SIZE; ++i) {
+        innerPad[i] = static_cast<char>(innerPad[i] ^ 0x36);
+        outerPad[i] = static_cast<char>(outerPad[i] ^ 0x5c);
+    }
+
+    Sha256 inner;
+    inner.update(innerPad);
+    inner.update(message);
+    auto innerHash = inner.finish();
+
+    Sha256 outer;
+    outer.update(outerPad);
+    outer.update(std::string_view(reinterpret_cast<const char*>(innerHash.data()), innerHash.size()));
+    return outer.finish();
+}
+
+std::string Sha256::toHex(const Digest& digest)
+{
+    constexpr std::string_view HEX_DIGITS = "0123456789abcdef";
+    std::string hex;
+    hex.reserve(DIGEST_SIZE * 2);
+    for (uint8_t byte : digest) {
+        hex += HEX_DIGITS[byte >> 4];
+        hex += HEX_DIGITS[byte & 0xf];
+    }
+    return hex;
+}
+
+std::optional<Sha256::Digest> Sha256::fromHex(std::string_view hex)
+{
+    if (hex.size() != DIGEST_SIZE * 2) {
+        return std::nullopt;
+    }
+    auto toNibble = [](char digit) -> int {
+        if (digit >= '0' && digit <= '9') {
+            return digit - '0';
+        }
+        if (digit >= 'a' && digit <= 'f') {
+            return digit - 'a' + 10;
+        }
+        if (digit >= 'A' && digit <= 'F') {
+            return digit - 'A' + 10;
+        }
+        return -1;
+    };
+
+    Digest digest {};
+    for (std::size_t i = 0; i < DIGEST_SIZE; ++i) {
+        int high = toNibble(hex[i * 2]);
+        int low = toNibble(hex[i * 2 + 1]);
+        if (high < 0 || low < 0) {
+            return std::nullopt;
+        }
+        digest[i] = static_cast<uint8_t>((high << 4) | low);
+    }
+    return digest;
+}
+
+bool Sha256::isEqual(const Digest& first, const Digest& second)
+{
+    uint8_t difference = 0;
+    for (std::size_t i = 0; i < DIGEST_SIZE; ++i) {
+        difference |= first[i] ^ second[i];
+    }
+    return difference == 0;
+}
+
+void Sha256::processBlock(const uint8_t* block)
+{
+    std::array<uint32_t, 64> schedule {};
+    for (std::size_t i = 0; i < 16; ++i) {
+        schedule[i] = (static_cast<uint32_t>(block[i * 4]) << 24) | (static_cast<uint32_t>(block[i * 4 + 1]) << 16) | (static_cast<uint32_t>(block[i * 4 + 2]) << 8) | block[i * 4 + 3];
+    }
+    for (std::size_t i = 16; i < 64; ++i) {
+        uint32_t sigma0 = rotateRight(schedule[i - 15], 7) ^ rotateRight(schedule[i - 15], 18) ^ (schedule[i - 15] >> 3);
+        uint32_t sigma1 = rotateRight(schedule[i - 2], 17) ^ rotateRight(schedule[i - 2], 19) ^ (schedule[i - 2] >> 10);
+        schedule[i] = schedule[i - 16] + sigma0 + schedule[i - 7] + sigma1;
+    }
+
+    auto [a, b, c, d, e, f, g, h] = m_state;
+    for (std::size_t i = 0; i < 64; ++i) {
+        uint32_t sum1 = rotateRight(e, 6) ^ rotateRight(e, 11) ^ rotateRight(e, 25);
+        uint32_t choice = (e & f) ^ (~e & g);
+        uint32_t temp1 = h + sum1 + choice + ROUND_CONSTANTS[i] + schedule[i];
+        uint32_t sum0 = rotateRight(a, 2) ^ rotateRight(a, 13) ^ rotateRight(a, 22);
+        uint32_t majority = (a & b) ^ (a & c) ^ (b & c);
+        uint32_t temp2 = sum0 + majority;
+
+        h = g;
+        g = f;
+        f = e;
+        e = d + temp1;
+        d = c;
+        c = b;
+        b = a;
+        a = temp1 + temp2;
+    }
+
+    m_state[0] += a;
+    m_state[1] += b;
+    m_state[2] += c;
+    m_state[3] += d;
+    m_state[4] += e;
+    m_state[5] += f;
+    m_state[6] += g;
+    m_state[7] += h;
+}
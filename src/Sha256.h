@@ -0,0 +1,108 @@
+/**
+ * \class Sha256
+ *
+ * Computes SHA-256 hashes, and HMAC-SHA256 message authentication codes.
+ *
+ * Data can be added in pieces with `update`, so large files can be hashed
+ * without reading them into memory.
+ *
+ * \date 2026-10-19 (last updated)
+ */
+
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <string_view>
+
+class Sha256 {
+public:
+    /**
+     * The size of a hash, in bytes.
+     */
+    constexpr static std::size_t DIGEST_SIZE = 32;
+
+    /**
+     * A hash value.
+     */
+    using Digest = std::array<uint8_t, DIGEST_SIZE>;
+
+    /**
+     * Starts a new hash.
+     */
+    Sha256();
+
+    /**
+     * Adds data to the hash.
+     *
+     * \param data The data to add.
+     */
+    void update(std::string_view data);
+
+    /**
+     * Finishes the hash.
+     *
+     * The object must not be used again afterwards.
+     *
+     * \return The hash of all the data that was added.
+     */
+    Digest finish();
+
+    /**
+     * Hashes a piece of data.
+     *
+     * \param data The data to hash.
+     * \return     The hash.
+     */
+    static Digest hash(std::string_view data);
+
+    /**
+     * Computes an HMAC-SHA256 message authentication code.
+     *
+     * \param key     The secret key.
+     * \param message The message to authenticate.
+     * \return        The message authentication code.
+     */
+    static Digest hmac(std::string_view key, std::string_view message);
+
+    /**
+     * Converts a hash to lowercase hexadecimal.
+     *
+     * \param digest The hash to convert.
+     * \return       A string of `2 * DIGEST_SIZE` characters.
+     */
+    static std::string toHex(const Digest& digest);
+
+    /**
+     * Converts hexadecimal from `toHex` back to a hash.
+     *
+     * \param hex The hexadecimal, in either case.
+     * \return    The hash, or `std::nullopt` if `hex` isn't a hash.
+     */
+    static std::optional<Digest> fromHex(std::string_view hex);
+
+    /**
+     * Compares two hashes in a constant amount of time, so that the
+     * comparison doesn't reveal how much of a secret value was guessed
+     * correctly.
+     *
+     * \return `true` if the hashes are equal.
+     */
+    static bool isEqual(const Digest& first, const Digest& second);
+
+private:
+    constexpr static std::size_t BLOCK_SIZE = 64;
+
+    std::array<uint32_t, 8> m_state;
+    std::array<uint8_t, BLOCK_SIZE> m_block {};
+    std::size_t m_blockSize { 0 };
+    uint64_t m_totalSize { 0 };
+
+    /**
+     * Adds a full block to the hash.
+     */
+    void processBlock(const uint8_t* block);
+};
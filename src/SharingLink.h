@@ -18,6 +18,7 @@
 #include <Wt/Dbo/ptr.h>
 #include <string>
 #include <utility>
+#include "SessionMemory.h"
 #include "User.h"
 
 class File;
@@ -26,6 +27,7 @@ class SharingLink {
 private:
     std::string m_urlID;
     Wt::Dbo::ptr<File> m_file;
+    SessionMemory::Tracker<SharingLink> m_memoryTracker;
 
 public:
     /**
@@ -1,26 +1,58 @@
 #include "StorageApplication.h"
 
 #include <Wt/Dbo/Session.h>
-#include <Wt/Dbo/backend/Sqlite3.h>
 #include <Wt/WApplication.h>
 #include <Wt/WContainerWidget.h>
+#include <Wt/WEvent.h>
 #include <Wt/WGlobal.h>
 #include <Wt/WLineEdit.h>
 #include <Wt/WPushButton.h>
 #include <Wt/WText.h>
+#include <algorithm>
+#include <cstdint>
+#include <cstddef>
 #include <cstdlib>
 #include <memory>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include "ApiToken.h"
+#include "BlobDeletion.h"
+#include "BlobGarbageCollector.h"
+#include "BlobIo.h"
+#include "Change.h"
+#include "Chunk.h"
+#include "Configuration.h"
+#include "DatabaseConnection.h"
+#include "Executor.h"
 #include "File.h"
+#include "FileStoragePage.h"
+#include "FileVersion.h"
 #include "FileViewPage.h"
 #include "Folder.h"
-#include "LoginPage.h"
+#include "FolderStoragePage.h"
+#include "LoginResource.h"
+#include "Metrics.h"
+#include "OrphanScanner.h"
+#include "PreviewGenerator.h"
+#include "QueryTrace.h"
+#include "SegmentStore.h"
+#include "SessionMemory.h"
 #include "User.h"
 
 constexpr const char* USERS_TABLE_EXISTS_QUERY = "SELECT EXISTS(SELECT 1 FROM sqlite_master WHERE type = 'table' AND name = 'users')";
 
+// Wt::Dbo doesn't create indexes, so they are added after the tables.
+constexpr const char* CREATE_FILE_TYPE_INDEX = "CREATE INDEX files_parent_extension ON files (parent_id, extension, name)";
+constexpr const char* CREATE_CHANGE_OWNER_INDEX = "CREATE INDEX changes_owner ON changes (owner_id, id)";
+constexpr const char* CREATE_CHUNK_HASH_INDEX = "CREATE UNIQUE INDEX chunks_hash ON chunks (hash)";
+constexpr const char* CREATE_FILE_SEGMENT_INDEX = "CREATE INDEX files_segment ON files (segment_id) WHERE segment_id > 0";
+constexpr const char* CREATE_FILE_VERSION_FILE_INDEX = "CREATE INDEX file_versions_file ON file_versions (file_id, id)";
+
 StorageApplication::StorageApplication(const Wt::WEnvironment& env)
     : Wt::WApplication(env)
-    , m_databaseSession(createDatabaseSession())
+    , m_sessionMemory(std::make_shared<SessionMemory>())
+    , m_maxLoadedObjects(std::max(0LL, Configuration::getInteger("session-object-limit", 10000)))
 {
 
     setTitle("Cloud Goose Storage");
@@ -29,8 +61,22 @@ StorageApplication::StorageApplication(const Wt::WEnvironment& env)
     useStyleSheet(Wt::WLink("/cloud-goose-storage.css"));
     root()->addStyleClass("root");
 
-    auto loginPage = std::make_unique<LoginPage>(*m_databaseSession);
-    switchPage(std::move(loginPage));
+    // Only visitors who just logged in with LoginResource get a database
+    // session. Everyone else is sent back to the login page.
+    const std::string* ticket = env.getCookie(std::string(LoginResource::TICKET_COOKIE));
+    std::optional<long long> userId = ticket != nullptr ? LoginResource::redeemTicket(*ticket) : std::nullopt;
+    if (!userId) {
+        redirect(std::string(LoginResource::LOGIN_PATH));
+        quit();
+        return;
+    }
+    m_databaseSession = createDatabaseSession();
+
+    internalPathChanged().connect([this] {
+        showInternalPath();
+    });
+
+    logIn(m_databaseSession->loadLazy<User>(*userId));
 }
 
 StorageApplication* StorageApplication::instance()
@@ -40,14 +86,16 @@ StorageApplication* StorageApplication::instance()
 
 std::unique_ptr<Wt::Dbo::Session> StorageApplication::createDatabaseSession()
 {
-    auto databaseConnection = std::make_unique<Wt::Dbo::backend::Sqlite3>("CloudGooseStorage.db");
+    return createDatabaseSession(std::string(DATABASE_PATH));
+}
+
+std::unique_ptr<Wt::Dbo::Session> StorageApplication::createDatabaseSession(const std::string& databasePath)
+{
+    auto databaseConnection = std::make_unique<DatabaseConnection>(databasePath);
     auto databaseSession = std::make_unique<Wt::Dbo::Session>();
     databaseSession->setConnection(std::move(databaseConnection));
 
-    databaseSession->mapClass<File>("files");
-    databaseSession->mapClass<Folder>("folders");
-    databaseSession->mapClass<SharingLink>("sharing_links");
-    databaseSession->mapClass<User>("users");
+    mapClasses(*databaseSession);
 
     // Check if the users table exists. If it does, we assume that all the
     // tables are correct.
@@ -58,13 +106,142 @@ std::unique_ptr<Wt::Dbo::Session> StorageApplication::createDatabaseSession()
     }
     if (!usersTableExists) {
         databaseSession->createTables();
+
+        Wt::Dbo::Transaction transaction(*databaseSession);
+        databaseSession->execute(CREATE_FILE_TYPE_INDEX);
+        databaseSession->execute(CREATE_CHANGE_OWNER_INDEX);
+        databaseSession->execute(CREATE_CHUNK_HASH_INDEX);
+        databaseSession->execute(CREATE_FILE_SEGMENT_INDEX);
+        databaseSession->execute(CREATE_FILE_VERSION_FILE_INDEX);
     }
 
     return databaseSession;
 }
 
-void StorageApplication::switchPage(std::unique_ptr<Wt::WWidget> newPage)
+void StorageApplication::mapClasses(Wt::Dbo::Session& databaseSession)
+{
+    databaseSession.mapClass<ApiToken>("api_tokens");
+    databaseSession.mapClass<BlobDeletion>("blob_deletions");
+    databaseSession.mapClass<Change>("changes");
+    databaseSession.mapClass<Chunk>("chunks");
+    databaseSession.mapClass<File>("files");
+    databaseSession.mapClass<FileVersion>("file_versions");
+    databaseSession.mapClass<Folder>("folders");
+    databaseSession.mapClass<SharingLink>("sharing_links");
+    databaseSession.mapClass<User>("users");
+}
+
+void StorageApplication::startServices()
 {
-    root()->clear();
-    root()->addWidget(std::move(newPage));
+    Executor::instance().start();
+    BlobIo::instance().start();
+    BlobGarbageCollector::instance().start();
+    OrphanScanner::instance().start();
+    PreviewGenerator::instance().start();
+    SegmentStore::instance().start();
+}
+
+void StorageApplication::stopServices()
+{
+    SegmentStore::instance().stop();
+    PreviewGenerator::instance().stop();
+    OrphanScanner::instance().stop();
+    BlobGarbageCollector::instance().stop();
+    BlobIo::instance().stop();
+    Executor::instance().stop();
+}
+
+void StorageApplication::notify(const Wt::WEvent& event)
+{
+    {
+        QueryTrace trace("Event in session " + sessionId());
+        Wt::WApplication::notify(event);
+    }
+    limitSessionMemory();
+}
+
+void StorageApplication::limitSessionMemory()
+{
+    static auto& objectHistogram = Metrics::instance().getHistogram("cgs_session_loaded_objects", "Number of database objects loaded by a browser session, after each event.", Metrics::Unit::Count);
+    static auto& byteHistogram = Metrics::instance().getHistogram("cgs_session_loaded_bytes", "Approximate memory used by the database objects loaded by a browser session, after each event.", Metrics::Unit::Bytes);
+    static auto& unloadHistogram = Metrics::instance().getHistogram("cgs_session_unloaded_objects", "Number of database objects unloaded when a browser session went over session-object-limit.", Metrics::Unit::Count);
+
+    if (!m_databaseSession) {
+        return;
+    }
+
+    long long objectCount = m_sessionMemory->getObjectCount();
+    if (m_maxLoadedObjects > 0 && objectCount > m_maxLoadedObjects) {
+        // Wt::Dbo doesn't say which objects were used recently, so everything
+        // is unloaded instead. Every transaction has been committed by the
+        // end of an event, so no changes are lost. Only the ID and version of
+        // each object are kept, which frees almost all of their memory.
+        m_databaseSession->rereadAll();
+        unloadHistogram.record(static_cast<uint64_t>(std::max(0LL, objectCount - m_sessionMemory->getObjectCount())));
+        objectCount = m_sessionMemory->getObjectCount();
+    }
+
+    objectHistogram.record(static_cast<uint64_t>(std::max(0LL, objectCount)));
+    byteHistogram.record(static_cast<uint64_t>(std::max(0LL, m_sessionMemory->getByteCount())));
+}
+
+void StorageApplication::logIn(const Wt::Dbo::ptr<User>& user)
+{
+    m_user = user;
+    m_fileViewPage = root()->addNew<FileViewPage>(m_user, *m_databaseSession);
+
+    if (!internalPathMatches("/folders/")) {
+        setInternalPath(getFolderPath(m_fileViewPage->getRootFolderId()));
+    }
+    showInternalPath();
+}
+
+void StorageApplication::logOut()
+{
+    // The session ends, so nothing it loaded is kept.
+    redirect(std::string(LoginResource::LOGIN_PATH));
+    quit();
+}
+
+std::string StorageApplication::getFolderPath(long long folderId)
+{
+    return "/folders/" + std::to_string(folderId);
+}
+
+void StorageApplication::showInternalPath()
+{
+    if (m_folderActionPage) {
+        root()->removeWidget(m_folderActionPage);
+        m_folderActionPage = nullptr;
+    }
+
+    std::string folderPart = internalPathNextPart("/folders/");
+    long long folderId = 0;
+    try {
+        std::size_t length = 0;
+        folderId = std::stoll(folderPart, &length);
+        if (length != folderPart.size()) {
+            folderId = 0;
+        }
+    } catch (const std::logic_error&) {
+        folderId = 0;
+    }
+
+    long long rootFolderId = m_fileViewPage->getRootFolderId();
+    if (!m_fileViewPage->showFolder(folderId)) {
+        if (folderId != rootFolderId) {
+            setInternalPath(getFolderPath(rootFolderId), true);
+        }
+        return;
+    }
+
+    // The file view page is only hidden while these pages are shown, so that
+    // going back to it doesn't rebuild it.
+    std::string action = internalPathNextPart(getFolderPath(folderId) + "/");
+    if (action == "upload") {
+        m_folderActionPage = root()->addNew<FileStoragePage>(m_user, *m_databaseSession, m_databaseSession->loadLazy<Folder>(folderId));
+    } else if (action == "new-folder") {
+        m_folderActionPage = root()->addNew<FolderStoragePage>(m_user, *m_databaseSession, m_databaseSession->loadLazy<Folder>(folderId));
+    }
+    m_fileViewPage->setHidden(m_folderActionPage != nullptr);
 }
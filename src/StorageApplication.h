@@ -11,18 +11,43 @@
 
 #include <Wt/Dbo/Session.h>
 #include <Wt/WApplication.h>
+#include <Wt/WEvent.h>
 #include <Wt/WGlobal.h>
+#include <memory>
+#include <string>
+#include <string_view>
+#include "SessionMemory.h"
+#include "User.h"
+
+class FileViewPage;
 
 class StorageApplication : public Wt::WApplication {
 private:
+    // This is created first so that every object loaded by the database
+    // session can be counted.
+    std::shared_ptr<SessionMemory> m_sessionMemory;
+    // This is null until the visitor's login ticket has been checked.
     std::unique_ptr<Wt::Dbo::Session> m_databaseSession;
+    long long m_maxLoadedObjects;
+    Wt::Dbo::ptr<User> m_user;
+    // Both of these are owned by the root container, and are null when not
+    // shown.
+    FileViewPage* m_fileViewPage { nullptr };
+    Wt::WWidget* m_folderActionPage { nullptr };
 
 public:
+    /**
+     * The SQLite database file that all data is stored in.
+     */
+    constexpr static std::string_view DATABASE_PATH = "CloudGooseStorage.db";
+
     /**
      * Creates a new `StorageApplication`.
      *
      * There will be one instance of `StorageApplication` for each user that is
-     * using the application simultaneously.
+     * using the application simultaneously. It is only created after logging
+     * in with `LoginResource`, and without a valid ticket it just redirects
+     * back to the login page.
      *
      * \param env The `WEnvironment` to create the application with.
      */
@@ -47,9 +72,104 @@ public:
     static std::unique_ptr<Wt::Dbo::Session> createDatabaseSession();
 
     /**
-     * Switch this application to a different page.
+     * Creates a new Wt::Dbo database session for a database other than the
+     * usual one, creating its tables if they don't exist.
+     *
+     * This is meant for tools and benchmarks that work on a copy of the data.
+     *
+     * \param databasePath The SQLite database file to use.
+     * \return             The created session.
+     */
+    static std::unique_ptr<Wt::Dbo::Session> createDatabaseSession(const std::string& databasePath);
+
+    /**
+     * Maps all the database classes to their tables.
+     *
+     * This is done automatically by `createDatabaseSession`. It only needs to
+     * be called for sessions that are set up in some other way.
+     *
+     * \param databaseSession The session to set up.
+     */
+    static void mapClasses(Wt::Dbo::Session& databaseSession);
+
+    /**
+     * Starts the work that the server does outside of any session, like
+     * collecting deleted blobs and compacting segments.
+     *
+     * The services are started in the order that they depend on each other,
+     * so this has to be called before the server starts.
+     */
+    static void startServices();
+
+    /**
+     * Stops the services started by `startServices`, in the reverse order.
+     *
+     * This has to be called after the server stops.
+     */
+    static void stopServices();
+
+    /**
+     * Logs the user out, ending this session, and goes to the login page.
+     */
+    void logOut();
+
+    /**
+     * Gets the internal path that shows a folder.
+     *
+     * Adding `/upload` or `/new-folder` to the path shows the pages for
+     * uploading a file or adding a folder to it.
+     *
+     * \param folderId The ID of the folder.
+     * \return         The internal path.
+     */
+    static std::string getFolderPath(long long folderId);
+
+    /**
+     * Gets the count of database objects that this application has loaded.
+     *
+     * \return The session's memory.
+     */
+    const std::shared_ptr<SessionMemory>& getSessionMemory() const { return m_sessionMemory; }
+
+protected:
+    /**
+     * Handles an event from the browser.
+     *
+     * This wraps each event in a `QueryTrace`, so events that make too many
+     * database queries can be found. Afterwards, if the session has loaded
+     * more database objects than allowed, they are all unloaded. The ones
+     * still in use are loaded again when they are next needed.
+     *
+     * \param event The event to handle.
+     */
+    void notify(const Wt::WEvent& event) override;
+
+private:
+    /**
+     * Records how much memory the session uses, and unloads its database
+     * objects if it is over the limit.
+     *
+     * This must only be called when no transaction is active, since changes
+     * that haven't been saved yet would be lost.
+     */
+    void limitSessionMemory();
+
+    /**
+     * Shows a user's files after they logged in.
+     *
+     * If the browser was already at one of the user's folders, that folder is
+     * shown, and otherwise their root folder is.
+     *
+     * \param user The user who logged in.
+     */
+    void logIn(const Wt::Dbo::ptr<User>& user);
+
+    /**
+     * Shows the page for the current internal path.
      *
-     * \param newPage The page to switch to.
+     * The file view page is kept when changing folders, so only the folder
+     * being shown is changed. Paths that aren't one of the user's folders go
+     * to their root folder instead.
      */
-    void switchPage(std::unique_ptr<Wt::WWidget> newPage);
+    void showInternalPath();
 };
@@ -0,0 +1,535 @@
+#include "Thumbnailer.h"
+
+#include <zlib.h>
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstdlib>
+#include <istream>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Reference: https://www.w3.org/TR/png/
+
+constexpr std::string_view PNG_SIGNATURE = "\x89PNG\r\n\x1a\n";
+
+// Limits that keep decoding time and memory reasonable for any input.
+constexpr uint32_t MAX_PNG_WIDTH = 16384;
+constexpr uint64_t MAX_PNG_PIXELS = 64 * 1024 * 1024;
+constexpr uint32_t MAX_PNG_CHUNK_SIZE = 0x7fffffff;
+// A palette has at most 256 entries of three bytes, and one alpha each.
+constexpr uint32_t MAX_PNG_PALETTE_SIZE = 256 * 3;
+constexpr uint32_t MAX_PNG_PALETTE_ALPHA_SIZE = 256;
+
+// How much of a text file is looked at for a text preview.
+constexpr std::size_t TEXT_PREVIEW_BYTES = 4096;
+constexpr int TEXT_PREVIEW_LINES = 12;
+constexpr int TEXT_PREVIEW_COLUMNS = 28;
+
+enum PngColorType : uint8_t {
+    Grayscale = 0,
+    Truecolor = 2,
+    Indexed = 3,
+    GrayscaleAlpha = 4,
+    TruecolorAlpha = 6,
+};
+
+static uint32_t readUint32(const unsigned char* bytes)
+{
+    return (static_cast<uint32_t>(bytes[0]) << 24) | (static_cast<uint32_t>(bytes[1]) << 16) | (static_cast<uint32_t>(bytes[2]) << 8) | bytes[3];
+}
+
+static void appendUint32(std::string& output, uint32_t value)
+{
+    output += static_cast<char>((value >> 24) & 0xff);
+    output += static_cast<char>((value >> 16) & 0xff);
+    output += static_cast<char>((value >> 8) & 0xff);
+    output += static_cast<char>(value & 0xff);
+}
+
+/**
+ * Decodes PNG image data one row at a time, and scales the rows down into a
+ * preview as they are decoded.
+ */
+class PngPreviewDecoder {
+public:
+    PngPreviewDecoder(uint32_t width, uint32_t height, uint8_t colorType)
+        : m_width(width)
+        , m_height(height)
+        , m_colorType(colorType)
+    {
+        switch (colorType) {
+        case Grayscale:
+        case Indexed:
+            m_bytesPerPixel = 1;
+            break;
+        case GrayscaleAlpha:
+            m_bytesPerPixel = 2;
+            break;
+        case Truecolor:
+            m_bytesPerPixel = 3;
+            break;
+        default:
+            m_bytesPerPixel = 4;
+            break;
+        }
+
+        const uint32_t largestSide = std::max(width, height);
+        if (largestSide > static_cast<uint32_t>(Thumbnailer::PREVIEW_SIZE)) {
+            m_previewWidth = std::max(1, static_cast<int>(static_cast<uint64_t>(width) * Thumbnailer::PREVIEW_SIZE / largestSide));
+            m_previewHeight = std::max(1, static_cast<int>(static_cast<uint64_t>(height) * Thumbnailer::PREVIEW_SIZE / largestSide));
+        } else {
+            m_previewWidth = static_cast<int>(width);
+            m_previewHeight = static_cast<int>(height);
+        }
+
+        const std::size_t stride = static_cast<std::size_t>(width) * m_bytesPerPixel;
+        m_row.resize(stride + 1);
+        m_previousRow.resize(stride);
+        m_sums.resize(static_cast<std::size_t>(m_previewWidth) * 4);
+        m_counts.resize(static_cast<std::size_t>(m_previewWidth));
+        m_preview.reserve(static_cast<std::size_t>(m_previewWidth) * m_previewHeight * 4);
+
+        // Palette entries are opaque unless a tRNS chunk says otherwise.
+        m_palette.fill({ 0, 0, 0, 255 });
+
+        m_isValid = inflateInit(&m_inflateStream) == Z_OK;
+    }
+
+    ~PngPreviewDecoder()
+    {
+        inflateEnd(&m_inflateStream);
+    }
+
+    PngPreviewDecoder(const PngPreviewDecoder&) = delete;
+    PngPreviewDecoder& operator=(const PngPreviewDecoder&) = delete;
+
+    void setPalette(const std::string& palette)
+    {
+        for (std::size_t i = 0; i + 2 < palette.size() && i / 3 < m_palette.size(); i += 3) {
+            auto& entry = m_palette[i / 3];
+            entry[0] = static_cast<uint8_t>(palette[i]);
+            entry[1] = static_cast<uint8_t>(palette[i + 1]);
+            entry[2] = static_cast<uint8_t>(palette[i + 2]);
+        }
+    }
+
+    void setPaletteAlpha(const std::string& alpha)
+    {
+        for (std::size_t i = 0; i < alpha.size() && i < m_palette.size(); ++i) {
+            m_palette[i][3] = static_cast<uint8_t>(alpha[i]);
+        }
+    }
+
+    /**
+     * Decodes part of the compressed image data.
+     *
+     * \return `false` if the data is invalid.
+     */
+    bool addData(const char* data, std::size_t size)
+    {
+        if (!m_isValid) {
+            return false;
+        }
+
+        std::array<unsigned char, 32 * 1024> buffer {};
+        m_inflateStream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data));
+        m_inflateStream.avail_in = static_cast<uInt>(size);
+        while (m_inflateStream.avail_in > 0 && !m_isStreamEnded) {
+            m_inflateStream.next_out = buffer.data();
+            m_inflateStream.avail_out = static_cast<uInt>(buffer.size());
+            int result = inflate(&m_inflateStream, Z_NO_FLUSH);
+            if (result != Z_OK && result != Z_STREAM_END) {
+                m_isValid = false;
+                return false;
+            }
+            m_isStreamEnded = result == Z_STREAM_END;
+
+            std::size_t produced = buffer.size() - m_inflateStream.avail_out;
+            for (std::size_t offset = 0; offset < produced && m_rowIndex < m_height;) {
+                std::size_t amount = std::min(produced - offset, m_row.size() - m_rowFilled);
+                std::copy_n(buffer.begin() + static_cast<std::ptrdiff_t>(offset), amount, m_row.begin() + static_cast<std::ptrdiff_t>(m_rowFilled));
+                offset += amount;
+                m_rowFilled += amount;
+                if (m_rowFilled == m_row.size()) {
+                    if (!processRow()) {
+                        m_isValid = false;
+                        return false;
+                    }
+                    m_rowFilled = 0;
+                }
+            }
+        }
+        return true;
+    }
+
+    /**
+     * Finishes decoding.
+     *
+     * \return The preview pixels, or an empty optional if the image was
+     *         incomplete.
+     */
+    std::optional<std::string> finish()
+    {
+        if (!m_isValid || m_rowIndex != m_height) {
+            return std::nullopt;
+        }
+        flushPreviewRow();
+        return std::move(m_preview);
+    }
+
+    int previewWidth() const { return m_previewWidth; }
+    int previewHeight() const { return m_previewHeight; }
+
+private:
+    uint32_t m_width;
+    uint32_t m_height;
+    uint8_t m_colorType;
+    std::size_t m_bytesPerPixel { 4 };
+    int m_previewWidth { 1 };
+    int m_previewHeight { 1 };
+
+    z_stream m_inflateStream {};
+    bool m_isValid { false };
+    bool m_isStreamEnded { false };
+
+    std::array<std::array<uint8_t, 4>, 256> m_palette {};
+
+    std::vector<uint8_t> m_row;
+    std::vector<uint8_t> m_previousRow;
+    std::size_t m_rowFilled { 0 };
+    uint32_t m_rowIndex { 0 };
+
+    // Sums of the source pixels that are averaged into the current preview
+    // row, 4 channels per preview pixel.
+    std::vector<uint32_t> m_sums;
+    std::vector<uint32_t> m_counts;
+    int m_previewRowIndex { 0 };
+    std::string m_preview;
+
+    bool processRow()
+    {
+        uint8_t filterType = m_row[0];
+        uint8_t* current = m_row.data() + 1;
+        const uint8_t* previous = m_previousRow.data();
+        const std::size_t stride = m_previousRow.size();
+
+        for (std::size_t i = 0; i < stride; ++i) {
+            const int left = i >= m_bytesPerPixel ? current[i - m_bytesPerPixel] : 0;
+            const int up = previous[i];
+            const int upLeft = i >= m_bytesPerPixel ? previous[i - m_bytesPerPixel] : 0;
+            int predictor = 0;
+            switch (filterType) {
+            case 0:
+                break;
+            case 1:
+                predictor = left;
+                break;
+            case 2:
+                predictor = up;
+                break;
+            case 3:
+                predictor = (left + up) / 2;
+                break;
+            case 4: {
+                const int estimate = left + up - upLeft;
+                const int leftDistance = std::abs(estimate - left);
+                const int upDistance = std::abs(estimate - up);
+                const int upLeftDistance = std::abs(estimate - upLeft);
+                if (leftDistance <= upDistance && leftDistance <= upLeftDistance) {
+                    predictor = left;
+                } else if (upDistance <= upLeftDistance) {
+                    predictor = up;
+                } else {
+                    predictor = upLeft;
+                }
+                break;
+            }
+            default:
+                return false;
+            }
+            current[i] = static_cast<uint8_t>(current[i] + predictor);
+        }
+
+        const int previewRow = static_cast<int>(static_cast<uint64_t>(m_rowIndex) * m_previewHeight / m_height);
+        if (previewRow != m_previewRowIndex) {
+            flushPreviewRow();
+            m_previewRowIndex = previewRow;
+        }
+
+        for (uint32_t x = 0; x < m_width; ++x) {
+            const uint8_t* pixel = current + x * m_bytesPerPixel;
+            std::array<uint8_t, 4> rgba {};
+            switch (m_colorType) {
+            case Grayscale:
+                rgba = { pixel[0], pixel[0], pixel[0], 255 };
+                break;
+            case GrayscaleAlpha:
+                rgba = { pixel[0], pixel[0], pixel[0], pixel[1] };
+                break;
+            case Indexed:
+                rgba = m_palette[pixel[0]];
+                break;
+            case Truecolor:
+                rgba = { pixel[0], pixel[1], pixel[2], 255 };
+                break;
+            default:
+                rgba = { pixel[0], pixel[1], pixel[2], pixel[3] };
+                break;
+            }
+
+            const std::size_t previewX = static_cast<std::size_t>(static_cast<uint64_t>(x) * m_previewWidth / m_width);
+            for (std::size_t channel = 0; channel < 4; ++channel) {
+                m_sums[previewX * 4 + channel] += rgba[channel];
+            }
+            ++m_counts[previewX];
+        }
+
+        std::copy(current, current + stride, m_previousRow.begin());
+        ++m_rowIndex;
+        return true;
+    }
+
+    void flushPreviewRow()
+    {
+        for (std::size_t x = 0; x < m_counts.size(); ++x) {
+            const uint32_t count = std::max<uint32_t>(m_counts[x], 1);
+            for (std::size_t channel = 0; channel < 4; ++channel) {
+                m_preview += static_cast<char>(m_sums[x * 4 + channel] / count);
+            }
+        }
+        std::fill(m_sums.begin(), m_sums.end(), 0);
+        std::fill(m_counts.begin(), m_counts.end(), 0);
+    }
+};
+
+std::optional<std::string> Thumbnailer::createPngPreview(std::istream& input)
+{
+    std::array<char, PNG_SIGNATURE.size()> signature {};
+    if (!input.read(signature.data(), signature.size()) || std::string_view(signature.data(), signature.size()) != PNG_SIGNATURE) {
+        return std::nullopt;
+    }
+
+    std::optional<PngPreviewDecoder> decoder;
+    std::string palette;
+    std::vector<char> buffer(32 * 1024);
+
+    while (true) {
+        std::array<unsigned char, 8> chunkHeader {};
+        if (!input.read(reinterpret_cast<char*>(chunkHeader.data()), chunkHeader.size())) {
+            return std::nullopt;
+        }
+        const uint32_t length = readUint32(chunkHeader.data());
+        const std::string_view type(reinterpret_cast<const char*>(chunkHeader.data() + 4), 4);
+        if (length > MAX_PNG_CHUNK_SIZE) {
+            return std::nullopt;
+        }
+
+        if (type == "IHDR") {
+            std::array<unsigned char, 13> header {};
+            if (length != header.size() || !input.read(reinterpret_cast<char*>(header.data()), header.size())) {
+                return std::nullopt;
+            }
+            const uint32_t width = readUint32(header.data());
+            const uint32_t height = readUint32(header.data() + 4);
+            const uint8_t bitDepth = header[8];
+            const uint8_t colorType = header[9];
+            const uint8_t interlaceMethod = header[12];
+
+            bool isSupportedColorType = colorType == Grayscale || colorType == Truecolor || colorType == Indexed || colorType == GrayscaleAlpha || colorType == TruecolorAlpha;
+            if (width == 0 || height == 0 || width > MAX_PNG_WIDTH || static_cast<uint64_t>(width) * height > MAX_PNG_PIXELS
+                || bitDepth != 8 || !isSupportedColorType || interlaceMethod != 0) {
+                return std::nullopt;
+            }
+            decoder.emplace(width, height, colorType);
+        } else if (type == "PLTE" || type == "tRNS") {
+            // The size is checked before anything is allocated for it.
+            if (type == "PLTE" ? length > MAX_PNG_PALETTE_SIZE || length % 3 != 0 : length > MAX_PNG_PALETTE_ALPHA_SIZE) {
+                return std::nullopt;
+            }
+            std::string data(length, '\0');
+            if (!input.read(data.data(), static_cast<std::streamsize>(length)) || !decoder) {
+                return std::nullopt;
+            }
+            if (type == "PLTE") {
+                decoder->setPalette(data);
+            } else {
+                // Only palette transparency is supported. Images with a single
+                // transparent color are shown as opaque.
+                decoder->setPaletteAlpha(data);
+            }
+        } else if (type == "IDAT") {
+            if (!decoder) {
+                return std::nullopt;
+            }
+            for (uint32_t remaining = length; remaining > 0;) {
+                const auto amount = static_cast<std::streamsize>(std::min<std::size_t>(remaining, buffer.size()));
+                if (!input.read(buffer.data(), amount) || !decoder->addData(buffer.data(), static_cast<std::size_t>(amount))) {
+                    return std::nullopt;
+                }
+                remaining -= static_cast<uint32_t>(amount);
+            }
+        } else if (type == "IEND") {
+            break;
+        } else {
+            input.ignore(length);
+        }
+
+        // Skip the CRC. Corrupted data will most likely fail to decompress.
+        input.ignore(4);
+    }
+
+    if (!decoder) {
+        return std::nullopt;
+    }
+    auto pixels = decoder->finish();
+    if (!pixels) {
+        return std::nullopt;
+    }
+    return encodePng(decoder->previewWidth(), decoder->previewHeight(), *pixels);
+}
+
+/**
+ * Gets the length of the UTF-8 sequence that starts with the given byte.
+ *
+ * \return The length, or 0 if the byte can't start a sequence.
+ */
+static int utf8SequenceLength(unsigned char byte)
+{
+    if (byte < 0x80) {
+        return 1;
+    }
+    if (byte >= 0xc2 && byte <= 0xdf) {
+        return 2;
+    }
+    if (byte >= 0xe0 && byte <= 0xef) {
+        return 3;
+    }
+    if (byte >= 0xf0 && byte <= 0xf4) {
+        return 4;
+    }
+    return 0;
+}
+
+std::optional<std::string> Thumbnailer::createTextPreview(std::istream& input)
+{
+    std::string text(TEXT_PREVIEW_BYTES, '\0');
+    input.read(text.data(), static_cast<std::streamsize>(text.size()));
+    text.resize(static_cast<std::size_t>(input.gcount()));
+
+    // Check that this is really text: UTF-8 with no null characters. The last
+    // character may have been cut off by the size limit.
+    for (std::size_t i = 0; i < text.size();) {
+        auto byte = static_cast<unsigned char>(text[i]);
+        int length = utf8SequenceLength(byte);
+        if (byte == 0 || length == 0) {
+            return std::nullopt;
+        }
+        if (i + length > text.size()) {
+            text.resize(i);
+            break;
+        }
+        for (int j = 1; j < length; ++j) {
+            if ((static_cast<unsigned char>(text[i + j]) & 0xc0) != 0x80) {
+                return std::nullopt;
+            }
+        }
+        i += length;
+    }
+
+    std::string svg = "<svg xmlns=\"http://www.w3.org/2000/svg\" width=\"" + std::to_string(PREVIEW_SIZE) + "\" height=\"" + std::to_string(PREVIEW_SIZE)
+        + "\"><rect width=\"100%\" height=\"100%\" fill=\"#ffffff\"/>"
+          "<text font-family=\"monospace\" font-size=\"8\" fill=\"#333333\" xml:space=\"preserve\">";
+
+    int lineCount = 0;
+    int column = 0;
+    std::string line;
+    auto finishLine = [&] {
+        svg += "<tspan x=\"4\" y=\"" + std::to_string(12 + lineCount * 10) + "\">" + line + "</tspan>";
+        line.clear();
+        column = 0;
+        ++lineCount;
+    };
+
+    for (std::size_t i = 0; i < text.size() && lineCount < TEXT_PREVIEW_LINES;) {
+        const char character = text[i];
+        const int length = utf8SequenceLength(static_cast<unsigned char>(character));
+        if (character == '\n') {
+            finishLine();
+        } else if (column < TEXT_PREVIEW_COLUMNS) {
+            switch (character) {
+            case '&':
+                line += "&amp;";
+                break;
+            case '<':
+                line += "&lt;";
+                break;
+            case '>':
+                line += "&gt;";
+                break;
+            case '\t':
+                line += "    ";
+                column += 3;
+                break;
+            default:
+                // Other control characters can't be shown, and aren't allowed
+                // in XML.
+                if (static_cast<unsigned char>(character) >= 0x20 && character != 0x7f) {
+                    line.append(text, i, length);
+                } else {
+                    --column;
+                }
+                break;
+            }
+            ++column;
+        }
+        i += length;
+    }
+    if (!line.empty() && lineCount < TEXT_PREVIEW_LINES) {
+        finishLine();
+    }
+
+    svg += "</text></svg>";
+    return svg;
+}
+
+std::string Thumbnailer::encodePng(int width, int height, const std::string& pixels)
+{
+    auto appendChunk = [](std::string& output, std::string_view type, const std::string& data) {
+        appendUint32(output, static_cast<uint32_t>(data.size()));
+        std::string typeAndData = std::string(type) + data;
+        output += typeAndData;
+        appendUint32(output, static_cast<uint32_t>(crc32(0, reinterpret_cast<const Bytef*>(typeAndData.data()), static_cast<uInt>(typeAndData.size()))));
+    };
+
+    std::string header;
+    appendUint32(header, static_cast<uint32_t>(width));
+    appendUint32(header, static_cast<uint32_t>(height));
+    header += '\x08'; // bit depth
+    header += static_cast<char>(TruecolorAlpha);
+    header += '\0'; // compression method
+    header += '\0'; // filter method
+    header += '\0'; // interlace method
+
+    // Each row starts with its filter type, which is always "none" here.
+    const std::size_t stride = static_cast<std::size_t>(width) * 4;
+    std::string rows;
+    rows.reserve((stride + 1) * height);
+    for (int y = 0; y < height; ++y) {
+        rows += '\0';
+        rows.append(pixels, static_cast<std::size_t>(y) * stride, stride);
+    }
+
+    uLongf compressedSize = compressBound(static_cast<uLong>(rows.size()));
+    std::string compressed(compressedSize, '\0');
+    compress2(reinterpret_cast<Bytef*>(compressed.data()), &compressedSize, reinterpret_cast<const Bytef*>(rows.data()), static_cast<uLong>(rows.size()), Z_BEST_COMPRESSION);
+    compressed.resize(compressedSize);
+
+    std::string png(PNG_SIGNATURE);
+    appendChunk(png, "IHDR", header);
+    appendChunk(png, "IDAT", compressed);
+    appendChunk(png, "IEND", "");
+    return png;
+}
@@ -0,0 +1,58 @@
+/**
+ * \class Thumbnailer
+ *
+ * Creates small preview images of file contents.
+ *
+ * Everything is done with local code (and zlib), without any external image
+ * libraries. Inputs are read as a stream, and only a couple of rows of an
+ * image are kept in memory at once, so large files don't use much memory.
+ *
+ * \date 2026-10-19 (last updated)
+ */
+
+#pragma once
+
+#include <istream>
+#include <optional>
+#include <string>
+
+class Thumbnailer {
+public:
+    Thumbnailer() = delete;
+
+    /**
+     * The largest width or height of a generated preview, in pixels.
+     */
+    constexpr static int PREVIEW_SIZE = 128;
+
+    /**
+     * Creates a scaled-down copy of a PNG image.
+     *
+     * Only non-interlaced images with 8 bits per channel are supported, which
+     * covers most PNG files in practice.
+     *
+     * \param input The PNG image to read.
+     * \return      The preview as a PNG image, or an empty optional if the
+     *              image is not supported.
+     */
+    static std::optional<std::string> createPngPreview(std::istream& input);
+
+    /**
+     * Creates an image of the first few lines of a text file.
+     *
+     * \param input The text to read.
+     * \return      The preview as an SVG image, or an empty optional if the
+     *              input is not UTF-8 text.
+     */
+    static std::optional<std::string> createTextPreview(std::istream& input);
+
+    /**
+     * Encodes an RGBA image as a PNG file.
+     *
+     * \param width  The width of the image.
+     * \param height The height of the image.
+     * \param pixels The pixels of the image, 4 bytes each, row by row.
+     * \return       The PNG file.
+     */
+    static std::string encodePng(int width, int height, const std::string& pixels);
+};
@@ -4,12 +4,25 @@
 #include <Wt/Dbo/Transaction.h>
 #include <memory>
 #include <stdexcept>
+#include <string>
+#include <utility>
 #include "Folder.h"
+#include "Histogram.h"
+#include "Metrics.h"
+
+// bcrypt is deliberately slow, so it is worth knowing how much time it takes
+// from handling requests.
+static Histogram& getPasswordHashHistogram()
+{
+    static auto& histogram = Metrics::instance().getHistogram("cgs_password_hash_duration_seconds", "Time taken to hash or check a password with bcrypt.", Metrics::Unit::Microseconds);
+    return histogram;
+}
 
 User::User(std::string username, const std::string& password)
     : m_username(std::move(username))
-    , m_passwordHash(m_hashFunction.compute(password, ""))
 {
+    Metrics::ScopedTimer timer(getPasswordHashHistogram());
+    m_passwordHash = m_hashFunction.compute(password, "");
 }
 
 Wt::Dbo::ptr<User> User::findByUsername(Wt::Dbo::Session& databaseSession, const std::string& username)
@@ -20,12 +33,30 @@ Wt::Dbo::ptr<User> User::findByUsername(Wt::Dbo::Session& databaseSession, const
     return user;
 }
 
+Wt::Dbo::ptr<User> User::create(Wt::Dbo::Session& databaseSession, std::string username, const std::string& password)
+{
+    if (findByUsername(databaseSession, username)) {
+        throw std::runtime_error("Username is already taken.");
+    }
+
+    auto user = databaseSession.addNew<User>(std::move(username), password);
+    const std::string rootFolderName = "~root";
+    auto rootFolder = databaseSession.addNew<Folder>(rootFolderName, user, nullptr);
+
+    rootFolder.flush();
+    user.modify()->setRootFolder(rootFolder);
+
+    return user;
+}
+
 bool User::isPasswordCorrect(const std::string& password) const
 {
+    Metrics::ScopedTimer timer(getPasswordHashHistogram());
     return m_hashFunction.verify(password, "", m_passwordHash);
 }
 
 void User::setPassword(const std::string& password)
 {
+    Metrics::ScopedTimer timer(getPasswordHashHistogram());
     m_passwordHash = m_hashFunction.compute(password, "");
 }
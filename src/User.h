@@ -15,6 +15,7 @@
 #include <cstdint>
 #include <string>
 #include <utility>
+#include "SessionMemory.h"
 
 class Folder;
 
@@ -25,6 +26,7 @@ private:
     std::string m_username;
     std::string m_passwordHash;
     Wt::Dbo::ptr<Folder> m_rootFolder;
+    SessionMemory::Tracker<User> m_memoryTracker;
 
 public:
     /**
@@ -53,6 +55,19 @@ public:
      */
     static Wt::Dbo::ptr<User> findByUsername(Wt::Dbo::Session& databaseSession, const std::string& username);
 
+    /**
+     * Creates a new user along with their root folder.
+     *
+     * This must be called inside a transaction.
+     *
+     * \param databaseSession The database session to use.
+     * \param username        The username of the new user.
+     * \param password        The password of the new user.
+     * \return                The new user.
+     * \exception std::runtime_error If the username is already taken.
+     */
+    static Wt::Dbo::ptr<User> create(Wt::Dbo::Session& databaseSession, std::string username, const std::string& password);
+
     /**
      * Gets the username of this user.
      *
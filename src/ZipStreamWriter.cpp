@@ -0,0 +1,301 @@
+#include "ZipStreamWriter.h"
+
+#include <zlib.h>
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <ctime>
+#include <limits>
+#include <stdexcept>
+#include <string>
+
+// Reference: https://pkware.cachefly.net/webdocs/casestudies/APPNOTE.TXT
+
+constexpr uint32_t LOCAL_HEADER_SIGNATURE = 0x04034b50;
+constexpr uint32_t DATA_DESCRIPTOR_SIGNATURE = 0x08074b50;
+constexpr uint32_t CENTRAL_HEADER_SIGNATURE = 0x02014b50;
+constexpr uint32_t ZIP64_END_SIGNATURE = 0x06064b50;
+constexpr uint32_t ZIP64_LOCATOR_SIGNATURE = 0x07064b50;
+constexpr uint32_t END_SIGNATURE = 0x06054b50;
+
+constexpr uint16_t FLAG_DATA_DESCRIPTOR = 0x0008;
+constexpr uint16_t FLAG_UTF8_NAMES = 0x0800;
+
+constexpr uint16_t VERSION_DEFAULT = 20;
+constexpr uint16_t VERSION_ZIP64 = 45;
+constexpr uint16_t ZIP64_EXTRA_FIELD_ID = 0x0001;
+
+constexpr uint16_t MAX_UINT16 = std::numeric_limits<uint16_t>::max();
+constexpr uint32_t MAX_UINT32 = std::numeric_limits<uint32_t>::max();
+
+// Raw deflate (no zlib header), as required by the ZIP format.
+constexpr int DEFLATE_WINDOW_BITS = -15;
+constexpr int DEFLATE_MEMORY_LEVEL = 8;
+
+ZipStreamWriter::ZipStreamWriter(Method method)
+    : m_method(method)
+{
+    if (m_method == Method::Deflate) {
+        int result = deflateInit2(&m_deflateStream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, DEFLATE_WINDOW_BITS, DEFLATE_MEMORY_LEVEL, Z_DEFAULT_STRATEGY);
+        if (result != Z_OK) {
+            throw std::runtime_error("ZipStreamWriter: Failed to initialize deflate");
+        }
+    }
+
+    // Every entry gets the time at which the archive was created.
+    std::time_t now = std::time(nullptr);
+    std::tm localTime {};
+    localtime_r(&now, &localTime);
+    m_dosTime = static_cast<uint16_t>((localTime.tm_hour << 11) | (localTime.tm_min << 5) | (localTime.tm_sec / 2));
+    m_dosDate = static_cast<uint16_t>(((localTime.tm_year - 80) << 9) | ((localTime.tm_mon + 1) << 5) | localTime.tm_mday);
+}
+
+ZipStreamWriter::~ZipStreamWriter()
+{
+    if (m_method == Method::Deflate) {
+        deflateEnd(&m_deflateStream);
+    }
+}
+
+void ZipStreamWriter::addDirectory(const std::string& path)
+{
+    if (m_isFileOpen || m_isFinished) {
+        throw std::logic_error("ZipStreamWriter: Cannot add a directory now");
+    }
+
+    Entry entry;
+    entry.path = path;
+    entry.headerOffset = m_offset;
+    writeLocalHeader(entry);
+    m_entries.push_back(std::move(entry));
+}
+
+void ZipStreamWriter::beginFile(const std::string& path)
+{
+    if (m_isFileOpen || m_isFinished) {
+        throw std::logic_error("ZipStreamWriter: Cannot begin a file now");
+    }
+
+    Entry entry;
+    entry.path = path;
+    entry.method = m_method;
+    entry.hasDataDescriptor = true;
+    entry.crc = crc32(0, nullptr, 0);
+    entry.headerOffset = m_offset;
+    writeLocalHeader(entry);
+    m_entries.push_back(std::move(entry));
+    m_isFileOpen = true;
+}
+
+void ZipStreamWriter::write(const char* data, std::size_t size)
+{
+    if (!m_isFileOpen) {
+        throw std::logic_error("ZipStreamWriter: No file is open");
+    }
+
+    auto& entry = m_entries.back();
+    while (size > 0) {
+        // zlib takes 32-bit lengths, so split up anything larger.
+        auto chunkSize = static_cast<uInt>(std::min<std::size_t>(size, MAX_UINT32));
+        const auto* bytes = reinterpret_cast<const Bytef*>(data);
+        entry.crc = crc32(entry.crc, bytes, chunkSize);
+        entry.uncompressedSize += chunkSize;
+
+        if (entry.method == Method::Deflate) {
+            m_deflateStream.next_in = const_cast<Bytef*>(bytes);
+            m_deflateStream.avail_in = chunkSize;
+            writeCompressed(Z_NO_FLUSH);
+        } else {
+            append(data, chunkSize);
+            entry.compressedSize += chunkSize;
+        }
+
+        data += chunkSize;
+        size -= chunkSize;
+    }
+}
+
+void ZipStreamWriter::endFile()
+{
+    if (!m_isFileOpen) {
+        throw std::logic_error("ZipStreamWriter: No file is open");
+    }
+
+    auto& entry = m_entries.back();
+    if (entry.method == Method::Deflate) {
+        m_deflateStream.next_in = nullptr;
+        m_deflateStream.avail_in = 0;
+        writeCompressed(Z_FINISH);
+        deflateReset(&m_deflateStream);
+    }
+
+    // Streamed entries can't go back and patch in ZIP64 sizes, so individual
+    // files are limited to 4 GiB. The archive as a whole is not.
+    if (entry.compressedSize >= MAX_UINT32 || entry.uncompressedSize >= MAX_UINT32) {
+        throw std::runtime_error("ZipStreamWriter: File is too large to be streamed: " + entry.path);
+    }
+
+    appendUint32(DATA_DESCRIPTOR_SIGNATURE);
+    appendUint32(entry.crc);
+    appendUint32(static_cast<uint32_t>(entry.compressedSize));
+    appendUint32(static_cast<uint32_t>(entry.uncompressedSize));
+    m_isFileOpen = false;
+}
+
+void ZipStreamWriter::finish()
+{
+    if (m_isFileOpen || m_isFinished) {
+        throw std::logic_error("ZipStreamWriter: Cannot finish now");
+    }
+
+    const uint64_t centralDirectoryOffset = m_offset;
+    for (const auto& entry : m_entries) {
+        // Only the fields that overflow are moved to the ZIP64 extra field.
+        std::string zip64Extra;
+        auto addZip64Value = [&zip64Extra](uint64_t value) {
+            for (int i = 0; i < 8; ++i) {
+                zip64Extra += static_cast<char>((value >> (i * 8)) & 0xff);
+            }
+        };
+        bool needsZip64 = entry.headerOffset >= MAX_UINT32;
+        if (needsZip64) {
+            addZip64Value(entry.headerOffset);
+        }
+
+        appendUint32(CENTRAL_HEADER_SIGNATURE);
+        appendUint16(needsZip64 ? VERSION_ZIP64 : VERSION_DEFAULT); // version made by (MS-DOS)
+        appendUint16(needsZip64 ? VERSION_ZIP64 : VERSION_DEFAULT); // version needed to extract
+        appendUint16(FLAG_UTF8_NAMES | (entry.hasDataDescriptor ? FLAG_DATA_DESCRIPTOR : 0));
+        appendUint16(static_cast<uint16_t>(entry.method));
+        appendUint16(m_dosTime);
+        appendUint16(m_dosDate);
+        appendUint32(entry.crc);
+        appendUint32(static_cast<uint32_t>(entry.compressedSize));
+        appendUint32(static_cast<uint32_t>(entry.uncompressedSize));
+        appendUint16(static_cast<uint16_t>(entry.path.size()));
+        appendUint16(static_cast<uint16_t>(zip64Extra.empty() ? 0 : zip64Extra.size() + 4));
+        appendUint16(0); // comment length
+        appendUint16(0); // disk number
+        appendUint16(0); // internal attributes
+        appendUint32(entry.path.ends_with('/') ? 0x10 : 0); // external attributes (MS-DOS directory flag)
+        appendUint32(needsZip64 ? MAX_UINT32 : static_cast<uint32_t>(entry.headerOffset));
+        append(entry.path.data(), entry.path.size());
+        if (!zip64Extra.empty()) {
+            appendUint16(ZIP64_EXTRA_FIELD_ID);
+            appendUint16(static_cast<uint16_t>(zip64Extra.size()));
+            append(zip64Extra.data(), zip64Extra.size());
+        }
+    }
+    const uint64_t centralDirectorySize = m_offset - centralDirectoryOffset;
+    const uint64_t entryCount = m_entries.size();
+
+    bool needsZip64 = entryCount >= MAX_UINT16 || centralDirectoryOffset >= MAX_UINT32 || centralDirectorySize >= MAX_UINT32;
+    if (needsZip64) {
+        const uint64_t zip64EndOffset = m_offset;
+        constexpr uint64_t ZIP64_END_RECORD_SIZE = 44; // excludes the signature and this field
+
+        appendUint32(ZIP64_END_SIGNATURE);
+        appendUint64(ZIP64_END_RECORD_SIZE);
+        appendUint16(VERSION_ZIP64);
+        appendUint16(VERSION_ZIP64);
+        appendUint32(0); // this disk
+        appendUint32(0); // disk with the central directory
+        appendUint64(entryCount);
+        appendUint64(entryCount);
+        appendUint64(centralDirectorySize);
+        appendUint64(centralDirectoryOffset);
+
+        appendUint32(ZIP64_LOCATOR_SIGNATURE);
+        appendUint32(0); // disk with the ZIP64 end record
+        appendUint64(zip64EndOffset);
+        appendUint32(1); // total number of disks
+    }
+
+    appendUint32(END_SIGNATURE);
+    appendUint16(0); // this disk
+    appendUint16(0); // disk with the central directory
+    appendUint16(static_cast<uint16_t>(std::min<uint64_t>(entryCount, MAX_UINT16)));
+    appendUint16(static_cast<uint16_t>(std::min<uint64_t>(entryCount, MAX_UINT16)));
+    appendUint32(static_cast<uint32_t>(std::min<uint64_t>(centralDirectorySize, MAX_UINT32)));
+    appendUint32(static_cast<uint32_t>(std::min<uint64_t>(centralDirectoryOffset, MAX_UINT32)));
+    appendUint16(0); // comment length
+
+    m_entries.clear();
+    m_entries.shrink_to_fit();
+    m_isFinished = true;
+}
+
+void ZipStreamWriter::drainTo(std::ostream& out)
+{
+    out.write(m_output.data(), static_cast<std::streamsize>(m_output.size()));
+    m_output.clear();
+}
+
+void ZipStreamWriter::writeLocalHeader(const Entry& entry)
+{
+    if (entry.path.size() > MAX_UINT16) {
+        throw std::runtime_error("ZipStreamWriter: Path is too long: " + entry.path);
+    }
+
+    appendUint32(LOCAL_HEADER_SIGNATURE);
+    appendUint16(VERSION_DEFAULT);
+    appendUint16(FLAG_UTF8_NAMES | (entry.hasDataDescriptor ? FLAG_DATA_DESCRIPTOR : 0));
+    appendUint16(static_cast<uint16_t>(entry.method));
+    appendUint16(m_dosTime);
+    appendUint16(m_dosDate);
+    // The CRC and sizes are in the data descriptor for streamed entries, and
+    // are all zero for directories.
+    appendUint32(0);
+    appendUint32(0);
+    appendUint32(0);
+    appendUint16(static_cast<uint16_t>(entry.path.size()));
+    appendUint16(0); // extra field length
+    append(entry.path.data(), entry.path.size());
+}
+
+void ZipStreamWriter::writeCompressed(int flush)
+{
+    auto& entry = m_entries.back();
+    std::array<Bytef, 16 * 1024> buffer {};
+
+    int result = Z_OK;
+    do {
+        m_deflateStream.next_out = buffer.data();
+        m_deflateStream.avail_out = static_cast<uInt>(buffer.size());
+        result = deflate(&m_deflateStream, flush);
+        if (result == Z_STREAM_ERROR) {
+            throw std::runtime_error("ZipStreamWriter: Failed to deflate " + entry.path);
+        }
+
+        std::size_t produced = buffer.size() - m_deflateStream.avail_out;
+        append(reinterpret_cast<const char*>(buffer.data()), produced);
+        entry.compressedSize += produced;
+    } while (m_deflateStream.avail_out == 0 || (flush == Z_FINISH && result != Z_STREAM_END));
+}
+
+void ZipStreamWriter::append(const char* data, std::size_t size)
+{
+    m_output.append(data, size);
+    m_offset += size;
+}
+
+void ZipStreamWriter::appendUint16(uint16_t value)
+{
+    const std::array<char, 2> bytes {
+        static_cast<char>(value & 0xff),
+        static_cast<char>((value >> 8) & 0xff),
+    };
+    append(bytes.data(), bytes.size());
+}
+
+void ZipStreamWriter::appendUint32(uint32_t value)
+{
+    appendUint16(static_cast<uint16_t>(value & 0xffff));
+    appendUint16(static_cast<uint16_t>(value >> 16));
+}
+
+void ZipStreamWriter::appendUint64(uint64_t value)
+{
+    appendUint32(static_cast<uint32_t>(value & 0xffffffff));
+    appendUint32(static_cast<uint32_t>(value >> 32));
+}
@@ -0,0 +1,124 @@
+/**
+ * \class ZipStreamWriter
+ *
+ * Produces a ZIP archive incrementally, one entry at a time.
+ *
+ * The writer never seeks backwards: entries are written with a trailing data
+ * descriptor, so the CRC and sizes don't need to be known until the entry has
+ * been fully written. This allows the archive to be streamed directly to a
+ * client while the entries are still being read.
+ *
+ * Produced bytes are accumulated in an internal buffer that must be drained
+ * regularly with `drainTo`. Apart from that buffer, the writer only keeps one
+ * small central directory record per entry.
+ *
+ * \date 2026-10-19 (last updated)
+ */
+
+#pragma once
+
+#include <zlib.h>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+class ZipStreamWriter {
+public:
+    /**
+     * The compression method used for file entries.
+     */
+    enum class Method : uint16_t {
+        Stored = 0,
+        Deflate = 8,
+    };
+
+    /**
+     * Creates a new writer with no entries.
+     *
+     * \param method The compression method to use for file entries.
+     */
+    explicit ZipStreamWriter(Method method);
+
+    ~ZipStreamWriter();
+
+    ZipStreamWriter(const ZipStreamWriter&) = delete;
+    ZipStreamWriter& operator=(const ZipStreamWriter&) = delete;
+
+    /**
+     * Adds an empty directory entry.
+     *
+     * \param path The path of the directory inside the archive, which should
+     *             end with a `/`.
+     */
+    void addDirectory(const std::string& path);
+
+    /**
+     * Starts a new file entry. Its content is given with `write`, and the entry
+     * must be completed with `endFile` before any other entry is added.
+     *
+     * \param path The path of the file inside the archive.
+     */
+    void beginFile(const std::string& path);
+
+    /**
+     * Appends content to the current file entry.
+     *
+     * \param data The data to append.
+     * \param size The number of bytes in `data`.
+     */
+    void write(const char* data, std::size_t size);
+
+    /**
+     * Completes the current file entry.
+     */
+    void endFile();
+
+    /**
+     * Writes the central directory. No entries may be added afterwards.
+     */
+    void finish();
+
+    /**
+     * Gets the number of produced bytes that haven't been drained yet.
+     *
+     * \return The number of buffered bytes.
+     */
+    std::size_t bufferedSize() const { return m_output.size(); }
+
+    /**
+     * Writes all buffered bytes to a stream and clears the buffer.
+     *
+     * \param out The stream to write to.
+     */
+    void drainTo(std::ostream& out);
+
+private:
+    struct Entry {
+        std::string path;
+        Method method { Method::Stored };
+        bool hasDataDescriptor { false };
+        uint32_t crc { 0 };
+        uint64_t compressedSize { 0 };
+        uint64_t uncompressedSize { 0 };
+        uint64_t headerOffset { 0 };
+    };
+
+    Method m_method;
+    z_stream m_deflateStream {};
+    bool m_isFileOpen { false };
+    bool m_isFinished { false };
+    uint16_t m_dosTime { 0 };
+    uint16_t m_dosDate { 0 };
+    uint64_t m_offset { 0 };
+    std::string m_output;
+    std::vector<Entry> m_entries;
+
+    void writeLocalHeader(const Entry& entry);
+    void writeCompressed(int flush);
+    void append(const char* data, std::size_t size);
+    void appendUint16(uint16_t value);
+    void appendUint32(uint32_t value);
+    void appendUint64(uint64_t value);
+};
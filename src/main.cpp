@@ -9,6 +9,9 @@
 #include <exception>
 #include <iostream>
 #include <memory>
+#include "ApiResource.h"
+#include "LoginResource.h"
+#include "MetricsResource.h"
 #include "SharingLink.h"
 #include "StorageApplication.h"
 #include "User.h"
@@ -40,14 +43,20 @@ int main(int argc, char** argv)
             }
         }
 
+        server.addResource(std::make_shared<ApiResource>(), "/api");
+        server.addResource(std::make_shared<MetricsResource>(), "/metrics");
+        server.addResource(std::make_shared<LoginResource>(), std::string(LoginResource::LOGIN_PATH));
+
         server.addEntryPoint(Wt::EntryPointType::Application, [](const Wt::WEnvironment& env) {
             return std::make_unique<StorageApplication>(env);
-        });
+        }, std::string(LoginResource::APPLICATION_PATH));
+        StorageApplication::startServices();
         if (server.start()) {
             int signal = Wt::WServer::waitForShutdown();
 
             std::cerr << "Server shutdown on signal " << signal << std::endl;
             server.stop();
+            StorageApplication::stopServices();
 
             if (signal == SIGHUP) {
                 Wt::WServer::restart(applicationPath, args);